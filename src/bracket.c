@@ -31,6 +31,7 @@
 #include "potfit.h"
 
 #include "bracket.h"
+#include "checkpoint.h"
 #include "force.h"
 #include "memory.h"
 #include "utils.h"
@@ -55,14 +56,17 @@ void bracket(double* x_lower, double* x_minimum, double* x_upper,
   int last = 0; /* indicates whether upwards is left or right */
   long nb_eval = 0;
 
-  static double* vecu = NULL;
-  static double* f_vec3 = NULL;
+  static POTFIT_TLS double* vecu = NULL;
+  static POTFIT_TLS double* f_vec3 = NULL;
 
   if (vecu == NULL)
     vecu = (double*)Malloc(g_calc.ndimtot * sizeof(double));
 
-  if (f_vec3 == NULL)
+  // punishment entries of earlier calls are kept, so restarts need them
+  if (f_vec3 == NULL) {
     f_vec3 = (double*)Malloc(g_calc.mdim * sizeof(double));
+    checkpoint_register("bracket", f_vec3, g_calc.mdim * sizeof(double));
+  }
 
   p_left = f_vec1;
   p_right = f_vec2;
@@ -98,8 +102,8 @@ void bracket(double* x_lower, double* x_minimum, double* x_upper,
         *f_lower = f_left;
         *f_upper = f_right;
         *f_minimum = f_center;
-        for (int i = 0; i < g_calc.mdim; i++)
-          f_vec1[i] = p_center[i];
+        for (int i = 0; i < g_calc.rdim; i++)
+          f_vec1[g_calc.res_idx[i]] = p_center[g_calc.res_idx[i]];
         return;
       } else if (f_center > f_right) {
         /* OK, go right! */
@@ -42,7 +42,7 @@
   (b) = (c);              \
   (c) = (d);
 
-extern double *xicom, *delcom;
+extern POTFIT_TLS double *xicom, *delcom;
 
 void bracket(double*, double*, double*, double*, double*, double*, double*,
              double*);
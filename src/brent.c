@@ -32,6 +32,7 @@
 #include "potfit.h"
 
 #include "bracket.h"
+#include "checkpoint.h"
 #include "force.h"
 #include "memory.h"
 #include "utils.h"
@@ -58,13 +59,16 @@ double brent(double ax, double bx, double cx, double fbx, double tol,
   double w_lower, w_upper;
   double *p_w, *p_z, *p_u, *p_temp;
 
-  static double* vecu = NULL;
-  static double* fxu = NULL; /* Vector of location u */
+  static POTFIT_TLS double* vecu = NULL;
+  static POTFIT_TLS double* fxu = NULL; /* Vector of location u */
 
   double p = 0, q = 0, r = 0;
 
-  if (fxu == NULL)
+  // punishment entries of earlier calls are kept, so restarts need them
+  if (fxu == NULL) {
     fxu = (double*)Malloc(g_calc.mdim * sizeof(double));
+    checkpoint_register("brent", fxu, g_calc.mdim * sizeof(double));
+  }
 
   if (vecu == NULL)
     vecu = (double*)Malloc(g_calc.ndimtot * sizeof(double));
@@ -92,10 +96,11 @@ double brent(double ax, double bx, double cx, double fbx, double tol,
       *xmin = z;
       *xmin2 = w;
       /* Put correct values in pointers */
-      for (j = 0; j < g_calc.mdim; j++) {
-        w_lower = p_z[j]; /* temporary storage */
-        fxmin2[j] = p_w[j];
-        fxmin[j] = w_lower;
+      for (j = 0; j < g_calc.rdim; j++) {
+        int idx = g_calc.res_idx[j];
+        w_lower = p_z[idx]; /* temporary storage */
+        fxmin2[idx] = p_w[idx];
+        fxmin[idx] = w_lower;
       }
       return f_z;
     }
@@ -0,0 +1,397 @@
+/****************************************************************
+ *
+ * checkpoint.c: binary checkpoints of the optimizer state
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+
+#include <time.h>
+
+#include "potfit.h"
+
+#include "checkpoint.h"
+#include "force.h"
+#include "memory.h"
+#include "random.h"
+
+// A checkpoint file starts with a header, followed by named records of
+// raw data and an empty record as end marker. The files are only meant
+// to be read by the same potfit binary on the same machine type.
+
+#define CHECKPOINT_MAGIC "potfitck"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_NAME_LEN 16
+#define CHECKPOINT_MAX_BUFFERS 8
+
+typedef struct {
+  char magic[8];
+  int version;
+  int stage;
+  int ndim;
+  int ndimtot;
+  int mdim;
+} checkpoint_header;
+
+typedef struct {
+  char name[CHECKPOINT_NAME_LEN];
+  size_t size;
+  void* data;
+} checkpoint_record;
+
+// checkpoint which is currently written
+static POTFIT_TLS FILE* g_ckpt_outfile = NULL;
+static POTFIT_TLS char* g_ckpt_tempname = NULL;
+static POTFIT_TLS int g_ckpt_failed = 0;
+static POTFIT_TLS time_t g_ckpt_last = 0;
+
+// registered scratch buffers
+static POTFIT_TLS checkpoint_record g_ckpt_buffers[CHECKPOINT_MAX_BUFFERS];
+static POTFIT_TLS int g_ckpt_num_buffers = 0;
+
+// checkpoint read by read_checkpoint()
+static POTFIT_TLS checkpoint_record* g_restart_records = NULL;
+static POTFIT_TLS int g_restart_num_records = 0;
+static POTFIT_TLS int g_restart_stage = 0;
+
+void write_record(const char* name, const void* data, size_t size);
+checkpoint_record* find_record(const char* name);
+void add_common_state(void);
+void restore_common_state(void);
+
+/****************************************************************
+  read_checkpoint
+    a missing file starts a new optimization, this way restart
+    can always be enabled for jobs on preemptible queues
+****************************************************************/
+
+void read_checkpoint(void)
+{
+  checkpoint_header header;
+
+  FILE* infile = fopen(g_files.checkpoint, "rb");
+
+  if (infile == NULL) {
+    warning("Checkpoint file %s not found, starting a new optimization.\n",
+            g_files.checkpoint);
+    return;
+  }
+
+  if (fread(&header, sizeof(header), 1, infile) != 1 ||
+      strncmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+    error(1, "%s is not a potfit checkpoint file.\n", g_files.checkpoint);
+
+  if (header.version != CHECKPOINT_VERSION)
+    error(1, "Checkpoint file %s has version %d, expected %d.\n",
+          g_files.checkpoint, header.version, CHECKPOINT_VERSION);
+
+  if (header.ndim != g_calc.ndim || header.ndimtot != g_calc.ndimtot ||
+      header.mdim != g_calc.mdim)
+    error(1,
+          "Checkpoint file %s does not match the potential and "
+          "configurations of this run.\n",
+          g_files.checkpoint);
+
+  while (1) {
+    checkpoint_record record;
+
+    if (fread(record.name, CHECKPOINT_NAME_LEN, 1, infile) != 1 ||
+        fread(&record.size, sizeof(size_t), 1, infile) != 1)
+      error(1, "Checkpoint file %s is truncated.\n", g_files.checkpoint);
+
+    record.name[CHECKPOINT_NAME_LEN - 1] = '\0';
+
+    if (record.size == 0)
+      break;
+
+    record.data = Malloc(record.size);
+
+    if (fread(record.data, record.size, 1, infile) != 1)
+      error(1, "Checkpoint file %s is truncated.\n", g_files.checkpoint);
+
+    g_restart_records = (checkpoint_record*)Realloc(
+        g_restart_records,
+        (g_restart_num_records + 1) * sizeof(checkpoint_record));
+    g_restart_records[g_restart_num_records++] = record;
+  }
+
+  fclose(infile);
+
+  g_restart_stage = header.stage;
+}
+
+/****************************************************************
+  checkpoint_due
+****************************************************************/
+
+int checkpoint_due(void)
+{
+  if (g_files.checkpoint == NULL)
+    return 0;
+
+  time_t now = time(NULL);
+
+  // the interval starts with the first safe point of the optimizer
+  if (g_ckpt_last == 0)
+    g_ckpt_last = now;
+
+  return difftime(now, g_ckpt_last) >= g_param.checkpoint_interval;
+}
+
+/****************************************************************
+  checkpoint_begin
+    the checkpoint is written to a temporary file, the old one is
+    only replaced after the new one is complete
+****************************************************************/
+
+void checkpoint_begin(int stage)
+{
+  checkpoint_header header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.stage = stage;
+  header.ndim = g_calc.ndim;
+  header.ndimtot = g_calc.ndimtot;
+  header.mdim = g_calc.mdim;
+
+  if (g_ckpt_tempname == NULL) {
+    g_ckpt_tempname = (char*)Malloc(strlen(g_files.checkpoint) + 5);
+    sprintf(g_ckpt_tempname, "%s.tmp", g_files.checkpoint);
+  }
+
+  g_ckpt_failed = 0;
+  g_ckpt_outfile = fopen(g_ckpt_tempname, "wb");
+
+  if (g_ckpt_outfile == NULL ||
+      fwrite(&header, sizeof(header), 1, g_ckpt_outfile) != 1)
+    g_ckpt_failed = 1;
+}
+
+/****************************************************************
+  checkpoint_add
+****************************************************************/
+
+void checkpoint_add(const char* name, const void* data, size_t size)
+{
+  if (size > 0)
+    write_record(name, data, size);
+}
+
+/****************************************************************
+  checkpoint_commit
+    failing to write a checkpoint does not stop the optimization
+****************************************************************/
+
+void checkpoint_commit(void)
+{
+  add_common_state();
+
+  // end marker
+  write_record("", NULL, 0);
+
+  if (g_ckpt_outfile != NULL && fclose(g_ckpt_outfile) != 0)
+    g_ckpt_failed = 1;
+
+  g_ckpt_outfile = NULL;
+
+  if (g_ckpt_failed || rename(g_ckpt_tempname, g_files.checkpoint) != 0) {
+    warning("Could not write checkpoint file %s\n", g_files.checkpoint);
+    remove(g_ckpt_tempname);
+  }
+
+  g_ckpt_last = time(NULL);
+}
+
+/****************************************************************
+  checkpoint_register
+****************************************************************/
+
+void checkpoint_register(const char* name, void* data, size_t size)
+{
+  // a reallocated buffer replaces the old one, it is not restored again
+  for (int i = 0; i < g_ckpt_num_buffers; i++) {
+    if (strncmp(g_ckpt_buffers[i].name, name, CHECKPOINT_NAME_LEN - 1) == 0) {
+      g_ckpt_buffers[i].size = size;
+      g_ckpt_buffers[i].data = data;
+      return;
+    }
+  }
+
+  if (g_ckpt_num_buffers == CHECKPOINT_MAX_BUFFERS)
+    error(1, "Too many checkpoint buffers, increase CHECKPOINT_MAX_BUFFERS\n");
+
+  checkpoint_record* buffer = g_ckpt_buffers + g_ckpt_num_buffers++;
+
+  strncpy(buffer->name, name, CHECKPOINT_NAME_LEN - 1);
+  buffer->size = size;
+  buffer->data = data;
+
+  // buffers are allocated on first use, which can be after the restart
+  checkpoint_record* record = find_record(buffer->name);
+
+  if (record != NULL && record->size == size)
+    memcpy(data, record->data, size);
+}
+
+/****************************************************************
+  restart_stage
+****************************************************************/
+
+int restart_stage(int stage)
+{
+  if (g_restart_stage != stage)
+    return 0;
+
+  printf("Resuming the optimization from checkpoint %s\n", g_files.checkpoint);
+
+  restore_common_state();
+
+  g_restart_stage = 0;
+
+  return 1;
+}
+
+/****************************************************************
+  restart_skip
+****************************************************************/
+
+int restart_skip(int stage) { return g_restart_stage > stage; }
+
+/****************************************************************
+  restart_get
+****************************************************************/
+
+void restart_get(const char* name, void* data, size_t size)
+{
+  if (size == 0)
+    return;
+
+  checkpoint_record* record = find_record(name);
+
+  if (record == NULL || record->size != size)
+    error(1, "Checkpoint file %s has no valid entry for %s.\n",
+          g_files.checkpoint, name);
+
+  memcpy(data, record->data, size);
+}
+
+/****************************************************************
+  write_record
+****************************************************************/
+
+void write_record(const char* name, const void* data, size_t size)
+{
+  char record_name[CHECKPOINT_NAME_LEN];
+
+  if (g_ckpt_failed)
+    return;
+
+  memset(record_name, 0, CHECKPOINT_NAME_LEN);
+  strncpy(record_name, name, CHECKPOINT_NAME_LEN - 1);
+
+  if (fwrite(record_name, CHECKPOINT_NAME_LEN, 1, g_ckpt_outfile) != 1 ||
+      fwrite(&size, sizeof(size_t), 1, g_ckpt_outfile) != 1 ||
+      (size > 0 && fwrite(data, size, 1, g_ckpt_outfile) != 1))
+    g_ckpt_failed = 1;
+}
+
+/****************************************************************
+  find_record
+****************************************************************/
+
+checkpoint_record* find_record(const char* name)
+{
+  for (int i = 0; i < g_restart_num_records; i++)
+    if (strncmp(g_restart_records[i].name, name, CHECKPOINT_NAME_LEN) == 0)
+      return g_restart_records + i;
+
+  return NULL;
+}
+
+/****************************************************************
+  add_common_state
+    state outside of the optimizer which changes during a fit
+****************************************************************/
+
+void add_common_state(void)
+{
+  static POTFIT_TLS void* rng = NULL;
+
+  if (rng == NULL)
+    rng = Malloc(rng_state_size());
+
+  get_rng_state(rng);
+
+  checkpoint_add("fcalls", &g_calc.fcalls, sizeof(int));
+  checkpoint_add("rng", rng, rng_state_size());
+
+#if !defined(APOT)
+  // rescaling changes the sampling points of tabulated potentials
+  const size_t ncols = g_pot.opt_pot.ncols * sizeof(double);
+
+  checkpoint_add("begin", g_pot.opt_pot.begin, ncols);
+  checkpoint_add("end", g_pot.opt_pot.end, ncols);
+  checkpoint_add("step", g_pot.opt_pot.step, ncols);
+  checkpoint_add("invstep", g_pot.opt_pot.invstep, ncols);
+  checkpoint_add("xcoord", g_pot.opt_pot.xcoord,
+                 g_calc.ndimtot * sizeof(double));
+#endif  // !APOT
+
+  for (int i = 0; i < g_ckpt_num_buffers; i++)
+    checkpoint_add(g_ckpt_buffers[i].name, g_ckpt_buffers[i].data,
+                   g_ckpt_buffers[i].size);
+}
+
+/****************************************************************
+  restore_common_state
+****************************************************************/
+
+void restore_common_state(void)
+{
+  void* rng = Malloc(rng_state_size());
+
+  restart_get("fcalls", &g_calc.fcalls, sizeof(int));
+  restart_get("rng", rng, rng_state_size());
+
+  set_rng_state(rng);
+
+#if !defined(APOT)
+  const size_t ncols = g_pot.opt_pot.ncols * sizeof(double);
+
+  restart_get("begin", g_pot.opt_pot.begin, ncols);
+  restart_get("end", g_pot.opt_pot.end, ncols);
+  restart_get("step", g_pot.opt_pot.step, ncols);
+  restart_get("invstep", g_pot.opt_pot.invstep, ncols);
+  restart_get("xcoord", g_pot.opt_pot.xcoord, g_calc.ndimtot * sizeof(double));
+
+#if defined(MPI)
+  // the other processes still have the sampling points of the start potential
+  calc_forces(g_pot.opt_pot.table, g_calc.force, 2);
+  restart_get("fcalls", &g_calc.fcalls, sizeof(int));
+#endif  // MPI
+#endif  // !APOT
+}
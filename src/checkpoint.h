@@ -0,0 +1,65 @@
+/****************************************************************
+ *
+ * checkpoint.h: optimizer state for restarts
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+
+// optimizer stages which can be resumed
+#define CHECKPOINT_SIMANN 1
+#define CHECKPOINT_DIFF_EVO 2
+#define CHECKPOINT_CMAES 3
+#define CHECKPOINT_POWELL 4
+
+// read the checkpoint file, called before the optimization starts
+void read_checkpoint(void);
+
+// a checkpoint is written if the checkpoint_interval has passed
+int checkpoint_due(void);
+
+// the state of one stage is written between begin and commit, the force
+// calculation counter, the pRNG and all registered buffers are added
+void checkpoint_begin(int stage);
+void checkpoint_add(const char* name, const void* data, size_t size);
+void checkpoint_commit(void);
+
+// scratch buffers which keep their content between optimizer calls,
+// the content is restored when a checkpoint contains them
+void checkpoint_register(const char* name, void* data, size_t size);
+
+// returns 1 if the checkpoint belongs to stage, the common state is
+// restored and the stage has to call restart_get() for its own state
+int restart_stage(int stage);
+
+// returns 1 if the checkpoint belongs to a stage after stage
+int restart_skip(int stage);
+
+void restart_get(const char* name, void* data, size_t size);
+
+#endif  // CHECKPOINT_H_INCLUDED
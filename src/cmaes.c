@@ -0,0 +1,539 @@
+/****************************************************************
+ *
+ * cmaes.c: Covariance matrix adaptation evolution strategy
+ *	(CMA-ES) with restarts for global optimization
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+/****************************************************************
+ *
+ *  The strategy follows N. Hansen, "The CMA Evolution Strategy:
+ *  A Tutorial", arXiv:1604.00772, with the default parameters
+ *  given there. The restarts double the population size (IPOP).
+ *
+ *  The parameters are scaled to y = (x - x_0) / s, with x_0 = pmin
+ *  and s = pmax - pmin for analytic potentials. Samples outside of
+ *  [0, 1] are mirrored back into the box before their error sum is
+ *  calculated, the strategy itself works on the unmirrored samples.
+ *  Tabulated potentials have no bounds, there x_0 = 0 and s is the
+ *  magnitude of the starting value.
+ *
+ ****************************************************************/
+
+#include "potfit.h"
+
+#if defined(CMAES)
+
+#if defined(MKL)
+#include <mkl_lapack.h>
+#elif defined(__ACCELERATE__)
+#include <Accelerate/Accelerate.h>
+#else
+#error No math library defined!
+#endif  // MKL
+
+#include "checkpoint.h"
+#include "force.h"
+#include "memory.h"
+#include "optimize.h"
+#include "random.h"
+#include "tempfile.h"
+#include "utils.h"
+
+#define TOL_X 1.0e-12   /* smallest step size in scaled coordinates */
+#define MAX_COND 1.0e14 /* largest condition number of C */
+
+// scaled coordinates and the strategy parameters of one run
+typedef struct {
+  int n;      /* number of free parameters */
+  int lambda; /* samples per generation */
+  int mu;     /* number of selected samples */
+  double* weights;
+  double mueff, cc, cs, c1, cmu, damps, chin;
+
+  double* x0;    /* origin of the scaled coordinates */
+  double* scale; /* scale of the coordinates */
+
+  // state of the strategy, contiguous for checkpoints
+  double* state;
+  double* mean;
+  double* pc; /* evolution path of C */
+  double* ps; /* evolution path of sigma */
+  double* D;  /* square roots of the eigenvalues of C */
+  double* C;  /* covariance matrix */
+  double* B;  /* eigenvectors of C, one per row */
+} cmaes_t;
+
+void cmaes_init(cmaes_t* es, int lambda);
+void cmaes_to_params(const cmaes_t* es, const double* y, double* xi);
+void cmaes_update(cmaes_t* es, double** y, const int* order, double* sigma,
+                  int gen);
+int cmaes_eigen(cmaes_t* es);
+
+/****************************************************************
+ *
+ *  set the strategy parameters for lambda samples
+ *
+ ****************************************************************/
+
+void cmaes_init(cmaes_t* es, int lambda)
+{
+  const double n = es->n;
+
+  es->lambda = lambda;
+  es->mu = lambda / 2;
+
+  es->weights = (double*)Malloc(es->mu * sizeof(double));
+
+  double sum = 0.0;
+  double sum2 = 0.0;
+
+  for (int i = 0; i < es->mu; i++) {
+    es->weights[i] = log(0.5 * (lambda + 1)) - log(i + 1.0);
+    sum += es->weights[i];
+  }
+
+  for (int i = 0; i < es->mu; i++) {
+    es->weights[i] /= sum;
+    sum2 += dsquare(es->weights[i]);
+  }
+
+  es->mueff = 1.0 / sum2;
+  es->cc = (4.0 + es->mueff / n) / (n + 4.0 + 2.0 * es->mueff / n);
+  es->cs = (es->mueff + 2.0) / (n + es->mueff + 5.0);
+  es->c1 = 2.0 / (dsquare(n + 1.3) + es->mueff);
+  es->cmu = MIN(1.0 - es->c1, 2.0 * (es->mueff - 2.0 + 1.0 / es->mueff) /
+                                  (dsquare(n + 2.0) + es->mueff));
+  es->damps =
+      1.0 + 2.0 * MAX(0.0, sqrt((es->mueff - 1.0) / (n + 1.0)) - 1.0) + es->cs;
+  es->chin = sqrt(n) * (1.0 - 1.0 / (4.0 * n) + 1.0 / (21.0 * n * n));
+}
+
+/****************************************************************
+ *
+ *  parameter vector of the scaled sample y
+ *
+ ****************************************************************/
+
+void cmaes_to_params(const cmaes_t* es, const double* y, double* xi)
+{
+  for (int j = 0; j < es->n; j++) {
+#if defined(APOT)
+    // mirror into [0, 1]
+    double t = fmod(fabs(y[j]), 2.0);
+    if (t > 1.0)
+      t = 2.0 - t;
+#else
+    double t = y[j];
+#endif  // APOT
+    xi[g_pot.opt_pot.idx[j]] = es->x0[j] + t * es->scale[j];
+  }
+}
+
+/****************************************************************
+ *
+ *  eigendecomposition C = B^T diag(D^2) B, returns 0 on failure
+ *
+ ****************************************************************/
+
+int cmaes_eigen(cmaes_t* es)
+{
+  char jobz[1] = "V";
+  char uplo[1] = "L";
+  int n = es->n;
+  int lwork = 3 * n;
+  int info = 0;
+  static POTFIT_TLS double* work = NULL;
+
+  if (work == NULL)
+    work = (double*)Malloc(lwork * sizeof(double));
+
+  // the symmetric C is the same in row and column major order and the
+  // eigenvectors are returned in the columns of the column major array
+  memcpy(es->B, es->C, n * n * sizeof(double));
+
+#if defined(MKL)
+  dsyev(jobz, uplo, &n, es->B, &n, es->D, work, &lwork, &info);
+#elif defined(__ACCELERATE__)
+  dsyev_(jobz, uplo, &n, es->B, &n, es->D, work, &lwork, &info);
+#endif  // MKL
+
+  if (info != 0)
+    return 0;
+
+  for (int i = 0; i < n; i++)
+    es->D[i] = sqrt(MAX(es->D[i], 0.0));
+
+  return 1;
+}
+
+/****************************************************************
+ *
+ *  move the mean to the weighted best samples and adapt the
+ *  evolution paths, the covariance matrix and the step size
+ *
+ ****************************************************************/
+
+void cmaes_update(cmaes_t* es, double** y, const int* order, double* sigma,
+                  int gen)
+{
+  const int n = es->n;
+  double yw[n];
+  double t[n];
+
+  for (int i = 0; i < n; i++) {
+    double m = 0.0;
+    for (int k = 0; k < es->mu; k++)
+      m += es->weights[k] * y[order[k]][i];
+    yw[i] = (m - es->mean[i]) / *sigma;
+  }
+
+  // C^(-1/2) yw
+  for (int k = 0; k < n; k++) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+      sum += es->B[k * n + i] * yw[i];
+    t[k] = (es->D[k] > 0.0) ? sum / es->D[k] : 0.0;
+  }
+
+  double norm_ps = 0.0;
+  const double fs = sqrt(es->cs * (2.0 - es->cs) * es->mueff);
+
+  for (int i = 0; i < n; i++) {
+    double sum = 0.0;
+    for (int k = 0; k < n; k++)
+      sum += es->B[k * n + i] * t[k];
+    es->ps[i] = (1.0 - es->cs) * es->ps[i] + fs * sum;
+    norm_ps += dsquare(es->ps[i]);
+  }
+
+  norm_ps = sqrt(norm_ps);
+
+  // stall the update of pc if ps is too long
+  const int hsig = norm_ps / sqrt(1.0 - pow(1.0 - es->cs, 2.0 * (gen + 1))) /
+                       es->chin <
+                   1.4 + 2.0 / (n + 1.0);
+  const double fc = sqrt(es->cc * (2.0 - es->cc) * es->mueff);
+
+  for (int i = 0; i < n; i++)
+    es->pc[i] = (1.0 - es->cc) * es->pc[i] + hsig * fc * yw[i];
+
+  // rank-one and rank-mu update
+  const double c_old = 1.0 - es->c1 - es->cmu +
+                       (1 - hsig) * es->c1 * es->cc * (2.0 - es->cc);
+
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j <= i; j++) {
+      double rank_mu = 0.0;
+      for (int k = 0; k < es->mu; k++)
+        rank_mu += es->weights[k] * (y[order[k]][i] - es->mean[i]) *
+                   (y[order[k]][j] - es->mean[j]);
+      double c = c_old * es->C[i * n + j] + es->c1 * es->pc[i] * es->pc[j] +
+                 es->cmu * rank_mu / dsquare(*sigma);
+      es->C[i * n + j] = c;
+      es->C[j * n + i] = c;
+    }
+  }
+
+  for (int i = 0; i < n; i++)
+    es->mean[i] += *sigma * yw[i];
+
+  *sigma *= exp(es->cs / es->damps * (norm_ps / es->chin - 1.0));
+}
+
+/****************************************************************
+ *
+ *  CMA-ES
+ *
+ ****************************************************************/
+
+void run_cma_es(double* xi)
+{
+  cmaes_t es;
+  const int n = g_calc.ndim;
+
+  int run = 0;
+  int gen = 0;
+  int eigen_gen = 0;
+  int lambda = g_param.cmaes_lambda;
+  double sigma = g_param.cmaes_sigma;
+  double min_cost = 10e10;
+
+  if (g_param.cmaes_threshold == 0.0 || n == 0)
+    return;
+
+  if (lambda == 0)
+    lambda = 4 + (int)(3.0 * log((double)n));
+
+  es.n = n;
+  es.x0 = (double*)Malloc(n * sizeof(double));
+  es.scale = (double*)Malloc(n * sizeof(double));
+  es.state = (double*)Malloc((4 * n + 2 * n * n) * sizeof(double));
+  es.mean = es.state;
+  es.pc = es.state + n;
+  es.ps = es.state + 2 * n;
+  es.D = es.state + 3 * n;
+  es.C = es.state + 4 * n;
+  es.B = es.state + 4 * n + n * n;
+
+  for (int j = 0; j < n; j++) {
+    double val = xi[g_pot.opt_pot.idx[j]];
+#if defined(APOT)
+    es.x0[j] = g_pot.apot_table
+                   .pmin[g_pot.apot_table.idxpot[j]][g_pot.apot_table.idxparam[j]];
+    es.scale[j] =
+        g_pot.apot_table
+            .pmax[g_pot.apot_table.idxpot[j]][g_pot.apot_table.idxparam[j]] -
+        es.x0[j];
+#else
+    es.x0[j] = 0.0;
+    es.scale[j] = (val != 0.0) ? fabs(val) : 1.0;
+#endif  // APOT
+    es.mean[j] = (es.scale[j] > 0.0) ? (val - es.x0[j]) / es.scale[j] : 0.0;
+  }
+
+  // best parameters and the costs of the best sample of each generation
+  double* best = (double*)Malloc(g_calc.ndimtot * sizeof(double));
+  memcpy(best, xi, g_calc.ndimtot * sizeof(double));
+
+  const int hist_max = 10 + (int)ceil(30.0 * n / 4.0);
+  double* history = (double*)Malloc(hist_max * sizeof(double));
+  int hist_len = 0;
+
+  int resumed = restart_stage(CHECKPOINT_CMAES);
+
+  if (resumed) {
+    restart_get("run", &run, sizeof(int));
+    restart_get("gen", &gen, sizeof(int));
+    restart_get("eigen_gen", &eigen_gen, sizeof(int));
+    restart_get("lambda", &lambda, sizeof(int));
+    restart_get("sigma", &sigma, sizeof(double));
+    restart_get("min_cost", &min_cost, sizeof(double));
+    restart_get("best", best, g_calc.ndimtot * sizeof(double));
+    restart_get("state", es.state, (4 * n + 2 * n * n) * sizeof(double));
+    restart_get("hist_len", &hist_len, sizeof(int));
+    restart_get("history", history, hist_max * sizeof(double));
+  }
+
+  // the buffers of the samples are allocated once for the largest
+  // population, every restart doubles it
+  int lambda_max = lambda;
+  for (int i = run; i < g_param.cmaes_restarts; i++)
+    lambda_max *= 2;
+
+  // samples in scaled coordinates and as parameter vectors
+  double** y = (double**)Malloc(lambda_max * sizeof(double*));
+  double** trial = (double**)Malloc(lambda_max * sizeof(double*));
+  double** forces = (double**)Malloc(lambda_max * sizeof(double*));
+  double* cost = (double*)Malloc(lambda_max * sizeof(double));
+  int* order = (int*)Malloc(lambda_max * sizeof(int));
+
+  for (int k = 0; k < lambda_max; k++) {
+    y[k] = (double*)Malloc(n * sizeof(double));
+    trial[k] = (double*)Malloc(g_calc.ndimtot * sizeof(double));
+    memcpy(trial[k], xi, g_calc.ndimtot * sizeof(double));
+    forces[k] = (double*)Malloc(g_calc.mdim * sizeof(double));
+  }
+
+  if (!resumed)
+    min_cost = calc_forces(xi, forces[0], 0);
+
+  printf("Run\tLoops\tSamples\t\tOptimum\t\tAverage error sum\tsigma\n");
+  fflush(stdout);
+
+  int stop = 0;
+
+  for (; run <= g_param.cmaes_restarts && !stop; run++) {
+    cmaes_init(&es, lambda);
+
+    if (!resumed) {
+      gen = 0;
+      eigen_gen = 0;
+      hist_len = 0;
+      sigma = g_param.cmaes_sigma;
+      for (int i = 0; i < n; i++) {
+        es.pc[i] = 0.0;
+        es.ps[i] = 0.0;
+        es.D[i] = 1.0;
+        for (int j = 0; j < n; j++) {
+          es.C[i * n + j] = (i == j) ? 1.0 : 0.0;
+          es.B[i * n + j] = (i == j) ? 1.0 : 0.0;
+        }
+      }
+      // restarts begin at the best parameters found so far
+      if (run > 0) {
+        for (int j = 0; j < n; j++)
+          es.mean[j] = (es.scale[j] > 0.0) ? (best[g_pot.opt_pot.idx[j]] -
+                                              es.x0[j]) / es.scale[j]
+                                           : 0.0;
+      }
+    }
+    resumed = 0;
+
+    const int hist_run = MIN(hist_max, 10 + (int)ceil(30.0 * n / lambda));
+    const int max_gen =
+        100 + (int)(150.0 * dsquare(n + 3.0) / sqrt((double)lambda));
+    const double eigen_gap = lambda / (es.c1 + es.cmu) / n / 10.0;
+    const char* reason = "maximum number of generations";
+
+    while (gen < max_gen) {
+      // sample the generation
+      for (int k = 0; k < lambda; k++) {
+        double z[n];
+        for (int i = 0; i < n; i++)
+          z[i] = es.D[i] * normdist();
+        for (int i = 0; i < n; i++) {
+          double sum = 0.0;
+          for (int j = 0; j < n; j++)
+            sum += es.B[j * n + i] * z[j];
+          y[k][i] = es.mean[i] + sigma * sum;
+        }
+        cmaes_to_params(&es, y[k], trial[k]);
+      }
+
+      // the samples are independent and evaluated in batches
+      calc_forces_batch(trial, forces, cost, lambda);
+
+      // rank the samples
+      for (int k = 0; k < lambda; k++) {
+        int pos = k;
+        while (pos > 0 && cost[order[pos - 1]] > cost[k]) {
+          order[pos] = order[pos - 1];
+          pos--;
+        }
+        order[pos] = k;
+      }
+
+      if (cost[order[0]] < min_cost) {
+        min_cost = cost[order[0]];
+        memcpy(best, trial[order[0]], g_calc.ndimtot * sizeof(double));
+        update_tempfile(best);
+      }
+
+      cmaes_update(&es, y, order, &sigma, gen);
+      gen++;
+
+      if (gen - eigen_gen > eigen_gap) {
+        eigen_gen = gen;
+        if (!cmaes_eigen(&es)) {
+          reason = "failed eigendecomposition";
+          break;
+        }
+      }
+
+      if (hist_len == hist_run) {
+        memmove(history, history + 1, (hist_run - 1) * sizeof(double));
+        hist_len--;
+      }
+      history[hist_len++] = cost[order[0]];
+
+      if (gen % 10 == 0) {
+        double cost_sum = 0.0;
+        for (int k = 0; k < lambda; k++)
+          cost_sum += cost[k];
+        printf("%3d\t%5d\t%7d\t%15f\t%20f\t%.2e\n", run, gen, lambda, min_cost,
+               cost_sum / lambda, sigma);
+        fflush(stdout);
+      }
+
+      /* End optimization if break flagfile exists */
+      if (break_flagfile()) {
+        printf("\nCMA-ES terminated ");
+        printf("in presence of break flagfile \"%s\"!\n\n", g_files.flagfile);
+        reason = "stopped by flag file";
+        stop = 1;
+        break;
+      }
+
+      if (min_cost < g_param.cmaes_threshold) {
+        reason = "threshold reached";
+        stop = 1;
+        break;
+      }
+
+      // the best costs of the last generations and this generation
+      // differ by less than the threshold
+      double fmin = cost[order[0]];
+      double fmax = cost[order[lambda - 1]];
+      for (int i = 0; i < hist_len; i++) {
+        fmin = MIN(fmin, history[i]);
+        fmax = MAX(fmax, history[i]);
+      }
+      if (hist_len == hist_run && fmax - fmin < g_param.cmaes_threshold) {
+        reason = "no further improvement";
+        break;
+      }
+
+      double dmin = es.D[0];
+      double dmax = es.D[0];
+      for (int i = 1; i < n; i++) {
+        dmin = MIN(dmin, es.D[i]);
+        dmax = MAX(dmax, es.D[i]);
+      }
+      if (sigma * dmax < TOL_X) {
+        reason = "step size too small";
+        break;
+      }
+      if (dsquare(dmax) > MAX_COND * dsquare(dmin)) {
+        reason = "covariance matrix ill-conditioned";
+        break;
+      }
+
+      /* save the state after this generation for a restart */
+      if (checkpoint_due()) {
+        checkpoint_begin(CHECKPOINT_CMAES);
+        checkpoint_add("run", &run, sizeof(int));
+        checkpoint_add("gen", &gen, sizeof(int));
+        checkpoint_add("eigen_gen", &eigen_gen, sizeof(int));
+        checkpoint_add("lambda", &lambda, sizeof(int));
+        checkpoint_add("sigma", &sigma, sizeof(double));
+        checkpoint_add("min_cost", &min_cost, sizeof(double));
+        checkpoint_add("best", best, g_calc.ndimtot * sizeof(double));
+        checkpoint_add("state", es.state,
+                       (4 * n + 2 * n * n) * sizeof(double));
+        checkpoint_add("hist_len", &hist_len, sizeof(int));
+        checkpoint_add("history", history, hist_max * sizeof(double));
+        checkpoint_commit();
+      }
+    }
+
+    printf("Run %d finished after %d generations (%s), optimum %f\n", run, gen,
+           reason, min_cost);
+    fflush(stdout);
+
+    // IPOP: the next run uses twice as many samples
+    lambda *= 2;
+  }
+
+  printf("Finished CMA-ES.\n");
+  fflush(stdout);
+
+  memcpy(xi, best, g_calc.ndimtot * sizeof(double));
+
+  flush_tempfile();
+}
+
+#endif  // CMAES
@@ -28,6 +28,7 @@
  ****************************************************************/
 
 #include <float.h>
+#include <stdint.h>
 
 #include "potfit.h"
 
@@ -35,6 +36,11 @@
 #include "memory.h"
 #include "utils.h"
 
+typedef struct {
+  uint32_t key;
+  int index;
+} morton_key;
+
 typedef struct {
   const char* filename;
   int atom_count;
@@ -49,6 +55,10 @@ typedef struct {
   vector cell_scale;
   int have_box_vector;
   sym_tens* stresses;
+  int* file_index; /* position in the config file of each sorted atom */
+  morton_key* sort_keys; /* scratch arrays of sort_atoms */
+  atom_t* sort_copy;
+  int sort_len;          /* number of atoms they can hold */
 #if defined(CONTRIB)
   int have_contrib_box_vector;
   int n_spheres;
@@ -59,14 +69,24 @@ typedef struct {
 #endif  // CONTRIB
 } config_state;
 
+// index of an atom inside the current config as given in the config file
+#define FILE_INDEX(cstate, i)                                         \
+  ((cstate)->file_index != NULL ? (cstate)->file_index[(i)-g_config.natoms] \
+                                : (i)-g_config.natoms)
+
 void reset_cstate(config_state* cstate);
 void create_memory_for_configs(const char* filename);
 void init_atom_memory(atom_t* atom);
 void read_box_vector(char const* pline, vector* pvect, const char* name, config_state* cstate);
 void read_chemical_elements(char* psrc, config_state* cstate);
 void init_box_vectors(config_state* cstate);
+void sort_atoms(config_state* cstate);
+uint32_t morton_spread(uint32_t x);
+int compare_morton_keys(const void* a, const void* b);
 void init_neighbors(config_state* cstate, double* mindist);
 void set_neighbor_slot(neigh_t* neighbor, int col, double r, int neighbor_slot);
+int compare_neighbors(const void* a, const void* b);
+void update_neighbor_ends(void);
 void init_angles(config_state* cstate);
 
 double make_box(config_state* cstate);
@@ -380,6 +400,9 @@ void read_config(const char* filename)
 
     init_box_vectors(&cstate);
 
+    if (g_param.sort_atoms)
+      sort_atoms(&cstate);
+
     init_neighbors(&cstate, mindist);
 
     init_angles(&cstate);
@@ -503,17 +526,45 @@ void read_config(const char* filename)
   if (g_param.write_pair == 1)
     write_pair_distribution_file();
 
-/* assign correct distances to different tables */
+  // check if all potentials have atoms in their interaction range
+  for (int i = 0; i < g_param.ntypes; i++)
+    for (int j = 0; j < g_param.ntypes; j++) {
+      k = (i <= j) ? i * g_param.ntypes + j - ((i * (i + 1)) / 2)
+                   : j * g_param.ntypes + i - ((j * (j + 1)) / 2);
+      if (mindist[k] == DBL_MAX)
+        error(1, "No atoms found in interaction range for potential %d!", k);
+    }
+
+  g_config.mindist = mindist;
+
 #if defined(APOT)
+  // assign correct distances to different tables
+  init_potential_ranges();
+#elif !defined(KIM)
+  update_neighbor_ends();
+#endif  // APOT
+
+  print_minimal_distances_matrix(mindist);
+}
+
+#if defined(APOT)
+
+/****************************************************************
+  init_potential_ranges:
+    adjust the ranges of the analytic potentials to the minimal
+    distances found in the configurations and update the slots
+****************************************************************/
+
+void init_potential_ranges(void)
+{
+  const double* mindist = g_config.mindist;
   double min = DBL_MAX;
 
   /* pair potentials */
   for (int i = 0; i < g_param.ntypes; i++) {
     for (int j = 0; j < g_param.ntypes; j++) {
-      k = (i <= j) ? i * g_param.ntypes + j - ((i * (i + 1)) / 2)
-                   : j * g_param.ntypes + i - ((j * (j + 1)) / 2);
-      if (mindist[k] == DBL_MAX)
-        error(1, "No atoms found in interaction range for potential %d!", k);
+      int k = (i <= j) ? i * g_param.ntypes + j - ((i * (i + 1)) / 2)
+                       : j * g_param.ntypes + i - ((j * (j + 1)) / 2);
       g_config.rmin[i * g_param.ntypes + j] = mindist[k];
       g_pot.apot_table.begin[k] = mindist[k] * 0.95;
       g_pot.opt_pot.begin[k] = mindist[k] * 0.95;
@@ -612,25 +663,8 @@ void read_config(const char* filename)
 #if !defined(KIM)
   update_slots();
 #endif  // KIM
-
-#else  // APOT
-
-  // check if all potentials have atoms in their interaction range
-  for (int i = 0; i < g_param.ntypes; i++)
-    for (int j = 0; j < g_param.ntypes; j++) {
-      k = (i <= j) ? i * g_param.ntypes + j - ((i * (i + 1)) / 2)
-                   : j * g_param.ntypes + i - ((j * (j + 1)) / 2);
-      if (mindist[k] == DBL_MAX)
-        error(1, "No atoms found in interaction range for potential %d!", k);
-    }
-
-#endif  // APOT
-
-  print_minimal_distances_matrix(mindist);
 }
 
-#if defined(APOT)
-
 /****************************************************************
   update_slots:
     recalculate the slots of the atoms for analytic potential
@@ -671,6 +705,14 @@ void update_slots(void)
       update_neighbor_slots(g_config.atoms[i].neigh + j, r, 3);
 #endif  // ADP
 
+#if defined(REV_SLOT)
+      // update slots for reverse transfer functions
+      update_neighbor_slots(g_config.atoms[i].neigh + j, r, REV_SLOT);
+#if defined(TBEAM)
+      update_neighbor_slots(g_config.atoms[i].neigh + j, r, REV_SLOT + 1);
+#endif  // TBEAM
+#endif  // REV_SLOT
+
     }  // end loop over all neighbors
   }    // end loop over all atoms
 
@@ -713,6 +755,9 @@ void update_slots(void)
   }
 #endif  // THREEBODY && ANG
 
+  // the cutoff radii might have changed
+  update_neighbor_ends();
+
 #if defined(STIWEB)
   g_pot.apot_table.sw.init = 0;
 #endif  // STIWEB
@@ -833,6 +878,8 @@ void create_memory_for_configs(const char* filename)
 
   g_config.inconf = (int*)Malloc(config_count * sizeof(int));
   g_config.cnfstart = (int*)Malloc(config_count * sizeof(int));
+  if (g_param.sort_atoms)
+    g_config.atom_order = (int*)Malloc(atom_count * sizeof(int));
   g_config.useforce = (int*)Malloc(config_count * sizeof(int));
   g_config.na_type = (int**)Malloc((config_count + 1) * sizeof(int*));
   for (int i = 0; i <= config_count; ++i)
@@ -998,6 +1045,97 @@ void init_box_vectors(config_state* cstate)
 #endif  // DEBUG
 }
 
+/****************************************************************
+  sort_atoms
+    reorder the atoms of the current configuration along a Morton
+    (Z-order) curve through the box
+
+    the neighbor lists are built afterwards, so the neighbors of an
+    atom and the atoms written to by the force and density loops are
+    close in memory; the reference forces move with their atoms and
+    atom_order maps the order of the config file to the new one for
+    the output
+****************************************************************/
+
+void sort_atoms(config_state* cstate)
+{
+  const int count = cstate->atom_count;
+  atom_t* atoms = g_config.atoms + g_config.natoms;
+
+  // the arrays are reused for all configurations
+  if (count > cstate->sort_len) {
+    cstate->sort_keys = (morton_key*)Realloc(cstate->sort_keys,
+                                             count * sizeof(morton_key));
+    cstate->sort_copy =
+        (atom_t*)Realloc(cstate->sort_copy, count * sizeof(atom_t));
+    cstate->file_index =
+        (int*)Realloc(cstate->file_index, count * sizeof(int));
+    cstate->sort_len = count;
+  }
+
+  morton_key* keys = cstate->sort_keys;
+  atom_t* copy = cstate->sort_copy;
+
+  for (int i = 0; i < count; i++) {
+    // fractional coordinates, 10 bits per direction
+    double s[3] = {SPROD(atoms[i].pos, cstate->tbox_x),
+                   SPROD(atoms[i].pos, cstate->tbox_y),
+                   SPROD(atoms[i].pos, cstate->tbox_z)};
+    uint32_t q[3];
+
+    for (int j = 0; j < 3; j++) {
+      s[j] -= floor(s[j]);
+      q[j] = MIN((uint32_t)(s[j] * 1024.0), 1023);
+    }
+
+    keys[i].key = morton_spread(q[0]) | (morton_spread(q[1]) << 1) |
+                  (morton_spread(q[2]) << 2);
+    keys[i].index = i;
+  }
+
+  qsort(keys, count, sizeof(morton_key), compare_morton_keys);
+
+  memcpy(copy, atoms, count * sizeof(atom_t));
+
+  for (int i = 0; i < count; i++) {
+    atoms[i] = copy[keys[i].index];
+    cstate->file_index[i] = keys[i].index;
+    g_config.atom_order[g_config.natoms + keys[i].index] = g_config.natoms + i;
+  }
+}
+
+/****************************************************************
+  morton_spread
+    insert two zero bits after each of the lower 10 bits of x
+****************************************************************/
+
+uint32_t morton_spread(uint32_t x)
+{
+  x &= 0x000003ff;
+  x = (x | (x << 16)) & 0xff0000ff;
+  x = (x | (x << 8)) & 0x0300f00f;
+  x = (x | (x << 4)) & 0x030c30c3;
+  x = (x | (x << 2)) & 0x09249249;
+
+  return x;
+}
+
+/****************************************************************
+  compare_morton_keys
+    atoms in the same cell keep the order of the config file
+****************************************************************/
+
+int compare_morton_keys(const void* a, const void* b)
+{
+  const morton_key* k1 = (const morton_key*)a;
+  const morton_key* k2 = (const morton_key*)b;
+
+  if (k1->key != k2->key)
+    return (k1->key < k2->key) ? -1 : 1;
+
+  return k1->index - k2->index;
+}
+
 /****************************************************************
   init_neighbors
 ****************************************************************/
@@ -1047,10 +1185,10 @@ void init_neighbors(config_state* cstate, double* mindist)
               if (r <= g_config.rmin[type1 * g_param.ntypes + type2]) {
                 warning("Configuration %i: Distance %f\n", cstate->config, r);
                 warning(" atom %d (type %d) at pos: %f %f %f\n",
-                        i - g_config.natoms, type1, g_config.atoms[i].pos.x,
+                        FILE_INDEX(cstate, i), type1, g_config.atoms[i].pos.x,
                         g_config.atoms[i].pos.y, g_config.atoms[i].pos.z);
                 warning(" atom %d (type %d) at pos: %f %f %f\n",
-                        j - g_config.natoms, type2, dd.x, dd.y, dd.z);
+                        FILE_INDEX(cstate, j), type2, dd.x, dd.y, dd.z);
               }
               num_neigh++;
             }
@@ -1091,10 +1229,10 @@ void init_neighbors(config_state* cstate, double* mindist)
               if (r <= g_config.rmin[type1 * g_param.ntypes + type2]) {
                 warning("Configuration %i: Distance %f\n", cstate->config, r);
                 warning(" atom %d (type %d) at pos: %f %f %f\n",
-                        i - g_config.natoms, type1, g_config.atoms[i].pos.x,
+                        FILE_INDEX(cstate, i), type1, g_config.atoms[i].pos.x,
                         g_config.atoms[i].pos.y, g_config.atoms[i].pos.z);
                 warning(" atom %d (type %d) at pos: %f %f %f\n",
-                        j - g_config.natoms, type2, dd.x, dd.y, dd.z);
+                        FILE_INDEX(cstate, j), type2, dd.x, dd.y, dd.z);
               }
               dd.x /= r;
               dd.y /= r;
@@ -1149,6 +1287,18 @@ void init_neighbors(config_state* cstate, double* mindist)
 #endif  // TBEAM
 #endif  // EAM || ADP || MEAM
 
+#if defined(REV_SLOT)
+              /* transfer function - reverse direction */
+              col = g_calc.paircol + type1;
+              set_neighbor_slot(g_config.atoms[i].neigh + k, col, r, REV_SLOT);
+#if defined(TBEAM)
+              /* transfer function - d band, reverse direction */
+              col = g_calc.paircol + 2 * g_param.ntypes + type1;
+              set_neighbor_slot(g_config.atoms[i].neigh + k, col, r,
+                                REV_SLOT + 1);
+#endif  // TBEAM
+#endif  // REV_SLOT
+
 #if defined(MEAM)
               /* Store slots and stuff for f(r_ij) */
               col = g_calc.paircol + 2 * g_param.ntypes +
@@ -1188,9 +1338,57 @@ void init_neighbors(config_state* cstate, double* mindist)
     if (num_neigh != 0 && num_neigh != g_config.atoms[i].num_neigh) {
       error(1, "Neigh count mismatch!!");
     }
+
+    // the force routines only loop over the neighbors in range
+    qsort(g_config.atoms[i].neigh, g_config.atoms[i].num_neigh,
+          sizeof(neigh_t), compare_neighbors);
   }             /* first loop over atoms */
 }
 
+/****************************************************************
+  compare_neighbors
+    sort the neighbors of an atom by distance
+****************************************************************/
+
+int compare_neighbors(const void* a, const void* b)
+{
+  const neigh_t* n1 = (const neigh_t*)a;
+  const neigh_t* n2 = (const neigh_t*)b;
+
+  if (n1->r != n2->r)
+    return (n1->r < n2->r) ? -1 : 1;
+
+  return n1->nr - n2->nr;
+}
+
+/****************************************************************
+  update_neighbor_ends
+    for each slot count the neighbors up to the last one inside the
+    range of its column; the neighbor lists are sorted by distance,
+    so all neighbors after it are out of range for this slot
+
+    with several atom types the neighbors before the end can still
+    be out of range, this is why the force routines keep their
+    range checks
+****************************************************************/
+
+void update_neighbor_ends(void)
+{
+  for (int i = 0; i < g_config.natoms; i++) {
+    atom_t* atom = g_config.atoms + i;
+
+    for (int k = 0; k < SLOTS; k++) {
+      int end = atom->num_neigh;
+
+      while (end > 0 && atom->neigh[end - 1].r >=
+                            g_pot.calc_pot.end[atom->neigh[end - 1].col[k]])
+        end--;
+
+      atom->neigh_end[k] = end;
+    }
+  }
+}
+
 /****************************************************************
   set_neighbor_slot
     compute box transformation matrix
@@ -33,6 +33,7 @@
 void read_config(const char* filename);
 
 #if defined(APOT)
+void init_potential_ranges(void);
 void update_slots(void);
 void update_neighbor_slots(neigh_t* neighbor, double r, int neighbor_slot);
 #endif  // APOT
@@ -73,47 +73,69 @@
  *      0 ... pair distance
  *      1 ... f(r_ij)
  *
- *  EAM:        SLOTS = 2
+ *  EAM:        SLOTS = 3
  *      0 ... pair distance
  *      1 ... transfer function
+ *      2 ... transfer function of the central atom (reverse direction)
  *
  *  STIWEB:     SLOTS = 2
  *      0 ... pair distance
  *      1 ... exponential functions
  *
- *  TBEAM:      SLOTS = 3
+ *  TBEAM:      SLOTS = 5
  *      0 ... pair distance
  *      1 ... transfer function
  *      2 ... 2nd transfer function
+ *      3 ... transfer function of the central atom (reverse direction)
+ *      4 ... 2nd transfer function of the central atom (reverse direction)
  *
  *  MEAM:       SLOTS = 3
  *      0 ... pair distance
  *      1 ... transfer function
  *      2 ... f(r_ij)
  *
- *  ADP:        SLOTS = 4
+ *  ADP:        SLOTS = 5
  *      0 ... pair distance
  *      1 ... transfer function
  *      2 ... dipole term
  *      3 ... quadrupole term
+ *      4 ... transfer function of the central atom (reverse direction)
+ *
+ *  EAM and ADP use half neighbor lists, the density of the neighbor is
+ *  accumulated from the same entry. REV_SLOT is the slot of the transfer
+ *  function in reverse direction (the s-band one follows at REV_SLOT + 1).
  *
  ****************************************************************/
 
 #define SLOTS 1
 
-#if defined(EAM) || defined(STIWEB) || defined(ANG)
+#if defined(STIWEB) || defined(ANG)
 #undef SLOTS
 #define SLOTS 2
-#endif  // EAM || STIWEB || ANG
+#endif  // STIWEB || ANG
+
+#if defined(EAM)
+#undef SLOTS
+#define SLOTS 3
+#define REV_SLOT 2
+#endif  // EAM
 
-#if defined(TBEAM) || defined(MEAM)
+#if defined(MEAM)
 #undef SLOTS
 #define SLOTS 3
-#endif  // TBEAM || MEAM
+#endif  // MEAM
+
+#if defined(TBEAM)
+#undef SLOTS
+#undef REV_SLOT
+#define SLOTS 5
+#define REV_SLOT 3
+#endif  // TBEAM
 
 #if defined(ADP)
 #undef SLOTS
-#define SLOTS 4
+#define SLOTS 5
+#define REV_SLOT 4
 #endif  // ADP
 
 #endif  // DEFINES_H_INCLUDED
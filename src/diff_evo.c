@@ -32,12 +32,14 @@
 
 #if defined(EVO)
 
+#include "checkpoint.h"
 #include "force.h"
 #include "memory.h"
 #include "optimize.h"
-#include "potential_output.h"
 #include "random.h"
 #include "rescale.h"
+#include "surrogate.h"
+#include "tempfile.h"
 #include "utils.h"
 
 #define D (g_calc.ndimtot + 2)
@@ -51,6 +53,7 @@
 #define TAU_1 0.1   /* probability for changing F */
 #define TAU_2 0.1   /* probability for changing CR */
 
+void population_cost(double** population, double* cost, int num);
 #if defined(APOT)
 void opposite_check(double** population, double* cost, int do_init);
 void quicksort(double* cost, int start, int end, double** population);
@@ -102,16 +105,34 @@ void init_population(double** pop, double* xi, double* cost)
     }
   }
 
-  double forces[g_calc.mdim];
-
-  for (int i = 0; i < NP; i++)
-    cost[i] = calc_forces(pop[i], forces, 0);
+  population_cost(pop, cost, NP);
 
 #if defined(APOT)
   opposite_check(pop, cost, 1);
 #endif  // APOT
 }
 
+/****************************************************************
+ *
+ *  calculate the cost of num independent individuals,
+ *  FORCE_BATCH of them share one sweep over the neighbor lists
+ *
+ ****************************************************************/
+
+void population_cost(double** population, double* cost, int num)
+{
+  static POTFIT_TLS double* forces[FORCE_BATCH];
+
+  if (forces[0] == NULL) {
+    for (int k = 0; k < FORCE_BATCH; k++)
+      forces[k] = (double*)Malloc(g_calc.mdim * sizeof(double));
+  }
+
+  for (int i = 0; i < num; i += FORCE_BATCH)
+    calc_forces_batch(population + i, forces, cost + i,
+                      MIN(FORCE_BATCH, num - i));
+}
+
 #if defined(APOT)
 
 /****************************************************************
@@ -122,14 +143,13 @@ void init_population(double** pop, double* xi, double* cost)
 
 void opposite_check(double** population, double* cost, int do_init)
 {
-  double fxi[g_calc.mdim];
   double min = 0.0;
   double max = 0.0;
   double minp[g_calc.ndim];
   double maxp[g_calc.ndim];
 
-  static double* tot_cost;  // cost of two populations
-  static double** tot_P;    // two populations
+  static POTFIT_TLS double* tot_cost;  // cost of two populations
+  static POTFIT_TLS double** tot_P;    // two populations
 
   // allocate memory if not done yet
   if (tot_P == NULL) {
@@ -188,8 +208,7 @@ void opposite_check(double** population, double* cost, int do_init)
   for (int i = 0; i < NP; i++)
     tot_cost[i] = cost[i];
 
-  for (int i = NP; i < 2 * NP; i++)
-    tot_cost[i] = calc_forces(tot_P[i], fxi, 0);
+  population_cost(tot_P + NP, tot_cost + NP, NP);
 
   // evaluate the NP best individuals from both populations
   // sort with quicksort and return NP best indivuals
@@ -257,7 +276,7 @@ int partition(double* cost, int low, int high, int index, double** population)
 void swap_population(double* pop_1, double* pop_2)
 {
   int size = (g_calc.ndimtot + 2) * sizeof(double);
-  static double* temp = NULL;
+  static POTFIT_TLS double* temp = NULL;
 
   if (temp == NULL)
     temp = (double*)Malloc((g_calc.ndimtot + 2) * sizeof(double));
@@ -312,28 +331,58 @@ void run_differential_evolution(double* xi)
     pop_2[i] = (double*)Malloc(D * sizeof(double));
   }
 
-  printf("Initializing population ... ");
-  fflush(stdout);
+  // contiguous copy of the population for checkpoints
+  double* population = NULL;
 
-  init_population(pop_1, xi, cost);
+  if (g_files.checkpoint != NULL)
+    population = (double*)Malloc(NP * D * sizeof(double));
 
-  for (int i = 0; i < NP; i++) {
-    if (cost[i] < min_cost) {
-      min_cost = cost[i];
-      memcpy(best, pop_1[i], D * sizeof(double));
-    }
-    if (cost[i] > max_cost)
-      max_cost = cost[i];
+  surrogate_init();
 
-    cost_sum += cost[i];
-  }
+  if (restart_stage(CHECKPOINT_DIFF_EVO)) {
+    restart_get("count", &count, sizeof(int));
+    restart_get("crit", &crit, sizeof(double));
+    restart_get("min_cost", &min_cost, sizeof(double));
+    restart_get("xi", xi, g_calc.ndimtot * sizeof(double));
+    restart_get("trial", trial, D * sizeof(double));
+    restart_get("best", best, D * sizeof(double));
+    restart_get("cost", cost, NP * sizeof(double));
+    restart_get("population", population, NP * D * sizeof(double));
+    for (int i = 0; i < NP; i++)
+      memcpy(pop_1[i], population + i * D, D * sizeof(double));
+#if defined(APOT)
+    restart_get("jump_steps", &jump_steps, sizeof(int));
+    restart_get("jump_rate", &jump_rate, sizeof(double));
+#endif  // APOT
 
-  printf("done\n");
+    printf("Loops\t\tOptimum\t\tAverage error sum\t\tMax-Min\n");
+  } else {
+    printf("Initializing population ... ");
+    fflush(stdout);
+
+    init_population(pop_1, xi, cost);
+
+    for (int i = 0; i < NP; i++) {
+      surrogate_add(pop_1[i], cost[i]);
 
-  crit = max_cost - min_cost;
+      if (cost[i] < min_cost) {
+        min_cost = cost[i];
+        memcpy(best, pop_1[i], D * sizeof(double));
+      }
+      if (cost[i] > max_cost)
+        max_cost = cost[i];
 
-  printf("Loops\t\tOptimum\t\tAverage error sum\t\tMax-Min\n");
-  printf("%5d\t\t%15f\t%20f\t\t%.2e\n", count, min_cost, cost_sum / (NP), crit);
+      cost_sum += cost[i];
+    }
+
+    printf("done\n");
+
+    crit = max_cost - min_cost;
+
+    printf("Loops\t\tOptimum\t\tAverage error sum\t\tMax-Min\n");
+    printf("%5d\t\t%15f\t%20f\t\t%.2e\n", count, min_cost, cost_sum / (NP),
+           crit);
+  }
   fflush(stdout);
 
   // main differential evolution loop
@@ -427,22 +476,24 @@ void run_differential_evolution(double* xi)
         j = (j + 1) % g_calc.ndim;
       }
 
+      // keep the parent if the model predicts no improvement
+      if (!surrogate_screen(trial, cost[i])) {
+        memcpy(pop_2[i], pop_1[i], D * sizeof(double));
+
+        if (cost[i] > max_cost)
+          max_cost = cost[i];
+
+        continue;
+      }
+
       double force = calc_forces(trial, forces, 0);
 
+      surrogate_add(trial, force);
+
       if (force < min_cost) {
         memcpy(best, trial, D * sizeof(double));
 
-        if (g_files.tempfile && strlen(g_files.tempfile)) {
-          for (j = 0; j < g_calc.ndim; j++)
-#if defined(APOT)
-            g_pot.apot_table.values[g_pot.apot_table.idxpot[j]]
-                                   [g_pot.apot_table.idxparam[j]] =
-                trial[g_pot.opt_pot.idx[j]];
-#else
-            xi[g_pot.opt_pot.idx[j]] = trial[g_pot.opt_pot.idx[j]];
-#endif  // APOT
-          write_pot_table_potfit(g_files.tempfile);
-        }
+        update_tempfile(trial);
         min_cost = force;
       }
 
@@ -488,25 +539,45 @@ void run_differential_evolution(double* xi)
     count++;
 
     /* End optimization if break flagfile exists */
-    if (g_files.flagfile && strlen(g_files.flagfile)) {
-      FILE* ff = fopen(g_files.flagfile, "r");
-
-      if (NULL != ff) {
-        printf("\nEvolutionary algorithm terminated ");
-        printf("in presence of break flagfile \"%s\"!\n\n", g_files.flagfile);
-        fclose(ff);
-        remove(g_files.flagfile);
-        break;
-      }
+    if (break_flagfile()) {
+      printf("\nEvolutionary algorithm terminated ");
+      printf("in presence of break flagfile \"%s\"!\n\n", g_files.flagfile);
+      break;
     }
 
     crit = max_cost - min_cost;
+
+    /* save the state after this generation for a restart */
+    if (crit >= g_param.evo_threshold && min_cost >= g_param.evo_threshold &&
+        checkpoint_due()) {
+      for (int i = 0; i < NP; i++)
+        memcpy(population + i * D, pop_1[i], D * sizeof(double));
+
+      checkpoint_begin(CHECKPOINT_DIFF_EVO);
+      checkpoint_add("count", &count, sizeof(int));
+      checkpoint_add("crit", &crit, sizeof(double));
+      checkpoint_add("min_cost", &min_cost, sizeof(double));
+      checkpoint_add("xi", xi, g_calc.ndimtot * sizeof(double));
+      checkpoint_add("trial", trial, D * sizeof(double));
+      checkpoint_add("best", best, D * sizeof(double));
+      checkpoint_add("cost", cost, NP * sizeof(double));
+      checkpoint_add("population", population, NP * D * sizeof(double));
+#if defined(APOT)
+      checkpoint_add("jump_steps", &jump_steps, sizeof(int));
+      checkpoint_add("jump_rate", &jump_rate, sizeof(double));
+#endif  // APOT
+      checkpoint_commit();
+    }
   }
 
   printf("Finished differential evolution.\n");
   fflush(stdout);
 
+  surrogate_report();
+
   memcpy(xi, best, g_calc.ndimtot * sizeof(double));
+
+  flush_tempfile();
 }
 
 #endif  // EVO
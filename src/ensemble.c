@@ -0,0 +1,288 @@
+/****************************************************************
+ *
+ * ensemble.c: multi-start fits over one set of configurations
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <ctype.h>
+
+#include "potfit.h"
+
+#include "ensemble.h"
+#include "force.h"
+#include "memory.h"
+#include "optimize.h"
+#include "potential_input.h"
+#include "potential_output.h"
+#include "random.h"
+
+typedef struct {
+  int member;
+  int seed;
+  int finished;         // survived the culling and was optimized to the end
+  int fcalls;           // force calculations of this member
+  double start_error;   // error sum of the starting point
+  double global_error;  // after simulated annealing or differential evolution
+  double error;         // after the powell minimization
+  double* table;        // parameters of this member (copy of opt_pot.table)
+} ensemble_member;
+
+void randomize_start(double* xi);
+int compare_members(const void* a, const void* b);
+void write_ensemble_ranking(ensemble_member** rank);
+
+/****************************************************************
+  run_ensemble
+
+  every member starts from the potential in startpot, the members use
+  consecutive seeds starting at seed; for analytic potentials all
+  members except the first one start from random parameters inside
+  the bounds
+
+  all members run the global optimization stage, afterwards only the
+  best ensemble_keep members are passed to the powell minimization
+
+  the potential of every member is written to <endpot>.<member>, the
+  best one is also written to endpot together with the usual error
+  files and the ranking goes to <output_prefix>.ensemble
+
+  the configurations, neighbor lists and force vector are shared by
+  all members, which are fitted one after the other
+****************************************************************/
+
+void run_ensemble(void)
+{
+  const int size = g_param.ensemble;
+  const int keep = g_param.ensemble_keep;
+
+  if (g_calc.ndim == 0)
+    error(1, "Ensemble fits need at least one free parameter.\n");
+
+#if !defined(APOT) && !defined(EVO) && !defined(CMAES)
+  if (tolower(g_param.anneal_temp[0]) != 'a' && atof(g_param.anneal_temp) == 0.0)
+    warning("All ensemble members start from the same tabulated potential "
+            "and anneal_temp is 0, the members will not differ.\n");
+#endif  // !APOT && !EVO && !CMAES
+
+  printf("\nStarting ensemble fit with %d members and %d parameters.\n", size,
+         g_calc.ndim);
+  fflush(stdout);
+
+  double* start = (double*)Malloc(g_calc.ndimtot * sizeof(double));
+  memcpy(start, g_pot.opt_pot.table, g_calc.ndimtot * sizeof(double));
+
+  ensemble_member* members =
+      (ensemble_member*)Malloc(size * sizeof(ensemble_member));
+  ensemble_member** rank =
+      (ensemble_member**)Malloc(size * sizeof(ensemble_member*));
+
+  // global stage for all members
+
+  for (int i = 0; i < size; i++) {
+    ensemble_member* m = members + i;
+    const int fcalls = g_calc.fcalls;
+
+    m->member = i;
+    m->seed = (i == 0) ? g_param.rng_seed : members[i - 1].seed + 1;
+    // srand() treats 0 like 1, the two members would be identical
+    if (i > 0 && m->seed == 1 && members[i - 1].seed == 0)
+      m->seed = 2;
+    m->table = (double*)Malloc(g_calc.ndimtot * sizeof(double));
+    memcpy(m->table, start, g_calc.ndimtot * sizeof(double));
+
+    printf("\nEnsemble member %d (seed %d)\n", i, m->seed);
+    fflush(stdout);
+
+    init_rng(m->seed);
+
+#if defined(APOT)
+    if (i > 0)
+      randomize_start(m->table);
+#endif  // APOT
+
+    m->start_error = calc_forces(m->table, g_calc.force, 0);
+
+    run_global_optimization(m->table);
+
+    m->global_error = calc_forces(m->table, g_calc.force, 0);
+    m->error = m->global_error;
+    m->fcalls = g_calc.fcalls - fcalls;
+
+    rank[i] = m;
+  }
+
+  // cull the poor performers before the expensive local stage
+
+  qsort(rank, size, sizeof(ensemble_member*), compare_members);
+
+  if (keep < size)
+    printf("\nKeeping the best %d of %d ensemble members.\n", keep, size);
+
+  for (int i = 0; i < keep; i++) {
+    ensemble_member* m = rank[i];
+    const int fcalls = g_calc.fcalls;
+
+    printf("\nEnsemble member %d (seed %d), local optimization\n", m->member,
+           m->seed);
+    fflush(stdout);
+
+    run_local_optimization(m->table);
+
+    m->error = calc_forces(m->table, g_calc.force, 0);
+    m->fcalls += g_calc.fcalls - fcalls;
+    m->finished = 1;
+  }
+
+  qsort(rank, size, sizeof(ensemble_member*), compare_members);
+
+  // write the potential of every member
+
+  const size_t len = strlen(g_files.endpot) + 13;
+  char* filename = (char*)Malloc(len);
+
+  for (int i = 0; i < size; i++) {
+    memcpy(g_pot.opt_pot.table, members[i].table,
+           g_calc.ndimtot * sizeof(double));
+#if defined(APOT)
+    update_apot_table(g_pot.opt_pot.table);
+#endif  // APOT
+    snprintf(filename, len, "%s.%d", g_files.endpot, i);
+    write_pot_table_potfit(filename);
+  }
+
+  write_ensemble_ranking(rank);
+
+  // the best member is treated like the result of a regular fit
+
+  memcpy(g_pot.opt_pot.table, rank[0]->table, g_calc.ndimtot * sizeof(double));
+#if defined(APOT)
+  update_apot_table(g_pot.opt_pot.table);
+  update_calc_table(g_pot.opt_pot.table, g_pot.calc_pot.table, 1);
+#endif  // APOT
+
+  printf("\nBest ensemble member is %d (seed %d) with error sum %f\n",
+         rank[0]->member, rank[0]->seed, rank[0]->error);
+
+  write_fit_results();
+}
+
+#if defined(APOT)
+
+/****************************************************************
+  randomize_start
+    same distribution as the initial population in diff_evo.c
+****************************************************************/
+
+void randomize_start(double* xi)
+{
+  for (int j = 0; j < g_calc.ndim; j++) {
+    const double val = xi[g_pot.opt_pot.idx[j]];
+    const double min =
+        g_pot.apot_table
+            .pmin[g_pot.apot_table.idxpot[j]][g_pot.apot_table.idxparam[j]];
+    const double max =
+        g_pot.apot_table
+            .pmax[g_pot.apot_table.idxpot[j]][g_pot.apot_table.idxparam[j]];
+
+    double temp = normdist() / 3.0;
+
+    if (fabs(temp) > 1)
+      temp /= fabs(temp);
+
+    if (temp > 0)
+      xi[g_pot.opt_pot.idx[j]] = val + temp * (max - val);
+    else
+      xi[g_pot.opt_pot.idx[j]] = val + temp * (val - min);
+  }
+}
+
+#endif  // APOT
+
+/****************************************************************
+  compare_members
+    finished members first, then by error sum, nan is the worst
+****************************************************************/
+
+int compare_members(const void* a, const void* b)
+{
+  const ensemble_member* m1 = *(ensemble_member* const*)a;
+  const ensemble_member* m2 = *(ensemble_member* const*)b;
+
+  if (m1->finished != m2->finished)
+    return m2->finished - m1->finished;
+
+  if (isnan(m1->error) != isnan(m2->error))
+    return isnan(m1->error) ? 1 : -1;
+
+  if (m1->error < m2->error)
+    return -1;
+  if (m1->error > m2->error)
+    return 1;
+
+  return m1->member - m2->member;
+}
+
+/****************************************************************
+  write_ensemble_ranking
+****************************************************************/
+
+void write_ensemble_ranking(ensemble_member** rank)
+{
+  const int size = g_param.ensemble;
+  FILE* outfile = stdout;
+
+  if (g_param.write_output_files) {
+    char file[255];
+    sprintf(file, "%s.ensemble", g_files.output_prefix);
+
+    outfile = fopen(file, "w");
+    if (NULL == outfile)
+      error(1, "Could not open file %s\n", file);
+  } else {
+    printf("\n");
+  }
+
+  fprintf(outfile, "# potfit ensemble ranking, %d members, %d optimized to the end\n",
+          size, g_param.ensemble_keep);
+  fprintf(outfile, "# rank\tmember\tseed\tstart_error\tglobal_error\tfinal_error\tfcalls\tendpot\n");
+
+  for (int i = 0; i < size; i++) {
+    const ensemble_member* m = rank[i];
+    fprintf(outfile, "%d\t%d\t%d\t%f\t%f\t", i + 1, m->member, m->seed,
+            m->start_error, m->global_error);
+    if (m->finished)
+      fprintf(outfile, "%f", m->error);
+    else
+      fprintf(outfile, "culled");
+    fprintf(outfile, "\t%d\t%s.%d\n", m->fcalls, g_files.endpot, m->member);
+  }
+
+  if (outfile != stdout) {
+    fclose(outfile);
+    printf("\nEnsemble ranking written to \t\t%s.ensemble\n",
+           g_files.output_prefix);
+  }
+}
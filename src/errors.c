@@ -37,6 +37,7 @@ double write_force_errors(double* force);
 double write_energy_errors(double* force);
 double write_stress_errors(double* force);
 void write_eam_punishments(double* force);
+int file_atom(int n);
 
 /****************************************************************
   write_errors
@@ -241,16 +242,15 @@ void write_local_electron_density()
   fprintf(outfile, "#    atomtype\trho\trho_eam\trho_meam\n");
 #endif  // !MEAM
 
-  for (int i = 0; i < g_config.natoms; i++) {
+  for (int n = 0; n < g_config.natoms; n++) {
+    const atom_t* atom = g_config.atoms + file_atom(n);
 #if !defined(MEAM)
-    fprintf(outfile, "%d\t%d\t%f\n", i, g_config.atoms[i].type,
-            g_config.atoms[i].rho);
+    fprintf(outfile, "%d\t%d\t%f\n", n, atom->type, atom->rho);
 #else
-    fprintf(outfile, "%d\t%d\t%f\t%f\t%f\n", i, g_config.atoms[i].type,
-            g_config.atoms[i].rho, g_config.atoms[i].rho_eam,
-            g_config.atoms[i].rho - g_config.atoms[i].rho_eam);
+    fprintf(outfile, "%d\t%d\t%f\t%f\t%f\n", n, atom->type, atom->rho,
+            atom->rho_eam, atom->rho - atom->rho_eam);
 #endif  // !MEAM
-    totdens[g_config.atoms[i].type] += g_config.atoms[i].rho;
+    totdens[atom->type] += atom->rho;
   }
 
   fprintf(outfile, "\n");
@@ -297,37 +297,36 @@ double write_force_errors(double* force)
   component[1] = 'y';
   component[2] = 'z';
 
-  for (int i = 0; i < 3 * g_config.natoms; i++) {
+  // the atoms are written in the order of the config file
+  for (int n = 0; n < 3 * g_config.natoms; n++) {
+    const atom_t* atom = g_config.atoms + file_atom(n / 3);
+    const int i = 3 * file_atom(n / 3) + n % 3;
 #if defined(CONTRIB)
-    if (g_config.atoms[i / 3].contrib == 0)
+    if (atom->contrib == 0)
       sqr = 0.0;
     else
 #endif  // CONTRIB
-      sqr =
-          g_config.conf_weight[g_config.atoms[i / 3].conf] * dsquare(force[i]);
+      sqr = g_config.conf_weight[atom->conf] * dsquare(force[i]);
     force_error += sqr;
 #if defined(FWEIGHT)
-    if (i > 2 && i % 3 == 0 &&
-        g_config.atoms[i / 3].conf != g_config.atoms[i / 3 - 1].conf)
+    if (n > 2 && n % 3 == 0 &&
+        atom->conf != g_config.atoms[file_atom(n / 3 - 1)].conf)
       fprintf(outfile, "\n\n");
-    if (i == 0)
+    if (n == 0)
       fprintf(outfile, "#conf:atom\ttype\tdf^2\t\tf\t\tf0\t\tdf/f0\t\t|f|\n");
-    fprintf(outfile, "%3d:%6d:%c\t%4s\t%e\t%e\t%e\t%e\t%e\n",
-            g_config.atoms[i / 3].conf, i / 3, component[i % 3],
-            g_config.elements[g_config.atoms[i / 3].type], sqr,
-            force[i] * (FORCE_EPS + g_config.atoms[i / 3].absforce) +
-                g_config.force_0[i],
+    fprintf(outfile, "%3d:%6d:%c\t%4s\t%e\t%e\t%e\t%e\t%e\n", atom->conf,
+            n / 3, component[n % 3], g_config.elements[atom->type], sqr,
+            force[i] * (FORCE_EPS + atom->absforce) + g_config.force_0[i],
             g_config.force_0[i], force[i] / g_config.force_0[i],
-            g_config.atoms[i / 3].absforce);
+            atom->absforce);
 #else
-    if (i > 2 && i % 3 == 0 &&
-        g_config.atoms[i / 3].conf != g_config.atoms[i / 3 - 1].conf)
+    if (n > 2 && n % 3 == 0 &&
+        atom->conf != g_config.atoms[file_atom(n / 3 - 1)].conf)
       fprintf(outfile, "\n\n");
-    if (i == 0)
+    if (n == 0)
       fprintf(outfile, "#conf:atom\ttype\tdf^2\t\tf\t\tf0\t\tdf/f0\n");
-    fprintf(outfile, "%3d:%6d:%c\t%4s\t%e\t%e\t%e\t%e\n",
-            g_config.atoms[i / 3].conf, i / 3, component[i % 3],
-            g_config.elements[g_config.atoms[i / 3].type], sqr,
+    fprintf(outfile, "%3d:%6d:%c\t%4s\t%e\t%e\t%e\t%e\n", atom->conf, n / 3,
+            component[n % 3], g_config.elements[atom->type], sqr,
             force[i] + g_config.force_0[i], g_config.force_0[i],
             force[i] / g_config.force_0[i]);
 #endif  // FWEIGHT
@@ -341,6 +340,16 @@ double write_force_errors(double* force)
   return force_error;
 }
 
+/****************************************************************
+  file_atom
+    index of the n-th atom of the config file in g_config.atoms
+****************************************************************/
+
+int file_atom(int n)
+{
+  return (g_config.atom_order != NULL) ? g_config.atom_order[n] : n;
+}
+
 /****************************************************************
   write_energy_errors
 ****************************************************************/
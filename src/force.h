@@ -31,9 +31,32 @@
 #define FORCE_H_INCLUDED
 
 double calc_forces(double* xi_opt, double* forces, int shutdown_flag);
-extern double (*g_splint)(pot_table_t*, double*, int, double);
-extern double (*g_splint_grad)(pot_table_t*, double*, int, double);
-extern double (*g_splint_comb)(pot_table_t*, double*, int, double, double*);
+
+// number of parameter vectors evaluated in one sweep over the neighbors
+#define FORCE_BATCH 8
+
+// force routines with a batch sweep, all others (and every MPI build)
+// evaluate the vectors of calc_forces_batch one after the other
+#if !defined(MPI) && (defined(PAIR) || (defined(EAM) && !defined(TBEAM) && !defined(COULOMB)))
+#define FORCE_BATCH_SWEEP
+void init_batch(double* const* xi_opt, int count, double** xi, double** coeff);
+void select_batch(int k);
+#endif  // !MPI && (PAIR || EAM)
+
+// error sums and forces of count independent parameter vectors
+void calc_forces_batch(double* const* xi_opt, double* const* forces,
+                       double* error_sums, int count);
+
+#if defined(MPI)
+// the first process of every group but the one of the root process
+// calculates the vectors of calc_forces_batch in here (mpi_groups)
+void calc_forces_group(double* forces);
+void shutdown_groups(void);
+#endif  // MPI
+extern POTFIT_TLS double (*g_splint)(pot_table_t*, double*, int, double);
+extern POTFIT_TLS double (*g_splint_grad)(pot_table_t*, double*, int, double);
+extern POTFIT_TLS double (*g_splint_comb)(pot_table_t*, double*, int, double,
+                                           double*);
 
 // common force initialization (force_common.cc)
 void init_force_common(int is_worker);
@@ -44,8 +67,28 @@ void set_force_vector_pointers();
 void gather_variable(double* var);
 void gather_forces(double* error_sum, double* forces);
 
+// configurations with at least split_atoms atoms are calculated by several
+// processes (MPI), each of them calculates the atoms [first, last) and keeps
+// the other atoms of the configuration as halo
+void calc_range(int h, int* first, int* last);
+void reduce_config(double* forces, int h, int uf);
+void exchange_halo(int h, size_t offset, int sum);
+
 void update_splines(double* xi, int start_col, int num_col, int grad_flag);
 
+#if defined(EAM) || defined(ADP) || defined(MEAM)
+// embedding energies F(rho) of num atoms of one configuration and the
+// gradients F'(rho), evaluated per atom type in one pass over the
+// densities; band 1 uses the s-band of TBEAM, the densities are added
+// to rho_sum and with RESCALE the punishments to limit
+double embedding_energies(double* xi_opt, atom_t* atoms, int num, int band,
+                          double* limit, double* rho_sum);
+#endif  // EAM || ADP || MEAM
+
+#if defined(DIPOLE)
+void solve_induced_dipoles(int h, const double* dp_alpha);
+#endif  // DIPOLE
+
 #if defined(STIWEB)
 void update_stiweb_pointers(double*);
 #endif  // STIWEB
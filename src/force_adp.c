@@ -42,6 +42,7 @@
 #include "potential_input.h"
 #include "potential_output.h"
 #include "splines.h"
+#include "timer.h"
 #include "utils.h"
 
 /****************************************************************
@@ -136,6 +137,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
   // This is the start of an infinite loop
 
   while (1) {
+    TIMER_START(TIMER_CALC);
+
     // error_sum = Sum of all the forces, energies and constraints
     double error_sum = 0.0;
     // rho_sum = Sum of density, rho, for all atoms
@@ -149,11 +152,14 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // APOT && !MPI
 
 #if defined(MPI)
-#if !defined(APOT)
+    TIMER_START(TIMER_COMM);
+#if defined(APOT)
+    MPI_Bcast(&flag, 1, MPI_INT, 0, g_mpi.comm);
+#else
     // exchange potential and flag value
-    MPI_Bcast(xi, g_pot.calc_pot.len, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    broadcast_potential(xi, &flag);
 #endif  // APOT
-    MPI_Bcast(&flag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    TIMER_STOP(TIMER_COMM);
 
     if (flag == 1)
       break; // Exception: flag 1 means clean up
@@ -161,7 +167,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #if defined(APOT)
     if (g_mpi.myid == 0)
       apot_check_params(xi_opt);
-    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
     update_calc_table(xi_opt, xi, 0);
 #else
     // if flag==2 then the potential parameters have changed -> sync
@@ -190,6 +198,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     // loop over configurations
     for (int config_idx = g_mpi.firstconf; config_idx < g_mpi.firstconf + g_mpi.myconf; config_idx++) {
+      TIMER_CONF_START();
+
       int uf = g_config.conf_uf[config_idx - g_mpi.firstconf];
 #if defined(STRESS)
       int us = g_config.conf_us[config_idx - g_mpi.firstconf];
@@ -228,6 +238,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         atom->lambda.zx = 0.0;
       }
 
+      TIMER_START(TIMER_PAIR);
       // second loop: calculate pair forces, energies and atomic densities
       for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
         atom_t* atom = g_config.conf_atoms + atom_idx + g_config.cnfstart[config_idx] - g_mpi.firstatom;
@@ -244,9 +255,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
             double phi_grad = 0.0;
             // potential value and gradient are calculated in the same step
             if (uf)
-              phi_val = splint_comb_dir(&g_pot.calc_pot, xi, neigh->slot[0], neigh->shift[0], neigh->step[0], &phi_grad);
+              phi_val = splint_comb_coeff(&g_pot.calc_pot, neigh->slot[0], neigh->shift[0], neigh->step[0], &phi_grad);
             else
-              phi_val = splint_dir(&g_pot.calc_pot, xi, neigh->slot[0], neigh->shift[0], neigh->step[0]);
+              phi_val = splint_coeff(&g_pot.calc_pot, neigh->slot[0], neigh->shift[0]);
 
             // avoid double counting if atom is interacting with itself
             if (self) {
@@ -288,9 +299,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           if (neigh->r < g_pot.calc_pot.end[neigh->col[2]]) {
             // potential value and grad are calculated in the same step
             if (uf)
-              neigh->u_val = splint_comb_dir(&g_pot.calc_pot, xi, neigh->slot[2], neigh->shift[2], neigh->step[2], &neigh->u_grad);
+              neigh->u_val = splint_comb_coeff(&g_pot.calc_pot, neigh->slot[2], neigh->shift[2], neigh->step[2], &neigh->u_grad);
             else
-              neigh->u_val = splint_dir(&g_pot.calc_pot, xi, neigh->slot[2], neigh->shift[2], neigh->step[2]);
+              neigh->u_val = splint_coeff(&g_pot.calc_pot, neigh->slot[2], neigh->shift[2]);
 
             // avoid double counting if atom is interacting with itself
             if (self) {
@@ -314,9 +325,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           if (neigh->r < g_pot.calc_pot.end[neigh->col[3]]) {
             // potential value and grad are calculated in the same step
             if (uf)
-              neigh->w_val = splint_comb_dir(&g_pot.calc_pot, xi, neigh->slot[3], neigh->shift[3], neigh->step[3], &neigh->w_grad);
+              neigh->w_val = splint_comb_coeff(&g_pot.calc_pot, neigh->slot[3], neigh->shift[3], neigh->step[3], &neigh->w_grad);
             else
-              neigh->w_val = splint_dir(&g_pot.calc_pot, xi, neigh->slot[3], neigh->shift[3], neigh->step[3]);
+              neigh->w_val = splint_coeff(&g_pot.calc_pot, neigh->slot[3], neigh->shift[3]);
 
             // avoid double counting if atom is interacting with itself
             if (self) {
@@ -351,7 +362,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           if (atom->type == neigh->type) {
             // then transfer(a->b)==transfer(b->a)
             if (neigh->r < g_pot.calc_pot.end[neigh->col[1]]) {
-              double rho_val = splint_dir(&g_pot.calc_pot, xi, neigh->slot[1], neigh->shift[1], neigh->step[1]);
+              double rho_val = splint_coeff(&g_pot.calc_pot, neigh->slot[1], neigh->shift[1]);
               atom->rho += rho_val;
               // avoid double counting if atom is interacting with itself
               if (!self)
@@ -360,62 +371,13 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           } else {
             // transfer(a->b)!=transfer(b->a)
             if (neigh->r < g_pot.calc_pot.end[neigh->col[1]]) {
-              atom->rho += splint_dir(&g_pot.calc_pot, xi, neigh->slot[1], neigh->shift[1], neigh->step[1]);
+              atom->rho += splint_coeff(&g_pot.calc_pot, neigh->slot[1], neigh->shift[1]);
             }
-            // cannot use slot/shift to access splines
-            if (neigh->r < g_pot.calc_pot.end[g_calc.paircol + atom->type])
-              g_config.conf_atoms[neigh->nr - g_mpi.firstatom].rho += (*g_splint)(&g_pot.calc_pot, xi, g_calc.paircol + atom->type, neigh->r);
+            if (neigh->r < g_pot.calc_pot.end[neigh->col[REV_SLOT]])
+              g_config.conf_atoms[neigh->nr - g_mpi.firstatom].rho += splint_coeff(&g_pot.calc_pot, neigh->slot[REV_SLOT], neigh->shift[REV_SLOT]);
           }
         } // loop over neighbors
 
-        // column of F
-        int col_F = g_calc.paircol + g_param.ntypes + atom->type;
-#if defined(RESCALE)
-        if (atom->rho > g_pot.calc_pot.end[col_F]) {
-          // then punish target function -> bad potential
-          forces[g_calc.limit_p + config_idx] += DUMMY_WEIGHT * 10.0 * dsquare(atom->rho - g_pot.calc_pot.end[col_F]);
-          atom->rho = g_pot.calc_pot.end[col_F];
-        }
-
-        if (atom->rho < g_pot.calc_pot.begin[col_F]) {
-          // then punish target function -> bad potential
-          forces[g_calc.limit_p + config_idx] += DUMMY_WEIGHT * 10.0 * dsquare(g_pot.calc_pot.begin[col_F] - atom->rho);
-          atom->rho = g_pot.calc_pot.begin[col_F];
-        }
-#endif  // RESCALE
-
-// embedding energy, embedding gradient
-// contribution to cohesive energy is F(n)
-
-#if !defined(RESCALE)
-#if defined(APOT)
-        if ((atom->rho < g_pot.calc_pot.begin[col_F]) || (atom->rho > g_pot.calc_pot.end[col_F]) || (atom->rho < 0.1)) {
-          // calculate analytic value explicitly
-          double temp_eng = 0.0;
-          g_pot.apot_table.fvalue[col_F](atom->rho, xi_opt + g_pot.opt_pot.first[col_F], &temp_eng);
-          atom->gradF = apot_gradient(atom->rho, xi_opt + g_pot.opt_pot.first[col_F], g_pot.apot_table.fvalue[col_F]);
-          forces[g_calc.energy_p + config_idx] += temp_eng;
-        } else {
-#else // APOT
-        if (atom->rho < g_pot.calc_pot.begin[col_F]) {
-          // linear extrapolation left
-          double rho_val = g_splint_comb(&g_pot.calc_pot, xi, col_F, g_pot.calc_pot.begin[col_F], &atom->gradF);
-          forces[g_calc.energy_p + config_idx] += rho_val + (atom->rho - g_pot.calc_pot.begin[col_F]) * atom->gradF;
-        } else if (atom->rho > g_pot.calc_pot.end[col_F]) {
-          // and right
-          double rho_val = g_splint_comb(&g_pot.calc_pot, xi, col_F, g_pot.calc_pot.end[col_F] - 0.5 * g_pot.calc_pot.step[col_F], &atom->gradF);
-          forces[g_calc.energy_p + config_idx] += rho_val + (atom->rho - g_pot.calc_pot.end[col_F]) * atom->gradF;
-        } else { // and in-between
-#endif // APOT
-          forces[g_calc.energy_p + config_idx] += g_splint_comb(&g_pot.calc_pot, xi, col_F, atom->rho, &atom->gradF);
-        }
-#else // RESCALE
-        forces[g_calc.energy_p + config_idx] += g_splint_comb(&g_pot.calc_pot, xi, col_F, atom->rho, &atom->gradF);
-#endif  // !RESCALE
-
-        // sum up rho
-        rho_sum += atom->rho;
-
         double eng_store = 0.0;
         /* calculate ADP energy for atom i */
         eng_store += dsquare(atom->mu.x);
@@ -432,6 +394,15 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         eng_store *= 0.5;
         forces[g_calc.energy_p + config_idx] += eng_store;
       } // second loop over atoms
+      TIMER_STOP(TIMER_PAIR);
+
+      TIMER_START(TIMER_EMBED);
+      // embedding energy F(rho) and gradient of all atoms, densities outside
+      // of F are punished (RESCALE), calculated analytically (APOT) or
+      // extrapolated linearly
+      atom_t* atoms = g_config.conf_atoms + g_config.cnfstart[config_idx] - g_mpi.firstatom;
+      forces[g_calc.energy_p + config_idx] +=
+        embedding_energies(xi_opt, atoms, g_config.inconf[config_idx], 0, forces + g_calc.limit_p + config_idx, &rho_sum);
 
       // third loop over atom: ADP forces
       // only required if we calc forces
@@ -452,7 +423,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
             {
               double rho_grad = 0.0;
               if (neigh->r < g_pot.calc_pot.end[neigh->col[1]])
-                rho_grad = splint_grad_dir(&g_pot.calc_pot, xi, neigh->slot[1],
+                rho_grad = splint_grad_coeff(&g_pot.calc_pot, neigh->slot[1],
                                         neigh->shift[1], neigh->step[1]);
               double rho_grad_j = 0.0;
               // use actio = reactio
@@ -460,7 +431,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
                 rho_grad_j = rho_grad;
               else
                 if (neigh->r < g_pot.calc_pot.end[col_F - g_param.ntypes])
-                  rho_grad_j = g_splint_grad(&g_pot.calc_pot, xi, col_F - g_param.ntypes, neigh->r);
+                  rho_grad_j = splint_grad_coeff(&g_pot.calc_pot, neigh->slot[REV_SLOT], neigh->shift[REV_SLOT], neigh->step[REV_SLOT]);
 
               // now we know everything - calculate forces
               double eam_force = (rho_grad * atom->gradF + rho_grad_j * g_config.conf_atoms[(neigh->nr) - g_mpi.firstatom] .gradF);
@@ -590,6 +561,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
             error_sum += g_config.conf_weight[config_idx] * (dsquare(forces[n_i + 0]) + dsquare(forces[n_i + 1]) + dsquare(forces[n_i + 2]));
         } // third loop over atoms
       } // uf
+      TIMER_STOP(TIMER_EMBED);
 
       // energy contributions
       forces[g_calc.energy_p + config_idx] /= (double)g_config.inconf[config_idx];
@@ -610,6 +582,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
       // limiting constraints per configuration
       error_sum += g_config.conf_weight[config_idx] * dsquare(forces[g_calc.limit_p + config_idx]);
 
+      TIMER_CONF_STOP(config_idx);
     } // loop over configurations
 
     gather_variable(&rho_sum);
@@ -654,6 +627,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     gather_forces(&error_sum, forces);
 
+    TIMER_STOP(TIMER_CALC);
+
     // root process exits this function now
     if (g_mpi.myid == 0) {
       // increase function call counter
@@ -45,6 +45,7 @@
 #include "potential_input.h"
 #include "potential_output.h"
 #include "splines.h"
+#include "timer.h"
 #include "utils.h"
 
 /****************************************************************
@@ -58,6 +59,7 @@
 void init_force(int is_worker)
 {
 #if defined(COULOMB)
+  reset_tails();
   if (g_pot.apot_table.sw_kappa)  // FIXME is sw_kappa really correct here?
     init_tails(g_pot.apot_table.dp_kappa[0]);
 #endif  // COULOMB
@@ -172,6 +174,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
   /* This is the start of an infinite loop */
   while (1) {
+    TIMER_START(TIMER_CALC);
+
     /* Reset
        error_sum = Sum of all the forces, energies and constraints
         */
@@ -185,11 +189,14 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // APOT && !MPI
 
 #if defined(MPI)
+    TIMER_START(TIMER_COMM);
 /* exchange potential and flag value */
-#if !defined(APOT)
-    MPI_Bcast(xi, g_pot.calc_pot.len, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#if defined(APOT)
+    MPI_Bcast(&flag, 1, MPI_INT, 0, g_mpi.comm);
+#else
+    broadcast_potential(xi, &flag);
 #endif  // APOT
-    MPI_Bcast(&flag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    TIMER_STOP(TIMER_COMM);
 
     if (1 == flag)
       break; /* Exception: flag 1 means clean up */
@@ -197,7 +204,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #if defined(APOT)
     if (g_mpi.myid == 0)
       apot_check_params(xi_opt);
-    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
     update_calc_table(xi_opt, xi, 0);
 #else
     /* if flag==2 then the potential parameters have changed -> sync */
@@ -252,6 +261,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
     {
       /* Loop over configurations */
       for (h = g_mpi.firstconf; h < g_mpi.firstconf + g_mpi.myconf; h++) {
+        TIMER_CONF_START();
+
         uf = g_config.conf_uf[h - g_mpi.firstconf];
 #if defined(STRESS)
         us = g_config.conf_us[h - g_mpi.firstconf];
@@ -285,6 +296,11 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         } /* i */
         /* END OF FIRST LOOP */
 
+        /* updating tail-functions - only necessary with varying kappa */
+        if (!g_pot.apot_table.sw_kappa)
+          update_tails(h, dp_kappa);
+
+        TIMER_START(TIMER_THREEBODY);
         /* SECOND LOOP: Calculate pair and monopole forces and energies */
         for (i = 0; i < g_config.inconf[h]; i++) {
           /* Set pointer to temp atom pointer */
@@ -346,16 +362,6 @@ double calc_forces(double* xi_opt, double* forces, int flag)
             }
 
             /* calculate monopole forces */
-            /* updating tail-functions - only necessary with variing kappa */
-            if (!g_pot.apot_table.sw_kappa)
-#if defined(DSF)
-            elstat_dsf(neigh_j->r, dp_kappa, &neigh_j->fnval_el,
-                            &neigh_j->grad_el, &neigh_j->ggrad_el);
-#else
-            elstat_shift(neigh_j->r, dp_kappa, &neigh_j->fnval_el,
-                           &neigh_j->grad_el, &neigh_j->ggrad_el);
-#endif // DSF
-
             if (neigh_j->r < g_config.dp_cut &&
                 (charge[type1] || charge[type2])) {
               fnval_tail = neigh_j->fnval_el;
@@ -531,6 +537,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           forces[g_calc.energy_p + h] += angener_sum;
 
         } /* END OF SECOND LOOP OVER ATOM i */
+        TIMER_STOP(TIMER_THREEBODY);
 
 
         /* THIRD loop: self energy contributions and sum-up force
@@ -599,6 +606,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
                        dsquare(forces[stresses + i]);
         }
 #endif  // STRESS
+
+        TIMER_CONF_STOP(h);
       }
     } /* END MAIN LOOP OVER CONFIGURATIONS */
 
@@ -612,6 +621,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     gather_forces(&error_sum, forces);
 
+    TIMER_STOP(TIMER_CALC);
+
     /* Root process only */
     if (g_mpi.myid == 0) {
       /* Increment function calls */
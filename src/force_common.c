@@ -27,16 +27,34 @@
  *
  ****************************************************************/
 
+#include <float.h>
+#include <stdint.h>
+
 #include "potfit.h"
 
 #include "force.h"
+#if defined(APOT) && (defined(EAM) || defined(ADP) || defined(MEAM) || defined(FORCE_BATCH_SWEEP) || defined(MPI))
+#include "functions.h"
+#endif
 #include "memory.h"
+#if defined(APOT) && defined(FORCE_BATCH_SWEEP)
+#include "potential_input.h"
+#endif
 #include "splines.h"
+#include "timer.h"
 #include "utils.h"
 
-double (*g_splint)(pot_table_t*, double*, int, double);
-double (*g_splint_grad)(pot_table_t*, double*, int, double);
-double (*g_splint_comb)(pot_table_t*, double*, int, double, double*);
+POTFIT_TLS double (*g_splint)(pot_table_t*, double*, int, double);
+POTFIT_TLS double (*g_splint_grad)(pot_table_t*, double*, int, double);
+POTFIT_TLS double (*g_splint_comb)(pot_table_t*, double*, int, double,
+                                    double*);
+
+void set_residual_map();
+void init_coeff(pot_table_t* pt);
+#if defined(MPI)
+void calc_forces_groups(double* const* xi_opt, double* const* forces,
+                        double* error_sums, int num);
+#endif  // MPI
 
 /****************************************************************
   init_force_common
@@ -80,6 +98,8 @@ void init_force_common(int is_worker)
     punish_par_p    position of the first parameter *punishment (APOT only)
     punish_pot_p    position of the first potential *punishment (APOT only)
 
+    the entries used by the optimizers are listed by set_residual_map()
+
     limiting constraints: (EAM and similar potentials only)
       text
 
@@ -138,6 +158,79 @@ void set_force_vector_pointers()
 #endif  // EAM || ADP || MEAM
 
 #endif  // STRESS
+
+  set_residual_map();
+}
+
+/****************************************************************
+  set_residual_map
+    the forces of configurations with 'use_force 0' and the stresses
+    of configurations without stresses are always zero, the optimizers
+    only work on the rdim entries at the positions in res_idx
+
+    calc_forces() and the output in errors.c use the full force vector
+****************************************************************/
+
+void set_residual_map()
+{
+  if (g_mpi.myid == 0) {
+    g_calc.res_idx = (int*)Malloc(g_calc.mdim * sizeof(int));
+    g_calc.rdim = 0;
+
+    // forces
+    for (int h = 0; h < g_config.nconf; h++) {
+      if (g_config.useforce[h]) {
+        for (int i = 3 * g_config.cnfstart[h];
+             i < 3 * (g_config.cnfstart[h] + g_config.inconf[h]); i++)
+          g_calc.res_idx[g_calc.rdim++] = i;
+      }
+    }
+
+    // energies
+    for (int h = 0; h < g_config.nconf; h++)
+      g_calc.res_idx[g_calc.rdim++] = g_calc.energy_p + h;
+
+#if defined(STRESS)
+    // stresses
+    for (int h = 0; h < g_config.nconf; h++) {
+      if (g_config.useforce[h] && g_config.usestress[h]) {
+        for (int i = 0; i < 6; i++)
+          g_calc.res_idx[g_calc.rdim++] = g_calc.stress_p + 6 * h + i;
+      }
+    }
+
+    int first = g_calc.stress_p + 6 * g_config.nconf;
+#else
+    int first = g_calc.energy_p + g_config.nconf;
+#endif  // STRESS
+
+    // constraints and punishments
+    for (int i = first; i < g_calc.mdim; i++)
+      g_calc.res_idx[g_calc.rdim++] = i;
+  }
+
+#if defined(MPI)
+  // only the forces of configurations with forces are gathered, a split
+  // configuration from the process which calculates its first atom
+  g_mpi.myforces = 0;
+  for (int h = g_mpi.firstowned; h < g_mpi.firstowned + g_mpi.myowned; h++)
+    if (g_config.useforce[h])
+      g_mpi.myforces += g_config.inconf[h];
+
+  if (g_mpi.myid == 0) {
+    g_mpi.force_len = (int*)Malloc(g_mpi.num_cpus * sizeof(int));
+    g_mpi.force_dist = (int*)Malloc(g_mpi.num_cpus * sizeof(int));
+
+    // the forces of the root process are already in place
+    for (int i = 1; i < g_mpi.num_cpus; i++) {
+      int last = g_mpi.conf_dist[i] + g_mpi.conf_len[i];
+      for (int h = g_mpi.conf_dist[i]; h < last; h++)
+        if (g_config.useforce[h])
+          g_mpi.force_len[i] += g_config.inconf[h];
+      g_mpi.force_dist[i] = g_mpi.force_dist[i - 1] + g_mpi.force_len[i - 1];
+    }
+  }
+#endif  // MPI
 }
 
 /****************************************************************
@@ -147,11 +240,13 @@ void set_force_vector_pointers()
 void gather_variable(double* var)
 {
 #if defined(MPI)
+  TIMER_START(TIMER_COMM);
   // Reduce variable
   double tmpvar = 0.0;
-  MPI_Reduce(&var, &tmpvar, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Reduce(var, &tmpvar, 1, MPI_DOUBLE, MPI_SUM, 0, g_mpi.comm);
   if (g_mpi.myid == 0)
     *var = tmpvar;
+  TIMER_STOP(TIMER_COMM);
 #endif  // MPI
 }
 
@@ -164,58 +259,455 @@ void gather_variable(double* var)
 void gather_forces(double* error_sum, double* forces)
 {
 #if defined(MPI)
+  static POTFIT_TLS double* force_buf = NULL;
   double tmpsum = 0.0;
 
-  MPI_Reduce(error_sum, &tmpsum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  TIMER_START(TIMER_COMM);
+
+  // the forces of the other processes are sent in one block
+  if (force_buf == NULL) {
+    int len = g_mpi.myforces;
+    if (g_mpi.myid == 0)
+      len = g_mpi.force_dist[g_mpi.num_cpus - 1] +
+            g_mpi.force_len[g_mpi.num_cpus - 1];
+    if (len > 0)
+      force_buf = (double*)Malloc(3 * len * sizeof(double));
+  }
+
+  MPI_Reduce(error_sum, &tmpsum, 1, MPI_DOUBLE, MPI_SUM, 0, g_mpi.comm);
 
   // gather forces, energies, stresses
   if (g_mpi.myid == 0) {
     // root node already has data in place
     // forces
-    MPI_Gatherv(MPI_IN_PLACE, g_mpi.myatoms, g_mpi.MPI_VECTOR, forces,
-                g_mpi.atom_len, g_mpi.atom_dist, g_mpi.MPI_VECTOR, 0,
-                MPI_COMM_WORLD);
+    MPI_Gatherv(MPI_IN_PLACE, 0, g_mpi.MPI_VECTOR, force_buf, g_mpi.force_len,
+                g_mpi.force_dist, g_mpi.MPI_VECTOR, 0, g_mpi.comm);
+    int k = 0;
+    for (int h = g_mpi.myowned; h < g_config.nconf; h++) {
+      double* f = forces + 3 * g_config.cnfstart[h];
+      if (g_config.useforce[h]) {
+        memcpy(f, force_buf + k, 3 * g_config.inconf[h] * sizeof(double));
+        k += 3 * g_config.inconf[h];
+      } else {
+        memset(f, 0, 3 * g_config.inconf[h] * sizeof(double));
+      }
+    }
     // energies
-    MPI_Gatherv(MPI_IN_PLACE, g_mpi.myconf, MPI_DOUBLE,
+    MPI_Gatherv(MPI_IN_PLACE, g_mpi.myowned, MPI_DOUBLE,
                 forces + g_calc.energy_p, g_mpi.conf_len, g_mpi.conf_dist,
-                MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                MPI_DOUBLE, 0, g_mpi.comm);
 #if defined(STRESS)
     // stresses
-    MPI_Gatherv(MPI_IN_PLACE, g_mpi.myconf, g_mpi.MPI_STENS,
+    MPI_Gatherv(MPI_IN_PLACE, g_mpi.myowned, g_mpi.MPI_STENS,
                 forces + g_calc.stress_p, g_mpi.conf_len, g_mpi.conf_dist,
-                g_mpi.MPI_STENS, 0, MPI_COMM_WORLD);
+                g_mpi.MPI_STENS, 0, g_mpi.comm);
 #endif  // STRESS
 #if defined(RESCALE) && (defined(EAM) || defined(ADP) || defined(MEAM))
     // punishment constraints
-    MPI_Gatherv(MPI_IN_PLACE, g_mpi.myconf, MPI_DOUBLE, forces + g_calc.limit_p,
-                g_mpi.conf_len, g_mpi.conf_dist, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(MPI_IN_PLACE, g_mpi.myowned, MPI_DOUBLE, forces + g_calc.limit_p,
+                g_mpi.conf_len, g_mpi.conf_dist, MPI_DOUBLE, 0, g_mpi.comm);
 #endif  // RESCALE && (EAM || ADP || MEAM)
   } else {
     // forces
-    MPI_Gatherv(forces + g_mpi.firstatom * 3, g_mpi.myatoms, g_mpi.MPI_VECTOR,
-                forces, g_mpi.atom_len, g_mpi.atom_dist, g_mpi.MPI_VECTOR, 0,
-                MPI_COMM_WORLD);
+    int k = 0;
+    for (int h = g_mpi.firstowned; h < g_mpi.firstowned + g_mpi.myowned; h++) {
+      if (g_config.useforce[h]) {
+        memcpy(force_buf + k, forces + 3 * g_config.cnfstart[h],
+               3 * g_config.inconf[h] * sizeof(double));
+        k += 3 * g_config.inconf[h];
+      }
+    }
+    MPI_Gatherv(force_buf, g_mpi.myforces, g_mpi.MPI_VECTOR, NULL, NULL, NULL,
+                g_mpi.MPI_VECTOR, 0, g_mpi.comm);
     // energies
-    MPI_Gatherv(forces + g_calc.energy_p + g_mpi.firstconf, g_mpi.myconf,
+    MPI_Gatherv(forces + g_calc.energy_p + g_mpi.firstowned, g_mpi.myowned,
                 MPI_DOUBLE, forces + g_calc.energy_p, g_mpi.conf_len,
-                g_mpi.conf_dist, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                g_mpi.conf_dist, MPI_DOUBLE, 0, g_mpi.comm);
 #if defined(STRESS)
     // stresses
-    MPI_Gatherv(forces + g_calc.stress_p + 6 * g_mpi.firstconf, g_mpi.myconf,
+    MPI_Gatherv(forces + g_calc.stress_p + 6 * g_mpi.firstowned, g_mpi.myowned,
                 g_mpi.MPI_STENS, forces + g_calc.stress_p, g_mpi.conf_len,
-                g_mpi.conf_dist, g_mpi.MPI_STENS, 0, MPI_COMM_WORLD);
+                g_mpi.conf_dist, g_mpi.MPI_STENS, 0, g_mpi.comm);
 #endif  // STRESS
 #if defined(RESCALE) && (defined(EAM) || defined(ADP) || defined(MEAM))
     // punishment constraints
-    MPI_Gatherv(forces + g_calc.limit_p + g_mpi.firstconf, g_mpi.myconf,
+    MPI_Gatherv(forces + g_calc.limit_p + g_mpi.firstowned, g_mpi.myowned,
                 MPI_DOUBLE, forces + g_calc.limit_p, g_mpi.conf_len,
-                g_mpi.conf_dist, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                g_mpi.conf_dist, MPI_DOUBLE, 0, g_mpi.comm);
 #endif  // RESCALE && (EAM || ADP || MEAM)
   }
 
   *error_sum = tmpsum;
 
+  TIMER_STOP(TIMER_COMM);
+#endif  // MPI
+}
+
+/****************************************************************
+  calc_range
+    the atoms [*first, *last) of configuration h are calculated by
+    this process, all of them unless h is split across processes
+****************************************************************/
+
+void calc_range(int h, int* first, int* last)
+{
+#if defined(MPI)
+  *first = MAX(g_mpi.firstcalc - g_config.cnfstart[h], 0);
+  *last = MIN(g_mpi.firstcalc + g_mpi.mycalc - g_config.cnfstart[h],
+              g_config.inconf[h]);
+#else
+  *first = 0;
+  *last = g_config.inconf[h];
+#endif  // MPI
+}
+
+#if defined(MPI)
+
+/****************************************************************
+  split_comm
+    processes which calculate configuration h, MPI_COMM_NULL if it
+    is calculated by this process alone
+****************************************************************/
+
+static MPI_Comm split_comm(int h)
+{
+  for (int k = 0; k < 2; k++)
+    if (g_mpi.split_conf[k] == h)
+      return g_mpi.split_comm[k];
+
+  return MPI_COMM_NULL;
+}
+
+#endif  // MPI
+
+/****************************************************************
+  reduce_config
+    sums the partial forces, energy and stresses of a split
+    configuration over the processes which calculate it
+****************************************************************/
+
+void reduce_config(double* forces, int h, int uf)
+{
+#if defined(MPI)
+  MPI_Comm comm = split_comm(h);
+  double buf[8];
+  int n = 0;
+
+  if (comm == MPI_COMM_NULL)
+    return;
+
+  TIMER_START(TIMER_COMM);
+
+  if (uf)
+    MPI_Allreduce(MPI_IN_PLACE, forces + 3 * g_config.cnfstart[h],
+                  3 * g_config.inconf[h], MPI_DOUBLE, MPI_SUM, comm);
+
+  buf[n++] = forces[g_calc.energy_p + h];
+#if defined(STRESS)
+  for (int i = 0; i < 6; i++)
+    buf[n++] = forces[g_calc.stress_p + 6 * h + i];
+#endif  // STRESS
+#if defined(RESCALE) && defined(EAM)
+  buf[n++] = forces[g_calc.limit_p + h];
+#endif  // RESCALE && EAM
+
+  MPI_Allreduce(MPI_IN_PLACE, buf, n, MPI_DOUBLE, MPI_SUM, comm);
+
+  n = 0;
+  forces[g_calc.energy_p + h] = buf[n++];
+#if defined(STRESS)
+  for (int i = 0; i < 6; i++)
+    forces[g_calc.stress_p + 6 * h + i] = buf[n++];
+#endif  // STRESS
+#if defined(RESCALE) && defined(EAM)
+  forces[g_calc.limit_p + h] = buf[n++];
+#endif  // RESCALE && EAM
+
+  TIMER_STOP(TIMER_COMM);
+#endif  // MPI
+}
+
+/****************************************************************
+  exchange_halo
+    exchanges the double at offset of every atom_t of a split
+    configuration; partial values of all atoms are summed up if sum
+    is set, otherwise the halo atoms receive the values of the
+    processes which calculate them
+****************************************************************/
+
+void exchange_halo(int h, size_t offset, int sum)
+{
+#if defined(MPI)
+  static POTFIT_TLS double* buf = NULL;
+  static POTFIT_TLS int len = 0;
+  MPI_Comm comm = split_comm(h);
+  atom_t* atoms = g_config.conf_atoms + g_config.cnfstart[h] - g_mpi.firstatom;
+  int first = 0;
+  int last = 0;
+
+  if (comm == MPI_COMM_NULL)
+    return;
+
+  TIMER_START(TIMER_COMM);
+
+  if (len < g_config.inconf[h]) {
+    len = g_config.inconf[h];
+    buf = (double*)Realloc(buf, len * sizeof(double));
+  }
+
+  calc_range(h, &first, &last);
+
+  for (int i = 0; i < g_config.inconf[h]; i++) {
+    if (sum || (i >= first && i < last))
+      buf[i] = *(double*)((char*)(atoms + i) + offset);
+    else
+      buf[i] = 0.0;
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, buf, g_config.inconf[h], MPI_DOUBLE, MPI_SUM,
+                comm);
+
+  for (int i = 0; i < g_config.inconf[h]; i++)
+    *(double*)((char*)(atoms + i) + offset) = buf[i];
+
+  TIMER_STOP(TIMER_COMM);
+#endif  // MPI
+}
+
+#if defined(FORCE_BATCH_SWEEP)
+
+// spline tables of the parameter vectors of one batch
+typedef struct {
+  int len;
+  double* coeff_mem[FORCE_BATCH];
+  double* coeff[FORCE_BATCH];
+  double* d2tab[FORCE_BATCH];
+#if defined(APOT)
+  double* table[FORCE_BATCH];
+  double* calc_list;
+#endif  // APOT
+  double* calc_coeff;
+  double* calc_d2tab;
+} batch_tables_t;
+
+static POTFIT_TLS batch_tables_t g_batch = {0, };
+
+/****************************************************************
+  init_batch
+    the potential tables of count parameter vectors, xi[k] is the
+    table of vector k and coeff[k] the packed coefficients which
+    select_batch(k) sets up for update_splines
+****************************************************************/
+
+void init_batch(double* const* xi_opt, int count, double** xi, double** coeff)
+{
+  // reading a new potential might change the size of the tables
+  if (g_batch.len != g_pot.calc_pot.len) {
+    for (int k = 0; k < FORCE_BATCH; k++) {
+      // aligned like the coefficients in update_splines()
+      g_batch.coeff_mem[k] = (double*)Realloc(g_batch.coeff_mem[k], (4 * g_pot.calc_pot.len + 8) * sizeof(double));
+      g_batch.coeff[k] = (double*)(((uintptr_t)g_batch.coeff_mem[k] + 63) & ~(uintptr_t)63);
+      g_batch.d2tab[k] = (double*)Realloc(g_batch.d2tab[k], g_pot.calc_pot.len * sizeof(double));
+#if defined(APOT)
+      g_batch.table[k] = (double*)Realloc(g_batch.table[k], g_pot.calc_pot.len * sizeof(double));
+#endif  // APOT
+    }
+#if defined(APOT)
+    g_batch.calc_list = (double*)Realloc(g_batch.calc_list, g_pot.opt_pot.len * sizeof(double));
+#endif  // APOT
+    g_batch.len = g_pot.calc_pot.len;
+  }
+
+  // g_pot.calc_pot keeps the state of the last calc_forces call
+  init_coeff(&g_pot.calc_pot);
+  g_batch.calc_coeff = g_pot.calc_pot.coeff;
+  g_batch.calc_d2tab = g_pot.calc_pot.d2tab;
+
+#if defined(APOT)
+  // update_calc_table() only recalculates the potentials which differ
+  // from calc_list, the batch tables are always calculated completely
+  memcpy(g_batch.calc_list, g_pot.calc_list, g_pot.opt_pot.len * sizeof(double));
+#endif  // APOT
+
+  for (int k = 0; k < count; k++) {
+    xi[k] = xi_opt[k];
+#if defined(APOT)
+    if (g_pot.format_type == POTENTIAL_FORMAT_ANALYTIC) {
+      apot_check_params(xi_opt[k]);
+      memcpy(g_batch.table[k], g_pot.calc_pot.table, g_pot.calc_pot.len * sizeof(double));
+      update_calc_table(xi_opt[k], g_batch.table[k], 1);
+      xi[k] = g_batch.table[k];
+    }
+#endif  // APOT
+    coeff[k] = g_batch.coeff[k];
+  }
+
+#if defined(APOT)
+  memcpy(g_pot.calc_list, g_batch.calc_list, g_pot.opt_pot.len * sizeof(double));
+#endif  // APOT
+}
+
+/****************************************************************
+  select_batch
+    the splines of g_pot.calc_pot are those of vector k of the
+    batch, k < 0 restores the tables of calc_forces
+****************************************************************/
+
+void select_batch(int k)
+{
+  if (k < 0) {
+    g_pot.calc_pot.coeff = g_batch.calc_coeff;
+    g_pot.calc_pot.d2tab = g_batch.calc_d2tab;
+  } else {
+    g_pot.calc_pot.coeff = g_batch.coeff[k];
+    g_pot.calc_pot.d2tab = g_batch.d2tab[k];
+  }
+}
+
+#else
+
+/****************************************************************
+  calc_forces_batch
+    only the pair and EAM force routines evaluate several parameter
+    vectors in one sweep, all others calculate them one after the other
+
+    with mpi_groups every group of processes calculates one vector
+****************************************************************/
+
+void calc_forces_batch(double* const* xi_opt, double* const* forces,
+                       double* error_sums, int count)
+{
+#if defined(MPI)
+  if (g_mpi.num_groups > 1) {
+    for (int i = 0; i < count; i += g_mpi.num_groups)
+      calc_forces_groups(xi_opt + i, forces + i, error_sums + i,
+                         MIN(g_mpi.num_groups, count - i));
+    return;
+  }
+#endif  // MPI
+
+  for (int k = 0; k < count; k++)
+    error_sums[k] = calc_forces(xi_opt[k], forces[k], 0);
+}
+
+#if defined(MPI)
+
+/****************************************************************
+  calc_forces_groups
+    vector k of num vectors is calculated by group k, the root
+    process calculates the first one with its own group
+
+    the root process checks the parameters of the other vectors
+    and adds their punishments, only it knows the bounds
+****************************************************************/
+
+void calc_forces_groups(double* const* xi_opt, double* const* forces,
+                        double* error_sums, int num)
+{
+  TIMER_START(TIMER_COMM);
+
+  MPI_Bcast(&num, 1, MPI_INT, 0, g_mpi.group_comm);
+
+  for (int k = 1; k < num; k++) {
+#if defined(APOT)
+    apot_check_params(xi_opt[k]);
+#endif  // APOT
+    MPI_Send(xi_opt[k], g_calc.ndimtot, MPI_DOUBLE, k, 0, g_mpi.group_comm);
+  }
+
+  TIMER_STOP(TIMER_COMM);
+
+  error_sums[0] = calc_forces(xi_opt[0], forces[0], 0);
+
+  TIMER_START(TIMER_COMM);
+
+  for (int k = 1; k < num; k++) {
+    MPI_Recv(error_sums + k, 1, MPI_DOUBLE, k, 0, g_mpi.group_comm,
+             MPI_STATUS_IGNORE);
+    MPI_Recv(forces[k], g_calc.mdim, MPI_DOUBLE, k, 0, g_mpi.group_comm,
+             MPI_STATUS_IGNORE);
+#if defined(APOT)
+    error_sums[k] += apot_punish(xi_opt[k], forces[k]);
+#endif  // APOT
+    g_calc.fcalls++;
+  }
+
+  TIMER_STOP(TIMER_COMM);
+}
+
+/****************************************************************
+  calc_forces_group
+    main loop of the first process of every other group, calculates
+    the vectors calc_forces_groups() sends until shutdown_groups()
+****************************************************************/
+
+void calc_forces_group(double* forces)
+{
+  // only the root process knows opt_pot of tabulated potentials
+#if defined(APOT)
+  double* xi = g_pot.opt_pot.table;
+  int len = g_calc.ndimtot;
+#else
+  double* xi = g_pot.calc_pot.table;
+  int len = g_pot.calc_pot.len;
+#endif  // APOT
+  int num = 0;
+
+  while (1) {
+    MPI_Bcast(&num, 1, MPI_INT, 0, g_mpi.group_comm);
+
+    if (num == 0)
+      break;
+
+    // fewer vectors than groups
+    if (g_mpi.group >= num)
+      continue;
+
+    MPI_Recv(xi, len, MPI_DOUBLE, 0, 0, g_mpi.group_comm,
+             MPI_STATUS_IGNORE);
+
+    double error_sum = calc_forces(xi, forces, 0);
+
+    MPI_Send(&error_sum, 1, MPI_DOUBLE, 0, 0, g_mpi.group_comm);
+    MPI_Send(forces, g_calc.mdim, MPI_DOUBLE, 0, 0, g_mpi.group_comm);
+  }
+
+  // stop the other processes of this group
+  calc_forces(NULL, NULL, 1);
+}
+
+/****************************************************************
+  shutdown_groups
+    stops calc_forces_group() on the first process of every group
+****************************************************************/
+
+void shutdown_groups(void)
+{
+  int num = 0;
+
+  if (g_mpi.num_groups > 1)
+    MPI_Bcast(&num, 1, MPI_INT, 0, g_mpi.group_comm);
+}
+
 #endif  // MPI
+
+#endif  // FORCE_BATCH_SWEEP
+
+/****************************************************************
+  init_coeff
+    packed interval coefficients, aligned to 64 bytes (one cache line
+    holds the coefficients of two intervals), reallocated whenever the
+    length of the table changed
+****************************************************************/
+
+void init_coeff(pot_table_t* pt)
+{
+  if (pt->coeff_mem != NULL && pt->coeff_len == pt->len)
+    return;
+
+  pt->coeff_mem = (double*)Realloc(pt->coeff_mem, (4 * pt->len + 8) * sizeof(double));
+  pt->coeff = (double*)(((uintptr_t)pt->coeff_mem + 63) & ~(uintptr_t)63);
+  pt->coeff_len = pt->len;
 }
 
 /****************************************************************
@@ -224,6 +716,10 @@ void gather_forces(double* error_sum, double* forces)
 
 void update_splines(double* xi, int start_col, int num_col, int grad_flag)
 {
+  TIMER_START(TIMER_SPLINES);
+
+  init_coeff(&g_pot.calc_pot);
+
   for (int col = start_col; col < start_col + num_col; col++) {
     int first = g_pot.calc_pot.first[col];
     double grad_left = (grad_flag & 1) ? *(xi + first - 2) : 0.0;
@@ -248,5 +744,484 @@ void update_splines(double* xi, int start_col, int num_col, int grad_flag)
         warning("updates_splines() should not be called for KIM potentials!");
         return;
     }
+    spline_coeff(&g_pot.calc_pot, xi, col);
+  }
+
+  TIMER_STOP(TIMER_SPLINES);
+}
+
+#if defined(EAM) || defined(ADP) || defined(MEAM)
+
+// scratch arrays of the embedding pass, the atoms are grouped by type
+typedef struct {
+  int size;
+  int* offset; /* first entry of each type */
+  int* idx;    /* index of the atom in the configuration */
+  double* rho; /* density */
+  double* x;   /* point where the spline is evaluated */
+  double* val;
+  double* grad;
+#if defined(APOT) && !defined(RESCALE)
+  int* mask; /* densities which are calculated analytically */
+#endif  // APOT && !RESCALE
+} embed_scratch_t;
+
+static POTFIT_TLS embed_scratch_t g_embed = {0, };
+
+/****************************************************************
+  embed_spline
+    value and gradient of column col at num points from the packed
+    coefficients, the slots are computed without branches so that
+    the loop can be vectorized
+****************************************************************/
+
+static void embed_spline(int col, const double* restrict x,
+                         double* restrict val, double* restrict grad, int num)
+{
+  const pot_table_t* pt = &g_pot.calc_pot;
+  const double* restrict coeff = pt->coeff + 4 * pt->first[col];
+  const int last = pt->last[col] - pt->first[col] - 1;  // last interval
+
+  if (g_pot.format_type == POTENTIAL_FORMAT_TABULATED_NON_EQ_DIST) {
+    const double* restrict xc = pt->xcoord + pt->first[col];
+    int top = 1;
+
+    while (2 * top <= last)
+      top *= 2;
+
+    // binary search with a fixed number of steps
+    for (int i = 0; i < num; i++) {
+      int k = 0;
+
+      for (int s = top; s > 0; s >>= 1)
+        k += ((k + s <= last) & (xc[MIN(k + s, last)] <= x[i])) * s;
+
+      const double h = xc[k + 1] - xc[k];
+      const double b = (x[i] - xc[k]) / h;
+      const double* c = coeff + 4 * k;
+
+      val[i] = c[0] + b * (c[1] + b * (c[2] + b * c[3]));
+      grad[i] = (c[1] + b * (2.0 * c[2] + 3.0 * b * c[3])) / h;
+    }
+
+    return;
+  }
+
+  const double begin = pt->begin[col];
+  const double invstep = pt->invstep[col];
+
+  for (int i = 0; i < num; i++) {
+    const double t = (x[i] - begin) * invstep;
+    int k = (int)t;
+
+    k = (k < 0) ? 0 : k;
+    k = (k > last) ? last : k;
+
+    const double b = t - k;
+    const double* c = coeff + 4 * k;
+
+    val[i] = c[0] + b * (c[1] + b * (c[2] + b * c[3]));
+    grad[i] = (c[1] + b * (2.0 * c[2] + 3.0 * b * c[3])) * invstep;
+  }
+}
+
+/****************************************************************
+  embedding_energies
+****************************************************************/
+
+double embedding_energies(double* xi_opt, atom_t* atoms, int num, int band,
+                          double* limit, double* rho_sum)
+{
+  const int col_0 = g_calc.paircol + (1 + 2 * band) * g_param.ntypes;
+
+  if (num > g_embed.size) {
+    if (g_embed.offset == NULL)
+      g_embed.offset = (int*)Malloc((g_param.ntypes + 1) * sizeof(int));
+    g_embed.idx = (int*)Realloc(g_embed.idx, num * sizeof(int));
+    g_embed.rho = (double*)Realloc(g_embed.rho, num * sizeof(double));
+    g_embed.x = (double*)Realloc(g_embed.x, num * sizeof(double));
+    g_embed.val = (double*)Realloc(g_embed.val, num * sizeof(double));
+    g_embed.grad = (double*)Realloc(g_embed.grad, num * sizeof(double));
+#if defined(APOT) && !defined(RESCALE)
+    g_embed.mask = (int*)Realloc(g_embed.mask, num * sizeof(int));
+#endif  // APOT && !RESCALE
+    g_embed.size = num;
+  }
+
+  // group the densities by type
+  memset(g_embed.offset, 0, (g_param.ntypes + 1) * sizeof(int));
+
+  for (int i = 0; i < num; i++)
+    g_embed.offset[atoms[i].type + 1]++;
+
+  for (int t = 0; t < g_param.ntypes; t++)
+    g_embed.offset[t + 1] += g_embed.offset[t];
+
+  for (int i = 0; i < num; i++) {
+    const int pos = g_embed.offset[atoms[i].type]++;
+#if defined(TBEAM)
+    double* rho = band ? &atoms[i].rho_s : &atoms[i].rho;
+#else
+    double* rho = &atoms[i].rho;
+#endif  // TBEAM
+
+#if defined(RESCALE)
+    // punish densities outside of the embedding function
+    const int col = col_0 + atoms[i].type;
+    const double r = MIN(MAX(*rho, g_pot.calc_pot.begin[col]),
+                         g_pot.calc_pot.end[col]);
+
+    *limit += DUMMY_WEIGHT * 10.0 * dsquare(*rho - r);
+    *rho = r;
+#endif  // RESCALE
+
+    g_embed.idx[pos] = i;
+    g_embed.rho[pos] = *rho;
+    *rho_sum += *rho;
+  }
+
+  // offsets were moved to the end of each type
+  for (int t = g_param.ntypes; t > 0; t--)
+    g_embed.offset[t] = g_embed.offset[t - 1];
+
+  g_embed.offset[0] = 0;
+
+  double energy = 0.0;
+
+  for (int t = 0; t < g_param.ntypes; t++) {
+    const int col = col_0 + t;
+    const int first = g_embed.offset[t];
+    const int n = g_embed.offset[t + 1] - first;
+#if !defined(RESCALE)
+    const double begin = g_pot.calc_pot.begin[col];
+    const double end = g_pot.calc_pot.end[col];
+#endif  // !RESCALE
+    const double* restrict rho = g_embed.rho + first;
+    double* restrict x = g_embed.x + first;
+    double* restrict val = g_embed.val + first;
+    double* restrict grad = g_embed.grad + first;
+
+    if (n == 0)
+      continue;
+
+#if defined(RESCALE)
+    memcpy(x, rho, n * sizeof(double));
+#elif defined(APOT)
+    int* restrict mask = g_embed.mask + first;
+
+    // lanes outside of the table are calculated analytically below
+    for (int i = 0; i < n; i++) {
+      mask[i] = (rho[i] < begin) | (rho[i] > end) | (rho[i] < 0.1);
+      x[i] = MIN(MAX(rho[i], begin), end);
+    }
+#else
+    // linear extrapolation from begin and from end - step / 2
+    const double right = end - 0.5 * g_pot.calc_pot.step[col];
+
+    for (int i = 0; i < n; i++)
+      x[i] = (rho[i] < begin) ? begin : ((rho[i] > end) ? right : rho[i]);
+#endif  // RESCALE
+
+    embed_spline(col, x, val, grad, n);
+
+#if defined(APOT) && !defined(RESCALE)
+    for (int i = 0; i < n; i++) {
+      if (mask[i]) {
+        const double* params = xi_opt + g_pot.opt_pot.first[col];
+
+        g_pot.apot_table.fvalue[col](rho[i], params, val + i);
+        grad[i] = apot_gradient(rho[i], params, g_pot.apot_table.fvalue[col]);
+      }
+    }
+#endif  // APOT && !RESCALE
+
+    for (int i = 0; i < n; i++) {
+#if !defined(RESCALE) && !defined(APOT)
+      const double r = MIN(MAX(rho[i], begin), end);
+
+      energy += val[i] + (rho[i] - r) * grad[i];
+#else
+      energy += val[i];
+#endif  // !RESCALE && !APOT
+    }
+
+    for (int i = 0; i < n; i++) {
+#if defined(TBEAM)
+      if (band)
+        atoms[g_embed.idx[first + i]].gradF_s = grad[i];
+      else
+#endif  // TBEAM
+        atoms[g_embed.idx[first + i]].gradF = grad[i];
+    }
+  }
+
+  return energy;
+}
+
+#endif  // EAM || ADP || MEAM
+
+#if defined(DIPOLE)
+
+// number of previous iterates used for Anderson mixing
+#define DP_DEPTH 6
+// maximum number of iterations before giving up
+#define DP_MAX_IT 50
+
+// history of the Anderson mixing, grown for the largest configuration
+typedef struct {
+  int len;
+  double* work;
+} dipole_scratch_t;
+
+static POTFIT_TLS dipole_scratch_t g_dipole = {0, };
+
+/****************************************************************
+  dipole_field
+    computes the induced field E_ind = T * p_ind for configuration h
+****************************************************************/
+
+static void dipole_field(int h, const double* dp_alpha)
+{
+  atom_t* atom = NULL;
+
+  for (int i = 0; i < g_config.inconf[h]; i++) {
+    atom = g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+    if (dp_alpha[atom->type]) {
+      atom->E_ind.x = 0.0;
+      atom->E_ind.y = 0.0;
+      atom->E_ind.z = 0.0;
+    }
+  }
+
+  for (int i = 0; i < g_config.inconf[h]; i++) {
+    atom = g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+    if (!dp_alpha[atom->type])
+      continue;
+    for (int j = 0; j < atom->num_neigh; j++) {
+      neigh_t* neigh = atom->neigh + j;
+      if (neigh->r >= g_config.dp_cut || !dp_alpha[neigh->type])
+        continue;
+      atom_t* other = g_config.conf_atoms + neigh->nr - g_mpi.firstatom;
+      double rp = SPROD(other->p_ind, neigh->dist_r);
+      atom->E_ind.x += neigh->grad_el * (3 * rp * neigh->dist_r.x - other->p_ind.x);
+      atom->E_ind.y += neigh->grad_el * (3 * rp * neigh->dist_r.y - other->p_ind.y);
+      atom->E_ind.z += neigh->grad_el * (3 * rp * neigh->dist_r.z - other->p_ind.z);
+      // In small cells, an atom might interact with itself
+      if (neigh->nr != i + g_config.cnfstart[h]) {
+        rp = SPROD(atom->p_ind, neigh->dist_r);
+        other->E_ind.x += neigh->grad_el * (3 * rp * neigh->dist_r.x - atom->p_ind.x);
+        other->E_ind.y += neigh->grad_el * (3 * rp * neigh->dist_r.y - atom->p_ind.y);
+        other->E_ind.z += neigh->grad_el * (3 * rp * neigh->dist_r.z - atom->p_ind.z);
+      }
+    }
+  }
+}
+
+/****************************************************************
+  anderson_coefficients
+    solves the (regularized) normal equations of the Anderson
+    least squares problem min |f - dF * gamma| by Gaussian elimination
+    returns 0 if the system is singular
+****************************************************************/
+
+static int anderson_coefficients(int m, double A[DP_DEPTH][DP_DEPTH],
+                                 double* b, double* gamma)
+{
+  for (int i = 0; i < m; i++)
+    A[i][i] *= 1.0 + 1e-10;
+
+  for (int k = 0; k < m; k++) {
+    int p = k;
+    for (int i = k + 1; i < m; i++)
+      if (fabs(A[i][k]) > fabs(A[p][k]))
+        p = i;
+    if (fabs(A[p][k]) < DBL_MIN)
+      return 0;
+    if (p != k) {
+      for (int j = 0; j < m; j++) {
+        double t = A[k][j];
+        A[k][j] = A[p][j];
+        A[p][j] = t;
+      }
+      double t = b[k];
+      b[k] = b[p];
+      b[p] = t;
+    }
+    for (int i = k + 1; i < m; i++) {
+      double f = A[i][k] / A[k][k];
+      for (int j = k; j < m; j++)
+        A[i][j] -= f * A[k][j];
+      b[i] -= f * b[k];
+    }
+  }
+
+  for (int i = m - 1; i >= 0; i--) {
+    gamma[i] = b[i];
+    for (int j = i + 1; j < m; j++)
+      gamma[i] -= A[i][j] * gamma[j];
+    gamma[i] /= A[i][i];
   }
+
+  return 1;
 }
+
+/****************************************************************
+  solve_induced_dipoles
+    self-consistent solution of the induced dipoles of configuration h
+
+    The fixed point E = G(E) = T * (alpha * (E_stat + E) + p_sr) is
+    solved for the induced field with Anderson mixing; dp_mix damps
+    every update (without history this is plain linear mixing).
+    The induced field of the previous call is used as initial guess,
+    since the parameters only change slightly between force calls.
+
+    on return p_ind is consistent with E_tot, E_ind = G(E_tot - E_stat)
+    if the iteration does not converge, p_ind is induced by E_stat only
+****************************************************************/
+
+void solve_induced_dipoles(int h, const double* dp_alpha)
+{
+  const int n = 3 * g_config.inconf[h];
+  const double beta = 1.0 - g_config.dp_mix;
+
+  if (n > g_dipole.len) {
+    g_dipole.work = (double*)Realloc(g_dipole.work, (2 * DP_DEPTH + 2) * n * sizeof(double));
+    g_dipole.len = n;
+  }
+
+  double* work = g_dipole.work;
+
+  // x: current iterate (E_old), g: G(x) (E_ind), f = g - x
+  double* f_old = work;
+  double* g_old = work + n;
+  double* dF = work + 2 * n;
+  double* dG = work + (2 + DP_DEPTH) * n;
+
+  double A[DP_DEPTH][DP_DEPTH];
+  double b[DP_DEPTH];
+  double gamma[DP_DEPTH];
+
+  int m = 0;    // number of stored differences
+  int head = 0; // position of the next difference in the ring buffer
+  double max_diff = 10;
+  atom_t* atom = NULL;
+
+  // warm start from the induced field of the last call
+  for (int i = 0; i < g_config.inconf[h]; i++) {
+    atom = g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+    atom->E_old = atom->E_ind;
+  }
+
+  for (int dp_it = 0;; dp_it++) {
+    for (int i = 0; i < g_config.inconf[h]; i++) {
+      atom = g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+      double alpha = dp_alpha[atom->type];
+      if (alpha) {
+        atom->E_tot.x = atom->E_old.x + atom->E_stat.x;
+        atom->E_tot.y = atom->E_old.y + atom->E_stat.y;
+        atom->E_tot.z = atom->E_old.z + atom->E_stat.z;
+        atom->p_ind.x = alpha * atom->E_tot.x + atom->p_sr.x;
+        atom->p_ind.y = alpha * atom->E_tot.y + atom->p_sr.y;
+        atom->p_ind.z = alpha * atom->E_tot.z + atom->p_sr.z;
+      }
+    }
+
+    dipole_field(h, dp_alpha);
+
+    double dp_sum = 0.0;
+    for (int i = 0; i < g_config.inconf[h]; i++) {
+      atom = g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+      double alpha = dp_alpha[atom->type];
+      if (alpha) {
+        dp_sum += dsquare(alpha * (atom->E_ind.x - atom->E_old.x));
+        dp_sum += dsquare(alpha * (atom->E_ind.y - atom->E_old.y));
+        dp_sum += dsquare(alpha * (atom->E_ind.z - atom->E_old.z));
+      }
+    }
+    dp_sum = sqrt(dp_sum / n);
+
+    if (dp_sum < g_config.dp_tol)
+      return;
+
+    if (dp_it && ((dp_sum > max_diff) || (dp_it > DP_MAX_IT))) {
+      // no convergence, fall back to the static field like before, the
+      // next call starts from E_ind = E_stat
+      for (int i = 0; i < g_config.inconf[h]; i++) {
+        atom = g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+        double alpha = dp_alpha[atom->type];
+        if (alpha) {
+          atom->p_ind.x = alpha * atom->E_stat.x + atom->p_sr.x;
+          atom->p_ind.y = alpha * atom->E_stat.y + atom->p_sr.y;
+          atom->p_ind.z = alpha * atom->E_stat.z + atom->p_sr.z;
+          atom->E_ind = atom->E_stat;
+        }
+      }
+      return;
+    }
+
+    // update differences of residuals and images
+    if (dp_it) {
+      double* df = dF + head * n;
+      double* dg = dG + head * n;
+      for (int i = 0; i < g_config.inconf[h]; i++) {
+        atom = g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+        dg[3 * i + 0] = atom->E_ind.x - g_old[3 * i + 0];
+        dg[3 * i + 1] = atom->E_ind.y - g_old[3 * i + 1];
+        dg[3 * i + 2] = atom->E_ind.z - g_old[3 * i + 2];
+        df[3 * i + 0] = atom->E_ind.x - atom->E_old.x - f_old[3 * i + 0];
+        df[3 * i + 1] = atom->E_ind.y - atom->E_old.y - f_old[3 * i + 1];
+        df[3 * i + 2] = atom->E_ind.z - atom->E_old.z - f_old[3 * i + 2];
+      }
+      head = (head + 1) % DP_DEPTH;
+      if (m < DP_DEPTH)
+        m++;
+    }
+
+    for (int i = 0; i < g_config.inconf[h]; i++) {
+      atom = g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+      g_old[3 * i + 0] = atom->E_ind.x;
+      g_old[3 * i + 1] = atom->E_ind.y;
+      g_old[3 * i + 2] = atom->E_ind.z;
+      f_old[3 * i + 0] = atom->E_ind.x - atom->E_old.x;
+      f_old[3 * i + 1] = atom->E_ind.y - atom->E_old.y;
+      f_old[3 * i + 2] = atom->E_ind.z - atom->E_old.z;
+    }
+
+    // least squares coefficients of the stored differences
+    for (int k = 0; k < m; k++) {
+      b[k] = 0.0;
+      for (int l = 0; l < n; l++)
+        b[k] += dF[k * n + l] * f_old[l];
+      for (int j = 0; j <= k; j++) {
+        A[k][j] = 0.0;
+        for (int l = 0; l < n; l++)
+          A[k][j] += dF[k * n + l] * dF[j * n + l];
+        A[j][k] = A[k][j];
+      }
+    }
+    if (m && !anderson_coefficients(m, A, b, gamma)) {
+      // degenerate history, restart mixing
+      m = 0;
+      head = 0;
+    }
+
+    // x_new = x + beta * f - sum_k gamma_k * (dG_k - (1 - beta) * dF_k)
+    for (int i = 0; i < g_config.inconf[h]; i++) {
+      atom = g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+      if (!dp_alpha[atom->type])
+        continue;
+      double upd[3];
+      for (int d = 0; d < 3; d++) {
+        int l = 3 * i + d;
+        upd[d] = beta * f_old[l];
+        for (int k = 0; k < m; k++)
+          upd[d] -= gamma[k] * (dG[k * n + l] - (1.0 - beta) * dF[k * n + l]);
+      }
+      atom->E_old.x += upd[0];
+      atom->E_old.y += upd[1];
+      atom->E_old.z += upd[2];
+    }
+  }
+}
+
+#endif  // DIPOLE
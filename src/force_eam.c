@@ -31,6 +31,8 @@
 #error force_eam.c compiled without EAM support
 #endif
 
+#include <stddef.h>
+
 #include "potfit.h"
 
 #include "force.h"
@@ -42,8 +44,14 @@
 #include "potential_input.h"
 #include "potential_output.h"
 #include "splines.h"
+#include "timer.h"
 #include "utils.h"
 
+#if defined(FORCE_BATCH_SWEEP)
+void calc_forces_block(double* const* xi_opt, double* const* forces,
+                       double* error_sums, int count);
+#endif  // FORCE_BATCH_SWEEP
+
 /****************************************************************
  *
  *  init_forces
@@ -135,6 +143,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
   // This is the start of an infinite loop
   while (1) {
+    TIMER_START(TIMER_CALC);
+
     // sum of squares of local process
     double error_sum = 0.0;
     double rho_sum = 0.0;
@@ -150,19 +160,26 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // APOT && !MPI
 
 #if defined(MPI)
-#if !defined(APOT)
+    TIMER_START(TIMER_COMM);
+#if defined(APOT)
+    MPI_Bcast(&flag, 1, MPI_INT, 0, g_mpi.comm);
+#else
     // exchange potential and flag value
-    MPI_Bcast(xi, g_pot.calc_pot.len, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    broadcast_potential(xi, &flag);
 #endif  // APOT
-    MPI_Bcast(&flag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    TIMER_STOP(TIMER_COMM);
 
     if (flag == 1)
       break; // Exception: flag 1 means clean up
 
 #if defined(APOT)
-    if (g_mpi.myid == 0)
+    // the root process checks the vectors of the other groups before
+    // calc_forces_batch() sends them
+    if (g_mpi.myid == 0 && g_mpi.group == 0)
       apot_check_params(xi_opt);
-    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
     update_calc_table(xi_opt, xi, 0);
 #else   // APOT
     // if flag == 2 then the potential parameters have changed -> sync
@@ -195,7 +212,14 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     // loop over configurations
     for (int config_idx = g_mpi.firstconf; config_idx < g_mpi.firstconf + g_mpi.myconf; config_idx++) {
+      TIMER_CONF_START();
+
       int uf = g_config.conf_uf[config_idx - g_mpi.firstconf];
+      // atoms calculated by this process, the one with the first atom
+      // adds the terms of the whole configuration
+      int first = 0;
+      int last = 0;
+      calc_range(config_idx, &first, &last);
 #if defined(STRESS)
       int us = g_config.conf_us[config_idx - g_mpi.firstconf];
 #endif  // STRESS
@@ -208,13 +232,13 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
 #if defined(RESCALE)
       // set limiting constraints
-      forces[g_calc.limit_p + config_idx] = -g_config.force_0[g_calc.limit_p + config_idx];
+      forces[g_calc.limit_p + config_idx] = (first == 0) ? -g_config.force_0[g_calc.limit_p + config_idx] : 0.0;
 #endif  // RESCALE
 
       // first loop: reset forces and densities
       for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
         int n_i = 3 * (g_config.cnfstart[config_idx] + atom_idx);
-        if (uf) {
+        if (uf && atom_idx >= first && atom_idx < last) {
           forces[n_i + 0] = -g_config.force_0[n_i + 0];
           forces[n_i + 1] = -g_config.force_0[n_i + 1];
           forces[n_i + 2] = -g_config.force_0[n_i + 2];
@@ -228,8 +252,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // TBEAM
       }
 
+      TIMER_START(TIMER_PAIR);
       // second loop: calculate pair forces, energies and atomic densities
-      for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+      for (int atom_idx = first; atom_idx < last; atom_idx++) {
         atom_t* atom = g_config.conf_atoms + atom_idx + g_config.cnfstart[config_idx] - g_mpi.firstatom;
         int n_i = 3 * (g_config.cnfstart[config_idx] + atom_idx);
         // loop over all neighbors
@@ -244,9 +269,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
             double phi_grad = 0.0;
             // potential value and gradient are calculated in the same step
             if (uf)
-              phi_val = splint_comb_dir(&g_pot.calc_pot, xi, neigh->slot[0], neigh->shift[0], neigh->step[0], &phi_grad);
+              phi_val = splint_comb_coeff(&g_pot.calc_pot, neigh->slot[0], neigh->shift[0], neigh->step[0], &phi_grad);
             else
-              phi_val = splint_dir(&g_pot.calc_pot, xi, neigh->slot[0], neigh->shift[0], neigh->step[0]);
+              phi_val = splint_coeff(&g_pot.calc_pot, neigh->slot[0], neigh->shift[0]);
 
             // avoid double counting if atom is interacting with itself
             if (self) {
@@ -288,7 +313,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           if (atom->type == neigh->type) {
             // then transfer(a->b)==transfer(b->a)
             if (neigh->r < g_pot.calc_pot.end[neigh->col[1]]) {
-              double rho_val = splint_dir(&g_pot.calc_pot, xi, neigh->slot[1], neigh->shift[1], neigh->step[1]);
+              double rho_val = splint_coeff(&g_pot.calc_pot, neigh->slot[1], neigh->shift[1]);
               atom->rho += rho_val;
               // avoid double counting if atom is interacting with itself
               if (!self)
@@ -296,7 +321,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
             }
 #if defined(TBEAM)
             if (neigh->r < g_pot.calc_pot.end[neigh->col[2]]) {
-              double rho_s_val = splint_dir(&g_pot.calc_pot, xi, neigh->slot[2], neigh->shift[2], neigh->step[2]);
+              double rho_s_val = splint_coeff(&g_pot.calc_pot, neigh->slot[2], neigh->shift[2]);
               atom->rho_s += rho_s_val;
               // avoid double counting if atom is interacting with itself
               if (!self)
@@ -306,132 +331,63 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           } else {
             // transfer(a->b)!=transfer(b->a)
             if (neigh->r < g_pot.calc_pot.end[neigh->col[1]])
-              atom->rho += splint_dir(&g_pot.calc_pot, xi, neigh->slot[1], neigh->shift[1], neigh->step[1]);
-            // cannot use slot/shift to access splines
-            if (neigh->r < g_pot.calc_pot.end[g_calc.paircol + atom->type])
+              atom->rho += splint_coeff(&g_pot.calc_pot, neigh->slot[1], neigh->shift[1]);
+            if (neigh->r < g_pot.calc_pot.end[neigh->col[REV_SLOT]])
               g_config.conf_atoms[neigh->nr - g_mpi.firstatom].rho +=
-                g_splint(&g_pot.calc_pot, xi, g_calc.paircol + atom->type, neigh->r);
+                splint_coeff(&g_pot.calc_pot, neigh->slot[REV_SLOT], neigh->shift[REV_SLOT]);
 #if defined(TBEAM)
             if (neigh->r < g_pot.calc_pot.end[neigh->col[2]])
-              atom->rho_s += splint_dir(&g_pot.calc_pot, xi, neigh->slot[2], neigh->shift[2], neigh->step[2]);
-            if (neigh->r < g_pot.calc_pot .end[g_calc.paircol + 2 * g_param.ntypes + atom->type])
-              g_config.conf_atoms[neigh->nr - g_mpi.firstatom].rho_s += g_splint(&g_pot.calc_pot, xi, g_calc.paircol + 2 * g_param.ntypes + atom->type, neigh->r);
+              atom->rho_s += splint_coeff(&g_pot.calc_pot, neigh->slot[2], neigh->shift[2]);
+            if (neigh->r < g_pot.calc_pot.end[neigh->col[REV_SLOT + 1]])
+              g_config.conf_atoms[neigh->nr - g_mpi.firstatom].rho_s += splint_coeff(&g_pot.calc_pot, neigh->slot[REV_SLOT + 1], neigh->shift[REV_SLOT + 1]);
 #endif  // TBEAM
           }
         } // loop over all neighbors
+      } // second loop
+      TIMER_STOP(TIMER_PAIR);
 
-        // column of F
-        int col_F = g_calc.paircol + g_param.ntypes + atom->type;
+      // sum up the densities of a split configuration
+      exchange_halo(config_idx, offsetof(atom_t, rho), 1);
 #if defined(TBEAM)
-        // column of F of the s-band
-        int col_F_s = col_F + 2 * g_param.ntypes;
+      exchange_halo(config_idx, offsetof(atom_t, rho_s), 1);
 #endif  // TBEAM
 
-#if defined(RESCALE)
-        // we punish the potential for bad behavior:
-        // if the density of one atom is smaller or greater than we have the
-        // embedding function tabulated a punishment is added
-
-        if (atom->rho > g_pot.calc_pot.end[col_F]) {
-          // then punish target function -> bad potential
-          forces[g_calc.limit_p + config_idx] += DUMMY_WEIGHT * 10.0 * dsquare(atom->rho - g_pot.calc_pot.end[col_F]);
-          atom->rho = g_pot.calc_pot.end[col_F];
-        }
-
-        if (atom->rho < g_pot.calc_pot.begin[col_F]) {
-          // then punish target function -> bad potential
-          forces[g_calc.limit_p + config_idx] += DUMMY_WEIGHT * 10.0 * dsquare(g_pot.calc_pot.begin[col_F] - atom->rho);
-          atom->rho = g_pot.calc_pot.begin[col_F];
-        }
+      TIMER_START(TIMER_EMBED);
+      // embedding energy F(rho) and gradient of all atoms, densities outside
+      // of F are punished (RESCALE), calculated analytically (APOT) or
+      // extrapolated linearly
+      atom_t* atoms = g_config.conf_atoms + g_config.cnfstart[config_idx] + first - g_mpi.firstatom;
+      forces[g_calc.energy_p + config_idx] +=
+        embedding_energies(xi_opt, atoms, last - first, 0, forces + g_calc.limit_p + config_idx, &rho_sum);
 #if defined(TBEAM)
-        if (atom->rho_s > g_pot.calc_pot.end[col_F_s]) {
-          // then punish target function -> bad potential
-          forces[g_calc.limit_p + config_idx] += DUMMY_WEIGHT * 10.0 * dsquare(atom->rho_s - g_pot.calc_pot.end[col_F_s]);
-          atom->rho_s = g_pot.calc_pot.end[col_F_s];
-        }
-
-        if (atom->rho_s < g_pot.calc_pot.begin[col_F_s]) {
-          // then punish target function -> bad potential
-          forces[g_calc.limit_p + config_idx] += DUMMY_WEIGHT * 10.0 * dsquare(g_pot.calc_pot.begin[col_F_s] - atom->rho_s);
-          atom->rho_s = g_pot.calc_pot.begin[col_F_s];
-        }
+      forces[g_calc.energy_p + config_idx] +=
+        embedding_energies(xi_opt, atoms, last - first, 1, forces + g_calc.limit_p + config_idx, &rho_s_sum);
 #endif  // TBEAM
-#endif  // RESCALE
-
-// embedding energy, embedding gradient
-// contribution to cohesive energy is F(n)
-
-#if !defined(RESCALE)
-#if defined(APOT)
-        if ((atom->rho < g_pot.calc_pot.begin[col_F]) || (atom->rho > g_pot.calc_pot.end[col_F]) || (atom->rho < 0.1)) {
-          // calculate analytic value explicitly
-          double temp_eng = 0.0;
-          g_pot.apot_table.fvalue[col_F](atom->rho, xi_opt + g_pot.opt_pot.first[col_F], &temp_eng);
-          atom->gradF = apot_gradient(atom->rho, xi_opt + g_pot.opt_pot.first[col_F], g_pot.apot_table.fvalue[col_F]);
-          forces[g_calc.energy_p + config_idx] += temp_eng;
-        } else {
-#else // APOT
-        if (atom->rho < g_pot.calc_pot.begin[col_F]) {
-          // linear extrapolation left
-          double rho_val = g_splint_comb(&g_pot.calc_pot, xi, col_F, g_pot.calc_pot.begin[col_F], &atom->gradF);
-          forces[g_calc.energy_p + config_idx] += rho_val + (atom->rho - g_pot.calc_pot.begin[col_F]) * atom->gradF;
-        } else if (atom->rho > g_pot.calc_pot.end[col_F]) {
-          // and right
-          double rho_val = g_splint_comb(&g_pot.calc_pot, xi, col_F, g_pot.calc_pot.end[col_F] - 0.5 * g_pot.calc_pot.step[col_F], &atom->gradF);
-          forces[g_calc.energy_p + config_idx] += rho_val + (atom->rho - g_pot.calc_pot.end[col_F]) * atom->gradF;
-        } else { // and in-between
-#endif // APOT
-          forces[g_calc.energy_p + config_idx] += g_splint_comb(&g_pot.calc_pot, xi, col_F, atom->rho, &atom->gradF);
-        }
-#else // RESCALE
-        forces[g_calc.energy_p + config_idx] += g_splint_comb(&g_pot.calc_pot, xi, col_F, atom->rho, &atom->gradF);
-#endif  // !RESCALE
-
-        // sum up rho
-        rho_sum += atom->rho;
+      TIMER_STOP(TIMER_EMBED);
 
+      // the halo atoms need the gradients of the other processes
+      exchange_halo(config_idx, offsetof(atom_t, gradF), 0);
 #if defined(TBEAM)
-#if !defined(RESCALE)
-#if defined(APOT)
-        if ((atom->rho_s < g_pot.calc_pot.begin[col_F_s]) || (atom->rho_s > g_pot.calc_pot.end[col_F_s]) || (atom->rho_s < 0.1)) {
-          // calculate analytic value explicitly
-          double temp_eng = 0.0;
-          g_pot.apot_table.fvalue[col_F_s](atom->rho_s, xi_opt + g_pot.opt_pot.first[col_F_s], &temp_eng);
-          atom->gradF_s = apot_gradient(atom->rho_s, xi_opt + g_pot.opt_pot.first[col_F_s], g_pot.apot_table.fvalue[col_F_s]);
-          forces[g_calc.energy_p + config_idx] += temp_eng;
-        } else {
-#else // APOT
-        if (atom->rho_s < g_pot.calc_pot.begin[col_F_s]) {
-          // linear extrapolation left
-          double rho_s_val = g_splint_comb(&g_pot.calc_pot, xi, col_F_s, g_pot.calc_pot.begin[col_F_s], &atom->gradF_s);
-          forces[g_calc.energy_p + config_idx] += rho_s_val + (atom->rho_s - g_pot.calc_pot.begin[col_F_s]) * atom->gradF_s;
-        } else if (atom->rho_s > g_pot.calc_pot.end[col_F_s]) {
-          // and right
-          double rho_s_val = g_splint_comb(&g_pot.calc_pot, xi, col_F_s, g_pot.calc_pot.end[col_F_s] - 0.5 * g_pot.calc_pot.step[col_F_s], &atom->gradF_s);
-          forces[g_calc.energy_p + config_idx] += rho_s_val + (atom->rho_s - g_pot.calc_pot.end[col_F_s]) * atom->gradF_s;
-        } else {
-#endif // APOT
-          forces[g_calc.energy_p + config_idx] += g_splint_comb(&g_pot.calc_pot, xi, col_F_s, atom->rho_s, &atom->gradF_s);
-        }
-#else // RESCALE
-        forces[g_calc.energy_p + config_idx] += g_splint_comb(&g_pot.calc_pot, xi, col_F_s, atom->rho_s, &atom->gradF_s);
-#endif // RESCALE
-
-        // sum up rho_s
-        rho_s_sum += atom->rho_s;
-#endif // TBEAM
+      exchange_halo(config_idx, offsetof(atom_t, gradF_s), 0);
+#endif  // TBEAM
 
-      } // second loop
+      TIMER_START(TIMER_EMBED);
 
       // third loop: EAM force
       // only required if we calculate forces
       if (uf) {
-        for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+        for (int atom_idx = first; atom_idx < last; atom_idx++) {
           atom_t* atom = g_config.conf_atoms + atom_idx + g_config.cnfstart[config_idx] -
                   g_mpi.firstatom;
           int n_i = 3 * (g_config.cnfstart[config_idx] + atom_idx);
-          // loop over all neighbors
-          for (int neigh_idx = 0; neigh_idx < atom->num_neigh; neigh_idx++) {
+          // loop over the neighbors up to the last one in range of a transfer function
+#if defined(TBEAM)
+          int neigh_end = MAX(MAX(atom->neigh_end[1], atom->neigh_end[REV_SLOT]),
+                              MAX(atom->neigh_end[2], atom->neigh_end[REV_SLOT + 1]));
+#else
+          int neigh_end = MAX(atom->neigh_end[1], atom->neigh_end[REV_SLOT]);
+#endif  // TBEAM
+          for (int neigh_idx = 0; neigh_idx < neigh_end; neigh_idx++) {
             neigh_t* neigh = atom->neigh + neigh_idx;
             // In small cells, an atom might interact with itself
             int self = (neigh->nr == atom_idx + g_config.cnfstart[config_idx]) ? 1 : 0;
@@ -445,13 +401,13 @@ double calc_forces(double* xi_opt, double* forces, int flag)
             if ((r < g_pot.calc_pot.end[neigh->col[1]]) || (r < g_pot.calc_pot.end[col_F - g_param.ntypes])) {
               double rho_grad = 0.0;
               if (r < g_pot.calc_pot.end[neigh->col[1]])
-                rho_grad = splint_grad_dir(&g_pot.calc_pot, xi, neigh->slot[1], neigh->shift[1], neigh->step[1]);
+                rho_grad = splint_grad_coeff(&g_pot.calc_pot, neigh->slot[1], neigh->shift[1], neigh->step[1]);
               // use actio = reactio
               double rho_grad_j = 0.0;
               if (atom->type == neigh->type)
                 rho_grad_j = rho_grad;
               else if (r < g_pot.calc_pot.end[col_F - g_param.ntypes])
-                rho_grad_j =  g_splint_grad(&g_pot.calc_pot, xi, col_F - g_param.ntypes, r);
+                rho_grad_j = splint_grad_coeff(&g_pot.calc_pot, neigh->slot[REV_SLOT], neigh->shift[REV_SLOT], neigh->step[REV_SLOT]);
               // now we know everything - calculate forces
               double eam_force = (rho_grad * atom->gradF + rho_grad_j * g_config.conf_atoms[(neigh->nr) - g_mpi.firstatom] .gradF);
 
@@ -460,13 +416,13 @@ double calc_forces(double* xi_opt, double* forces, int flag)
               if ((r < g_pot.calc_pot.end[neigh->col[2]]) || (r < g_pot.calc_pot.end[col_F_s - g_param.ntypes])) {
                 double rho_s_grad = 0.0;
                 if (r < g_pot.calc_pot.end[neigh->col[2]])
-                  rho_s_grad = splint_grad_dir(&g_pot.calc_pot, xi, neigh->slot[2], neigh->shift[2], neigh->step[2]);
+                  rho_s_grad = splint_grad_coeff(&g_pot.calc_pot, neigh->slot[2], neigh->shift[2], neigh->step[2]);
                 // use actio = reactio
                 double rho_s_grad_j = 0.0;
                 if (atom->type == neigh->type)
                   rho_s_grad_j = rho_s_grad;
                 else if (r < g_pot.calc_pot.end[col_F_s - g_param.ntypes])
-                  rho_s_grad_j = g_splint_grad(&g_pot.calc_pot, xi, col_F_s - g_param.ntypes, r);
+                  rho_s_grad_j = splint_grad_coeff(&g_pot.calc_pot, neigh->slot[REV_SLOT + 1], neigh->shift[REV_SLOT + 1], neigh->step[REV_SLOT + 1]);
                 // now we know everything - calculate forces
                 eam_force += (rho_s_grad * atom->gradF_s + rho_s_grad_j * g_config.conf_atoms[(neigh->nr) - g_mpi.firstatom] .gradF_s);
               }
@@ -499,7 +455,22 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif          // STRESS
             } // within reach
           }   // loop over neighbours
+        } // third loop over atoms
+      } // use forces
+      TIMER_STOP(TIMER_EMBED);
 
+      // sum up the parts of a split configuration
+      reduce_config(forces, config_idx, uf);
+
+      // fourth loop: contribution of forces
+      if (uf) {
+        // the forces of all atoms are weighted, the owner of a split
+        // configuration sends all of them to the root process
+        for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+#if defined(FWEIGHT) || defined(CONTRIB)
+          atom_t* atom = g_config.conf_atoms + atom_idx + g_config.cnfstart[config_idx] - g_mpi.firstatom;
+#endif  // FWEIGHT || CONTRIB
+          int n_i = 3 * (g_config.cnfstart[config_idx] + atom_idx);
 #if defined(FWEIGHT)
           // Weigh by absolute value of force
           forces[n_i + 0] /= FORCE_EPS + atom->absforce;
@@ -507,21 +478,26 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           forces[n_i + 2] /= FORCE_EPS + atom->absforce;
 #endif  // FWEIGHT
 
+          // every process sums up the atoms it has calculated
+          if (atom_idx < first || atom_idx >= last)
+            continue;
+
           // sum up forces
 #if defined(CONTRIB)
           if (atom->contrib)
 #endif  // CONTRIB
             error_sum += g_config.conf_weight[config_idx] * (dsquare(forces[n_i + 0]) + dsquare(forces[n_i + 1]) + dsquare(forces[n_i + 2]));
-        } // third loop over atoms
+        }
       } // use forces
 
       // energy contributions
       forces[g_calc.energy_p + config_idx] /= (double)g_config.inconf[config_idx];
       forces[g_calc.energy_p + config_idx] -= g_config.force_0[g_calc.energy_p + config_idx];
-      error_sum += g_config.conf_weight[config_idx] * g_param.eweight * dsquare(forces[g_calc.energy_p + config_idx]);
+      if (first == 0)
+        error_sum += g_config.conf_weight[config_idx] * g_param.eweight * dsquare(forces[g_calc.energy_p + config_idx]);
 #if defined(STRESS)
       // stress contributions
-      if (uf && us) {
+      if (uf && us && first == 0) {
         for (int i = 0; i < 6; i++) {
           forces[stress_idx + i] /= g_config.conf_vol[config_idx - g_mpi.firstconf];
           forces[stress_idx + i] -= g_config.force_0[stress_idx + i];
@@ -533,14 +509,18 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
 #if defined(RESCALE)
       // limiting constraints per configuration
-      error_sum += g_config.conf_weight[config_idx] * dsquare(forces[g_calc.limit_p + config_idx]);
+      if (first == 0)
+        error_sum += g_config.conf_weight[config_idx] * dsquare(forces[g_calc.limit_p + config_idx]);
 #endif  // RESCALE
+
+      TIMER_CONF_STOP(config_idx);
     } // loop over configurations
 
     // dummy constraints (global)
 #if defined(APOT)
-    // add punishment for out of bounds (mostly for powell_lsq)
-    if (g_mpi.myid == 0)
+    // add punishment for out of bounds (mostly for powell_lsq), the root
+    // process adds it to the results of the other groups
+    if (g_mpi.myid == 0 && g_mpi.group == 0)
       error_sum += apot_punish(xi_opt, forces);
 #endif  // APOT
 
@@ -609,6 +589,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     gather_forces(&error_sum, forces);
 
+    TIMER_STOP(TIMER_CALC);
+
     // root process exits this function now
     if (g_mpi.myid == 0) {
       // increase function call counter
@@ -626,3 +608,339 @@ double calc_forces(double* xi_opt, double* forces, int flag)
   // once a non-root process arrives here, all is done.
   return -1.0;
 }
+
+#if defined(FORCE_BATCH_SWEEP)
+
+/****************************************************************
+  calc_forces_batch
+    same as count calls of calc_forces, but every neighbor is
+    loaded only once and evaluated with the splines of up to
+    FORCE_BATCH parameter vectors
+****************************************************************/
+
+void calc_forces_batch(double* const* xi_opt, double* const* forces,
+                       double* error_sums, int count)
+{
+  for (int i = 0; i < count; i += FORCE_BATCH) {
+    int num = MIN(FORCE_BATCH, count - i);
+    calc_forces_block(xi_opt + i, forces + i, error_sums + i, num);
+  }
+}
+
+/****************************************************************
+  calc_forces_block
+    the splines of each vector go to their own coefficient tables,
+    the densities and embedding gradients of each vector to their
+    own arrays, the embedding energies are calculated per vector
+****************************************************************/
+
+void calc_forces_block(double* const* xi_opt, double* const* forces,
+                       double* error_sums, int count)
+{
+  static POTFIT_TLS int alloc_len = 0;
+  static POTFIT_TLS double* rho[FORCE_BATCH];
+  static POTFIT_TLS double* gradF[FORCE_BATCH];
+
+  double* xi[FORCE_BATCH];
+  double* coeff[FORCE_BATCH];
+  // the coefficients of vector k in the tables of the spline functions
+  pot_table_t pot[FORCE_BATCH];
+  double rho_sum[FORCE_BATCH];
+
+  TIMER_START(TIMER_CALC);
+
+  if (alloc_len < g_config.natoms) {
+    for (int k = 0; k < FORCE_BATCH; k++) {
+      rho[k] = (double*)Realloc(rho[k], g_config.natoms * sizeof(double));
+      gradF[k] = (double*)Realloc(gradF[k], g_config.natoms * sizeof(double));
+    }
+    alloc_len = g_config.natoms;
+  }
+
+  init_batch(xi_opt, count, xi, coeff);
+
+  for (int k = 0; k < count; k++) {
+    select_batch(k);
+    update_splines(xi[k], 0, g_calc.paircol + g_param.ntypes, 1);
+    update_splines(xi[k], g_calc.paircol + g_param.ntypes, g_param.ntypes, 3);
+    pot[k] = g_pot.calc_pot;
+    error_sums[k] = 0.0;
+    rho_sum[k] = 0.0;
+  }
+
+  select_batch(-1);
+
+  g_mpi.myconf = g_config.nconf;
+
+  for (int config_idx = 0; config_idx < g_config.nconf; config_idx++) {
+    TIMER_CONF_START();
+
+    int uf = g_config.conf_uf[config_idx];
+    int start = g_config.cnfstart[config_idx];
+#if defined(STRESS)
+    int us = g_config.conf_us[config_idx];
+    int stress_idx = g_calc.stress_p + 6 * config_idx;
+#endif  // STRESS
+
+    // first loop: reset forces and densities
+    for (int k = 0; k < count; k++) {
+      forces[k][g_calc.energy_p + config_idx] = 0.0;
+#if defined(STRESS)
+      memset(forces[k] + stress_idx, 0, 6 * sizeof(double));
+#endif  // STRESS
+#if defined(RESCALE)
+      forces[k][g_calc.limit_p + config_idx] = -g_config.force_0[g_calc.limit_p + config_idx];
+#endif  // RESCALE
+
+      for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+        int n_i = 3 * (start + atom_idx);
+        if (uf) {
+          forces[k][n_i + 0] = -g_config.force_0[n_i + 0];
+          forces[k][n_i + 1] = -g_config.force_0[n_i + 1];
+          forces[k][n_i + 2] = -g_config.force_0[n_i + 2];
+        } else {
+          memset(forces[k] + n_i, 0, 3 * sizeof(double));
+        }
+      }
+
+      memset(rho[k] + start, 0, g_config.inconf[config_idx] * sizeof(double));
+    }
+
+    TIMER_START(TIMER_PAIR);
+    // second loop: pair forces, energies and atomic densities
+    for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+      atom_t* atom = g_config.conf_atoms + start + atom_idx;
+      int n_i = 3 * (start + atom_idx);
+      for (int neigh_idx = 0; neigh_idx < atom->num_neigh; neigh_idx++) {
+        neigh_t* neigh = atom->neigh + neigh_idx;
+        // In small cells, an atom might interact with itself
+        int self = (neigh->nr == atom_idx + start) ? 1 : 0;
+        int same = (atom->type == neigh->type) ? 1 : 0;
+        int n_j = 3 * neigh->nr;
+        int in_pair = neigh->r < g_pot.calc_pot.end[neigh->col[0]];
+        int in_rho = neigh->r < g_pot.calc_pot.end[neigh->col[1]];
+        int in_rev = !same && neigh->r < g_pot.calc_pot.end[neigh->col[REV_SLOT]];
+
+        // the neighbor data is loaded once for all parameter vectors
+        for (int k = 0; k < count; k++) {
+          double* f = forces[k];
+
+          if (in_pair) {
+            double phi_val = 0.0;
+            double phi_grad = 0.0;
+            if (uf)
+              phi_val = splint_comb_coeff(pot + k, neigh->slot[0], neigh->shift[0], neigh->step[0], &phi_grad);
+            else
+              phi_val = splint_coeff(pot + k, neigh->slot[0], neigh->shift[0]);
+
+            if (self) {
+              phi_val *= 0.5;
+              phi_grad *= 0.5;
+            }
+
+            f[g_calc.energy_p + config_idx] += phi_val;
+
+            if (uf) {
+              vector tmp_force;
+              tmp_force.x = neigh->dist_r.x * phi_grad;
+              tmp_force.y = neigh->dist_r.y * phi_grad;
+              tmp_force.z = neigh->dist_r.z * phi_grad;
+              f[n_i + 0] += tmp_force.x;
+              f[n_i + 1] += tmp_force.y;
+              f[n_i + 2] += tmp_force.z;
+              // actio = reactio
+              f[n_j + 0] -= tmp_force.x;
+              f[n_j + 1] -= tmp_force.y;
+              f[n_j + 2] -= tmp_force.z;
+#if defined(STRESS)
+              if (us) {
+                f[stress_idx + 0] -= neigh->dist.x * tmp_force.x;
+                f[stress_idx + 1] -= neigh->dist.y * tmp_force.y;
+                f[stress_idx + 2] -= neigh->dist.z * tmp_force.z;
+                f[stress_idx + 3] -= neigh->dist.x * tmp_force.y;
+                f[stress_idx + 4] -= neigh->dist.y * tmp_force.z;
+                f[stress_idx + 5] -= neigh->dist.z * tmp_force.x;
+              }
+#endif  // STRESS
+            }
+          }
+
+          if (in_rho) {
+            double rho_val = splint_coeff(pot + k, neigh->slot[1], neigh->shift[1]);
+            rho[k][start + atom_idx] += rho_val;
+            // transfer(a->b) == transfer(b->a) for atoms of the same type
+            if (same && !self)
+              rho[k][neigh->nr] += rho_val;
+          }
+          if (in_rev)
+            rho[k][neigh->nr] += splint_coeff(pot + k, neigh->slot[REV_SLOT], neigh->shift[REV_SLOT]);
+        }
+      }
+    }
+    TIMER_STOP(TIMER_PAIR);
+
+    TIMER_START(TIMER_EMBED);
+    // the embedding energies of each vector are calculated from the atoms,
+    // their densities and gradients are swapped in and out
+    atom_t* atoms = g_config.conf_atoms + start;
+    for (int k = 0; k < count; k++) {
+      for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++)
+        atoms[atom_idx].rho = rho[k][start + atom_idx];
+
+      select_batch(k);
+      forces[k][g_calc.energy_p + config_idx] +=
+        embedding_energies(xi_opt[k], atoms, g_config.inconf[config_idx], 0,
+                           forces[k] + g_calc.limit_p + config_idx, rho_sum + k);
+
+      for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++)
+        gradF[k][start + atom_idx] = atoms[atom_idx].gradF;
+    }
+    select_batch(-1);
+
+    // third loop: EAM force
+    if (uf) {
+      for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+        atom_t* atom = g_config.conf_atoms + start + atom_idx;
+        int n_i = 3 * (start + atom_idx);
+        int neigh_end = MAX(atom->neigh_end[1], atom->neigh_end[REV_SLOT]);
+        // column of F
+        int col_F = g_calc.paircol + g_param.ntypes + atom->type;
+        for (int neigh_idx = 0; neigh_idx < neigh_end; neigh_idx++) {
+          neigh_t* neigh = atom->neigh + neigh_idx;
+          double r = neigh->r;
+          int in_rho = r < g_pot.calc_pot.end[neigh->col[1]];
+          int in_rev = r < g_pot.calc_pot.end[col_F - g_param.ntypes];
+
+          if (!in_rho && !in_rev)
+            continue;
+
+          // In small cells, an atom might interact with itself
+          int self = (neigh->nr == atom_idx + start) ? 1 : 0;
+          int n_j = 3 * neigh->nr;
+
+          for (int k = 0; k < count; k++) {
+            double* f = forces[k];
+            double rho_grad = 0.0;
+            if (in_rho)
+              rho_grad = splint_grad_coeff(pot + k, neigh->slot[1], neigh->shift[1], neigh->step[1]);
+            // use actio = reactio
+            double rho_grad_j = 0.0;
+            if (atom->type == neigh->type)
+              rho_grad_j = rho_grad;
+            else if (in_rev)
+              rho_grad_j = splint_grad_coeff(pot + k, neigh->slot[REV_SLOT], neigh->shift[REV_SLOT], neigh->step[REV_SLOT]);
+            double eam_force = rho_grad * gradF[k][start + atom_idx] + rho_grad_j * gradF[k][neigh->nr];
+
+            // avoid double counting if atom is interacting with itself
+            if (self)
+              eam_force *= 0.5;
+            vector tmp_force;
+            tmp_force.x = neigh->dist_r.x * eam_force;
+            tmp_force.y = neigh->dist_r.y * eam_force;
+            tmp_force.z = neigh->dist_r.z * eam_force;
+            f[n_i + 0] += tmp_force.x;
+            f[n_i + 1] += tmp_force.y;
+            f[n_i + 2] += tmp_force.z;
+            // actio = reactio
+            f[n_j + 0] -= tmp_force.x;
+            f[n_j + 1] -= tmp_force.y;
+            f[n_j + 2] -= tmp_force.z;
+#if defined(STRESS)
+            if (us) {
+              f[stress_idx + 0] -= neigh->dist.x * tmp_force.x;
+              f[stress_idx + 1] -= neigh->dist.y * tmp_force.y;
+              f[stress_idx + 2] -= neigh->dist.z * tmp_force.z;
+              f[stress_idx + 3] -= neigh->dist.x * tmp_force.y;
+              f[stress_idx + 4] -= neigh->dist.y * tmp_force.z;
+              f[stress_idx + 5] -= neigh->dist.z * tmp_force.x;
+            }
+#endif  // STRESS
+          }
+        }
+      }
+    }
+    TIMER_STOP(TIMER_EMBED);
+
+    for (int k = 0; k < count; k++) {
+      double* f = forces[k];
+
+      // fourth loop: contribution of forces
+      if (uf) {
+        for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+#if defined(FWEIGHT) || defined(CONTRIB)
+          atom_t* atom = g_config.conf_atoms + start + atom_idx;
+#endif  // FWEIGHT || CONTRIB
+          int n_i = 3 * (start + atom_idx);
+#if defined(FWEIGHT)
+          f[n_i + 0] /= FORCE_EPS + atom->absforce;
+          f[n_i + 1] /= FORCE_EPS + atom->absforce;
+          f[n_i + 2] /= FORCE_EPS + atom->absforce;
+#endif  // FWEIGHT
+#if defined(CONTRIB)
+          if (atom->contrib)
+#endif  // CONTRIB
+            error_sums[k] += g_config.conf_weight[config_idx] * (dsquare(f[n_i + 0]) + dsquare(f[n_i + 1]) + dsquare(f[n_i + 2]));
+        }
+      }
+
+      f[g_calc.energy_p + config_idx] /= (double)g_config.inconf[config_idx];
+      f[g_calc.energy_p + config_idx] -= g_config.force_0[g_calc.energy_p + config_idx];
+      error_sums[k] += g_config.conf_weight[config_idx] * g_param.eweight * dsquare(f[g_calc.energy_p + config_idx]);
+#if defined(STRESS)
+      if (uf && us) {
+        for (int i = 0; i < 6; i++) {
+          f[stress_idx + i] /= g_config.conf_vol[config_idx];
+          f[stress_idx + i] -= g_config.force_0[stress_idx + i];
+          error_sums[k] += g_config.conf_weight[config_idx] * g_param.sweight * dsquare(f[stress_idx + i]);
+        }
+      }
+#endif  // STRESS
+#if defined(RESCALE)
+      error_sums[k] += g_config.conf_weight[config_idx] * dsquare(f[g_calc.limit_p + config_idx]);
+#endif  // RESCALE
+    }
+
+    TIMER_CONF_STOP(config_idx);
+  }
+
+  // dummy constraints (global)
+  for (int k = 0; k < count; k++) {
+    double* f = forces[k];
+#if defined(APOT)
+    error_sums[k] += apot_punish(xi_opt[k], f);
+#endif  // APOT
+#if !defined(NOPUNISH)
+    select_batch(k);
+    for (int g = 0; g < g_param.ntypes; g++) {
+      int col_F = g_calc.paircol + g_param.ntypes + g;
+      f[g_calc.dummy_p + g_param.ntypes + g] = 0.0; // Free end ...
+#if !defined(RESCALE)
+      // Constraint on U': U'(1.0)=0.0;
+      f[g_calc.dummy_p + g] = DUMMY_WEIGHT * g_splint_grad(&g_pot.calc_pot, xi[k], col_F, 1.0);
+#else
+      // constraints on U`(n)
+      f[g_calc.dummy_p + g] = DUMMY_WEIGHT * g_splint_grad(&g_pot.calc_pot, xi[k], col_F, 0.5 * (g_pot.calc_pot.begin[col_F] + g_pot.calc_pot.end[col_F])) - g_config.force_0[g_calc.dummy_p + g];
+#endif  // !RESCALE
+      error_sums[k] += dsquare(f[g_calc.dummy_p + g]);
+      error_sums[k] += dsquare(f[g_calc.dummy_p + g_param.ntypes + g]);
+    }
+#if !defined(RESCALE)
+    // Constraint on n: <n>=1.0 ONE CONSTRAINT ONLY
+    if (rho_sum[k] > 0.0) {
+      f[g_calc.dummy_p + g_param.ntypes] = DUMMY_WEIGHT * (rho_sum[k] / (double)g_config.natoms - 1.0);
+      error_sums[k] += dsquare(f[g_calc.dummy_p + g_param.ntypes]);
+    }
+#endif  // !RESCALE
+#endif  // !NOPUNISH
+    if (isnan(error_sums[k]))
+      error_sums[k] = 10e10;
+  }
+
+  select_batch(-1);
+
+  g_calc.fcalls += count;
+
+  TIMER_STOP(TIMER_CALC);
+}
+
+#endif  // FORCE_BATCH_SWEEP
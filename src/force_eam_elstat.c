@@ -36,9 +36,11 @@
 
 #include "force.h"
 #include "functions.h"
+#include "mpi_utils.h"
 #include "potential_input.h"
 #include "potential_output.h"
 #include "splines.h"
+#include "timer.h"
 #include "utils.h"
 
 /****************************************************************
@@ -52,6 +54,7 @@
 void init_force(int is_worker)
 {
 #if defined(COULOMB)
+  reset_tails();
   if (g_pot.apot_table.sw_kappa)  // FIXME is sw_kappa really correct here?
     init_tails(g_pot.apot_table.dp_kappa[0]);
 #endif  // COULOMB
@@ -128,7 +131,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
   double dp_c[g_calc.paircol];
 #endif  // DIPOLE
 
-  static double rho_sum_loc, rho_sum;
+  static POTFIT_TLS double rho_sum_loc, rho_sum;
   rho_sum_loc = rho_sum = 0.0;
 
   switch (g_pot.format_type) {
@@ -154,6 +157,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
   /* This is the start of an infinite loop */
   while (1) {
+    TIMER_START(TIMER_CALC);
+
     tmpsum = 0.0; /* sum of squares of local process */
     rho_sum_loc = 0.0;
 
@@ -165,11 +170,14 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // APOT && !MPI
 
 #if defined(MPI)
+    TIMER_START(TIMER_COMM);
 /* exchange potential and flag value */
-#if !defined(APOT)
-    MPI_Bcast(xi, g_pot.calc_pot.len, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#if defined(APOT)
+    MPI_Bcast(&flag, 1, MPI_INT, 0, g_mpi.comm);
+#else
+    broadcast_potential(xi, &flag);
 #endif  // APOT
-    MPI_Bcast(&flag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    TIMER_STOP(TIMER_COMM);
 
     if (flag == 1)
       break; /* Exception: flag 1 means clean up */
@@ -177,7 +185,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #if defined(APOT)
     if (g_mpi.myid == 0)
       apot_check_params(xi_opt);
-    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
     if (g_pot.format_type == POTENTIAL_FORMAT_ANALYTIC)
       update_calc_table(xi_opt, xi, 0);
 #else   /* APOT */
@@ -229,6 +239,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // DIPOLE
 
     /* init second derivatives for splines */
+    TIMER_START(TIMER_SPLINES);
 
     /* pair potentials & rho */
     for (col = 0; col < g_calc.paircol + g_param.ntypes; col++) {
@@ -281,6 +292,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           error(1, "KIM format is not supported by EAM elstat force routine!");
       }
     }
+    TIMER_STOP(TIMER_SPLINES);
 
     /* region containing loop over configurations */
     {
@@ -305,6 +317,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
       /* loop over configurations: M A I N LOOP CONTAINING ALL ATOM-LOOPS */
       for (h = g_mpi.firstconf; h < g_mpi.firstconf + g_mpi.myconf; h++) {
+        TIMER_CONF_START();
+
         uf = g_config.conf_uf[h - g_mpi.firstconf];
 #if defined(STRESS)
         us = g_config.conf_us[h - g_mpi.firstconf];
@@ -351,6 +365,11 @@ double calc_forces(double* xi_opt, double* forces, int flag)
               0.0;
         } /* end F I R S T LOOP */
 
+        /* updating tail-functions - only necessary with varying kappa */
+        if (!apt->sw_kappa)
+          update_tails(h, dp_kappa);
+
+        TIMER_START(TIMER_PAIR);
         /* S E C O N D loop: calculate short-range and monopole forces,
            calculate static field- and dipole-contributions,
            calculate atomic densities */
@@ -359,21 +378,12 @@ double calc_forces(double* xi_opt, double* forces, int flag)
               g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
           type1 = atom->type;
           n_i = 3 * (g_config.cnfstart[h] + i);
-          for (j = 0; j < atom->num_neigh; j++) { /* neighbors */
+          /* the pair potentials usually end before dp_cut */
+          for (j = 0; j < atom->neigh_end[0]; j++) { /* neighbors */
             neigh = atom->neigh + j;
             type2 = neigh->type;
             col = neigh->col[0];
 
-            /* updating tail-functions - only necessary with variing kappa */
-            if (!apt->sw_kappa)
-#if defined(DSF)
-              elstat_dsf(neigh->r, dp_kappa, &neigh->fnval_el,
-                           &neigh->grad_el, &neigh->ggrad_el);
-#else
-              elstat_shift(neigh->r, dp_kappa, &neigh->fnval_el,
-                           &neigh->grad_el, &neigh->ggrad_el);
-#endif // DSF
-
             /* In small cells, an atom might interact with itself */
             self = (neigh->nr == i + g_config.cnfstart[h]) ? 1 : 0;
 
@@ -420,6 +430,15 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // STRESS
               }
             }
+          } /* loop over neighbours in range of the pair potentials */
+
+          for (j = 0; j < atom->num_neigh; j++) { /* neighbors */
+            neigh = atom->neigh + j;
+            type2 = neigh->type;
+            col = neigh->col[0];
+
+            /* In small cells, an atom might interact with itself */
+            self = (neigh->nr == i + g_config.cnfstart[h]) ? 1 : 0;
 
             /* calculate monopole forces */
             if (neigh->r < g_config.dp_cut &&
@@ -525,11 +544,10 @@ double calc_forces(double* xi_opt, double* forces, int flag)
                 atom->rho += splint_dir(&g_pot.calc_pot, xi, neigh->slot[1],
                                         neigh->shift[1], neigh->step[1]);
               }
-              /* cannot use slot/shift to access splines */
-              if (neigh->r < g_pot.calc_pot.end[g_calc.paircol + atom->type])
+              if (neigh->r < g_pot.calc_pot.end[neigh->col[REV_SLOT]])
                 g_config.conf_atoms[neigh->nr - g_mpi.firstatom].rho +=
-                    (*g_splint)(&g_pot.calc_pot, xi,
-                                g_calc.paircol + atom->type, neigh->r);
+                    splint_dir(&g_pot.calc_pot, xi, neigh->slot[REV_SLOT],
+                               neigh->shift[REV_SLOT], neigh->step[REV_SLOT]);
             }
 
           } /* loop over neighbours */
@@ -593,140 +611,13 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           rho_sum_loc += atom->rho;
 
         } /* end S E C O N D loop over atoms */
+        TIMER_STOP(TIMER_PAIR);
 
 #if defined(DIPOLE)
         /* T H I R D loop: calculate whole dipole moment for every atom */
-        double rp, dp_sum;
-        int dp_converged = 0, dp_it = 0;
-        double max_diff = 10;
-
-        while (dp_converged == 0) {
-          dp_sum = 0;
-          for (i = 0; i < g_config.inconf[h]; i++) { /* atoms */
-            atom = g_config.conf_atoms + i + g_config.cnfstart[h] -
-                   g_mpi.firstatom;
-            type1 = atom->type;
-            if (dp_alpha[type1]) {
-              if (dp_it) {
-                /* note: mixing parameter is different from that on in IMD */
-                atom->E_tot.x = (1 - g_config.dp_mix) * atom->E_ind.x +
-                                g_config.dp_mix * atom->E_old.x +
-                                atom->E_stat.x;
-                atom->E_tot.y = (1 - g_config.dp_mix) * atom->E_ind.y +
-                                g_config.dp_mix * atom->E_old.y +
-                                atom->E_stat.y;
-                atom->E_tot.z = (1 - g_config.dp_mix) * atom->E_ind.z +
-                                g_config.dp_mix * atom->E_old.z +
-                                atom->E_stat.z;
-              } else {
-                atom->E_tot.x = atom->E_ind.x + atom->E_stat.x;
-                atom->E_tot.y = atom->E_ind.y + atom->E_stat.y;
-                atom->E_tot.z = atom->E_ind.z + atom->E_stat.z;
-              }
-
-              atom->p_ind.x = dp_alpha[type1] * atom->E_tot.x + atom->p_sr.x;
-              atom->p_ind.y = dp_alpha[type1] * atom->E_tot.y + atom->p_sr.y;
-              atom->p_ind.z = dp_alpha[type1] * atom->E_tot.z + atom->p_sr.z;
-
-              atom->E_old.x = atom->E_ind.x;
-              atom->E_old.y = atom->E_ind.y;
-              atom->E_old.z = atom->E_ind.z;
-
-              atom->E_ind.x = 0.0;
-              atom->E_ind.y = 0.0;
-              atom->E_ind.z = 0.0;
-            }
-          }
-
-          for (i = 0; i < g_config.inconf[h]; i++) { /* atoms */
-            atom = g_config.conf_atoms + i + g_config.cnfstart[h] -
-                   g_mpi.firstatom;
-            type1 = atom->type;
-            for (j = 0; j < atom->num_neigh; j++) { /* neighbors */
-              neigh = atom->neigh + j;
-              type2 = neigh->type;
-              col = neigh->col[0];
-              /* In small cells, an atom might interact with itself */
-              self = (neigh->nr == i + g_config.cnfstart[h]) ? 1 : 0;
-
-              if (neigh->r < g_config.dp_cut && dp_alpha[type1] &&
-                  dp_alpha[type2]) {
-                rp = SPROD(
-                    g_config.conf_atoms[neigh->nr - g_mpi.firstatom].p_ind,
-                    neigh->dist_r);
-                atom->E_ind.x +=
-                    neigh->grad_el *
-                    (3 * rp * neigh->dist_r.x -
-                     g_config.conf_atoms[neigh->nr - g_mpi.firstatom].p_ind.x);
-                atom->E_ind.y +=
-                    neigh->grad_el *
-                    (3 * rp * neigh->dist_r.y -
-                     g_config.conf_atoms[neigh->nr - g_mpi.firstatom].p_ind.y);
-                atom->E_ind.z +=
-                    neigh->grad_el *
-                    (3 * rp * neigh->dist_r.z -
-                     g_config.conf_atoms[neigh->nr - g_mpi.firstatom].p_ind.z);
-
-                if (!self) {
-                  rp = SPROD(atom->p_ind, neigh->dist_r);
-                  g_config.conf_atoms[neigh->nr - g_mpi.firstatom].E_ind.x +=
-                      neigh->grad_el *
-                      (3 * rp * neigh->dist_r.x - atom->p_ind.x);
-                  g_config.conf_atoms[neigh->nr - g_mpi.firstatom].E_ind.y +=
-                      neigh->grad_el *
-                      (3 * rp * neigh->dist_r.y - atom->p_ind.y);
-                  g_config.conf_atoms[neigh->nr - g_mpi.firstatom].E_ind.z +=
-                      neigh->grad_el *
-                      (3 * rp * neigh->dist_r.z - atom->p_ind.z);
-                }
-              }
-            }
-          }
-
-          for (i = 0; i < g_config.inconf[h]; i++) { /* atoms */
-            atom = g_config.conf_atoms + i + g_config.cnfstart[h] -
-                   g_mpi.firstatom;
-            type1 = atom->type;
-            if (dp_alpha[type1]) {
-              dp_sum +=
-                  dsquare(dp_alpha[type1] * (atom->E_old.x - atom->E_ind.x));
-              dp_sum +=
-                  dsquare(dp_alpha[type1] * (atom->E_old.y - atom->E_ind.y));
-              dp_sum +=
-                  dsquare(dp_alpha[type1] * (atom->E_old.z - atom->E_ind.z));
-            }
-          }
-
-          dp_sum /= 3 * g_config.inconf[h];
-          dp_sum = sqrt(dp_sum);
-
-          if (dp_it) {
-            if ((dp_sum > max_diff) || (dp_it > 50)) {
-              dp_converged = 1;
-              for (i = 0; i < g_config.inconf[h]; i++) { /* atoms */
-                atom = g_config.conf_atoms + i + g_config.cnfstart[h] -
-                       g_mpi.firstatom;
-                type1 = atom->type;
-                if (dp_alpha[type1]) {
-                  atom->p_ind.x =
-                      dp_alpha[type1] * atom->E_stat.x + atom->p_sr.x;
-                  atom->p_ind.y =
-                      dp_alpha[type1] * atom->E_stat.y + atom->p_sr.y;
-                  atom->p_ind.z =
-                      dp_alpha[type1] * atom->E_stat.z + atom->p_sr.z;
-                  atom->E_ind.x = atom->E_stat.x;
-                  atom->E_ind.y = atom->E_stat.y;
-                  atom->E_ind.z = atom->E_stat.z;
-                }
-              }
-            }
-          }
-
-          if (dp_sum < g_config.dp_tol)
-            dp_converged = 1;
-
-          dp_it++;
-        } /* end T H I R D loop over atoms */
+        TIMER_START(TIMER_DIPOLE);
+        solve_induced_dipoles(h, dp_alpha);
+        TIMER_STOP(TIMER_DIPOLE);
 
         /* F O U R T H  loop: calculate monopole-dipole and dipole-dipole forces
          */
@@ -989,14 +880,16 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
         } /* end F I F T H loop over atoms */
 
+        TIMER_START(TIMER_EMBED);
         /* S I X T H  loop: EAM force */
         if (uf) { /* only required if we calc forces */
           for (i = 0; i < g_config.inconf[h]; i++) {
             atom = g_config.conf_atoms + i + g_config.cnfstart[h] -
                    g_mpi.firstatom;
             n_i = 3 * (g_config.cnfstart[h] + i);
-            for (j = 0; j < atom->num_neigh; j++) {
-              /* loop over neighbors */
+            /* loop over neighbors in range of a transfer function */
+            for (j = 0; j < MAX(atom->neigh_end[1], atom->neigh_end[REV_SLOT]);
+                 j++) {
               neigh = atom->neigh + j;
               /* In small cells, an atom might interact with itself */
               self = (neigh->nr == i + g_config.cnfstart[h]) ? 1 : 0;
@@ -1015,8 +908,10 @@ double calc_forces(double* xi_opt, double* forces, int flag)
                   rho_grad_j = rho_grad;
                 else
                   rho_grad_j = (r < g_pot.calc_pot.end[col_F - g_param.ntypes])
-                                   ? (*g_splint_grad)(&g_pot.calc_pot, xi,
-                                                      col_F - g_param.ntypes, r)
+                                   ? splint_grad_dir(&g_pot.calc_pot, xi,
+                                                     neigh->slot[REV_SLOT],
+                                                     neigh->shift[REV_SLOT],
+                                                     neigh->step[REV_SLOT])
                                    : 0.0;
                 /* now we know everything - calculate forces */
                 eam_force =
@@ -1069,6 +964,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         }
 
         /* end S I X T H loop over atoms */
+        TIMER_STOP(TIMER_EMBED);
         /* whole energy contributions flow into tmpsum */
         forces[g_calc.energy_p + h] /= (double)g_config.inconf[h];
         forces[g_calc.energy_p + h] -= g_config.force_0[g_calc.energy_p + h];
@@ -1088,12 +984,14 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // STRESS
         /* limiting constraints per configuration */
         tmpsum += g_config.conf_weight[h] * dsquare(forces[g_calc.limit_p + h]);
+
+        TIMER_CONF_STOP(h);
       } /* end M A I N loop over configurations */
     }   /* parallel region */
 #if defined(MPI)
     /* Reduce rho_sum */
     MPI_Reduce(&rho_sum_loc, &rho_sum, 1, MPI_DOUBLE, MPI_SUM, 0,
-               MPI_COMM_WORLD);
+               g_mpi.comm);
 #else   /* MPI */
     rho_sum = rho_sum_loc;
 #endif  // MPI
@@ -1145,58 +1043,62 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // NOPUNISH
 
 #if defined(MPI)
+    TIMER_START(TIMER_COMM);
     /* reduce global sum */
     sum = 0.0;
-    MPI_Reduce(&tmpsum, &sum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&tmpsum, &sum, 1, MPI_DOUBLE, MPI_SUM, 0, g_mpi.comm);
     /* gather forces, energies, stresses */
     if (g_mpi.myid == 0) { /* root node already has data in place */
       /* forces */
       MPI_Gatherv(MPI_IN_PLACE, g_mpi.myatoms, g_mpi.MPI_VECTOR, forces,
                   g_mpi.atom_len, g_mpi.atom_dist, g_mpi.MPI_VECTOR, 0,
-                  MPI_COMM_WORLD);
+                  g_mpi.comm);
       /* energies */
       MPI_Gatherv(MPI_IN_PLACE, g_mpi.myconf, MPI_DOUBLE,
                   forces + g_calc.energy_p, g_mpi.conf_len, g_mpi.conf_dist,
-                  MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                  MPI_DOUBLE, 0, g_mpi.comm);
 #if defined(STRESS)
       /* stresses */
       MPI_Gatherv(MPI_IN_PLACE, g_mpi.myconf, g_mpi.MPI_STENS,
                   forces + g_calc.stress_p, g_mpi.conf_len, g_mpi.conf_dist,
-                  g_mpi.MPI_STENS, 0, MPI_COMM_WORLD);
+                  g_mpi.MPI_STENS, 0, g_mpi.comm);
 #endif  // STRESS
 #if !defined(NORESCALE)
       /* punishment constraints */
       MPI_Gatherv(MPI_IN_PLACE, g_mpi.myconf, MPI_DOUBLE,
                   forces + g_calc.limit_p, g_mpi.conf_len, g_mpi.conf_dist,
-                  MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                  MPI_DOUBLE, 0, g_mpi.comm);
 #endif  // !NORESCALE
     } else {
       /* forces */
       MPI_Gatherv(forces + g_mpi.firstatom * 3, g_mpi.myatoms, g_mpi.MPI_VECTOR,
                   forces, g_mpi.atom_len, g_mpi.atom_dist, g_mpi.MPI_VECTOR, 0,
-                  MPI_COMM_WORLD);
+                  g_mpi.comm);
       /* energies */
       MPI_Gatherv(forces + g_calc.energy_p + g_mpi.firstconf, g_mpi.myconf,
                   MPI_DOUBLE, forces + g_calc.energy_p, g_mpi.conf_len,
-                  g_mpi.conf_dist, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                  g_mpi.conf_dist, MPI_DOUBLE, 0, g_mpi.comm);
 #if defined(STRESS)
       /* stresses */
       MPI_Gatherv(forces + g_calc.stress_p + 6 * g_mpi.firstconf, g_mpi.myconf,
                   g_mpi.MPI_STENS, forces + g_calc.stress_p, g_mpi.conf_len,
-                  g_mpi.conf_dist, g_mpi.MPI_STENS, 0, MPI_COMM_WORLD);
+                  g_mpi.conf_dist, g_mpi.MPI_STENS, 0, g_mpi.comm);
 #endif  // STRESS
 #if !defined(NORESCALE)
       /* punishment constraints */
       MPI_Gatherv(forces + g_calc.limit_p + g_mpi.firstconf, g_mpi.myconf,
                   MPI_DOUBLE, forces + g_calc.limit_p, g_mpi.conf_len,
-                  g_mpi.conf_dist, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                  g_mpi.conf_dist, MPI_DOUBLE, 0, g_mpi.comm);
 #endif  // !NORESCALE
     }
 /* no need to pick up dummy constraints - they are already @ root */
+    TIMER_STOP(TIMER_COMM);
 #else
     sum = tmpsum; /* global sum = local sum  */
 #endif  // MPI
 
+    TIMER_STOP(TIMER_CALC);
+
     /* root process exits this function now */
     if (g_mpi.myid == 0) {
       g_calc.fcalls++; /* Increase function call counter */
@@ -45,8 +45,14 @@
 #include "potential_input.h"
 #include "potential_output.h"
 #include "splines.h"
+#include "timer.h"
 #include "utils.h"
 
+/* Atoms of a configuration are handled in blocks of this size: densities,
+   embedding energies and embedding forces of one block are calculated
+   before the next block, so its neighbor data is still cached */
+#define EMBED_BLOCK 64
+
 /****************************************************************
  *
  *  init_forces
@@ -115,7 +121,7 @@ void init_force(int is_worker)
 
 double calc_forces(double* xi_opt, double* forces, int flag)
 {
-  int first, col, i = flag;
+  int i = flag;
   double* xi = NULL;
 
   /* Some useful temp variables */
@@ -125,11 +131,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
   /* Temp variables */
   atom_t* atom = NULL; /* atom pointer */
   int h, j, k;
+  int block, block_end;
   int n_i, n_j, n_k;
   int uf;
-#if defined(APOT)
-  double temp_eng;
-#endif  // APOT
 #if defined(STRESS)
   int us, stresses;
 #endif  // STRESS
@@ -143,11 +147,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
   vector tmp_force;
 
   /* EAM variables */
-  int col_F;
   double eam_force;
-#if !defined RESCALE && !defined APOT
-  double rho_val;
-#endif  // !RESCALE && !APOT
 
   /* MEAM variables */
   double dV3j, dV3k, V3, vlj, vlk, vv3j, vv3k;
@@ -171,6 +171,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
   /* This is the start of an infinite loop */
   while (1) {
+    TIMER_START(TIMER_CALC);
+
     /* Reset tmpsum and rho_sum_loc
        tmpsum = Sum of all the forces, energies and constraints
        rho_sum_loc = Sum of density, rho, for all atoms */
@@ -185,11 +187,14 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // APOT && !MPI
 
 #if defined(MPI)
+    TIMER_START(TIMER_COMM);
 /* exchange potential and flag value */
-#if !defined(APOT)
-    MPI_Bcast(xi, g_pot.calc_pot.len, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#if defined(APOT)
+    MPI_Bcast(&flag, 1, MPI_INT, 0, g_mpi.comm);
+#else
+    broadcast_potential(xi, &flag);
 #endif  // APOT
-    MPI_Bcast(&flag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    TIMER_STOP(TIMER_COMM);
 
     if (1 == flag)
       break; /* Exception: flag 1 means clean up */
@@ -197,7 +202,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #if defined(APOT)
     if (g_mpi.myid == 0)
       apot_check_params(xi_opt);
-    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
     update_calc_table(xi_opt, xi, 0);
 #else
     /* if flag==2 then the potential parameters have changed -> sync */
@@ -212,22 +219,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
        where paircol is number of pair potential columns
        and g_param.ntypes is number of rho columns
        and g_param.ntypes is number of F columns */
-    for (col = 0; col < 2 * g_calc.paircol + 3 * g_param.ntypes; col++) {
-      /* Pointer to first entry */
-      first = g_pot.calc_pot.first[col];
-
-      /* Initialize 2nd derivatives
-         step = width of spline knots (known as h)
-         xi+first = array with spline values
-         g_pot.calc_pot.last[col1] - first + 1 = num of spline pts
-         *(xi + first - 2) = value of endpoint gradient (default: 1e30)
-         *(xi + first - 1) = value of other endpoint gradient
-         (default: phi=0.0, rho=0.0, F=1e30)
-         g_pot.calc_pot.d2tab + first = array to hold 2nd deriv */
-      spline_ed(g_pot.calc_pot.step[col], xi + first,
-                g_pot.calc_pot.last[col] - first + 1, *(xi + first - 2),
-                *(xi + first - 1), g_pot.calc_pot.d2tab + first);
-    }
+    update_splines(xi, 0, 2 * g_calc.paircol + 3 * g_param.ntypes, 3);
 
 #if !defined(MPI)
     g_mpi.myconf = g_config.nconf;
@@ -237,6 +229,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
     {
       /* Loop over configurations */
       for (h = g_mpi.firstconf; h < g_mpi.firstconf + g_mpi.myconf; h++) {
+        TIMER_CONF_START();
+
         uf = g_config.conf_uf[h - g_mpi.firstconf];
 #if defined(STRESS)
         us = g_config.conf_us[h - g_mpi.firstconf];
@@ -276,385 +270,304 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         } /* i */
         /* END OF FIRST LOOP */
 
+        TIMER_START(TIMER_THREEBODY);
         /* SECOND LOOP: Calculate pair forces and energies, atomic densities */
-        for (i = 0; i < g_config.inconf[h]; i++) {
-          /* Set pointer to temp atom pointer */
-          atom = g_config.conf_atoms +
-                 (g_config.cnfstart[h] - g_mpi.firstatom + i);
-          /* Skip every 3 spots for force array */
-          n_i = 3 * (g_config.cnfstart[h] + i);
-          /* Loop over neighbors */
-          for (j = 0; j < atom->num_neigh; j++) {
-            /* Set pointer to temp neighbor pointer */
-            neigh_j = atom->neigh + j;
-            /* Find the correct column in the potential table for pair
-               potential: phi_ij
-               For Binary Alloy: 0 = phi_AA, 1 = (phi_AB or phi_BA), 2 = phi_BB
-               where typ = A = 0 and typ = B = 1 */
-            /* We need to check that neighbor atom exists inside pair
-             * potential's radius */
-            if (neigh_j->r < g_pot.calc_pot.end[neigh_j->col[0]]) {
-              /* Compute phi and phi' value given radial distance
-                 NOTE: slot = spline point index right below radial distance
-                 shift = % distance from 'slot' spline pt
-                 step = width of spline points (given as 'h' in books)
-                 0 means the pair potential columns */
-              /* fn value and grad are calculated in the same step */
-              if (uf)
-                phi_val = splint_comb_dir(&g_pot.calc_pot, xi, neigh_j->slot[0],
-                                          neigh_j->shift[0], neigh_j->step[0],
-                                          &phi_grad);
-              else
-                phi_val = splint_dir(&g_pot.calc_pot, xi, neigh_j->slot[0],
-                                     neigh_j->shift[0], neigh_j->step[0]);
-
-              /* Add in piece contributed by neighbor to energy */
-              forces[g_calc.energy_p + h] += 0.5 * phi_val;
-
-              if (uf) {
-                /* Compute tmp force values */
-                tmp_force.x = neigh_j->dist_r.x * phi_grad;
-                tmp_force.y = neigh_j->dist_r.y * phi_grad;
-                tmp_force.z = neigh_j->dist_r.z * phi_grad;
-                /* Add in force on atom i from atom j */
-                forces[n_i + 0] += tmp_force.x;
-                forces[n_i + 1] += tmp_force.y;
-                forces[n_i + 2] += tmp_force.z;
+        for (block = 0; block < g_config.inconf[h]; block += EMBED_BLOCK) {
+          block_end = MIN(block + EMBED_BLOCK, g_config.inconf[h]);
+          for (i = block; i < block_end; i++) {
+            /* Set pointer to temp atom pointer */
+            atom = g_config.conf_atoms +
+                   (g_config.cnfstart[h] - g_mpi.firstatom + i);
+            /* Skip every 3 spots for force array */
+            n_i = 3 * (g_config.cnfstart[h] + i);
+            /* Loop over neighbors */
+            for (j = 0; j < atom->num_neigh; j++) {
+              /* Set pointer to temp neighbor pointer */
+              neigh_j = atom->neigh + j;
+              /* Find the correct column in the potential table for pair
+                 potential: phi_ij
+                 For Binary Alloy: 0 = phi_AA, 1 = (phi_AB or phi_BA), 2 = phi_BB
+                 where typ = A = 0 and typ = B = 1 */
+              /* We need to check that neighbor atom exists inside pair
+               * potential's radius */
+              if (neigh_j->r < g_pot.calc_pot.end[neigh_j->col[0]]) {
+                /* Compute phi and phi' value given radial distance
+                   NOTE: slot = spline point index right below radial distance
+                   shift = % distance from 'slot' spline pt
+                   step = width of spline points (given as 'h' in books)
+                   0 means the pair potential columns */
+                /* fn value and grad are calculated in the same step */
+                if (uf)
+                  phi_val = splint_comb_dir(&g_pot.calc_pot, xi, neigh_j->slot[0],
+                                            neigh_j->shift[0], neigh_j->step[0],
+                                            &phi_grad);
+                else
+                  phi_val = splint_dir(&g_pot.calc_pot, xi, neigh_j->slot[0],
+                                       neigh_j->shift[0], neigh_j->step[0]);
+
+                /* Add in piece contributed by neighbor to energy */
+                forces[g_calc.energy_p + h] += 0.5 * phi_val;
+
+                if (uf) {
+                  /* Compute tmp force values */
+                  tmp_force.x = neigh_j->dist_r.x * phi_grad;
+                  tmp_force.y = neigh_j->dist_r.y * phi_grad;
+                  tmp_force.z = neigh_j->dist_r.z * phi_grad;
+                  /* Add in force on atom i from atom j */
+                  forces[n_i + 0] += tmp_force.x;
+                  forces[n_i + 1] += tmp_force.y;
+                  forces[n_i + 2] += tmp_force.z;
 #if defined(STRESS)
-                if (us) {
-                  /* also calculate pair stresses */
-                  forces[stresses + 0] -= 0.5 * neigh_j->dist.x * tmp_force.x;
-                  forces[stresses + 1] -= 0.5 * neigh_j->dist.y * tmp_force.y;
-                  forces[stresses + 2] -= 0.5 * neigh_j->dist.z * tmp_force.z;
-                  forces[stresses + 3] -= 0.5 * neigh_j->dist.x * tmp_force.y;
-                  forces[stresses + 4] -= 0.5 * neigh_j->dist.y * tmp_force.z;
-                  forces[stresses + 5] -= 0.5 * neigh_j->dist.z * tmp_force.x;
-                }
+                  if (us) {
+                    /* also calculate pair stresses */
+                    forces[stresses + 0] -= 0.5 * neigh_j->dist.x * tmp_force.x;
+                    forces[stresses + 1] -= 0.5 * neigh_j->dist.y * tmp_force.y;
+                    forces[stresses + 2] -= 0.5 * neigh_j->dist.z * tmp_force.z;
+                    forces[stresses + 3] -= 0.5 * neigh_j->dist.x * tmp_force.y;
+                    forces[stresses + 4] -= 0.5 * neigh_j->dist.y * tmp_force.z;
+                    forces[stresses + 5] -= 0.5 * neigh_j->dist.z * tmp_force.x;
+                  }
 #endif  // STRESS
+                }
               }
-            }
 
-            /* r < cutoff */
-            /* END IF STMNT: NEIGH LIES INSIDE CUTOFF FOR PAIR POTENTIAL */
-            /* Find the correct column in the potential table for atomic
-               density, rho_ij
-               paircol = number of pair potential columns
-               Binary Alloy: paircol = 3 (3 pair potentials with index 0, 1, 2)
-               index of densitiy functions: 3 = rho_A, 4 = rho_B
-               where A, B are atom type for the neighbor */
-            /* Compute rho rho value and sum them up
-               Need to play tricks so that rho values are put in the correct
-               columns if alloy. If atom j is A or B, fn value needs to be
-               in correct rho_A or rho_B respectively, it doesn't depend on atom
-               i. */
-            /* Check that atom j lies inside rho_typ2 */
-            if (neigh_j->r < g_pot.calc_pot.end[neigh_j->col[1]]) {
-              /* Store gradient in the neighbor for the pair r_ij
-                 to be used in the future when computing forces
-                 and sum up rho for atom i */
-              atom->rho += splint_comb_dir(&g_pot.calc_pot, xi,
-                                           neigh_j->slot[1], neigh_j->shift[1],
-                                           neigh_j->step[1], &neigh_j->drho);
-            } else {
-              /* If the pair distance does not lie inside rho_typ2
-                 We set the grad to 0 so it doesn't sum into the net force */
-              neigh_j->drho = 0.0;
-            } /* r < cutoff */
-
-            /* Compute the f_ij values and store the fn and grad in each
-             * neighbor struct for easy access later */
-
-            /* Find the correct column in the potential table for "f": f_ij
-               For Binary Alloy: 0 = f_AA, 1 = f_AB, f_BA, 2 = f_BB
-               where typ = A = 0 and typ = B = 1
-               Note: it is "paircol+2*ntypes" spots away in the array */
-
-            /* Check that atom j lies inside f_col2 */
-            if (neigh_j->r < g_pot.calc_pot.end[neigh_j->col[2]]) {
-              /* Store the f(r_ij) value and the gradient for future use */
-              neigh_j->f = splint_comb_dir(&g_pot.calc_pot, xi,
-                                           neigh_j->slot[2], neigh_j->shift[2],
-                                           neigh_j->step[2], &neigh_j->df);
-            } else {
-              /* Store f and f' = 0 if doesn't lie in boundary to be used later
-               * when calculating forces */
-              neigh_j->f = 0.0;
-              neigh_j->df = 0.0;
-            }
+              /* r < cutoff */
+              /* END IF STMNT: NEIGH LIES INSIDE CUTOFF FOR PAIR POTENTIAL */
+              /* Find the correct column in the potential table for atomic
+                 density, rho_ij
+                 paircol = number of pair potential columns
+                 Binary Alloy: paircol = 3 (3 pair potentials with index 0, 1, 2)
+                 index of densitiy functions: 3 = rho_A, 4 = rho_B
+                 where A, B are atom type for the neighbor */
+              /* Compute rho rho value and sum them up
+                 Need to play tricks so that rho values are put in the correct
+                 columns if alloy. If atom j is A or B, fn value needs to be
+                 in correct rho_A or rho_B respectively, it doesn't depend on atom
+                 i. */
+              /* Check that atom j lies inside rho_typ2 */
+              if (neigh_j->r < g_pot.calc_pot.end[neigh_j->col[1]]) {
+                /* Store gradient in the neighbor for the pair r_ij
+                   to be used in the future when computing forces
+                   and sum up rho for atom i */
+                atom->rho += splint_comb_dir(&g_pot.calc_pot, xi,
+                                             neigh_j->slot[1], neigh_j->shift[1],
+                                             neigh_j->step[1], &neigh_j->drho);
+              } else {
+                /* If the pair distance does not lie inside rho_typ2
+                   We set the grad to 0 so it doesn't sum into the net force */
+                neigh_j->drho = 0.0;
+              } /* r < cutoff */
+
+              /* Compute the f_ij values and store the fn and grad in each
+               * neighbor struct for easy access later */
+
+              /* Find the correct column in the potential table for "f": f_ij
+                 For Binary Alloy: 0 = f_AA, 1 = f_AB, f_BA, 2 = f_BB
+                 where typ = A = 0 and typ = B = 1
+                 Note: it is "paircol+2*ntypes" spots away in the array */
+
+              /* Check that atom j lies inside f_col2 */
+              if (neigh_j->r < g_pot.calc_pot.end[neigh_j->col[2]]) {
+                /* Store the f(r_ij) value and the gradient for future use */
+                neigh_j->f = splint_comb_dir(&g_pot.calc_pot, xi,
+                                             neigh_j->slot[2], neigh_j->shift[2],
+                                             neigh_j->step[2], &neigh_j->df);
+              } else {
+                /* Store f and f' = 0 if doesn't lie in boundary to be used later
+                 * when calculating forces */
+                neigh_j->f = 0.0;
+                neigh_j->df = 0.0;
+              }
 
-            /* END LOOP OVER NEIGHBORS */
-          }
+              /* END LOOP OVER NEIGHBORS */
+            }
 
-          /* Find the correct column in the potential table for angle part:
-             g_ijk
-             Binary Alloy: 0 = g_A, 1 = g_B
-             where A, B are atom type for the main atom i
-             Note: it is now "2*paircol+2*ntypes" from beginning column
-             to account for
-             phi(paircol)+rho(nytpes)+F(g_param.ntypes)+f(paircol)
-             col2 = 2 * paircol + 2 * g_param.ntypes + typ1; */
+            /* Find the correct column in the potential table for angle part:
+               g_ijk
+               Binary Alloy: 0 = g_A, 1 = g_B
+               where A, B are atom type for the main atom i
+               Note: it is now "2*paircol+2*ntypes" from beginning column
+               to account for
+               phi(paircol)+rho(nytpes)+F(g_param.ntypes)+f(paircol)
+               col2 = 2 * paircol + 2 * g_param.ntypes + typ1; */
 
-          /* Loop over every angle formed by neighbors
-             N(N-1)/2 possible combinations
-             Used in computing angular part g_ijk */
+            /* Loop over every angle formed by neighbors
+               N(N-1)/2 possible combinations
+               Used in computing angular part g_ijk */
 
-          /* set angl pointer to angl_part of current atom */
-          angle = atom->angle_part;
+            /* set angl pointer to angl_part of current atom */
+            angle = atom->angle_part;
 
-          for (j = 0; j < atom->num_neigh - 1; j++) {
-            /* Get pointer to neighbor jj */
-            neigh_j = atom->neigh + j;
+            for (j = 0; j < atom->num_neigh - 1; j++) {
+              /* Get pointer to neighbor jj */
+              neigh_j = atom->neigh + j;
 
-            for (k = j + 1; k < atom->num_neigh; k++) {
-              /* Get pointer to neighbor kk */
-              neigh_k = atom->neigh + k;
+              for (k = j + 1; k < atom->num_neigh; k++) {
+                /* Get pointer to neighbor kk */
+                neigh_k = atom->neigh + k;
 
-              /* The cos(theta) should always lie inside -1 ... 1
-                 So store the g and g' without checking bounds */
-              angle->g = splint_comb_dir(&g_pot.calc_pot, xi, angle->slot,
-                                         angle->shift, angle->step, &angle->dg);
+                /* The cos(theta) should always lie inside -1 ... 1
+                   So store the g and g' without checking bounds */
+                angle->g = splint_comb_dir(&g_pot.calc_pot, xi, angle->slot,
+                                           angle->shift, angle->step, &angle->dg);
 
-              /* Sum up rho piece for atom i caused by j and k
-                 f_ij * f_ik * m_ijk */
-              atom->rho += neigh_j->f * neigh_k->f * angle->g;
+                /* Sum up rho piece for atom i caused by j and k
+                   f_ij * f_ik * m_ijk */
+                atom->rho += neigh_j->f * neigh_k->f * angle->g;
 
-              /* Increase angl pointer */
-              angle++;
+                /* Increase angl pointer */
+                angle++;
+              }
             }
-          }
-
-          /* Column for embedding function, F */
-          col_F = g_calc.paircol + g_param.ntypes + atom->type;
-
-#if defined(RESCALE)
-          /* Compute energy, gradient for embedding function F
-             Check if rho lies short of inner cutoff of F(rho) */
-          if (atom->rho < g_pot.calc_pot.begin[col_F]) {
-            /* Punish this potential for having rho lie outside of F */
-            forces[g_calc.limit_p + h] +=
-                DUMMY_WEIGHT * 10.0 *
-                dsquare(g_pot.calc_pot.begin[col_F] - atom->rho);
-
-            /* Set the atomic density to the first rho in the spline F */
-            atom->rho = g_pot.calc_pot.begin[col_F];
-          } else if (atom->rho >
-                     g_pot.calc_pot
-                         .end[col_F]) { /* rho is to the right of the spline */
-
-            /* Punish this potential for having rho lie outside of F */
-            forces[g_calc.limit_p + h] +=
-                DUMMY_WEIGHT * 10.0 *
-                dsquare(atom->rho - g_pot.calc_pot.end[col_F]);
-
-            /* Set the atomic density to the last rho in the spline F */
-            atom->rho = g_pot.calc_pot.end[col_F];
-          }
-          /* Compute energy piece from F, and store the gradient for later use
-           */
-          forces[g_calc.energy_p + h] += (*g_splint_comb)(
-              &g_pot.calc_pot, xi, col_F, atom->rho, &atom->gradF);
-
-#else
-          /* Compute energy, gradient for embedding function F
-             Check if rho lies short of inner cutoff of F(rho) */
-          if (atom->rho < g_pot.calc_pot.begin[col_F]) {
-#if defined(APOT)
-            /* calculate analytic value explicitly */
-            g_pot.apot_table.fvalue[col_F](
-                atom->rho, xi_opt + g_pot.opt_pot.first[col_F], &temp_eng);
-            atom->gradF =
-                apot_gradient(atom->rho, xi_opt + g_pot.opt_pot.first[col_F],
-                              g_pot.apot_table.fvalue[col_F]);
-            forces[g_calc.energy_p + h] += temp_eng;
-#else
-            /* Linear extrapolate values to left to get F_i(rho)
-               This gets value and grad of initial spline point */
-            rho_val =
-                (*g_splint_comb)(&g_pot.calc_pot, xi, col_F,
-                                 g_pot.calc_pot.begin[col_F], &atom->gradF);
-
-            /* Sum this to the total energy for this configuration
-               Linear extrapolate this energy */
-            forces[g_calc.energy_p + h] +=
-                rho_val +
-                (atom->rho - g_pot.calc_pot.begin[col_F]) * atom->gradF;
-#endif  // APOT
-            /* rho is to the right of the spline */
-          } else if (atom->rho > g_pot.calc_pot.end[col_F]) {
-#if defined(APOT)
-            /* calculate analytic value explicitly */
-            g_pot.apot_table.fvalue[col_F](
-                atom->rho, xi_opt + g_pot.opt_pot.first[col_F], &temp_eng);
-            atom->gradF =
-                apot_gradient(atom->rho, xi_opt + g_pot.opt_pot.first[col_F],
-                              g_pot.apot_table.fvalue[col_F]);
-            forces[g_calc.energy_p + h] += temp_eng;
-#else
-            /* Get value and grad at 1/2 the width from the final spline point
-             */
-            rho_val = (*g_splint_comb)(
-                &g_pot.calc_pot, xi, col_F,
-                g_pot.calc_pot.end[col_F] - 0.5 * g_pot.calc_pot.step[col_F],
-                &atom->gradF);
-            /* Linear extrapolate to the right to get energy */
-            forces[g_calc.energy_p + h] +=
-                rho_val + (atom->rho - g_pot.calc_pot.end[col_F]) * atom->gradF;
-#endif  // APOT
-            /* and in-between */
-          } else {
-#if defined(APOT)
-            /* calculate small values directly */
-            if (atom->rho < 0.1) {
-              g_pot.apot_table.fvalue[col_F](
-                  atom->rho, xi_opt + g_pot.opt_pot.first[col_F], &temp_eng);
-              atom->gradF =
-                  apot_gradient(atom->rho, xi_opt + g_pot.opt_pot.first[col_F],
-                                g_pot.apot_table.fvalue[col_F]);
-              forces[g_calc.energy_p + h] += temp_eng;
-            } else
-#endif
-              /* Get energy value from within spline and store the grad */
-              forces[g_calc.energy_p + h] += (*g_splint_comb)(
-                  &g_pot.calc_pot, xi, col_F, atom->rho, &atom->gradF);
-          }
-#endif  // RESCALE
+          } /* END OF SECOND LOOP OVER ATOM i */
 
-          /* Sum up rho for future MPI use */
-          rho_sum += atom->rho;
+          /* Embedding energy F(rho) and gradient of the atoms in this block,
+             densities outside of F are punished (RESCALE), calculated
+             analytically (APOT) or extrapolated linearly */
+          atom = g_config.conf_atoms + g_config.cnfstart[h] - g_mpi.firstatom;
+          forces[g_calc.energy_p + h] +=
+              embedding_energies(xi_opt, atom + block, block_end - block, 0,
+                                 forces + g_calc.limit_p + h, &rho_sum);
 
           /* Calculate remaining forces from embedding function */
-
           if (uf) {
-            /* Loop over neighbors */
-            for (j = 0; j < atom->num_neigh; ++j) {
-              /* Set pointer to temp neighbor pointer and record type */
-              neigh_j = atom->neigh + j;
-
-              /* Check that radial distance between pair is within
-                 cutoff distance of either possible rho_A or rho_B
-                 for alloys, where A or B stands for atom i
-                 WARNING: Double check this!!! May not need this
-                 since drho will be 0 otherwise */
-              if (neigh_j->r < g_pot.calc_pot.end[neigh_j->col[1]]) {
-                /* Calculate eam force */
-                eam_force = neigh_j->drho * atom->gradF;
-
-                /* Multiply the eamforce with x/r to get real force */
-                tmp_force.x = neigh_j->dist_r.x * eam_force;
-                tmp_force.y = neigh_j->dist_r.y * eam_force;
-                tmp_force.z = neigh_j->dist_r.z * eam_force;
-
-                /* Sum up forces acting on atom i from atom j */
-                forces[n_i + 0] += tmp_force.x;
-                forces[n_i + 1] += tmp_force.y;
-                forces[n_i + 2] += tmp_force.z;
-
-                /* Subtract off forces acting on atom j from atom i */
-                n_j = 3 * neigh_j->nr;
-                forces[n_j + 0] -= tmp_force.x;
-                forces[n_j + 1] -= tmp_force.y;
-                forces[n_j + 2] -= tmp_force.z;
+            for (i = block; i < block_end; i++) {
+              atom = g_config.conf_atoms +
+                     (g_config.cnfstart[h] - g_mpi.firstatom + i);
+              n_i = 3 * (g_config.cnfstart[h] + i);
+
+              /* Loop over neighbors */
+              for (j = 0; j < atom->num_neigh; ++j) {
+                /* Set pointer to temp neighbor pointer and record type */
+                neigh_j = atom->neigh + j;
+
+                /* Check that radial distance between pair is within
+                   cutoff distance of either possible rho_A or rho_B
+                   for alloys, where A or B stands for atom i
+                   WARNING: Double check this!!! May not need this
+                   since drho will be 0 otherwise */
+                if (neigh_j->r < g_pot.calc_pot.end[neigh_j->col[1]]) {
+                  /* Calculate eam force */
+                  eam_force = neigh_j->drho * atom->gradF;
+
+                  /* Multiply the eamforce with x/r to get real force */
+                  tmp_force.x = neigh_j->dist_r.x * eam_force;
+                  tmp_force.y = neigh_j->dist_r.y * eam_force;
+                  tmp_force.z = neigh_j->dist_r.z * eam_force;
+
+                  /* Sum up forces acting on atom i from atom j */
+                  forces[n_i + 0] += tmp_force.x;
+                  forces[n_i + 1] += tmp_force.y;
+                  forces[n_i + 2] += tmp_force.z;
+
+                  /* Subtract off forces acting on atom j from atom i */
+                  n_j = 3 * neigh_j->nr;
+                  forces[n_j + 0] -= tmp_force.x;
+                  forces[n_j + 1] -= tmp_force.y;
+                  forces[n_j + 2] -= tmp_force.z;
 
 #if defined(STRESS)
-                if (us) {
-                  forces[stresses + 0] -= neigh_j->dist.x * tmp_force.x;
-                  forces[stresses + 1] -= neigh_j->dist.y * tmp_force.y;
-                  forces[stresses + 2] -= neigh_j->dist.z * tmp_force.z;
-                  forces[stresses + 3] -= neigh_j->dist.x * tmp_force.y;
-                  forces[stresses + 4] -= neigh_j->dist.y * tmp_force.z;
-                  forces[stresses + 5] -= neigh_j->dist.z * tmp_force.x;
-                }
+                  if (us) {
+                    forces[stresses + 0] -= neigh_j->dist.x * tmp_force.x;
+                    forces[stresses + 1] -= neigh_j->dist.y * tmp_force.y;
+                    forces[stresses + 2] -= neigh_j->dist.z * tmp_force.z;
+                    forces[stresses + 3] -= neigh_j->dist.x * tmp_force.y;
+                    forces[stresses + 4] -= neigh_j->dist.y * tmp_force.z;
+                    forces[stresses + 5] -= neigh_j->dist.z * tmp_force.x;
+                  }
 #endif          // STRESS
-              } /* END IF STMT: Inside reach of rho cutoff */
-            }   /* END LOOP OVER NEIGHBORS */
+                } /* END IF STMT: Inside reach of rho cutoff */
+              }   /* END LOOP OVER NEIGHBORS */
 
-            /* Compute MEAM Forces */
-            /********************************/
+              /* Compute MEAM Forces */
+              /********************************/
 
-            /* Loop over every angle formed by neighbors
-               N(N-1)/2 possible combinations
-               Used in computing angular part g_ijk */
+              /* Loop over every angle formed by neighbors
+                 N(N-1)/2 possible combinations
+                 Used in computing angular part g_ijk */
 
-            /* set angle pointer to angl_part of current atom */
-            angle = atom->angle_part;
+              /* set angle pointer to angl_part of current atom */
+              angle = atom->angle_part;
 
-            for (j = 0; j < atom->num_neigh - 1; j++) {
-              /* Get pointer to neighbor j */
-              neigh_j = atom->neigh + j;
-              /* Force location for atom j */
-              n_j = 3 * neigh_j->nr;
+              for (j = 0; j < atom->num_neigh - 1; j++) {
+                /* Get pointer to neighbor j */
+                neigh_j = atom->neigh + j;
+                /* Force location for atom j */
+                n_j = 3 * neigh_j->nr;
 
-              for (k = j + 1; k < atom->num_neigh; k++) {
-                /* Get pointer to neighbor k */
-                neigh_k = atom->neigh + k;
+                for (k = j + 1; k < atom->num_neigh; k++) {
+                  /* Get pointer to neighbor k */
+                  neigh_k = atom->neigh + k;
 
-                /* Force location for atom k */
-                n_k = 3 * neigh_k->nr;
+                  /* Force location for atom k */
+                  n_k = 3 * neigh_k->nr;
 
-                /* Some tmp variables to clean up force fn below */
-                dV3j = angle->g * neigh_j->df * neigh_k->f;
-                dV3k = angle->g * neigh_j->f * neigh_k->df;
-                V3 = neigh_j->f * neigh_k->f * angle->dg;
+                  /* Some tmp variables to clean up force fn below */
+                  dV3j = angle->g * neigh_j->df * neigh_k->f;
+                  dV3k = angle->g * neigh_j->f * neigh_k->df;
+                  V3 = neigh_j->f * neigh_k->f * angle->dg;
 
-                vlj = V3 * neigh_j->inv_r;
-                vlk = V3 * neigh_k->inv_r;
-                vv3j = dV3j - vlj * angle->cos;
-                vv3k = dV3k - vlk * angle->cos;
+                  vlj = V3 * neigh_j->inv_r;
+                  vlk = V3 * neigh_k->inv_r;
+                  vv3j = dV3j - vlj * angle->cos;
+                  vv3k = dV3k - vlk * angle->cos;
 
-                dfj.x = vv3j * neigh_j->dist_r.x + vlj * neigh_k->dist_r.x;
-                dfj.y = vv3j * neigh_j->dist_r.y + vlj * neigh_k->dist_r.y;
-                dfj.z = vv3j * neigh_j->dist_r.z + vlj * neigh_k->dist_r.z;
+                  dfj.x = vv3j * neigh_j->dist_r.x + vlj * neigh_k->dist_r.x;
+                  dfj.y = vv3j * neigh_j->dist_r.y + vlj * neigh_k->dist_r.y;
+                  dfj.z = vv3j * neigh_j->dist_r.z + vlj * neigh_k->dist_r.z;
 
-                dfk.x = vv3k * neigh_k->dist_r.x + vlk * neigh_j->dist_r.x;
-                dfk.y = vv3k * neigh_k->dist_r.y + vlk * neigh_j->dist_r.y;
-                dfk.z = vv3k * neigh_k->dist_r.z + vlk * neigh_j->dist_r.z;
+                  dfk.x = vv3k * neigh_k->dist_r.x + vlk * neigh_j->dist_r.x;
+                  dfk.y = vv3k * neigh_k->dist_r.y + vlk * neigh_j->dist_r.y;
+                  dfk.z = vv3k * neigh_k->dist_r.z + vlk * neigh_j->dist_r.z;
 
-                /* Force on atom i from j and k */
-                forces[n_i + 0] += atom->gradF * (dfj.x + dfk.x);
-                forces[n_i + 1] += atom->gradF * (dfj.y + dfk.y);
-                forces[n_i + 2] += atom->gradF * (dfj.z + dfk.z);
+                  /* Force on atom i from j and k */
+                  forces[n_i + 0] += atom->gradF * (dfj.x + dfk.x);
+                  forces[n_i + 1] += atom->gradF * (dfj.y + dfk.y);
+                  forces[n_i + 2] += atom->gradF * (dfj.z + dfk.z);
 
-                /* Reaction force on atom j from i and k */
-                forces[n_j + 0] -= atom->gradF * dfj.x;
-                forces[n_j + 1] -= atom->gradF * dfj.y;
-                forces[n_j + 2] -= atom->gradF * dfj.z;
+                  /* Reaction force on atom j from i and k */
+                  forces[n_j + 0] -= atom->gradF * dfj.x;
+                  forces[n_j + 1] -= atom->gradF * dfj.y;
+                  forces[n_j + 2] -= atom->gradF * dfj.z;
 
-                /* Reaction force on atom k from i and j */
-                forces[n_k + 0] -= atom->gradF * dfk.x;
-                forces[n_k + 1] -= atom->gradF * dfk.y;
-                forces[n_k + 2] -= atom->gradF * dfk.z;
+                  /* Reaction force on atom k from i and j */
+                  forces[n_k + 0] -= atom->gradF * dfk.x;
+                  forces[n_k + 1] -= atom->gradF * dfk.y;
+                  forces[n_k + 2] -= atom->gradF * dfk.z;
 
 #if defined(STRESS)
-                if (us) {
-                  /* Force from j on atom i */
-                  tmp_force.x = atom->gradF * dfj.x;
-                  tmp_force.y = atom->gradF * dfj.y;
-                  tmp_force.z = atom->gradF * dfj.z;
-                  forces[stresses + 0] -= neigh_j->dist.x * tmp_force.x;
-                  forces[stresses + 1] -= neigh_j->dist.y * tmp_force.y;
-                  forces[stresses + 2] -= neigh_j->dist.z * tmp_force.z;
-                  forces[stresses + 3] -= neigh_j->dist.x * tmp_force.y;
-                  forces[stresses + 4] -= neigh_j->dist.y * tmp_force.z;
-                  forces[stresses + 5] -= neigh_j->dist.z * tmp_force.x;
-
-                  /* Force from k on atom i */
-                  tmp_force.x = atom->gradF * dfk.x;
-                  tmp_force.y = atom->gradF * dfk.y;
-                  tmp_force.z = atom->gradF * dfk.z;
-                  forces[stresses + 0] -= neigh_k->dist.x * tmp_force.x;
-                  forces[stresses + 1] -= neigh_k->dist.y * tmp_force.y;
-                  forces[stresses + 2] -= neigh_k->dist.z * tmp_force.z;
-                  forces[stresses + 3] -= neigh_k->dist.x * tmp_force.y;
-                  forces[stresses + 4] -= neigh_k->dist.y * tmp_force.z;
-                  forces[stresses + 5] -= neigh_k->dist.z * tmp_force.x;
-                }
+                  if (us) {
+                    /* Force from j on atom i */
+                    tmp_force.x = atom->gradF * dfj.x;
+                    tmp_force.y = atom->gradF * dfj.y;
+                    tmp_force.z = atom->gradF * dfj.z;
+                    forces[stresses + 0] -= neigh_j->dist.x * tmp_force.x;
+                    forces[stresses + 1] -= neigh_j->dist.y * tmp_force.y;
+                    forces[stresses + 2] -= neigh_j->dist.z * tmp_force.z;
+                    forces[stresses + 3] -= neigh_j->dist.x * tmp_force.y;
+                    forces[stresses + 4] -= neigh_j->dist.y * tmp_force.z;
+                    forces[stresses + 5] -= neigh_j->dist.z * tmp_force.x;
+
+                    /* Force from k on atom i */
+                    tmp_force.x = atom->gradF * dfk.x;
+                    tmp_force.y = atom->gradF * dfk.y;
+                    tmp_force.z = atom->gradF * dfk.z;
+                    forces[stresses + 0] -= neigh_k->dist.x * tmp_force.x;
+                    forces[stresses + 1] -= neigh_k->dist.y * tmp_force.y;
+                    forces[stresses + 2] -= neigh_k->dist.z * tmp_force.z;
+                    forces[stresses + 3] -= neigh_k->dist.x * tmp_force.y;
+                    forces[stresses + 4] -= neigh_k->dist.y * tmp_force.z;
+                    forces[stresses + 5] -= neigh_k->dist.z * tmp_force.x;
+                  }
 #endif  // STRESS
-                /* Increase n_angl pointer */
-                angle++;
-              } /* End inner loop over angles (neighbor atom k) */
-            }   /* End outer loop over angles (neighbor atom j) */
-          }     /* uf */
-        }       /* END OF SECOND LOOP OVER ATOM i */
+                  /* Increase n_angl pointer */
+                  angle++;
+                } /* End inner loop over angles (neighbor atom k) */
+              }   /* End outer loop over angles (neighbor atom j) */
+            } /* i */
+          }   /* uf */
+        } /* block */
+        TIMER_STOP(TIMER_THREEBODY);
 
         /* 3RD LOOP OVER ATOM i */
         /* Sum up the square of the forces for each atom
@@ -709,6 +622,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         forces[g_calc.limit_p + h] *= g_config.conf_weight[h];
         error_sum += dsquare(forces[g_calc.limit_p + h]);
 #endif  // RESCALE
+
+        TIMER_CONF_STOP(h);
       } /* END MAIN LOOP OVER CONFIGURATIONS */
     }
 
@@ -724,7 +639,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
     /* Reduce the rho_sum into root node */
     double rho_sum_temp = 0.0;
     MPI_Reduce(&rho_sum, &rho_sum_temp, 1, MPI_DOUBLE, MPI_SUM, 0,
-               MPI_COMM_WORLD);
+               g_mpi.comm);
     if (g_mpi.myid == 0)
       rho_sum = rho_sum_temp;
 #endif  // MPI
@@ -746,6 +661,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     gather_forces(&error_sum, forces);
 
+    TIMER_STOP(TIMER_CALC);
+
     /* Root process only */
     if (g_mpi.myid == 0) {
       /* Increment function calls */
@@ -39,10 +39,17 @@
 #endif
 #include "force.h"
 #include "functions.h"
+#include "memory.h"
 #include "potential_input.h"
 #include "splines.h"
+#include "timer.h"
 #include "utils.h"
 
+#if defined(FORCE_BATCH_SWEEP)
+void calc_forces_block(double* const* xi_opt, double* const* forces,
+                       double* error_sums, int count);
+#endif  // FORCE_BATCH_SWEEP
+
 /****************************************************************
   init_force
     called after all parameters and potentials are read
@@ -129,6 +136,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
   // This is the start of an infinite loop
 
   while (1) {
+    TIMER_START(TIMER_CALC);
+
     // sum of squares of local process
     double error_sum = 0.0;
 
@@ -140,19 +149,26 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // APOT && !MPI
 
 #if defined(MPI)
-#if !defined(APOT)
+    TIMER_START(TIMER_COMM);
+#if defined(APOT)
+    MPI_Bcast(&flag, 1, MPI_INT, 0, g_mpi.comm);
+#else
     // exchange potential and flag value
-    MPI_Bcast(xi, g_pot.calc_pot.len, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-#endif  // !APOT
-    MPI_Bcast(&flag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    broadcast_potential(xi, &flag);
+#endif  // APOT
+    TIMER_STOP(TIMER_COMM);
 
     if (flag == 1)
       break; // Exception: flag 1 means clean up
 
 #if defined(APOT)
-    if (g_mpi.myid == 0)
+    // the root process checks the vectors of the other groups before
+    // calc_forces_batch() sends them
+    if (g_mpi.myid == 0 && g_mpi.group == 0)
       apot_check_params(xi_opt);
-    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
     update_calc_table(xi_opt, xi, 0);
 #else   // APOT
     // if flag == 2 then the potential parameters have changed -> sync
@@ -169,7 +185,14 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     // loop over configurations
     for (int config_idx = g_mpi.firstconf; config_idx < g_mpi.firstconf + g_mpi.myconf; config_idx++) {
+      TIMER_CONF_START();
+
       int uf = g_config.conf_uf[config_idx - g_mpi.firstconf];
+      // atoms calculated by this process, the one with the first atom
+      // adds the terms of the whole configuration
+      int first = 0;
+      int last = 0;
+      calc_range(config_idx, &first, &last);
 #if defined(STRESS)
       int us = g_config.conf_us[config_idx - g_mpi.firstconf];
 #endif  // STRESS
@@ -181,7 +204,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // STRESS
 
 #if defined(APOT)
-      if (g_param.enable_cp)
+      if (g_param.enable_cp && first == 0)
         forces[g_calc.energy_p + config_idx] += chemical_potential(
             g_param.ntypes, g_config.na_type[config_idx], xi_opt + g_pot.cp_start);
 #endif  // APOT
@@ -189,7 +212,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
       // first loop: reset forces
       for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
         int n_i = 3 * (g_config.cnfstart[config_idx] + atom_idx);
-        if (uf) {
+        if (uf && atom_idx >= first && atom_idx < last) {
           forces[n_i + 0] = -g_config.force_0[n_i + 0];
           forces[n_i + 1] = -g_config.force_0[n_i + 1];
           forces[n_i + 2] = -g_config.force_0[n_i + 2];
@@ -198,12 +221,13 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         }
       }
 
+      TIMER_START(TIMER_PAIR);
       // second loop: calculate pair forces and energies
-      for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+      for (int atom_idx = first; atom_idx < last; atom_idx++) {
         atom_t* atom = g_config.conf_atoms + atom_idx + g_config.cnfstart[config_idx] - g_mpi.firstatom;
         int n_i = 3 * (g_config.cnfstart[config_idx] + atom_idx);
-        // loop over all neighbors
-        for (int neigh_idx = 0; neigh_idx < atom->num_neigh; neigh_idx++) {
+        // loop over the neighbors up to the last one in range
+        for (int neigh_idx = 0; neigh_idx < atom->neigh_end[0]; neigh_idx++) {
           neigh_t* neigh = atom->neigh + neigh_idx;
           // In small cells, an atom might interact with itself
           int self = (neigh->nr == atom_idx + g_config.cnfstart[config_idx]) ? 1 : 0;
@@ -214,9 +238,9 @@ double calc_forces(double* xi_opt, double* forces, int flag)
             double phi_grad = 0.0;
             // potential value and gradient are calculated in the same step
             if (uf)
-              phi_val = splint_comb_dir(&g_pot.calc_pot, xi, neigh->slot[0], neigh->shift[0], neigh->step[0], &phi_grad);
+              phi_val = splint_comb_coeff(&g_pot.calc_pot, neigh->slot[0], neigh->shift[0], neigh->step[0], &phi_grad);
             else
-              phi_val = splint_dir(&g_pot.calc_pot, xi, neigh->slot[0], neigh->shift[0], neigh->step[0]);
+              phi_val = splint_coeff(&g_pot.calc_pot, neigh->slot[0], neigh->shift[0]);
 
             // avoid double counting if atom is interacting with itself
             if (self) {
@@ -254,10 +278,22 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 #endif  // STRESS
             }
           } // neighbors in range
-        }   // loop over all neighbors
-
-        // calculate contribution of forces right away
-        if (uf) {
+        }   // loop over neighbors
+      } // second loop over atoms
+      TIMER_STOP(TIMER_PAIR);
+
+      // sum up the parts of a split configuration
+      reduce_config(forces, config_idx, uf);
+
+      // third loop: contribution of forces
+      if (uf) {
+        // the forces of all atoms are weighted, the owner of a split
+        // configuration sends all of them to the root process
+        for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+#if defined(FWEIGHT) || defined(CONTRIB)
+          atom_t* atom = g_config.conf_atoms + atom_idx + g_config.cnfstart[config_idx] - g_mpi.firstatom;
+#endif  // FWEIGHT || CONTRIB
+          int n_i = 3 * (g_config.cnfstart[config_idx] + atom_idx);
 #if defined(FWEIGHT)
           // weigh by absolute value of force
           forces[n_i + 0] /= FORCE_EPS + atom->absforce;
@@ -265,22 +301,27 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           forces[n_i + 2] /= FORCE_EPS + atom->absforce;
 #endif  // FWEIGHT
 
+          // every process sums up the atoms it has calculated
+          if (atom_idx < first || atom_idx >= last)
+            continue;
+
           // sum up forces
 #if defined(CONTRIB)
           if (atom->contrib)
 #endif  // CONTRIB
             error_sum += g_config.conf_weight[config_idx] * (dsquare(forces[n_i + 0]) + dsquare(forces[n_i + 1]) + dsquare(forces[n_i + 2]));
         }
-      } // second loop over atoms
+      } // use forces
 
       // energy contributions
       forces[g_calc.energy_p + config_idx] /= (double)g_config.inconf[config_idx];
       forces[g_calc.energy_p + config_idx] -= g_config.force_0[g_calc.energy_p + config_idx];
-      error_sum += g_config.conf_weight[config_idx] * g_param.eweight * dsquare(forces[g_calc.energy_p + config_idx]);
+      if (first == 0)
+        error_sum += g_config.conf_weight[config_idx] * g_param.eweight * dsquare(forces[g_calc.energy_p + config_idx]);
 
 #if defined(STRESS)
       // stress contributions
-      if (uf && us) {
+      if (uf && us && first == 0) {
         for (int i = 0; i < 6; i++) {
           forces[stress_idx + i] /= g_config.conf_vol[config_idx - g_mpi.firstconf];
           forces[stress_idx + i] -= g_config.force_0[stress_idx + i];
@@ -289,17 +330,21 @@ double calc_forces(double* xi_opt, double* forces, int flag)
       }
 #endif  // STRESS
 
+      TIMER_CONF_STOP(config_idx);
     } // loop over configurations
 
     // dummy constraints (global)
 #if defined(APOT)
-    // add punishment for out of bounds (mostly for powell_lsq)
-    if (g_mpi.myid == 0)
+    // add punishment for out of bounds (mostly for powell_lsq), the root
+    // process adds it to the results of the other groups
+    if (g_mpi.myid == 0 && g_mpi.group == 0)
       error_sum += apot_punish(xi_opt, forces);
 #endif  // APOT
 
     gather_forces(&error_sum, forces);
 
+    TIMER_STOP(TIMER_CALC);
+
     // root process exits this function now
     if (g_mpi.myid == 0) {
       // Increase function call counter
@@ -317,3 +362,188 @@ double calc_forces(double* xi_opt, double* forces, int flag)
   // once a non-root process arrives here, all is done
   return -1.0;
 }
+
+#if defined(FORCE_BATCH_SWEEP)
+
+/****************************************************************
+  calc_forces_batch
+    same as count calls of calc_forces, but every neighbor is
+    loaded only once and evaluated with the splines of up to
+    FORCE_BATCH parameter vectors
+****************************************************************/
+
+void calc_forces_batch(double* const* xi_opt, double* const* forces,
+                       double* error_sums, int count)
+{
+  for (int i = 0; i < count; i += FORCE_BATCH) {
+    int num = MIN(FORCE_BATCH, count - i);
+    calc_forces_block(xi_opt + i, forces + i, error_sums + i, num);
+  }
+}
+
+/****************************************************************
+  calc_forces_block
+    the splines of each vector go to their own coefficient tables
+****************************************************************/
+
+void calc_forces_block(double* const* xi_opt, double* const* forces,
+                       double* error_sums, int count)
+{
+  double* xi[FORCE_BATCH];
+  double* coeff[FORCE_BATCH];
+
+  TIMER_START(TIMER_CALC);
+
+  init_batch(xi_opt, count, xi, coeff);
+
+  for (int k = 0; k < count; k++) {
+    select_batch(k);
+    update_splines(xi[k], 0, g_calc.paircol, 1);
+    error_sums[k] = 0.0;
+  }
+
+  select_batch(-1);
+
+  g_mpi.myconf = g_config.nconf;
+
+  for (int config_idx = 0; config_idx < g_config.nconf; config_idx++) {
+    TIMER_CONF_START();
+
+    int uf = g_config.conf_uf[config_idx];
+#if defined(STRESS)
+    int us = g_config.conf_us[config_idx];
+    int stress_idx = g_calc.stress_p + 6 * config_idx;
+#endif  // STRESS
+
+    for (int k = 0; k < count; k++) {
+      forces[k][g_calc.energy_p + config_idx] = 0.0;
+#if defined(STRESS)
+      memset(forces[k] + stress_idx, 0, 6 * sizeof(double));
+#endif  // STRESS
+#if defined(APOT)
+      if (g_param.enable_cp)
+        forces[k][g_calc.energy_p + config_idx] += chemical_potential(
+            g_param.ntypes, g_config.na_type[config_idx], xi_opt[k] + g_pot.cp_start);
+#endif  // APOT
+
+      for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+        int n_i = 3 * (g_config.cnfstart[config_idx] + atom_idx);
+        if (uf) {
+          forces[k][n_i + 0] = -g_config.force_0[n_i + 0];
+          forces[k][n_i + 1] = -g_config.force_0[n_i + 1];
+          forces[k][n_i + 2] = -g_config.force_0[n_i + 2];
+        } else {
+          memset(forces[k] + n_i, 0, 3 * sizeof(double));
+        }
+      }
+    }
+
+    TIMER_START(TIMER_PAIR);
+    for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
+      atom_t* atom = g_config.conf_atoms + atom_idx + g_config.cnfstart[config_idx];
+      int n_i = 3 * (g_config.cnfstart[config_idx] + atom_idx);
+      for (int neigh_idx = 0; neigh_idx < atom->neigh_end[0]; neigh_idx++) {
+        neigh_t* neigh = atom->neigh + neigh_idx;
+
+        if (neigh->r >= g_pot.calc_pot.end[neigh->col[0]])
+          continue;
+
+        // In small cells, an atom might interact with itself
+        int self = (neigh->nr == atom_idx + g_config.cnfstart[config_idx]) ? 1 : 0;
+        int n_j = 3 * neigh->nr;
+
+        // the neighbor data is loaded once for all parameter vectors
+        for (int k = 0; k < count; k++) {
+          double* f = forces[k];
+          const double* c = coeff[k] + 4 * neigh->slot[0];
+          double b = neigh->shift[0];
+          double phi_val = c[0] + b * (c[1] + b * (c[2] + b * c[3]));
+          double phi_grad = 0.0;
+
+          if (uf)
+            phi_grad = (c[1] + b * (2.0 * c[2] + 3.0 * b * c[3])) / neigh->step[0];
+
+          if (self) {
+            phi_val *= 0.5;
+            phi_grad *= 0.5;
+          }
+
+          f[g_calc.energy_p + config_idx] += phi_val;
+
+          if (uf) {
+            vector tmp_force;
+            tmp_force.x = neigh->dist_r.x * phi_grad;
+            tmp_force.y = neigh->dist_r.y * phi_grad;
+            tmp_force.z = neigh->dist_r.z * phi_grad;
+            f[n_i + 0] += tmp_force.x;
+            f[n_i + 1] += tmp_force.y;
+            f[n_i + 2] += tmp_force.z;
+            // actio = reactio
+            f[n_j + 0] -= tmp_force.x;
+            f[n_j + 1] -= tmp_force.y;
+            f[n_j + 2] -= tmp_force.z;
+#if defined(STRESS)
+            if (us) {
+              f[stress_idx + 0] -= neigh->dist.x * tmp_force.x;
+              f[stress_idx + 1] -= neigh->dist.y * tmp_force.y;
+              f[stress_idx + 2] -= neigh->dist.z * tmp_force.z;
+              f[stress_idx + 3] -= neigh->dist.x * tmp_force.y;
+              f[stress_idx + 4] -= neigh->dist.y * tmp_force.z;
+              f[stress_idx + 5] -= neigh->dist.z * tmp_force.x;
+            }
+#endif  // STRESS
+          }
+        }
+      }
+
+      // the reaction forces only go to atoms after this one
+      if (uf) {
+        for (int k = 0; k < count; k++) {
+          double* f = forces[k];
+#if defined(FWEIGHT)
+          f[n_i + 0] /= FORCE_EPS + atom->absforce;
+          f[n_i + 1] /= FORCE_EPS + atom->absforce;
+          f[n_i + 2] /= FORCE_EPS + atom->absforce;
+#endif  // FWEIGHT
+#if defined(CONTRIB)
+          if (atom->contrib)
+#endif  // CONTRIB
+            error_sums[k] += g_config.conf_weight[config_idx] * (dsquare(f[n_i + 0]) + dsquare(f[n_i + 1]) + dsquare(f[n_i + 2]));
+        }
+      }
+    }
+    TIMER_STOP(TIMER_PAIR);
+
+    for (int k = 0; k < count; k++) {
+      double* f = forces[k];
+      f[g_calc.energy_p + config_idx] /= (double)g_config.inconf[config_idx];
+      f[g_calc.energy_p + config_idx] -= g_config.force_0[g_calc.energy_p + config_idx];
+      error_sums[k] += g_config.conf_weight[config_idx] * g_param.eweight * dsquare(f[g_calc.energy_p + config_idx]);
+#if defined(STRESS)
+      if (uf && us) {
+        for (int i = 0; i < 6; i++) {
+          f[stress_idx + i] /= g_config.conf_vol[config_idx];
+          f[stress_idx + i] -= g_config.force_0[stress_idx + i];
+          error_sums[k] += g_config.conf_weight[config_idx] * g_param.sweight * dsquare(f[stress_idx + i]);
+        }
+      }
+#endif  // STRESS
+    }
+
+    TIMER_CONF_STOP(config_idx);
+  }
+
+  for (int k = 0; k < count; k++) {
+#if defined(APOT)
+    error_sums[k] += apot_punish(xi_opt[k], forces[k]);
+#endif  // APOT
+    if (isnan(error_sums[k]))
+      error_sums[k] = 10e10;
+  }
+
+  g_calc.fcalls += count;
+
+  TIMER_STOP(TIMER_CALC);
+}
+
+#endif  // FORCE_BATCH_SWEEP
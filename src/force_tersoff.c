@@ -39,6 +39,7 @@
 #include "potential_input.h"
 #include "potential_output.h"
 #include "splines.h"
+#include "timer.h"
 #include "utils.h"
 
 /****************************************************************
@@ -113,18 +114,24 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
   // This is the start of an infinite loop
   while (1) {
+    TIMER_START(TIMER_CALC);
+
     // sum of squares of local process
     double error_sum = 0.0;
 
 #if defined(MPI)
-    MPI_Bcast(&flag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(&flag, 1, MPI_INT, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
 
     if (flag == 1)
       break; // Exception: flag 1 means clean up
 
     if (g_mpi.myid == 0)
       apot_check_params(xi_opt);
-    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
 #else
     apot_check_params(xi_opt);
 #endif  // MPI
@@ -133,6 +140,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     // loop over configurations
     for (int config_idx = g_mpi.firstconf; config_idx < g_mpi.firstconf + g_mpi.myconf; config_idx++) {
+      TIMER_CONF_START();
+
       int uf = g_config.conf_uf[config_idx - g_mpi.firstconf];
 
       // reset energies and stresses
@@ -156,6 +165,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         }
       }
 
+      TIMER_START(TIMER_THREEBODY);
       // second loop: calculate cutoff function f_c for all neighbor
       for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
         atom_t* atom = g_config.conf_atoms + atom_idx + g_config.cnfstart[config_idx] - g_mpi.firstatom;
@@ -364,6 +374,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           } // neigh_j_idx
         }
       } // end second loop over all atoms
+      TIMER_STOP(TIMER_THREEBODY);
 
       // third loop over all atoms, sum up forces
       if (uf) {
@@ -402,6 +413,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         }
       }
 #endif  // STRESS
+
+      TIMER_CONF_STOP(config_idx);
     } // loop over configurations
 
     // add punishment for out of bounds (mostly for powell_lsq)
@@ -410,6 +423,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     gather_forces(&error_sum, forces);
 
+    TIMER_STOP(TIMER_CALC);
+
     // root process exits this function now
     if (g_mpi.myid == 0) {
       // Increase function call counter
@@ -445,18 +460,24 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
   // This is the start of an infinite loop
   while (1) {
+    TIMER_START(TIMER_CALC);
+
     // sum of squares of local process
     double error_sum = 0.0;
 
 #if defined(MPI)
-    MPI_Bcast(&flag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(&flag, 1, MPI_INT, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
 
     if (flag == 1)
       break; // Exception: flag 1 means clean up
 
     if (g_mpi.myid == 0)
       apot_check_params(xi_opt);
-    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TIMER_START(TIMER_COMM);
+    MPI_Bcast(xi_opt, g_calc.ndimtot, MPI_DOUBLE, 0, g_mpi.comm);
+    TIMER_STOP(TIMER_COMM);
 #else
     apot_check_params(xi_opt);
 #endif  // MPI
@@ -465,6 +486,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     // loop over configurations
     for (int config_idx = g_mpi.firstconf; config_idx < g_mpi.firstconf + g_mpi.myconf; config_idx++) {
+      TIMER_CONF_START();
+
       int uf = g_config.conf_uf[config_idx - g_mpi.firstconf];
 
       // reset energies and stresses
@@ -488,6 +511,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         }
       }
 
+      TIMER_START(TIMER_THREEBODY);
       // second loop: calculate cutoff function f_c for all neighbors
       for (int atom_idx = 0; atom_idx < g_config.inconf[config_idx]; atom_idx++) {
         atom_t* atom = g_config.conf_atoms + atom_idx + g_config.cnfstart[config_idx] - g_mpi.firstatom;
@@ -719,6 +743,7 @@ double calc_forces(double* xi_opt, double* forces, int flag)
           }     // neigh_f_idx
         }
       } // end second loop over all atoms
+      TIMER_STOP(TIMER_THREEBODY);
 
       // third loop over all atoms, sum up forces
       if (uf) {
@@ -758,6 +783,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
         }
       }
 #endif  // STRESS
+
+      TIMER_CONF_STOP(config_idx);
     } // loop over configurations
 
     // add punishment for out of bounds (mostly for powell_lsq)
@@ -766,6 +793,8 @@ double calc_forces(double* xi_opt, double* forces, int flag)
 
     gather_forces(&error_sum, forces);
 
+    TIMER_STOP(TIMER_CALC);
+
     // root process exits this function now
     if (g_mpi.myid == 0) {
       // Increase function call counter
@@ -42,7 +42,7 @@
     stores all available analytic potentials
 ****************************************************************/
 
-struct {
+POTFIT_TLS struct {
   char** name;             // identifier of the potential
   int* num_params;         // number of parameters
   fvalue_pointer* fvalue;  // function pointer
@@ -57,6 +57,13 @@ struct {
 
 void initialize_analytic_potentials(void)
 {
+  // the potential file is read again for every job in server mode
+  if (function_table.num_functions > 0) {
+    for (int i = 0; i < NUM_PUNISH_FUNCTIONS; ++i)
+      function_table.punish_index[i][0] = 0;
+    return;
+  }
+
 #define FUNCTION(name, npar) add_potential(#name, npar, &name##_value)
 
 #include "functions.itm"
@@ -137,6 +144,34 @@ int apot_assign_function_pointers(apot_table_t* apt)
   return 0;
 }
 
+/****************************************************************
+  apot_function_index
+    index of a function pointer in the function_table, -1 if unknown
+****************************************************************/
+
+int apot_function_index(fvalue_pointer function)
+{
+  for (int i = 0; i < function_table.num_functions; i++) {
+    if (function_table.fvalue[i] == function)
+      return i;
+  }
+
+  return -1;
+}
+
+/****************************************************************
+  apot_function_pointer
+    function pointer of an index of the function_table
+****************************************************************/
+
+fvalue_pointer apot_function_pointer(int index)
+{
+  if (index < 0 || index >= function_table.num_functions)
+    error(1, "Unknown analytic function index %d\n", index);
+
+  return function_table.fvalue[index];
+}
+
 /****************************************************************
   apot_assign_punish_functions
     assign function punishment indices
@@ -426,6 +461,29 @@ void elstat_value(double r, double dp_kappa, double* ftail, double* gtail,
   *ggtail = (2 * x[1] * x[2] * x[3] - *gtail * 3) / x[0]; /* 1/r dg/dr */
 }
 
+/****************************************************************
+  elstat_cut
+    tail of electrostatic potential at the cutoff radius
+    the values are cached, they only change with kappa
+****************************************************************/
+
+static void elstat_cut(double dp_kappa, double* ftail_cut, double* gtail_cut,
+                       double* ggtail_cut)
+{
+  static POTFIT_TLS double kappa = NAN, dp_cut = NAN;
+  static POTFIT_TLS double fcut, gcut, ggcut;
+
+  if (dp_kappa != kappa || g_config.dp_cut != dp_cut) {
+    elstat_value(g_config.dp_cut, dp_kappa, &fcut, &gcut, &ggcut);
+    kappa = dp_kappa;
+    dp_cut = g_config.dp_cut;
+  }
+
+  *ftail_cut = fcut;
+  *gtail_cut = gcut;
+  *ggtail_cut = ggcut;
+}
+
 /****************************************************************
   elstat_shift
     shifted tail of coulomb potential
@@ -442,7 +500,7 @@ void elstat_shift(double r, double dp_kappa, double* fnval_tail,
   x[2] = x[0] - x[1];
 
   elstat_value(r, dp_kappa, &ftail, &gtail, &ggtail);
-  elstat_value(g_config.dp_cut, dp_kappa, &ftail_cut, &gtail_cut, &ggtail_cut);
+  elstat_cut(dp_kappa, &ftail_cut, &gtail_cut, &ggtail_cut);
 
   *fnval_tail = ftail - ftail_cut - x[2] * gtail_cut / 2;
   *grad_tail = gtail - gtail_cut;
@@ -465,15 +523,16 @@ void elstat_shift(double r, double dp_kappa, double* fnval_tail,
 void elstat_dsf(double r, double dp_kappa, double* fnval_tail,
                 double* grad_tail, double* ggrad_tail)
 {
-  static double ftail, gtail, ggtail, ftail_cut, gtail_cut, ggtail_cut;
-  static double x[3];
+  static POTFIT_TLS double ftail, gtail, ggtail;
+  static POTFIT_TLS double ftail_cut, gtail_cut, ggtail_cut;
+  static POTFIT_TLS double x[3];
 
   x[0] = r * r;
   x[1] = g_config.dp_cut * g_config.dp_cut;
   x[2] = x[0] - x[1];
 
   elstat_value(r, dp_kappa, &ftail, &gtail, &ggtail);
-  elstat_value(g_config.dp_cut, dp_kappa, &ftail_cut, &gtail_cut, &ggtail_cut);
+  elstat_cut(dp_kappa, &ftail_cut, &gtail_cut, &ggtail_cut);
 
   *fnval_tail =
       ftail - ftail_cut - (r - g_config.dp_cut) * gtail_cut * g_config.dp_cut;
@@ -511,6 +570,50 @@ void init_tails(double dp_kappa)
   }
 }
 
+/****************************************************************
+  reset_tails
+    forget the kappa of all tails, called by init_force() after the
+    configurations or the potential were read or distributed
+****************************************************************/
+
+void reset_tails(void)
+{
+  if (g_config.tail_kappa == NULL)
+    g_config.tail_kappa = (double*)Malloc(g_config.nconf * sizeof(double));
+
+  for (int i = 0; i < g_config.nconf; i++)
+    g_config.tail_kappa[i] = NAN;
+}
+
+/****************************************************************
+  update_tails
+    recalculate the tails of all neighbors of configuration h,
+    skipped if kappa did not change since the last call for h
+****************************************************************/
+
+void update_tails(int h, double dp_kappa)
+{
+  if (g_config.tail_kappa[h] == dp_kappa)
+    return;
+
+  for (int i = 0; i < g_config.inconf[h]; i++) {
+    atom_t* atom =
+        g_config.conf_atoms + i + g_config.cnfstart[h] - g_mpi.firstatom;
+    for (int j = 0; j < atom->num_neigh; j++) {
+      neigh_t* neigh = atom->neigh + j;
+#if defined(DSF)
+      elstat_dsf(neigh->r, dp_kappa, &neigh->fnval_el, &neigh->grad_el,
+                 &neigh->ggrad_el);
+#else
+      elstat_shift(neigh->r, dp_kappa, &neigh->fnval_el, &neigh->grad_el,
+                   &neigh->ggrad_el);
+#endif  // DSF
+    }
+  }
+
+  g_config.tail_kappa[h] = dp_kappa;
+}
+
 #endif  // COULOMB
 
 #if defined(DIPOLE)
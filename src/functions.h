@@ -48,6 +48,8 @@ void initialize_analytic_potentials(void);
 void add_potential(const char* name, int npar, fvalue_pointer function);
 int apot_get_num_parameters(const char* potential_name);
 int apot_assign_function_pointers(apot_table_t* apot_table);
+int apot_function_index(fvalue_pointer function);
+fvalue_pointer apot_function_pointer(int index);
 void apot_assign_punish_functions(char const* name, int index);
 void check_correct_apot_functions(void);
 
@@ -69,6 +71,8 @@ void elstat_shift(double, double, double*, double*, double*);
 void elstat_dsf(double, double, double*, double*, double*);
 #endif
 void init_tails(double);
+void reset_tails(void);
+void update_tails(int, double);
 #endif  // COULOMB
 #if defined(DIPOLE)
 double shortrange_value(double, double, double, double);
@@ -316,7 +316,7 @@ void acosharmonic_value(const double r, const double* p, double* f)
 
 void csw_value(const double r, const double* p, double* f)
 {
-  static double power;
+  static POTFIT_TLS double power;
 
   power_1(&power, &r, &p[3]);
 
@@ -330,7 +330,7 @@ void csw_value(const double r, const double* p, double* f)
 
 void csw2_value(const double r, const double* p, double* f)
 {
-  static double power;
+  static POTFIT_TLS double power;
 
   power_1(&power, &r, &p[3]);
 
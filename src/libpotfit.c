@@ -0,0 +1,559 @@
+/****************************************************************
+ *
+ * libpotfit.c: library interface with an explicit context
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+// pthread mutexes are not part of C99
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <setjmp.h>
+
+#include "potfit.h"
+
+#include "config.h"
+#include "force.h"
+#include "libpotfit.h"
+#include "memory.h"
+#include "mpi_utils.h"
+#include "optimize.h"
+#include "params.h"
+#include "potential_input.h"
+#include "potential_output.h"
+#include "random.h"
+#include "tempfile.h"
+
+// Every context runs all of its calls in a thread of its own. The global
+// and static state of potfit (g_calc, g_config, g_pot, the memory list,
+// the spline and force buffers of the force routines and optimizers, ...)
+// is thread-local in library builds, so the state of that thread is the
+// state of the context. Calls on the same context are serialized, calls on
+// different contexts run in parallel.
+
+typedef struct lib_call lib_call;
+
+struct lib_call {
+  int (*func)(potfit_context* ctx, lib_call* call);
+  char const* filename;
+  double* params;
+  double const* new_params;
+  double* error_sum;
+  int ndim;
+};
+
+struct potfit_context {
+  pthread_t thread;           // runs all calls of this context
+  pthread_mutex_t call_lock;  // serializes the calling threads
+  pthread_mutex_t lock;       // protects call, status and quit
+  pthread_cond_t wakeup;      // new call or shutdown
+  pthread_cond_t done;        // the call has finished
+  lib_call* call;             // call for the context thread, NULL if idle
+  int status;                 // result of the last call
+  int quit;                   // stop the context thread
+
+  // only used by the context thread
+  int loaded;     // potfit_load() was successful
+  int failed;     // error() was called, only potfit_destroy() is allowed
+  double* table;  // work copy of opt_pot.table for potfit_evaluate()
+  jmp_buf jump;   // return point of error() for the active call
+};
+
+// the input files are parsed with strtok(), which is not reentrant
+static pthread_mutex_t g_lib_input_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// context of the calling thread, NULL outside of the context threads
+static POTFIT_TLS potfit_context* g_lib_active = NULL;
+
+void* run_context(void* arg);
+int run_call(potfit_context* ctx, lib_call* call, int need_loaded);
+
+int lib_load(potfit_context* ctx, lib_call* call);
+int lib_load_potential(potfit_context* ctx, lib_call* call);
+int lib_num_parameters(potfit_context* ctx, lib_call* call);
+int lib_get_parameters(potfit_context* ctx, lib_call* call);
+int lib_set_parameters(potfit_context* ctx, lib_call* call);
+int lib_evaluate(potfit_context* ctx, lib_call* call);
+int lib_optimize(potfit_context* ctx, lib_call* call);
+int lib_write_potential(potfit_context* ctx, lib_call* call);
+
+/****************************************************************
+  potfit_create
+****************************************************************/
+
+potfit_context* potfit_create(void)
+{
+  potfit_context* ctx = (potfit_context*)calloc(1, sizeof(potfit_context));
+
+  if (ctx == NULL)
+    return NULL;
+
+  pthread_mutex_init(&ctx->call_lock, NULL);
+  pthread_mutex_init(&ctx->lock, NULL);
+  pthread_cond_init(&ctx->wakeup, NULL);
+  pthread_cond_init(&ctx->done, NULL);
+
+  if (pthread_create(&ctx->thread, NULL, run_context, ctx) != 0) {
+    warning("Could not start the thread of the potfit context.\n");
+    pthread_cond_destroy(&ctx->done);
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_mutex_destroy(&ctx->lock);
+    pthread_mutex_destroy(&ctx->call_lock);
+    free(ctx);
+    return NULL;
+  }
+
+  return ctx;
+}
+
+/****************************************************************
+  potfit_load
+****************************************************************/
+
+int potfit_load(potfit_context* ctx, char const* param_file)
+{
+  lib_call call = {.func = lib_load, .filename = param_file};
+
+  return run_call(ctx, &call, 0);
+}
+
+/****************************************************************
+  potfit_load_potential
+****************************************************************/
+
+int potfit_load_potential(potfit_context* ctx, char const* potential_file)
+{
+  lib_call call = {.func = lib_load_potential, .filename = potential_file};
+
+  return run_call(ctx, &call, 1);
+}
+
+/****************************************************************
+  potfit_num_parameters
+****************************************************************/
+
+int potfit_num_parameters(potfit_context* ctx)
+{
+  lib_call call = {.func = lib_num_parameters};
+
+  if (run_call(ctx, &call, 1) != LIBPOTFIT_SUCCESS)
+    return -1;
+
+  return call.ndim;
+}
+
+/****************************************************************
+  potfit_get_parameters
+****************************************************************/
+
+int potfit_get_parameters(potfit_context* ctx, double* params)
+{
+  lib_call call = {.func = lib_get_parameters, .params = params};
+
+  return run_call(ctx, &call, 1);
+}
+
+/****************************************************************
+  potfit_set_parameters
+****************************************************************/
+
+int potfit_set_parameters(potfit_context* ctx, double const* params)
+{
+  lib_call call = {.func = lib_set_parameters, .new_params = params};
+
+  return run_call(ctx, &call, 1);
+}
+
+/****************************************************************
+  potfit_evaluate
+****************************************************************/
+
+int potfit_evaluate(potfit_context* ctx, double const* params,
+                    double* error_sum)
+{
+  lib_call call = {
+      .func = lib_evaluate, .new_params = params, .error_sum = error_sum};
+
+  return run_call(ctx, &call, 1);
+}
+
+/****************************************************************
+  potfit_optimize
+****************************************************************/
+
+int potfit_optimize(potfit_context* ctx, double* error_sum)
+{
+  lib_call call = {.func = lib_optimize, .error_sum = error_sum};
+
+  return run_call(ctx, &call, 1);
+}
+
+/****************************************************************
+  potfit_write_potential
+****************************************************************/
+
+int potfit_write_potential(potfit_context* ctx, char const* filename)
+{
+  lib_call call = {.func = lib_write_potential, .filename = filename};
+
+  return run_call(ctx, &call, 1);
+}
+
+/****************************************************************
+  potfit_destroy
+****************************************************************/
+
+void potfit_destroy(potfit_context* ctx)
+{
+  if (ctx == NULL)
+    return;
+
+  // wait for the running call of another thread
+  pthread_mutex_lock(&ctx->call_lock);
+
+  pthread_mutex_lock(&ctx->lock);
+  ctx->quit = 1;
+  pthread_cond_signal(&ctx->wakeup);
+  pthread_mutex_unlock(&ctx->lock);
+
+  pthread_join(ctx->thread, NULL);
+
+  pthread_mutex_unlock(&ctx->call_lock);
+
+  pthread_cond_destroy(&ctx->done);
+  pthread_cond_destroy(&ctx->wakeup);
+  pthread_mutex_destroy(&ctx->lock);
+  pthread_mutex_destroy(&ctx->call_lock);
+  free(ctx);
+}
+
+/****************************************************************
+  library_error
+    called by error(), jumps back to the active library call
+****************************************************************/
+
+void library_error(void)
+{
+  if (g_lib_active == NULL)
+    return;
+
+  g_lib_active->failed = 1;
+  longjmp(g_lib_active->jump, 1);
+}
+
+/****************************************************************
+  run_context
+    main loop of the context thread
+****************************************************************/
+
+void* run_context(void* arg)
+{
+  potfit_context* ctx = (potfit_context*)arg;
+
+  // the thread-local globals of this thread belong to the context
+  initialize_global_variables();
+  g_lib_active = ctx;
+
+  pthread_mutex_lock(&ctx->lock);
+
+  while (1) {
+    while (ctx->call == NULL && !ctx->quit)
+      pthread_cond_wait(&ctx->wakeup, &ctx->lock);
+
+    if (ctx->call == NULL)
+      break;
+
+    lib_call* call = ctx->call;
+    pthread_mutex_unlock(&ctx->lock);
+
+    int status = call->func(ctx, call);
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->status = status;
+    ctx->call = NULL;
+    pthread_cond_signal(&ctx->done);
+  }
+
+  pthread_mutex_unlock(&ctx->lock);
+
+  shutdown_tempfile();
+  free_allocated_memory();
+
+  return NULL;
+}
+
+/****************************************************************
+  run_call
+    pass the call to the context thread and wait for the result
+****************************************************************/
+
+int run_call(potfit_context* ctx, lib_call* call, int need_loaded)
+{
+  if (ctx == NULL) {
+    warning("Invalid potfit context.\n");
+    return LIBPOTFIT_ERROR;
+  }
+
+  pthread_mutex_lock(&ctx->call_lock);
+
+  // loaded and failed only change while the caller waits below
+  if (ctx->failed) {
+    pthread_mutex_unlock(&ctx->call_lock);
+    warning("Invalid potfit context.\n");
+    return LIBPOTFIT_ERROR;
+  }
+
+  if (need_loaded && !ctx->loaded) {
+    pthread_mutex_unlock(&ctx->call_lock);
+    warning("The potfit context has not been loaded yet.\n");
+    return LIBPOTFIT_ERROR;
+  }
+
+  pthread_mutex_lock(&ctx->lock);
+
+  ctx->call = call;
+  pthread_cond_signal(&ctx->wakeup);
+
+  while (ctx->call != NULL)
+    pthread_cond_wait(&ctx->done, &ctx->lock);
+
+  int status = ctx->status;
+
+  pthread_mutex_unlock(&ctx->lock);
+  pthread_mutex_unlock(&ctx->call_lock);
+
+  return status;
+}
+
+/****************************************************************
+  lib_load
+    same initialization as the root process of the potfit binary
+****************************************************************/
+
+int lib_load(potfit_context* ctx, lib_call* call)
+{
+  if (ctx->loaded) {
+    warning("The potfit context has already been loaded.\n");
+    return LIBPOTFIT_ERROR;
+  }
+
+  pthread_mutex_lock(&g_lib_input_lock);
+
+  if (setjmp(ctx->jump) != 0) {
+    pthread_mutex_unlock(&g_lib_input_lock);
+    return LIBPOTFIT_ERROR;
+  }
+
+  printf("Reading parameter file >> %s << ... \n", call->filename);
+  read_parameter_file(call->filename);
+  check_parameters_complete(call->filename);
+  printf("Reading parameter file >> %s << ... done\n", call->filename);
+
+  read_pot_table(g_files.startpot);
+  read_config(g_files.config);
+
+  pthread_mutex_unlock(&g_lib_input_lock);
+
+  if (setjmp(ctx->jump) != 0)
+    return LIBPOTFIT_ERROR;
+
+  init_force_common(0);
+  init_force(0);
+
+  g_mpi.init_done = 1;
+
+  init_rng(g_param.rng_seed);
+
+  // without MPI this only sets up the per-process configuration pointers
+  broadcast_params_mpi();
+
+  g_calc.ndim = g_pot.opt_pot.idxlen;
+  g_calc.ndimtot = g_pot.opt_pot.len;
+
+  g_calc.force = (double*)Malloc(g_calc.mdim * sizeof(double));
+
+  set_force_vector_pointers();
+
+#if defined(APOT)
+  update_calc_table(g_pot.opt_pot.table, g_pot.calc_pot.table, 1);
+#endif  // APOT
+
+  ctx->table = (double*)Malloc(g_calc.ndimtot * sizeof(double));
+  ctx->loaded = 1;
+
+  return LIBPOTFIT_SUCCESS;
+}
+
+/****************************************************************
+  lib_load_potential
+****************************************************************/
+
+int lib_load_potential(potfit_context* ctx, lib_call* call)
+{
+  pthread_mutex_lock(&g_lib_input_lock);
+
+  if (setjmp(ctx->jump) != 0) {
+    pthread_mutex_unlock(&g_lib_input_lock);
+    return LIBPOTFIT_ERROR;
+  }
+
+  // the old potential is kept if the new one is not compatible
+  int status = reload_pot_table(call->filename);
+
+  pthread_mutex_unlock(&g_lib_input_lock);
+
+  if (status != POTFIT_SUCCESS)
+    return LIBPOTFIT_ERROR;
+
+  if (setjmp(ctx->jump) != 0)
+    return LIBPOTFIT_ERROR;
+
+#if defined(APOT)
+  update_calc_table(g_pot.opt_pot.table, g_pot.calc_pot.table, 1);
+#endif  // APOT
+
+  init_force_common(0);
+  init_force(0);
+
+  return LIBPOTFIT_SUCCESS;
+}
+
+/****************************************************************
+  lib_num_parameters
+****************************************************************/
+
+int lib_num_parameters(potfit_context* ctx, lib_call* call)
+{
+  (void)ctx;
+
+  call->ndim = g_calc.ndim;
+
+  return LIBPOTFIT_SUCCESS;
+}
+
+/****************************************************************
+  lib_get_parameters
+****************************************************************/
+
+int lib_get_parameters(potfit_context* ctx, lib_call* call)
+{
+  (void)ctx;
+
+  for (int i = 0; i < g_calc.ndim; i++)
+    call->params[i] = g_pot.opt_pot.table[g_pot.opt_pot.idx[i]];
+
+  return LIBPOTFIT_SUCCESS;
+}
+
+/****************************************************************
+  lib_set_parameters
+****************************************************************/
+
+int lib_set_parameters(potfit_context* ctx, lib_call* call)
+{
+  if (setjmp(ctx->jump) != 0)
+    return LIBPOTFIT_ERROR;
+
+  for (int i = 0; i < g_calc.ndim; i++)
+    g_pot.opt_pot.table[g_pot.opt_pot.idx[i]] = call->new_params[i];
+
+#if defined(APOT)
+  // the potential output is written from apot_table
+  update_apot_table(g_pot.opt_pot.table);
+  update_calc_table(g_pot.opt_pot.table, g_pot.calc_pot.table, 1);
+#endif  // APOT
+
+  return LIBPOTFIT_SUCCESS;
+}
+
+/****************************************************************
+  lib_evaluate
+    the parameters are inserted into a copy of opt_pot.table,
+    calc_forces() takes care of the derived tables
+****************************************************************/
+
+int lib_evaluate(potfit_context* ctx, lib_call* call)
+{
+  if (setjmp(ctx->jump) != 0)
+    return LIBPOTFIT_ERROR;
+
+  memcpy(ctx->table, g_pot.opt_pot.table, g_calc.ndimtot * sizeof(double));
+
+  for (int i = 0; i < g_calc.ndim; i++)
+    ctx->table[g_pot.opt_pot.idx[i]] = call->new_params[i];
+
+  double tot = calc_forces(ctx->table, g_calc.force, 0);
+
+  if (call->error_sum != NULL)
+    *call->error_sum = tot;
+
+  return LIBPOTFIT_SUCCESS;
+}
+
+/****************************************************************
+  lib_optimize
+****************************************************************/
+
+int lib_optimize(potfit_context* ctx, lib_call* call)
+{
+  if (setjmp(ctx->jump) != 0)
+    return LIBPOTFIT_ERROR;
+
+  // the optimizer settings are only checked if opt is enabled
+  if (!g_param.opt) {
+    warning("Optimization is disabled in the parameter file.\n");
+    return LIBPOTFIT_ERROR;
+  }
+
+  // every optimization starts like a separate potfit run
+  g_calc.fcalls = 0;
+  init_rng(g_param.rng_seed);
+
+  if (g_calc.ndim > 0)
+    run_optimization();
+
+  // for tabulated potentials opt_pot.table and calc_pot.table are the same
+  double tot = calc_forces(g_pot.opt_pot.table, g_calc.force, 0);
+
+  if (call->error_sum != NULL)
+    *call->error_sum = tot;
+
+  return LIBPOTFIT_SUCCESS;
+}
+
+/****************************************************************
+  lib_write_potential
+****************************************************************/
+
+int lib_write_potential(potfit_context* ctx, lib_call* call)
+{
+  if (setjmp(ctx->jump) != 0)
+    return LIBPOTFIT_ERROR;
+
+  write_pot_table_potfit(call->filename);
+
+  return LIBPOTFIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+/****************************************************************
+ *
+ * libpotfit.h: public interface of the potfit library
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef LIBPOTFIT_H_INCLUDED
+#define LIBPOTFIT_H_INCLUDED
+
+// This header is self-contained and can be used by programs linking
+// against libpotfit_<model>_<interaction>_<mathlib>_lib.so
+//
+// All functions return LIBPOTFIT_SUCCESS or LIBPOTFIT_ERROR. Errors which
+// would terminate the potfit binary are printed to stderr and leave the
+// context in a failed state, only potfit_destroy() can be called then.
+//
+// The model and interaction are fixed at compile time. Every context owns
+// its own copy of the parameters, potential and configurations together
+// with all buffers of the force calculation and the optimizers, it runs its
+// calls in a thread of its own. Calls on the same context are serialized,
+// calls on different contexts run in parallel. Reading the input files is
+// serialized over all contexts.
+
+// the library is compiled with -fvisibility=hidden, only these functions
+// are exported and potfit internals like error() cannot clash with the host
+#if defined(LIBRARY)
+#define LIBPOTFIT_API __attribute__((visibility("default")))
+#else
+#define LIBPOTFIT_API
+#endif  // LIBRARY
+
+#define LIBPOTFIT_SUCCESS 0
+#define LIBPOTFIT_ERROR 2
+
+typedef struct potfit_context potfit_context;
+
+// create a new context, returns NULL if its thread could not be started
+LIBPOTFIT_API potfit_context* potfit_create(void);
+
+// read the parameter file, the start potential and the configurations
+LIBPOTFIT_API int potfit_load(potfit_context* ctx, char const* param_file);
+
+// replace the potential, it has to use the same cutoffs and sampling points
+LIBPOTFIT_API int potfit_load_potential(potfit_context* ctx,
+                                        char const* potential_file);
+
+// number of free parameters of the potential
+LIBPOTFIT_API int potfit_num_parameters(potfit_context* ctx);
+
+// copy the free parameters of the current potential to params
+LIBPOTFIT_API int potfit_get_parameters(potfit_context* ctx, double* params);
+
+// set the free parameters of the current potential
+LIBPOTFIT_API int potfit_set_parameters(potfit_context* ctx,
+                                        double const* params);
+
+// calculate the error sum of the given free parameters against all
+// configurations, the current potential is not changed
+LIBPOTFIT_API int potfit_evaluate(potfit_context* ctx, double const* params,
+                                  double* error_sum);
+
+// optimize the current potential with the settings of the parameter file
+LIBPOTFIT_API int potfit_optimize(potfit_context* ctx, double* error_sum);
+
+// write the current potential in potfit format
+LIBPOTFIT_API int potfit_write_potential(potfit_context* ctx,
+                                         char const* filename);
+
+// wait for a running call, then stop the context thread and free all
+// memory of the context, it must not be used afterwards
+LIBPOTFIT_API void potfit_destroy(potfit_context* ctx);
+
+#endif  // LIBPOTFIT_H_INCLUDED
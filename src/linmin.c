@@ -42,7 +42,16 @@
 
 #define TOL 1.0e-1
 
-double *xicom, *delcom;
+POTFIT_TLS double *xicom, *delcom;
+
+// a step length along delcom together with its error sum and forces
+typedef struct {
+  double x;
+  double f;
+  double* forces;
+} linmin_point_t;
+
+double linmin_batch(double, double*, double*, double*, double*, int);
 
 /****************************************************************
  *
@@ -55,7 +64,7 @@ double *xicom, *delcom;
 double linmin(double xi[], double del[], double fxi1, double* x1, double* x2,
               double* fret1, double* fret2)
 {
-  static double* vecu = NULL; /* Vector of location u */
+  static POTFIT_TLS double* vecu = NULL; /* Vector of location u */
   double xx, fx, fb, bx, ax;
   double fa = fxi1;
   double xmin;
@@ -63,21 +72,26 @@ double linmin(double xi[], double del[], double fxi1, double* x1, double* x2,
 
   xicom = xi;
   delcom = del;
-  ax = 0.0; /*do not change without correcting fa, */
-  /*saves 1 fcalc... */
-  bx = 0.1;
 
-  if (vecu == NULL)
-    vecu = (double*)Malloc(g_calc.ndimtot * sizeof(double));
+  if (g_param.linmin_batch > 1) {
+    fx = linmin_batch(fxi1, &xmin, &xmin2, fret1, fret2, g_param.linmin_batch);
+  } else {
+    ax = 0.0; /*do not change without correcting fa, */
+    /*saves 1 fcalc... */
+    bx = 0.1;
+
+    if (vecu == NULL)
+      vecu = (double*)Malloc(g_calc.ndimtot * sizeof(double));
 
-  for (int j = 0; j < g_calc.ndimtot; j++)
-    vecu[j] = xicom[j] + bx * delcom[j]; /*set vecu */
+    for (int j = 0; j < g_calc.ndimtot; j++)
+      vecu[j] = xicom[j] + bx * delcom[j]; /*set vecu */
 
-  fb = calc_forces(vecu, fret2, 0);
+    fb = calc_forces(vecu, fret2, 0);
 
-  bracket(&ax, &xx, &bx, &fa, &fx, &fb, fret1, fret2);
+    bracket(&ax, &xx, &bx, &fa, &fx, &fb, fret1, fret2);
 
-  fx = brent(ax, xx, bx, fx, TOL, &xmin, &xmin2, fret1, fret2);
+    fx = brent(ax, xx, bx, fx, TOL, &xmin, &xmin2, fret1, fret2);
+  }
 
   for (int j = 0; j < g_calc.ndimtot; j++) {
     del[j] *= xmin;
@@ -90,4 +104,180 @@ double linmin(double xi[], double del[], double fxi1, double* x1, double* x2,
   return fx;
 }
 
+/****************************************************************
+ *
+ *  compare two points by their step length (for qsort)
+ *
+ ****************************************************************/
+
+int linmin_point_cmp(const void* a, const void* b)
+{
+  double xa = ((const linmin_point_t*)a)->x;
+  double xb = ((const linmin_point_t*)b)->x;
+
+  return (xa > xb) - (xa < xb);
+}
+
+/****************************************************************
+ *
+ *  linmin_batch: line search with num step lengths per round
+ *
+ *  Every round evaluates num step lengths with one call of
+ *  calc_forces_batch(). Until a minimum is bracketed the steps
+ *  continue the golden section expansion of bracket() beyond the
+ *  lowest point. Afterwards the parabolic step of the bracket and
+ *  an equidistant grid over it are evaluated, until the bracket
+ *  is as small as brent() requires. This needs more force
+ *  calculations than bracket() and brent(), but far fewer rounds.
+ *
+ *  fxi1 and fret1 belong to step length 0, the best step length
+ *  is returned in xmin and its forces in fret1, the better
+ *  neighbor of it in xmin2 and fret2.
+ *
+ ****************************************************************/
+
+double linmin_batch(double fxi1, double* xmin, double* xmin2, double* fret1,
+                    double* fret2, int num)
+{
+  static POTFIT_TLS int len = 0;
+  static POTFIT_TLS linmin_point_t* pts = NULL;
+  static POTFIT_TLS double** vecu = NULL;
+  static POTFIT_TLS double** forces = NULL;
+  static POTFIT_TLS double* error_sums = NULL;
+
+  long nb_eval = 0;
+  int iter = 0;
+  int npts = 1;
+  int idx = 0;
+  linmin_point_t temp;
+
+  // the bracket keeps 3 points, every round adds up to num
+  if (len != num) {
+    pts = (linmin_point_t*)Malloc((num + 3) * sizeof(linmin_point_t));
+    for (int i = 0; i < num + 3; i++)
+      pts[i].forces = (double*)Malloc(g_calc.mdim * sizeof(double));
+    vecu = (double**)Malloc(num * sizeof(double*));
+    for (int i = 0; i < num; i++)
+      vecu[i] = (double*)Malloc(g_calc.ndimtot * sizeof(double));
+    forces = (double**)Malloc(num * sizeof(double*));
+    error_sums = (double*)Malloc(num * sizeof(double));
+    len = num;
+  }
+
+  pts[0].x = 0.0;
+  pts[0].f = fxi1;
+  memcpy(pts[0].forces, fret1, g_calc.mdim * sizeof(double));
+
+  // the first round starts like linmin() and bracket() to the right
+  double x_prev = 0.0;
+  double x_last = 0.1;
+
+  while (1) {
+    // the new step lengths go behind the kept points
+    linmin_point_t* cand = pts + npts;
+    int ncand = 0;
+
+    if (idx == 0 || idx == npts - 1) {
+      /* no bracket yet: continue the golden section expansion
+         in the direction of the lowest point */
+      if (nb_eval >= MAX_IT)
+        error(1, "Problems with bracketing of minimum, aborting\n");
+      if (npts == 1)
+        cand[ncand++].x = x_last;
+      while (ncand < num) {
+        double x_next = x_prev + (x_last - x_prev) / CGOLD;
+        x_prev = x_last;
+        x_last = x_next;
+        cand[ncand++].x = x_next;
+      }
+    } else {
+      double x_left = pts[idx - 1].x;
+      double x_right = pts[idx + 1].x;
+      double z = pts[idx].x;
+      double tolerance = TOL * fabs(z) + ZEPS;
+      double midpoint = 0.5 * (x_left + x_right);
+
+      // termination criterion of brent()
+      if (fabs(z - midpoint) <= 2 * tolerance - 0.5 * (x_right - x_left)) {
+        linmin_point_t* w =
+            (pts[idx - 1].f < pts[idx + 1].f) ? pts + idx - 1 : pts + idx + 1;
+        *xmin = z;
+        *xmin2 = w->x;
+        for (int j = 0; j < g_calc.rdim; j++) {
+          int k = g_calc.res_idx[j];
+          fret1[k] = pts[idx].forces[k];
+          fret2[k] = w->forces[k];
+        }
+        return pts[idx].f;
+      }
+
+      if (++iter > ITMAX)
+        error(1, "Too many iterations in Brent minimization.\n");
+
+      // minimum of the parabola through the bracket
+      double r = (z - x_left) * (pts[idx].f - pts[idx + 1].f);
+      double q = (z - x_right) * (pts[idx].f - pts[idx - 1].f);
+      double p = (z - x_right) * q - (z - x_left) * r;
+      q = 2.0 * (q - r);
+      if (q != 0.0) {
+        double u = z - p / q;
+        if (u - x_left > tolerance && x_right - u > tolerance &&
+            fabs(u - z) > tolerance)
+          cand[ncand++].x = u;
+      }
+
+      // and an equidistant grid over the bracket
+      int ngrid = num - ncand;
+      for (int i = 1; i <= ngrid; i++) {
+        double u = x_left + i * (x_right - x_left) / (ngrid + 1);
+        if (fabs(u - z) > tolerance)
+          cand[ncand++].x = u;
+      }
+      if (ncand == 0)
+        cand[ncand++].x = (z < midpoint) ? z + tolerance : z - tolerance;
+    }
+
+    for (int i = 0; i < ncand; i++) {
+      for (int j = 0; j < g_calc.ndimtot; j++)
+        vecu[i][j] = xicom[j] + cand[i].x * delcom[j];
+      forces[i] = cand[i].forces;
+#if defined(APOT)
+      // calc_forces() only writes the punishments which are violated
+      for (int j = g_calc.punish_par_p; j < g_calc.mdim; j++)
+        forces[i][j] = 0.0;
+#endif  // APOT
+    }
+
+    calc_forces_batch(vecu, forces, error_sums, ncand);
+
+    for (int i = 0; i < ncand; i++)
+      cand[i].f = error_sums[i];
+    npts += ncand;
+    nb_eval += ncand;
+
+    qsort(pts, npts, sizeof(linmin_point_t), linmin_point_cmp);
+
+    idx = 0;
+    for (int i = 1; i < npts; i++)
+      if (pts[i].f < pts[idx].f)
+        idx = i;
+
+    // keep the lowest point and its neighbors, the force vectors
+    // of the other points are reused in the next round
+    int first = (idx > 0) ? idx - 1 : 0;
+    int last = (idx < npts - 1) ? idx + 1 : npts - 1;
+    for (int i = first; i <= last; i++) {
+      SWAP(pts[i - first], pts[i], temp);
+    }
+    npts = last - first + 1;
+    idx -= first;
+
+    // expand from the neighbor through the lowest point
+    if (idx == 0 || idx == npts - 1) {
+      x_prev = pts[npts - 1 - idx].x;
+      x_last = pts[idx].x;
+    }
+  }
+}
+
 #undef TOL
@@ -49,7 +49,7 @@ typedef struct {
   int num_pointers;
 } potfit_memory;
 
-static potfit_memory g_memory;
+static POTFIT_TLS potfit_memory g_memory;
 
 /****************************************************************
  *
@@ -132,22 +132,36 @@ void initialize_global_variables()
   g_mpi.init_done = 0;
   g_mpi.myid = 0;
   g_mpi.num_cpus = 1;
+  g_mpi.group = 0;
+  g_mpi.num_groups = 1;
   g_mpi.firstatom = 0;
   g_mpi.firstconf = 0;
   g_mpi.myatoms = 0;
   g_mpi.myconf = 0;
+  g_mpi.firstcalc = 0;
+  g_mpi.mycalc = 0;
 #if defined(MPI)
   g_mpi.atom_dist = NULL;
   g_mpi.atom_len = NULL;
   g_mpi.conf_dist = NULL;
   g_mpi.conf_len = NULL;
+  g_mpi.split_conf[0] = g_mpi.split_conf[1] = -1;
+  g_mpi.split_comm[0] = g_mpi.split_comm[1] = MPI_COMM_NULL;
 #endif  // MPI
 
   memset(&g_param, 0, sizeof(g_param));
   g_param.sweight = -1.0;
   g_param.global_cell_scale = 1.0;
+  g_param.checkpoint_interval = 600;
+  g_param.tempfile_interval = 10.0;
 #if defined(EVO)
   g_param.evo_threshold = 1.0e-6;
+#elif defined(CMAES)
+  g_param.cmaes_threshold = 1.0e-6;
+  g_param.cmaes_sigma = 0.3;
+#else
+  g_param.anneal_nstep = 20;
+  g_param.anneal_cooling = 0.85;
 #endif  // EVO
 
   g_pot.interaction_name = NULL;
@@ -30,8 +30,13 @@
 #include "potfit.h"
 
 #include "config.h"
+#if defined(APOT)
+#include "functions.h"
+#endif  // APOT
 #include "memory.h"
 #include "mpi_utils.h"
+#include "tempfile.h"
+#include "timer.h"
 #include "utils.h"
 
 #define CHECK_RETURN(a)                                            \
@@ -44,8 +49,25 @@
   } while (0);
 
 #if defined(MPI)
+// shared memory windows, freed in shutdown_mpi()
+#define MAX_SHARED_WINDOWS 16
+static MPI_Win g_shared_win[MAX_SHARED_WINDOWS];
+static int g_num_shared_win = 0;
+// number of configurations which are calculated by several processes
+static int g_num_split = 0;
+
+#if !defined(APOT)
+// potential table of the workers as known by the root process
+// and the (index, value) pairs of broadcast_potential()
+static double* g_sent_table = NULL;
+static double* g_delta = NULL;
+static int g_sent_len = 0;
+#endif  // !APOT
+
 int create_custom_datatypes();
+int broadcast_shared(void** data, int count, MPI_Datatype type);
 int broadcast_basic_data();
+int split_groups();
 int broadcast_calcpot_table();
 int broadcast_apot_table();
 int broadcast_configurations();
@@ -61,14 +83,20 @@ int broadcast_angles();
 int initialize_mpi(int* argc, char*** argv)
 {
 #if defined(MPI)
-  // initialize the MPI communication
-  int rval = MPI_Init(argc, argv);
+  // initialize the MPI communication, the tempfile writer thread of the
+  // root process does not use MPI
+  int provided = 0;
+  int rval = MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
 
   if (rval != MPI_SUCCESS) {
     printf("Error initializing MPI communication! (Error: %d)\n", rval);
     return POTFIT_ERROR;
   }
 
+  // without thread support everything is done by the main thread
+  if (provided < MPI_THREAD_FUNNELED)
+    disable_tempfile_thread();
+
   rval = MPI_Comm_size(MPI_COMM_WORLD, &g_mpi.num_cpus);
 
   if (rval != MPI_SUCCESS) {
@@ -82,6 +110,28 @@ int initialize_mpi(int* argc, char*** argv)
     printf("Error getting MPI communicator rank! (Error: %d)\n", rval);
     return POTFIT_ERROR;
   }
+
+  // processes on the same node share the read-only data, the root
+  // process is always the first process of its node
+  rval = MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, g_mpi.myid,
+                             MPI_INFO_NULL, &g_mpi.node_comm);
+
+  if (rval == MPI_SUCCESS)
+    rval = MPI_Comm_rank(g_mpi.node_comm, &g_mpi.node_rank);
+
+  if (rval == MPI_SUCCESS)
+    rval = MPI_Comm_split(MPI_COMM_WORLD,
+                          (g_mpi.node_rank == 0) ? 0 : MPI_UNDEFINED,
+                          g_mpi.myid, &g_mpi.leader_comm);
+
+  if (rval != MPI_SUCCESS) {
+    printf("Error creating MPI node communicators! (Error: %d)\n", rval);
+    return POTFIT_ERROR;
+  }
+
+  // all processes form one group unless mpi_groups is set
+  g_mpi.comm = MPI_COMM_WORLD;
+  g_mpi.group_comm = MPI_COMM_NULL;
 #endif  // MPI
 
   if (g_mpi.myid == 0) {
@@ -107,6 +157,9 @@ void shutdown_mpi(void)
     int abort = -1;
     MPI_Bcast(&abort, 1, MPI_INT, 0, MPI_COMM_WORLD);
   }
+  for (int i = 0; i < g_num_shared_win; i++)
+    MPI_Win_free(g_shared_win + i);
+  g_num_shared_win = 0;
   MPI_Finalize(); /* Shutdown */
 #endif            // MPI
 }
@@ -132,6 +185,7 @@ int broadcast_params_mpi()
 
   CHECK_RETURN(create_custom_datatypes());
   CHECK_RETURN(broadcast_basic_data());
+  CHECK_RETURN(split_groups());
   CHECK_RETURN(broadcast_calcpot_table());
   CHECK_RETURN(broadcast_apot_table());
   CHECK_RETURN(broadcast_configurations());
@@ -141,8 +195,18 @@ int broadcast_params_mpi()
 
   if (g_mpi.myid == 0) {
     printf("done\n");
+    if (g_num_split > 0)
+      printf("%d configurations are split across processes.\n", g_num_split);
+    if (g_mpi.num_groups > 1)
+      printf("%d groups of %d processes calculate the force batches.\n",
+             g_mpi.num_groups, g_mpi.num_cpus / g_mpi.num_groups);
     fflush(stdout);
   }
+
+  // from here on every group works like a separate set of processes,
+  // its first process is the root of the force calculations
+  g_mpi.num_cpus /= g_mpi.num_groups;
+  g_mpi.myid %= g_mpi.num_cpus;
 #else
   // Identify subset of atoms/volumes belonging to individual
   // process with complete set of atoms/volumes
@@ -157,6 +221,66 @@ int broadcast_params_mpi()
   return POTFIT_SUCCESS;
 }
 
+#if defined(MPI) && !defined(APOT)
+
+/****************************************************************
+    broadcast_potential
+      exchange the flag of calc_forces() and the potential table
+
+      only the entries which changed since the last call are sent
+      as (index, value) pairs, unless the full table is shorter
+****************************************************************/
+
+void broadcast_potential(double* xi, int* flag)
+{
+  int len = g_pot.calc_pot.len;
+  // flag and number of changed entries, -1 for the full table
+  int header[2] = {*flag, -1};
+
+  if (g_delta == NULL)
+    g_delta = (double*)Malloc(2 * len * sizeof(double));
+
+  if (g_mpi.myid == 0) {
+    if (*flag == 1) {
+      header[1] = 0;
+    } else if (g_sent_len == len) {
+      int n = 0;
+      for (int i = 0; i < len && 2 * n < len; i++) {
+        // compare the bits, NaN entries have to be sent as well
+        if (memcmp(xi + i, g_sent_table + i, sizeof(double)) != 0) {
+          g_delta[2 * n] = i;
+          g_delta[2 * n + 1] = xi[i];
+          n++;
+        }
+      }
+      if (2 * n < len)
+        header[1] = n;
+    }
+  }
+
+  MPI_Bcast(header, 2, MPI_INT, 0, g_mpi.comm);
+
+  *flag = header[0];
+
+  if (header[1] < 0) {
+    MPI_Bcast(xi, len, MPI_DOUBLE, 0, g_mpi.comm);
+    if (g_mpi.myid == 0) {
+      if (g_sent_len != len) {
+        g_sent_table = (double*)Realloc(g_sent_table, len * sizeof(double));
+        g_sent_len = len;
+      }
+      memcpy(g_sent_table, xi, len * sizeof(double));
+    }
+  } else if (header[1] > 0) {
+    MPI_Bcast(g_delta, 2 * header[1], MPI_DOUBLE, 0, g_mpi.comm);
+    double* table = g_mpi.myid == 0 ? g_sent_table : xi;
+    for (int i = 0; i < header[1]; i++)
+      table[(int)g_delta[2 * i]] = g_delta[2 * i + 1];
+  }
+}
+
+#endif  // MPI && !APOT
+
 #if !defined(APOT)
 
 /****************************************************************
@@ -168,24 +292,33 @@ void potsync()
 #if defined(MPI)
   int firstcol = g_calc.paircol + g_param.ntypes;
 
+  TIMER_START(TIMER_COMM);
+
   /* Memory is allocated - just bcast that changed potential... */
   /* bcast begin/end/step/invstep of embedding energy  */
   MPI_Bcast(g_pot.calc_pot.begin + firstcol, g_param.ntypes, MPI_DOUBLE, 0,
-            MPI_COMM_WORLD);
+            g_mpi.comm);
   MPI_Bcast(g_pot.calc_pot.end + firstcol, g_param.ntypes, MPI_DOUBLE, 0,
-            MPI_COMM_WORLD);
+            g_mpi.comm);
   MPI_Bcast(g_pot.calc_pot.step + firstcol, g_param.ntypes, MPI_DOUBLE, 0,
-            MPI_COMM_WORLD);
+            g_mpi.comm);
   MPI_Bcast(g_pot.calc_pot.invstep + firstcol, g_param.ntypes, MPI_DOUBLE, 0,
-            MPI_COMM_WORLD);
+            g_mpi.comm);
   MPI_Bcast(g_pot.calc_pot.first + firstcol, g_param.ntypes, MPI_INT, 0,
-            MPI_COMM_WORLD);
+            g_mpi.comm);
 
   /* bcast table values of transfer fn. and embedding energy */
   int firstval = g_pot.calc_pot.first[g_calc.paircol];
   int nvals = g_pot.calc_pot.len - firstval;
   MPI_Bcast(g_pot.calc_pot.table + firstval, nvals, MPI_DOUBLE, 0,
-            MPI_COMM_WORLD);
+            g_mpi.comm);
+
+  // the workers received these values outside of broadcast_potential()
+  if (g_mpi.myid == 0 && g_sent_len == g_pot.calc_pot.len)
+    memcpy(g_sent_table + firstval, g_pot.calc_pot.table + firstval,
+           nvals * sizeof(double));
+
+  TIMER_STOP(TIMER_COMM);
 #endif  // MPI
 }
 
@@ -371,6 +504,7 @@ int create_custom_datatypes()
 
   data_len[size_a] = 1;     data_type[size_a++] = MPI_INT;          // type
   data_len[size_a] = 1;     data_type[size_a++] = MPI_INT;          // num_neigh
+  data_len[size_a] = SLOTS; data_type[size_a++] = MPI_INT;          // neigh_end
   data_len[size_a] = 1;     data_type[size_a++] = g_mpi.MPI_VECTOR; // pos
   data_len[size_a] = 1;     data_type[size_a++] = g_mpi.MPI_VECTOR; // force
   data_len[size_a] = 1;     data_type[size_a++] = MPI_DOUBLE;       // absforce
@@ -407,6 +541,7 @@ int create_custom_datatypes()
 
   CHECK_RETURN(MPI_Get_address(&atom.type,       &data_size[size_b++]));
   CHECK_RETURN(MPI_Get_address(&atom.num_neigh,  &data_size[size_b++]));
+  CHECK_RETURN(MPI_Get_address(&atom.neigh_end,  &data_size[size_b++]));
   CHECK_RETURN(MPI_Get_address(&atom.pos,        &data_size[size_b++]));
   CHECK_RETURN(MPI_Get_address(&atom.force,      &data_size[size_b++]));
   CHECK_RETURN(MPI_Get_address(&atom.absforce,   &data_size[size_b++]));
@@ -472,22 +607,18 @@ int broadcast_basic_data()
   CHECK_RETURN(MPI_Bcast(&g_config.nconf, 1, MPI_INT, 0, MPI_COMM_WORLD));
   CHECK_RETURN(MPI_Bcast(&g_calc.paircol, 1, MPI_INT, 0, MPI_COMM_WORLD));
   CHECK_RETURN(MPI_Bcast(&g_param.opt, 1, MPI_INT, 0, MPI_COMM_WORLD));
+  CHECK_RETURN(
+      MPI_Bcast(&g_param.mpi_groups, 1, MPI_INT, 0, MPI_COMM_WORLD));
 
-  // allocate and broadcast config metadata
-  if (g_mpi.myid > 0) {
-    g_config.inconf = (int*)Malloc(g_config.nconf * sizeof(int));
-    g_config.cnfstart = (int*)Malloc(g_config.nconf * sizeof(int));
-    g_config.force_0 = (double*)Malloc(g_calc.mdim * sizeof(double));
-    g_config.conf_weight = (double*)Malloc(g_config.nconf * sizeof(double));
-  }
+  // config metadata, one copy per node
   CHECK_RETURN(
-      MPI_Bcast(g_config.inconf, g_config.nconf, MPI_INT, 0, MPI_COMM_WORLD));
+      broadcast_shared((void**)&g_config.inconf, g_config.nconf, MPI_INT));
   CHECK_RETURN(
-      MPI_Bcast(g_config.cnfstart, g_config.nconf, MPI_INT, 0, MPI_COMM_WORLD));
+      broadcast_shared((void**)&g_config.cnfstart, g_config.nconf, MPI_INT));
   CHECK_RETURN(
-      MPI_Bcast(g_config.force_0, g_calc.mdim, MPI_DOUBLE, 0, MPI_COMM_WORLD));
-  CHECK_RETURN(MPI_Bcast(g_config.conf_weight, g_config.nconf, MPI_DOUBLE, 0,
-                         MPI_COMM_WORLD));
+      broadcast_shared((void**)&g_config.force_0, g_calc.mdim, MPI_DOUBLE));
+  CHECK_RETURN(broadcast_shared((void**)&g_config.conf_weight, g_config.nconf,
+                                MPI_DOUBLE));
 
   // Broadcast weights...
   CHECK_RETURN(MPI_Bcast(&g_param.eweight, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD));
@@ -507,6 +638,84 @@ int broadcast_basic_data()
   return MPI_SUCCESS;
 }
 
+/****************************************************************
+    split_groups
+      splits the processes into mpi_groups groups of consecutive
+      ranks, every group calculates all configurations and
+      calc_forces_batch() sends one parameter vector to each group
+****************************************************************/
+
+int split_groups()
+{
+  if (g_param.mpi_groups < 2)
+    return MPI_SUCCESS;
+
+  g_mpi.num_groups = g_param.mpi_groups;
+
+  int size = g_mpi.num_cpus / g_mpi.num_groups;
+  g_mpi.group = g_mpi.myid / size;
+
+  CHECK_RETURN(
+      MPI_Comm_split(MPI_COMM_WORLD, g_mpi.group, g_mpi.myid, &g_mpi.comm));
+  CHECK_RETURN(MPI_Comm_split(MPI_COMM_WORLD,
+                              (g_mpi.myid % size == 0) ? 0 : MPI_UNDEFINED,
+                              g_mpi.myid, &g_mpi.group_comm));
+
+  return MPI_SUCCESS;
+}
+
+/****************************************************************
+    broadcast_shared
+      copies count items of the root process into a shared memory
+      window of every node, all other processes of a node read the
+      data from there instead of holding their own copy
+
+      the root process keeps its own array, *data of the other
+      processes is set to the window and must not be written
+****************************************************************/
+
+int broadcast_shared(void** data, int count, MPI_Datatype type)
+{
+  int type_size = 0;
+  int disp_unit = 0;
+  MPI_Aint size = 0;
+  MPI_Aint query_size = 0;
+  void* base = NULL;
+  MPI_Win win;
+
+  if (g_num_shared_win == MAX_SHARED_WINDOWS) {
+    printf("Too many shared memory windows, increase MAX_SHARED_WINDOWS\n");
+    return POTFIT_ERROR;
+  }
+
+  CHECK_RETURN(MPI_Type_size(type, &type_size));
+
+  // the memory of a window is allocated by the first process of the node
+  if (g_mpi.node_rank == 0)
+    size = (MPI_Aint)count * type_size;
+
+  CHECK_RETURN(MPI_Win_allocate_shared(size, type_size, MPI_INFO_NULL,
+                                       g_mpi.node_comm, &base, &win));
+  CHECK_RETURN(MPI_Win_shared_query(win, 0, &query_size, &disp_unit, &base));
+
+  g_shared_win[g_num_shared_win++] = win;
+
+  CHECK_RETURN(MPI_Win_fence(0, win));
+
+  if (g_mpi.node_rank == 0 && count > 0) {
+    if (g_mpi.myid == 0)
+      memcpy(base, *data, (size_t)count * type_size);
+    CHECK_RETURN(MPI_Bcast(base, count, type, 0, g_mpi.leader_comm));
+  }
+
+  CHECK_RETURN(MPI_Win_fence(0, win));
+
+  if (g_mpi.myid > 0)
+    *data = base;
+
+  return MPI_SUCCESS;
+}
+
 /****************************************************************
     broadcast_calcpot_table
 ****************************************************************/
@@ -527,7 +736,6 @@ int broadcast_calcpot_table()
     g_pot.calc_pot.first = (int*)Malloc(ncols * sizeof(int));
     g_pot.calc_pot.last = (int*)Malloc(ncols * sizeof(int));
     g_pot.calc_pot.table = (double*)Malloc(calclen * sizeof(double));
-    g_pot.calc_pot.xcoord = (double*)Malloc(calclen * sizeof(double));
     g_pot.calc_pot.d2tab = (double*)Malloc(calclen * sizeof(double));
   }
 
@@ -547,8 +755,9 @@ int broadcast_calcpot_table()
       MPI_Bcast(g_pot.calc_pot.table, calclen, MPI_DOUBLE, 0, MPI_COMM_WORLD));
   CHECK_RETURN(
       MPI_Bcast(g_pot.calc_pot.d2tab, calclen, MPI_DOUBLE, 0, MPI_COMM_WORLD));
+  // the sampling points are only changed by the root process (rescaling)
   CHECK_RETURN(
-      MPI_Bcast(g_pot.calc_pot.xcoord, calclen, MPI_DOUBLE, 0, MPI_COMM_WORLD));
+      broadcast_shared((void**)&g_pot.calc_pot.xcoord, calclen, MPI_DOUBLE));
 
   return MPI_SUCCESS;
 }
@@ -617,8 +826,20 @@ int broadcast_apot_table()
                          MPI_DOUBLE, 0, MPI_COMM_WORLD));
   CHECK_RETURN(MPI_Bcast(g_config.rmin, g_param.ntypes * g_param.ntypes,
                          MPI_DOUBLE, 0, MPI_COMM_WORLD));
-  CHECK_RETURN(MPI_Bcast(g_pot.apot_table.fvalue, g_pot.apot_table.number,
-                         MPI_DOUBLE, 0, MPI_COMM_WORLD));
+  // function pointers differ between processes (address space layout
+  // randomization), send their index in the function table instead
+  int* fidx = (int*)Malloc(g_pot.apot_table.number * sizeof(int));
+  if (g_mpi.myid == 0) {
+    for (int i = 0; i < g_pot.apot_table.number; i++)
+      fidx[i] = apot_function_index(g_pot.apot_table.fvalue[i]);
+  }
+  CHECK_RETURN(
+      MPI_Bcast(fidx, g_pot.apot_table.number, MPI_INT, 0, MPI_COMM_WORLD));
+  if (g_mpi.myid > 0) {
+    initialize_analytic_potentials();
+    for (int i = 0; i < g_pot.apot_table.number; i++)
+      g_pot.apot_table.fvalue[i] = apot_function_pointer(fidx[i]);
+  }
   CHECK_RETURN(MPI_Bcast(g_pot.apot_table.end, g_pot.apot_table.number,
                          MPI_DOUBLE, 0, MPI_COMM_WORLD));
   CHECK_RETURN(MPI_Bcast(g_pot.apot_table.begin, g_pot.apot_table.number,
@@ -666,63 +887,184 @@ int broadcast_apot_table()
   return MPI_SUCCESS;
 }
 
+/****************************************************************
+    config_of_atom
+      index of the configuration which contains atom i
+****************************************************************/
+
+static int config_of_atom(int i)
+{
+  int low = 0;
+  int high = g_config.nconf - 1;
+
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (g_config.cnfstart[mid] <= i)
+      low = mid;
+    else
+      high = mid - 1;
+  }
+
+  return low;
+}
+
+/****************************************************************
+    split_atom_dist
+      first atom calculated by every process of a group of size
+      processes if configurations with at least split_atoms atoms
+      may be split
+
+      the atoms are distributed evenly, a cut inside of a smaller
+      configuration is moved to its nearest end
+****************************************************************/
+
+static void split_atom_dist(int* calc_dist, int size)
+{
+  calc_dist[0] = 0;
+
+  for (int i = 1; i < size; i++) {
+    int cut = (int)((long)i * g_config.natoms / size);
+    int h = config_of_atom(cut);
+    int begin = g_config.cnfstart[h];
+    int end = begin + g_config.inconf[h];
+
+    if (cut > begin && g_config.inconf[h] < g_param.split_atoms)
+      cut = (cut - begin < end - cut) ? begin : end;
+
+    calc_dist[i] = MAX(cut, calc_dist[i - 1]);
+  }
+}
+
+/****************************************************************
+    split_configurations
+      creates a communicator for every configuration which is
+      calculated by several processes
+
+      a process shares at most its first and its last configuration,
+      these are neighbors in the list of split configurations and
+      are assigned to split_comm[0] and split_comm[1] by their
+      position in that list
+****************************************************************/
+
+static int split_configurations(const int* calc_dist, int size)
+{
+  int num_split = 0;
+  int last_split = -1;
+  int color[2] = {MPI_UNDEFINED, MPI_UNDEFINED};
+
+  for (int i = 1; i < size; i++) {
+    if (calc_dist[i] == 0 || calc_dist[i] >= g_config.natoms)
+      continue;
+    int h = config_of_atom(calc_dist[i]);
+    if (calc_dist[i] == g_config.cnfstart[h] || h == last_split)
+      continue;
+    last_split = h;
+    if (g_mpi.mycalc > 0 && h >= g_mpi.firstconf &&
+        h < g_mpi.firstconf + g_mpi.myconf)
+      color[num_split % 2] = h;
+    num_split++;
+  }
+
+  for (int k = 0; k < 2; k++) {
+    CHECK_RETURN(MPI_Comm_split(g_mpi.comm, color[k], g_mpi.myid,
+                                &g_mpi.split_comm[k]));
+    g_mpi.split_conf[k] = (color[k] == MPI_UNDEFINED) ? -1 : color[k];
+  }
+
+  g_num_split = num_split;
+
+  return MPI_SUCCESS;
+}
+
 /****************************************************************
     broadcast_configurations
 ****************************************************************/
 
 int broadcast_configurations()
 {
-  // Each node: nconf/num_cpus configurations.
-  // Last nconf%num_cpus nodes: 1 additional config
+  // every group distributes all configurations over its processes
+  int size = g_mpi.num_cpus / g_mpi.num_groups;
+  int rank = g_mpi.myid % size;
+  int* calc_dist = (int*)Malloc((size + 1) * sizeof(int));
 
   if (g_mpi.myid == 0) {
-    int each = (g_config.nconf / g_mpi.num_cpus);
-    int odd = (g_config.nconf % g_mpi.num_cpus) - g_mpi.num_cpus;
-
-    g_mpi.atom_len = (int*)Malloc(g_mpi.num_cpus * sizeof(int));
-    g_mpi.atom_dist = (int*)Malloc(g_mpi.num_cpus * sizeof(int));
-    g_mpi.conf_len = (int*)Malloc(g_mpi.num_cpus * sizeof(int));
-    g_mpi.conf_dist = (int*)Malloc(g_mpi.num_cpus * sizeof(int));
-    for (int i = 0; i < g_mpi.num_cpus; i++)
-      g_mpi.conf_dist[i] = i * each + (((i + odd) > 0) ? (i + odd) : 0);
-    for (int i = 0; i < g_mpi.num_cpus - 1; i++)
-      g_mpi.conf_len[i] = g_mpi.conf_dist[i + 1] - g_mpi.conf_dist[i];
-    g_mpi.conf_len[g_mpi.num_cpus - 1] =
-        g_config.nconf - g_mpi.conf_dist[g_mpi.num_cpus - 1];
-    for (int i = 0; i < g_mpi.num_cpus; i++)
-      g_mpi.atom_dist[i] =
-          g_config.cnfstart[i * each + (((i + odd) > 0) ? (i + odd) : 0)];
-    for (int i = 0; i < g_mpi.num_cpus - 1; i++)
-      g_mpi.atom_len[i] = g_mpi.atom_dist[i + 1] - g_mpi.atom_dist[i];
-    g_mpi.atom_len[g_mpi.num_cpus - 1] =
-        g_config.natoms - g_mpi.atom_dist[g_mpi.num_cpus - 1];
+    if (g_param.split_atoms > 0) {
+      split_atom_dist(calc_dist, size);
+    } else {
+      // Each node: nconf/size configurations.
+      // Last nconf%size nodes: 1 additional config
+      int each = (g_config.nconf / size);
+      int odd = (g_config.nconf % size) - size;
+
+      for (int i = 0; i < size; i++)
+        calc_dist[i] =
+            g_config.cnfstart[i * each + (((i + odd) > 0) ? (i + odd) : 0)];
+    }
   }
 
-  CHECK_RETURN(MPI_Scatter(g_mpi.atom_len, 1, MPI_INT, &g_mpi.myatoms, 1,
-                           MPI_INT, 0, MPI_COMM_WORLD));
-  CHECK_RETURN(MPI_Scatter(g_mpi.atom_dist, 1, MPI_INT, &g_mpi.firstatom, 1,
-                           MPI_INT, 0, MPI_COMM_WORLD));
-  CHECK_RETURN(MPI_Scatter(g_mpi.conf_len, 1, MPI_INT, &g_mpi.myconf, 1,
-                           MPI_INT, 0, MPI_COMM_WORLD));
-  CHECK_RETURN(MPI_Scatter(g_mpi.conf_dist, 1, MPI_INT, &g_mpi.firstconf, 1,
-                           MPI_INT, 0, MPI_COMM_WORLD));
+  CHECK_RETURN(MPI_Bcast(calc_dist, size, MPI_INT, 0, MPI_COMM_WORLD));
+  calc_dist[size] = g_config.natoms;
+
+  // atoms calculated by this process
+  g_mpi.firstcalc = calc_dist[rank];
+  g_mpi.mycalc = calc_dist[rank + 1] - g_mpi.firstcalc;
+
+  // configurations with at least one of these atoms, the atoms of
+  // a split configuration which are calculated by other processes
+  // are kept as halo
+  if (g_mpi.mycalc > 0) {
+    int last = config_of_atom(g_mpi.firstcalc + g_mpi.mycalc - 1);
+    g_mpi.firstconf = config_of_atom(g_mpi.firstcalc);
+    g_mpi.myconf = last - g_mpi.firstconf + 1;
+    g_mpi.firstatom = g_config.cnfstart[g_mpi.firstconf];
+    g_mpi.myatoms =
+        g_config.cnfstart[last] + g_config.inconf[last] - g_mpi.firstatom;
+    // the results of a configuration are sent by the process which
+    // calculates its first atom
+    g_mpi.firstowned = g_mpi.firstconf;
+    if (g_config.cnfstart[g_mpi.firstconf] < g_mpi.firstcalc)
+      g_mpi.firstowned++;
+    g_mpi.myowned = last - g_mpi.firstowned + 1;
+  } else {
+    g_mpi.firstconf = g_mpi.firstowned = 0;
+    g_mpi.myconf = g_mpi.myowned = 0;
+    g_mpi.firstatom = g_mpi.myatoms = 0;
+  }
+
+  // the results are gathered by the first process of every group
+  if (rank == 0) {
+    g_mpi.atom_len = (int*)Malloc(size * sizeof(int));
+    g_mpi.atom_dist = (int*)Malloc(size * sizeof(int));
+    g_mpi.conf_len = (int*)Malloc(size * sizeof(int));
+    g_mpi.conf_dist = (int*)Malloc(size * sizeof(int));
+  }
 
-  g_config.conf_vol = (double*)Malloc(g_mpi.myconf * sizeof(double));
-  g_config.conf_uf = (int*)Malloc(g_mpi.myconf * sizeof(int));
+  CHECK_RETURN(MPI_Gather(&g_mpi.myatoms, 1, MPI_INT, g_mpi.atom_len, 1,
+                          MPI_INT, 0, g_mpi.comm));
+  CHECK_RETURN(MPI_Gather(&g_mpi.firstatom, 1, MPI_INT, g_mpi.atom_dist, 1,
+                          MPI_INT, 0, g_mpi.comm));
+  CHECK_RETURN(MPI_Gather(&g_mpi.myowned, 1, MPI_INT, g_mpi.conf_len, 1,
+                          MPI_INT, 0, g_mpi.comm));
+  CHECK_RETURN(MPI_Gather(&g_mpi.firstowned, 1, MPI_INT, g_mpi.conf_dist, 1,
+                          MPI_INT, 0, g_mpi.comm));
+
+  CHECK_RETURN(split_configurations(calc_dist, size));
+
+  // every process needs the flags of the configurations it calculates,
+  // which may overlap with those of its neighbors
+  CHECK_RETURN(broadcast_shared((void**)&g_config.volume, g_config.nconf,
+                                MPI_DOUBLE));
+  CHECK_RETURN(
+      broadcast_shared((void**)&g_config.useforce, g_config.nconf, MPI_INT));
 
-  CHECK_RETURN(MPI_Scatterv(g_config.volume, g_mpi.conf_len, g_mpi.conf_dist,
-                            MPI_DOUBLE, g_config.conf_vol, g_mpi.myconf,
-                            MPI_DOUBLE, 0, MPI_COMM_WORLD));
-  CHECK_RETURN(MPI_Scatterv(g_config.useforce, g_mpi.conf_len, g_mpi.conf_dist,
-                            MPI_INT, g_config.conf_uf, g_mpi.myconf, MPI_INT, 0,
-                            MPI_COMM_WORLD));
+  g_config.conf_vol = g_config.volume + g_mpi.firstconf;
+  g_config.conf_uf = g_config.useforce + g_mpi.firstconf;
 
 #if defined(STRESS)
-  g_config.conf_us = (int*)Malloc(g_mpi.myconf * sizeof(double));
+  CHECK_RETURN(
+      broadcast_shared((void**)&g_config.usestress, g_config.nconf, MPI_INT));
 
-  CHECK_RETURN(MPI_Scatterv(g_config.usestress, g_mpi.conf_len, g_mpi.conf_dist,
-                            MPI_INT, g_config.conf_us, g_mpi.myconf, MPI_INT, 0,
-                            MPI_COMM_WORLD));
+  g_config.conf_us = g_config.usestress + g_mpi.firstconf;
 #endif  // STRESS
 
   return MPI_SUCCESS;
@@ -763,11 +1105,16 @@ int broadcast_neighbors()
 
   for (int i = 0; i < g_config.natoms; ++i) {
     atom = g_config.conf_atoms + i - g_mpi.firstatom;
+    // halo atoms of split configurations have no neighbors
+    int calc = (i >= g_mpi.firstcalc && i < (g_mpi.firstcalc + g_mpi.mycalc));
     if (g_mpi.myid == 0)
       num_neighs = g_config.atoms[i].num_neigh;
     CHECK_RETURN(MPI_Bcast(&num_neighs, 1, MPI_INT, 0, MPI_COMM_WORLD));
-    if (num_neighs > 0 && i >= g_mpi.firstatom &&
-        i < (g_mpi.firstatom + g_mpi.myatoms)) {
+    if (!calc && i >= g_mpi.firstatom && i < (g_mpi.firstatom + g_mpi.myatoms)) {
+      atom->num_neigh = 0;
+      memset(atom->neigh_end, 0, sizeof(atom->neigh_end));
+    }
+    if (num_neighs > 0 && calc) {
       atom->neigh = (neigh_t*)Malloc(num_neighs * sizeof(neigh_t));
       for (int j = 0; j < num_neighs; ++j)
         memset(atom->neigh + j, 0, sizeof(neigh_t));
@@ -776,7 +1123,7 @@ int broadcast_neighbors()
       if (g_mpi.myid == 0)
         neigh = g_config.atoms[i].neigh[j];
       CHECK_RETURN(MPI_Bcast(&neigh, 1, g_mpi.MPI_NEIGH, 0, MPI_COMM_WORLD));
-      if (i >= g_mpi.firstatom && i < (g_mpi.firstatom + g_mpi.myatoms))
+      if (calc)
         atom->neigh[j] = neigh;
     }
   }
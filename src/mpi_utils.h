@@ -33,6 +33,7 @@
 int initialize_mpi(int* argc, char*** argv);
 void shutdown_mpi();
 int broadcast_params_mpi();
+void broadcast_potential(double* xi, int* flag);
 void potsync();
 
 #endif  // MPI_UTILS_H_INCLUDED
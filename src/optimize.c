@@ -29,11 +29,13 @@
 
 #include "potfit.h"
 
+#include "checkpoint.h"
 #include "optimize.h"
 
 // individual optimization algorithms
 void run_simulated_annealing(double* const xi);
 void run_differential_evolution(double* const xi);
+void run_cma_es(double* const xi);
 void run_powell_lsq(double* const xi);
 
 void run_optimization()
@@ -43,13 +45,32 @@ void run_optimization()
 
   double* xi = g_pot.opt_pot.table;
 
-#if !defined(EVO)
-  run_simulated_annealing(xi);
+  run_global_optimization(xi);
+
+  run_local_optimization(xi);
+}
+
+void run_global_optimization(double* const xi)
+{
+#if defined(EVO)
+  if (!restart_skip(CHECKPOINT_DIFF_EVO))
+    run_differential_evolution(xi);
+#elif defined(CMAES)
+  if (!restart_skip(CHECKPOINT_CMAES))
+    run_cma_es(xi);
 #else
-  run_differential_evolution(xi);
-#endif  // !EVO
+  // a checkpoint of the powell minimization skips this stage
+  if (!restart_skip(CHECKPOINT_SIMANN))
+    run_simulated_annealing(xi);
+#endif  // EVO
+}
 
+void run_local_optimization(double* const xi)
+{
   printf("\nStarting powell minimization ...\n");
+  if (g_param.linmin_batch > 1)
+    printf("Evaluating %d step lengths per line search round.\n",
+           g_param.linmin_batch);
 
   run_powell_lsq(xi);
 
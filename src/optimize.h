@@ -33,4 +33,8 @@
 // main optimization entry point
 void run_optimization();
 
+// the two stages of run_optimization, used separately by the ensemble fit
+void run_global_optimization(double* const xi);
+void run_local_optimization(double* const xi);
+
 #endif  // OPTIMIZE_H_INCLUDED
@@ -33,17 +33,16 @@
 
 #include "potfit.h"
 
+#include "force.h"
 #include "memory.h"
 #include "params.h"
 
-void read_parameter_file(char const* param_file);
 void get_param_double(char const* param_name, double* value, int line,
                       char const* param_file, double min, double max);
 void get_param_int(char const* param_name, int* value, int line,
                    char const* param_file, int min, int max);
 void get_param_string(char const* param_name, const char** value, int line,
                       char const* param_file);
-void check_parameters_complete(char const* paramfile);
 
 /****************************************************************
   read_parameters
@@ -151,10 +150,28 @@ void read_parameter_file(char const* param_file)
     else if (strcasecmp(token, "flagfile") == 0) {
       get_param_string("flagfile", &g_files.flagfile, line, param_file);
     }
+    // spool directory for server mode
+    else if (strcasecmp(token, "server_dir") == 0) {
+      get_param_string("server_dir", &g_files.server_dir, line, param_file);
+    }
     // write radial pair distribution ?
     else if (strcasecmp(token, "write_pair") == 0) {
       get_param_int("write_pair", &g_param.write_pair, line, param_file, 0, 1);
     }
+    // reorder the atoms of each configuration for cache locality
+    else if (strcasecmp(token, "sort_atoms") == 0) {
+      get_param_int("sort_atoms", &g_param.sort_atoms, line, param_file, 0, 1);
+    }
+    // split large configurations across MPI processes
+    else if (strcasecmp(token, "split_atoms") == 0) {
+      get_param_int("split_atoms", &g_param.split_atoms, line, param_file, 0,
+                    INT_MAX);
+    }
+    // groups of MPI processes which calculate different parameter vectors
+    else if (strcasecmp(token, "mpi_groups") == 0) {
+      get_param_int("mpi_groups", &g_param.mpi_groups, line, param_file, 0,
+                    INT_MAX);
+    }
     // plotpoint file
     else if (strcasecmp(token, "plotpointfile") == 0) {
       get_param_string("plotpointfile", &g_files.plotpointfile, line,
@@ -164,11 +181,39 @@ void read_parameter_file(char const* param_file)
     else if (strcasecmp(token, "tempfile") == 0) {
       get_param_string("tempfile", &g_files.tempfile, line, param_file);
     }
+    // file for the optimizer state
+    else if (strcasecmp(token, "checkpoint") == 0) {
+      get_param_string("checkpoint", &g_files.checkpoint, line, param_file);
+    }
+    // minimal time between two checkpoints
+    else if (strcasecmp(token, "checkpoint_interval") == 0) {
+      get_param_int("checkpoint_interval", &g_param.checkpoint_interval, line,
+                    param_file, 0, INT_MAX);
+    }
+    // resume the optimization from the checkpoint
+    else if (strcasecmp(token, "restart") == 0) {
+      get_param_int("restart", &g_param.restart, line, param_file, 0, 1);
+    }
+    // minimal time between two writes of the tempfile
+    else if (strcasecmp(token, "tempfile_interval") == 0) {
+      get_param_double("tempfile_interval", &g_param.tempfile_interval, line,
+                       param_file, 0, DBL_MAX);
+    }
     // seed for RNG
     else if (strcasecmp(token, "seed") == 0) {
       get_param_int("seed", &g_param.rng_seed, line, param_file, INT_MIN,
                     INT_MAX);
     }
+    // number of ensemble members
+    else if (strcasecmp(token, "ensemble") == 0) {
+      get_param_int("ensemble", &g_param.ensemble, line, param_file, 0,
+                    INT_MAX);
+    }
+    // ensemble members which are optimized after the global stage
+    else if (strcasecmp(token, "ensemble_keep") == 0) {
+      get_param_int("ensemble_keep", &g_param.ensemble_keep, line, param_file,
+                    1, INT_MAX);
+    }
     // Energy Weight
     else if (strcasecmp(token, "eng_weight") == 0) {
       get_param_double("eng_weight", &g_param.eweight, line, param_file, 0,
@@ -178,6 +223,21 @@ void read_parameter_file(char const* param_file)
     else if (strcasecmp(token, "d_eps") == 0) {
       get_param_double("d_eps", &g_calc.d_eps, line, param_file, 0, DBL_MAX);
     }
+    // update the powell linear equation system between factorizations
+    else if (strcasecmp(token, "powell_refactor") == 0) {
+      get_param_int("powell_refactor", &g_param.powell_refactor, line,
+                    param_file, 0, INT_MAX);
+    }
+    // evaluate several step lengths of the powell line search at once
+    else if (strcasecmp(token, "linmin_batch") == 0) {
+      get_param_int("linmin_batch", &g_param.linmin_batch, line, param_file,
+                    0, INT_MAX);
+    }
+    // pre-screen the candidates of the global optimizer with a model
+    else if (strcasecmp(token, "surrogate") == 0) {
+      get_param_int("surrogate", &g_param.surrogate, line, param_file, 0,
+                    INT_MAX);
+    }
 
     // write final potential in lammps format
     else if (strcasecmp(token, "write_lammps") == 0) {
@@ -242,12 +302,63 @@ void read_parameter_file(char const* param_file)
       get_param_double("evo_threshold", &g_param.evo_threshold, line,
                        param_file, 0, DBL_MAX);
     }
+#elif defined(CMAES)
+    // stopping criterion for CMA-ES
+    else if (strcasecmp(token, "cmaes_threshold") == 0) {
+      get_param_double("cmaes_threshold", &g_param.cmaes_threshold, line,
+                       param_file, 0, DBL_MAX);
+    }
+    // initial step size of CMA-ES
+    else if (strcasecmp(token, "cmaes_sigma") == 0) {
+      get_param_double("cmaes_sigma", &g_param.cmaes_sigma, line, param_file,
+                       DBL_MIN, DBL_MAX);
+    }
+    // samples per generation
+    else if (strcasecmp(token, "cmaes_lambda") == 0) {
+      get_param_int("cmaes_lambda", &g_param.cmaes_lambda, line, param_file, 0,
+                    INT_MAX);
+    }
+    // number of restarts with larger populations
+    else if (strcasecmp(token, "cmaes_restarts") == 0) {
+      get_param_int("cmaes_restarts", &g_param.cmaes_restarts, line,
+                    param_file, 0, INT_MAX);
+    }
 #else
     // starting temperature for annealing
     else if (strcasecmp(token, "anneal_temp") == 0) {
       get_param_string("anneal_temp", &g_param.anneal_temp, line, param_file);
     }
-#endif  // EVO
+    // trial steps per parameter before the step sizes are adjusted
+    else if (strcasecmp(token, "anneal_nstep") == 0) {
+      get_param_int("anneal_nstep", &g_param.anneal_nstep, line, param_file, 1,
+                    INT_MAX);
+    }
+    // step adjustments per temperature
+    else if (strcasecmp(token, "anneal_ntemp") == 0) {
+      get_param_int("anneal_ntemp", &g_param.anneal_ntemp, line, param_file, 0,
+                    INT_MAX);
+    }
+    // fixed cooling factor
+    else if (strcasecmp(token, "anneal_cooling") == 0) {
+      get_param_double("anneal_cooling", &g_param.anneal_cooling, line,
+                       param_file, DBL_MIN, 1.0 - DBL_EPSILON);
+    }
+    // cooling from the cost fluctuations at each temperature
+    else if (strcasecmp(token, "anneal_adaptive") == 0) {
+      get_param_double("anneal_adaptive", &g_param.anneal_adaptive, line,
+                       param_file, 0, DBL_MAX);
+    }
+    // stop annealing if the optimum did not improve for this many temperatures
+    else if (strcasecmp(token, "anneal_stagnation") == 0) {
+      get_param_int("anneal_stagnation", &g_param.anneal_stagnation, line,
+                    param_file, 0, INT_MAX);
+    }
+    // freeze parameters whose acceptance saturates
+    else if (strcasecmp(token, "anneal_freeze") == 0) {
+      get_param_int("anneal_freeze", &g_param.anneal_freeze, line, param_file,
+                    0, INT_MAX);
+    }
+#endif  // EVO || CMAES
 
 #if defined(BINDIST)
     // file for binned radial distribution
@@ -405,10 +516,54 @@ void check_parameters_complete(char const* paramfile)
 #endif  // PAIR
 #endif  // APOT
 
+  if (g_param.split_atoms > 0) {
+#if !defined(PAIR) && (!defined(EAM) || defined(COULOMB))
+    error(1, "split_atoms is only supported for pair and EAM potentials\n");
+#elif !defined(MPI)
+    warning("split_atoms has no effect without MPI\n");
+#endif  // !PAIR && (!EAM || COULOMB)
+  }
+
+  if (g_param.mpi_groups > 1) {
+#if !defined(PAIR) && (!defined(EAM) || defined(COULOMB))
+    error(1, "mpi_groups is only supported for pair and EAM potentials\n");
+#elif !defined(MPI)
+    warning("mpi_groups has no effect without MPI\n");
+#elif defined(RESCALE)
+    // the other groups would keep the old sampling points
+    error(1, "mpi_groups is not supported with the rescale option\n");
+#else
+    // every group calculates all configurations with the same number
+    // of processes
+    if (g_mpi.num_cpus % g_param.mpi_groups != 0)
+      error(1, "mpi_groups is \"%d\", but has to divide the number of MPI "
+               "processes (%d)\n", g_param.mpi_groups, g_mpi.num_cpus);
+#endif  // !PAIR && (!EAM || COULOMB)
+  }
+
+#if !defined(FORCE_BATCH_SWEEP)
+  // the step lengths of a round would be calculated one after the other,
+  // that takes more force calculations than brent() for nothing
+#if defined(MPI)
+  if (g_param.linmin_batch > 1 && g_param.mpi_groups < 2) {
+#else
+  if (g_param.linmin_batch > 1) {
+#endif  // MPI
+    warning("linmin_batch is ignored, this build calculates the forces of one "
+            "parameter vector at a time\n");
+    g_param.linmin_batch = 0;
+  }
+#endif  // !FORCE_BATCH_SWEEP
+
 #if defined(EVO)
     if (g_param.evo_threshold < 0)
       error(1, "Missing parameter or invalid value in %s : evo_threshold is"
                 "\"%f\"\n", paramfile, g_param.evo_threshold);
+#elif defined(CMAES)
+    if (g_param.cmaes_lambda > 0 && g_param.cmaes_lambda < 4)
+      error(1, "Missing parameter or invalid value in %s : cmaes_lambda is"
+               " \"%d\", CMA-ES needs at least 4 samples\n", paramfile,
+            g_param.cmaes_lambda);
 #else
     if (g_param.anneal_temp == NULL && g_param.opt == 1) {
       warning("anneal_temp not provided in %s, setting it to 0!\n", paramfile);
@@ -416,7 +571,7 @@ void check_parameters_complete(char const* paramfile)
       ((char*)g_param.anneal_temp)[0] = '0';
       ((char*)g_param.anneal_temp)[1] = '\0';
     }
-#endif  // EVO
+#endif  // EVO || CMAES
 
 #if defined(BINDIST)
   if (g_files.bindistfile == NULL)
@@ -425,6 +580,25 @@ void check_parameters_complete(char const* paramfile)
           paramfile);
 #endif  // BINDIST
 
+  if (g_param.ensemble > 0) {
+    if (g_param.opt == 0)
+      error(1, "Ensemble fits in %s need opt to be enabled\n", paramfile);
+    if (g_files.server_dir != NULL)
+      error(1, "Ensemble fits in %s cannot be combined with server_dir\n",
+            paramfile);
+    if (g_param.ensemble_keep == 0 ||
+        g_param.ensemble_keep > g_param.ensemble)
+      g_param.ensemble_keep = g_param.ensemble;
+  }
+
+  if (g_files.checkpoint != NULL || g_param.restart) {
+    if (g_param.restart && g_files.checkpoint == NULL)
+      error(1, "restart in %s needs a checkpoint file\n", paramfile);
+    if (g_param.ensemble > 0 || g_files.server_dir != NULL)
+      error(1, "Checkpoints in %s cannot be combined with ensemble or "
+            "server_dir\n", paramfile);
+  }
+
   if (g_param.global_cell_scale <= 0)
     error(1, "Missing parameter or invalid value in %s : cell_scale is \"%f\"\n",
           paramfile, g_param.global_cell_scale);
@@ -31,5 +31,7 @@
 #define PARAMS_H_INCLUDED
 
 void read_parameters(int argc, char** argv);
+void read_parameter_file(char const* param_file);
+void check_parameters_complete(char const* paramfile);
 
 #endif  // PARAMS_H_INCLUDED
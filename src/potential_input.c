@@ -30,10 +30,12 @@
 #include "potfit.h"
 
 #include "chempot.h"
+#include "config.h"
 #include "functions.h"
 #include "kim.h"
 #include "memory.h"
 #include "potential_input.h"
+#include "timer.h"
 #include "utils.h"
 
 void read_pot_line_F(char const* pbuf, potential_state* pstate);
@@ -46,6 +48,8 @@ void allocate_memory_for_potentials(potential_state* pstate);
 
 void calculate_cutoffs();
 void read_maxch_file();
+const char* compare_potentials(potfit_potentials const* old_pot,
+                               char const** old_elements, double const* old_rcut);
 
 void read_pot_table0(char const* potential_filename, FILE* pfile);
 void read_pot_table3(char const* potential_filename, FILE* pfile,
@@ -154,6 +158,99 @@ void read_pot_table(char const* potential_filename)
   read_maxch_file();
 }
 
+/****************************************************************
+ *
+ * reload_pot_table
+ *
+ * replaces the current potential by the one from potential_filename
+ *
+ * the neighbor lists of the configurations are not rebuilt, so the
+ * new potential needs the same cutoffs (and sampling points for
+ * tabulated potentials) and the same number of free parameters
+ * if this is not the case the old potential is kept
+ *
+ ****************************************************************/
+
+int reload_pot_table(char const* potential_filename)
+{
+  potfit_potentials old_pot = g_pot;
+  char const** old_elements = g_config.elements;
+  double* old_rcut = g_config.rcut;
+  double* old_rmin = g_config.rmin;
+#if !defined(APOT)
+  double* old_maxchange = g_calc.maxchange;
+#endif  // !APOT
+
+  memset(&g_pot, 0, sizeof(g_pot));
+  g_pot.interaction_name = old_pot.interaction_name;
+  g_pot.format_type = POTENTIAL_FORMAT_UNKNOWN;
+
+  read_pot_table(potential_filename);
+
+#if defined(APOT)
+  init_potential_ranges();
+#endif  // APOT
+
+  const char* reason = compare_potentials(&old_pot, old_elements, old_rcut);
+
+  if (reason != NULL) {
+    warning("The potential in %s cannot be used with the loaded configurations: %s\n",
+            potential_filename, reason);
+    g_pot = old_pot;
+    g_config.elements = old_elements;
+    g_config.rcut = old_rcut;
+    g_config.rmin = old_rmin;
+#if defined(APOT) && !defined(KIM)
+    update_slots();
+#elif !defined(APOT)
+    g_calc.maxchange = old_maxchange;
+#endif  // APOT
+    return POTFIT_ERROR;
+  }
+
+  return POTFIT_SUCCESS;
+}
+
+/****************************************************************
+  compare_potentials
+    returns the reason why the current potential cannot replace
+    old_pot or NULL if it can
+****************************************************************/
+
+const char* compare_potentials(potfit_potentials const* old_pot,
+                               char const** old_elements, double const* old_rcut)
+{
+  const char* reason = NULL;
+
+  if (g_pot.opt_pot.len != old_pot->opt_pot.len ||
+      g_pot.opt_pot.idxlen != old_pot->opt_pot.idxlen)
+    reason = "different number of (free) parameters";
+
+  for (int i = 0; reason == NULL && i < g_pot.opt_pot.ncols; i++)
+    if (g_pot.opt_pot.end[i] != old_pot->opt_pot.end[i])
+      reason = "different cutoff radius";
+
+  for (int i = 0; reason == NULL && i < g_param.ntypes * g_param.ntypes; i++)
+    if (g_config.rcut[i] != old_rcut[i])
+      reason = "different cutoff radius";
+
+#if !defined(APOT)
+  // the neighbor lists store the slots of the sampling points
+  if (reason == NULL && g_pot.calc_pot.len != old_pot->calc_pot.len)
+    reason = "different sampling points";
+
+  for (int i = 0; reason == NULL && i < g_pot.calc_pot.len; i++)
+    if (g_pot.calc_pot.xcoord[i] != old_pot->calc_pot.xcoord[i])
+      reason = "different sampling points";
+#endif  // !APOT
+
+  for (int i = 0; reason == NULL && i < g_param.ntypes; i++)
+    if (strcmp(g_config.elements[i], old_elements[i]) != 0)
+      reason = "different chemical elements";
+
+  return reason;
+}
+
 /****************************************************************
   read_pot_line_F
 ****************************************************************/
@@ -598,6 +695,8 @@ void update_calc_table(double* xi_opt, double* xi_calc, int do_all)
   double* val = xi_opt;
   double* list = g_pot.calc_list + 2;
 
+  TIMER_START(TIMER_SPLINES);
+
   // copy global parameters to the right positions
   if (g_pot.have_globals) {
     for (int i = 0; i < g_pot.apot_table.globals; i++) {
@@ -663,6 +762,8 @@ void update_calc_table(double* xi_opt, double* xi_calc, int do_all)
     val += g_pot.apot_table.n_par[i];
     list += g_pot.apot_table.n_par[i] + 2;
   }
+
+  TIMER_STOP(TIMER_SPLINES);
 }
 
 #endif  // APOT
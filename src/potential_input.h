@@ -40,6 +40,7 @@ typedef struct {
 
 // reading the potential file
 void read_pot_table(char const* potential_filename);
+int reload_pot_table(char const* potential_filename);
 
 #if defined(APOT)
 void update_apot_table(double* xi);
@@ -36,10 +36,10 @@
 
 #define NPLOT 1000
 
-void write_pot_table0(char const* filename);
-void write_pot_table3(char const* filename);
-void write_pot_table4(char const* filename);
-void write_pot_table5(char const* filename);
+void write_pot_table0(FILE* outfile);
+void write_pot_table3(FILE* pfile_table);
+void write_pot_table4(FILE* pfile_table);
+void write_pot_table5(FILE* outfile);
 
 /****************************************************************
  *
@@ -48,21 +48,40 @@ void write_pot_table5(char const* filename);
  ****************************************************************/
 
 void write_pot_table_potfit(char const* filename)
+{
+  FILE* outfile = fopen(filename, "w");
+
+  if (NULL == outfile)
+    error(1, "Could not open file %s\n", filename);
+
+  write_pot_table_potfit_stream(outfile);
+
+  fclose(outfile);
+}
+
+/****************************************************************
+ *
+ * write output potential to an open stream
+ *
+ ****************************************************************/
+
+void write_pot_table_potfit_stream(FILE* outfile)
 {
   switch (g_pot.format_type) {
     case POTENTIAL_FORMAT_UNKNOWN:
       error(1, "Unknown potential format detected! (%s:%d)\n", __FILE__,
             __LINE__);
     case POTENTIAL_FORMAT_ANALYTIC:
-      write_pot_table0(filename);
+      write_pot_table0(outfile);
       break;
     case POTENTIAL_FORMAT_TABULATED_EQ_DIST:
-      write_pot_table3(filename);
+    // format 3 potentials are written in format 4, write_pot_table4()
+    // used to overwrite the file written by write_pot_table3()
     case POTENTIAL_FORMAT_TABULATED_NON_EQ_DIST:
-      write_pot_table4(filename);
+      write_pot_table4(outfile);
       break;
     case POTENTIAL_FORMAT_KIM:
-      write_pot_table5(filename);
+      write_pot_table5(outfile);
       break;
   }
 }
@@ -73,18 +92,11 @@ void write_pot_table_potfit(char const* filename)
  *
  ****************************************************************/
 
-void write_pot_table0(char const* filename)
+void write_pot_table0(FILE* outfile)
 {
 #if defined(APOT)
   apot_table_t* apt = &g_pot.apot_table;
 
-  FILE* outfile = NULL;
-
-  /* open file */
-  outfile = fopen(filename, "w");
-  if (NULL == outfile)
-    error(1, "Could not open file %s\n", filename);
-
   /* write header */
   fprintf(outfile, "#F 0 %d", apt->number);
   fprintf(outfile, "\n#T %s", g_pot.interaction_name);
@@ -255,7 +267,6 @@ void write_pot_table0(char const* filename)
     if (i != (apt->number - 1))
       fprintf(outfile, "\n");
   }
-  fclose(outfile);
 #endif  // APOT
 }
 
@@ -265,9 +276,8 @@ void write_pot_table0(char const* filename)
  *
  ****************************************************************/
 
-void write_pot_table3(char const* filename)
+void write_pot_table3(FILE* pfile_table)
 {
-  FILE* pfile_table = NULL;
   FILE* pfile_plot = NULL;
   int plot_flag = 0;
   pot_table_t* pt = &g_pot.opt_pot;
@@ -275,16 +285,11 @@ void write_pot_table3(char const* filename)
   if (g_files.plotpointfile != NULL)
     plot_flag = 1;
 
-  /* open file */
-  pfile_table = fopen(filename, "w");
-  if (pfile_table == NULL)
-    error(1, "Could not open file %s\n", filename);
-
   /* if needed: open file for plotpoints */
   if (plot_flag) {
     pfile_plot = fopen(g_files.plotpointfile, "w");
-    if (pfile_table == NULL)
-      error(1, "Could not open file %s\n", filename);
+    if (pfile_plot == NULL)
+      error(1, "Could not open file %s\n", g_files.plotpointfile);
   }
 
   /* write header */
@@ -368,8 +373,6 @@ void write_pot_table3(char const* filename)
       fprintf(pfile_plot, "\n\n");
   }
 
-  fclose(pfile_table);
-
   if (plot_flag)
     fclose(pfile_plot);
 }
@@ -380,9 +383,8 @@ void write_pot_table3(char const* filename)
  *
  ****************************************************************/
 
-void write_pot_table4(char const* filename)
+void write_pot_table4(FILE* pfile_table)
 {
-  FILE* pfile_table = NULL;
   FILE* pfile_plot = NULL;
   int plot_flag = 0;
   pot_table_t* pt = &g_pot.opt_pot;
@@ -390,16 +392,11 @@ void write_pot_table4(char const* filename)
   if (g_files.plotpointfile != NULL)
     plot_flag = 1;
 
-  /* open file */
-  pfile_table = fopen(filename, "w");
-  if (pfile_table == NULL)
-    error(1, "Could not open file %s\n", filename);
-
   /* if needed: open file for plotpoints */
   if (plot_flag) {
     pfile_plot = fopen(g_files.plotpointfile, "w");
     if (pfile_plot == NULL)
-      error(1, "Could not open file %s\n", filename);
+      error(1, "Could not open file %s\n", g_files.plotpointfile);
   }
 
   /* write header */
@@ -475,8 +472,6 @@ void write_pot_table4(char const* filename)
     if (plot_flag)
       fprintf(pfile_plot, "\n\n");
   }
-  fclose(pfile_table);
-
   if (plot_flag)
     fclose(pfile_plot);
 }
@@ -487,16 +482,11 @@ void write_pot_table4(char const* filename)
  *
  ****************************************************************/
 
-void write_pot_table5(char const* filename)
+void write_pot_table5(FILE* outfile)
 {
 #if defined(KIM)
   pot_table_t* pt = &g_pot.opt_pot;
 
-  // open file
-  FILE* outfile = fopen(filename, "w");
-  if (outfile == NULL)
-    error(1, "Could not open file %s\n", filename);
-
   // write header
   fprintf(outfile, "#F 5 1");
   fprintf(outfile, "\n#C");
@@ -528,8 +518,6 @@ void write_pot_table5(char const* filename)
       k++;
     }
   }
-
-  fclose(outfile);
 #endif
 }
 
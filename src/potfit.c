@@ -31,7 +31,9 @@
 
 #include "potfit.h"
 
+#include "checkpoint.h"
 #include "config.h"
+#include "ensemble.h"
 #include "errors.h"
 #include "force.h"
 #include "functions.h"
@@ -43,27 +45,37 @@
 #include "potential_input.h"
 #include "potential_output.h"
 #include "random.h"
+#include "server.h"
+#include "tempfile.h"
+#include "timer.h"
 #include "utils.h"
 
+#if !defined(LIBRARY)
+
 // forward declarations of helper functions
 
 void read_input_files(int argc, char** argv);
 void start_mpi_worker(double* force);
 
+#endif  // !LIBRARY
+
 // potfit global variables
 
-potfit_calculation g_calc;
-potfit_configurations g_config;
-potfit_filenames g_files;
+POTFIT_TLS potfit_calculation g_calc;
+POTFIT_TLS potfit_configurations g_config;
+POTFIT_TLS potfit_filenames g_files;
 #if defined(KIM)
-potfit_kim g_kim;
+POTFIT_TLS potfit_kim g_kim;
 #endif // KIM
-potfit_mpi_config g_mpi;
-potfit_parameters g_param;
-potfit_potentials g_pot;
+POTFIT_TLS potfit_mpi_config g_mpi;
+POTFIT_TLS potfit_parameters g_param;
+POTFIT_TLS potfit_potentials g_pot;
+
+#if !defined(LIBRARY)
 
 /****************************************************************
     main potfit routine
+    library builds use the entry points in libpotfit.c instead
 ****************************************************************/
 
 int main(int argc, char** argv)
@@ -110,7 +122,7 @@ int main(int argc, char** argv)
 #endif  // !KIM
 #endif  // APOT
 
-  if (g_mpi.myid > 0) {
+  if (g_mpi.myid > 0 || g_mpi.group > 0) {
     start_mpi_worker(g_calc.force);
   } else {
 #if defined(MPI)
@@ -121,92 +133,28 @@ int main(int argc, char** argv)
     }
 #endif  // MPI
 
-    time_t start_time;
-    time_t end_time;
-
-    time(&start_time);
-
-    if (g_param.opt && g_calc.ndim > 0) {
-      run_optimization();
-    } else if (g_calc.ndim == 0) {
-      printf(
-          "\nOptimization disabled due to 0 free parameters. Calculating "
-          "errors.\n");
-    } else {
-      printf("\nOptimization disabled. Calculating errors.\n\n");
-    }
-
-    time(&end_time);
-
-#if defined(APOT)
-    double tot = calc_forces(g_pot.opt_pot.table, g_calc.force, 0);
-#else
-    double tot = calc_forces(g_pot.calc_pot.table, g_calc.force, 0);
-#endif  // APOT
-
-    write_pot_table_potfit(g_files.endpot);
-
-    {
-      int format = -1;
-
-      switch (g_pot.format_type) {
-        case POTENTIAL_FORMAT_UNKNOWN:
-          error(1, "Unknown potential format detected! (%s:%d)\n", __FILE__,
-                __LINE__);
-        case POTENTIAL_FORMAT_ANALYTIC:
-          format = 0;
-          break;
-        case POTENTIAL_FORMAT_TABULATED_EQ_DIST:
-          format = 3;
-          break;
-        case POTENTIAL_FORMAT_TABULATED_NON_EQ_DIST:
-          format = 4;
-          break;
-        case POTENTIAL_FORMAT_KIM:
-          format = 5;
-          break;
-      }
-
-      printf("\nPotential in format %d written to file \t%s\n", format,
-             g_files.endpot);
-    }
-
-#if !defined(KIM)
-    if (g_param.writeimd == 1)
-      write_pot_table_imd(g_files.imdpot);
-
-    if (g_param.plot == 1)
-      write_plotpot_pair(&g_pot.calc_pot, g_files.plotfile);
-
-    if (g_param.write_lammps == 1)
-      write_pot_table_lammps();
-#endif // !KIM
-
-#if defined(BINDIST) && !defined(MPI)
-    // bindist does not work with MPI
-    write_bindist_file(&g_pot.opt_pot, g_files.bindistfile);
-#endif // BINDIST && !MPI
-
-    // write the error files for forces, energies, stresses, ...
-    write_errors(g_calc.force, tot);
-
-    /* calculate total runtime */
-    if (g_param.opt && g_mpi.myid == 0 && g_calc.ndim > 0) {
-      printf("\nRuntime: %d hours, %d minutes and %d seconds.\n",
-             (int)difftime(end_time, start_time) / 3600,
-             ((int)difftime(end_time, start_time) % 3600) / 60,
-             (int)difftime(end_time, start_time) % 60);
-      printf("%d force calculations, each took %f seconds\n", g_calc.fcalls,
-             (double)difftime(end_time, start_time) / g_calc.fcalls);
-    }
+    if (g_files.server_dir != NULL)
+      run_server();
+    else if (g_param.ensemble > 0)
+      run_ensemble();
+    else
+      fit_potential();
 
 #if defined(MPI)
+    shutdown_groups();
     calc_forces(NULL, NULL, 1); /* go wake up other threads */
 #endif                          // MPI
   }                             /* myid == 0 */
 
+#if defined(TIMING)
+  // all processes contribute to the timing report
+  write_timing_report();
+#endif  // TIMING
+
 // do some cleanups before exiting
 
+  shutdown_tempfile();
+
 #if defined(MPI)
   // kill MPI
   shutdown_mpi();
@@ -221,6 +169,107 @@ int main(int argc, char** argv)
   return EXIT_SUCCESS;
 }
 
+#endif  // !LIBRARY
+
+/****************************************************************
+  fit_potential -- optimize the potential and write the results
+****************************************************************/
+
+void fit_potential(void)
+{
+  time_t start_time;
+  time_t end_time;
+
+  time(&start_time);
+
+  if (g_param.opt && g_calc.ndim > 0) {
+    if (g_param.restart)
+      read_checkpoint();
+    run_optimization();
+  } else if (g_calc.ndim == 0) {
+    printf(
+        "\nOptimization disabled due to 0 free parameters. Calculating "
+        "errors.\n");
+  } else {
+    printf("\nOptimization disabled. Calculating errors.\n\n");
+  }
+
+  time(&end_time);
+
+  write_fit_results();
+
+  /* calculate total runtime */
+  if (g_param.opt && g_mpi.myid == 0 && g_calc.ndim > 0) {
+    printf("\nRuntime: %d hours, %d minutes and %d seconds.\n",
+           (int)difftime(end_time, start_time) / 3600,
+           ((int)difftime(end_time, start_time) % 3600) / 60,
+           (int)difftime(end_time, start_time) % 60);
+    printf("%d force calculations, each took %f seconds\n", g_calc.fcalls,
+           (double)difftime(end_time, start_time) / g_calc.fcalls);
+  }
+}
+
+/****************************************************************
+  write_fit_results -- write the potential and the error files
+****************************************************************/
+
+void write_fit_results(void)
+{
+#if defined(APOT)
+  double tot = calc_forces(g_pot.opt_pot.table, g_calc.force, 0);
+#else
+  double tot = calc_forces(g_pot.calc_pot.table, g_calc.force, 0);
+#endif  // APOT
+
+  write_pot_table_potfit(g_files.endpot);
+
+  {
+    int format = -1;
+
+    switch (g_pot.format_type) {
+      case POTENTIAL_FORMAT_UNKNOWN:
+        error(1, "Unknown potential format detected! (%s:%d)\n", __FILE__,
+              __LINE__);
+      case POTENTIAL_FORMAT_ANALYTIC:
+        format = 0;
+        break;
+      case POTENTIAL_FORMAT_TABULATED_EQ_DIST:
+        format = 3;
+        break;
+      case POTENTIAL_FORMAT_TABULATED_NON_EQ_DIST:
+        format = 4;
+        break;
+      case POTENTIAL_FORMAT_KIM:
+        format = 5;
+        break;
+    }
+
+    printf("\nPotential in format %d written to file \t%s\n", format,
+           g_files.endpot);
+  }
+
+#if !defined(KIM)
+  if (g_param.writeimd == 1)
+    write_pot_table_imd(g_files.imdpot);
+
+  if (g_param.plot == 1)
+    write_plotpot_pair(&g_pot.calc_pot, g_files.plotfile);
+
+  if (g_param.write_lammps == 1)
+    write_pot_table_lammps();
+#endif // !KIM
+
+#if defined(BINDIST) && !defined(MPI)
+  // bindist does not work with MPI
+  write_bindist_file(&g_pot.opt_pot, g_files.bindistfile);
+#endif // BINDIST && !MPI
+
+  // write the error files for forces, energies, stresses, ...
+  write_errors(g_calc.force, tot);
+}
+
+#if !defined(LIBRARY)
+
 /****************************************************************
   read_input_files -- process all input files
 ****************************************************************/
@@ -261,6 +310,14 @@ void start_mpi_worker(double* force)
   init_force_common(1);
   init_force(1);
 
+#if defined(MPI)
+  // the first process of another group waits for calc_forces_batch
+  if (g_mpi.myid == 0) {
+    calc_forces_group(force);
+    return;
+  }
+#endif  // MPI
+
 #if defined(APOT)
   calc_forces(g_pot.opt_pot.table, force, 0);
 #else
@@ -268,6 +325,8 @@ void start_mpi_worker(double* force)
 #endif  // APOT
 }
 
+#endif  // !LIBRARY
+
 /****************************************************************
   error -- complain and abort
 ****************************************************************/
@@ -286,9 +345,18 @@ void error(int done, const char* msg, ...)
   fflush(stderr);
 
   if (done == 1) {
+#if defined(LIBRARY)
+    // does not return if called from inside a library function
+    library_error();
+#else
+    // does not return if called while a server job is running
+    server_error();
+#endif  // LIBRARY
 #if defined(MPI)
     if (g_mpi.init_done == 1) {
       /* go wake up other threads */
+      if (g_mpi.myid == 0 && g_mpi.group == 0)
+        shutdown_groups();
       calc_forces(NULL, NULL, 1);
       shutdown_mpi();
     }
@@ -54,6 +54,14 @@
 // very simple static assert
 #define STATIC_ASSERT(COND,MSG) typedef char static_assertion_##MSG[(COND)?1:-1]
 
+// every potfit context of the library runs in its own thread, all global
+// and static state of potfit is thread-local then (libpotfit.c)
+#if defined(LIBRARY)
+#define POTFIT_TLS __thread
+#else
+#define POTFIT_TLS
+#endif  // LIBRARY
+
 // include preprocessor flags and certain compile time constants
 #include "defines.h"
 
@@ -62,19 +70,32 @@
 
 // global variables (defined in potfit.c)
 
-extern potfit_calculation g_calc;
-extern potfit_configurations g_config;
-extern potfit_filenames g_files;
+extern POTFIT_TLS potfit_calculation g_calc;
+extern POTFIT_TLS potfit_configurations g_config;
+extern POTFIT_TLS potfit_filenames g_files;
 #if defined(KIM)
-extern potfit_kim g_kim;
+extern POTFIT_TLS potfit_kim g_kim;
 #endif
-extern potfit_mpi_config g_mpi;
-extern potfit_parameters g_param;
-extern potfit_potentials g_pot;
+extern POTFIT_TLS potfit_mpi_config g_mpi;
+extern POTFIT_TLS potfit_parameters g_param;
+extern POTFIT_TLS potfit_potentials g_pot;
 
 // general functions for warning and error output
 
 void error(int done, const char* msg, ...);
 void warning(const char* msg, ...);
 
+// optimize the current potential and write all output files
+void fit_potential(void);
+// write the current potential and the error files
+void write_fit_results(void);
+
+#if defined(LIBRARY)
+// return from error() to the active library call (libpotfit.c)
+void library_error(void);
+#else
+// return from error() to the server loop if a job is running (server.c)
+void server_error(void);
+#endif  // LIBRARY
+
 #endif  // POTFIT_H_INCLUDED
@@ -48,12 +48,14 @@
 #endif  // MKL
 
 #include "bracket.h"
+#include "checkpoint.h"
 #include "force.h"
+#include "functions.h"
 #include "memory.h"
 #include "optimize.h"
 #include "potential_input.h"
-#include "potential_output.h"
 #include "rescale.h"
+#include "tempfile.h"
 #include "utils.h"
 
 #define EPS 0.001
@@ -61,12 +63,17 @@
 #define VERY_SMALL 1.E-12
 #define INNERLOOPS 801
 #define TOOBIG 10000
+#define MIN_RCOND 1.E-10
 
 int gamma_init(double**, double**, double*, double*);
 int gamma_update(double**, double, double, double*, double*, double*, int, int,
                  int, double);
 void lineqsys_init(double**, double**, double*, double*, int, int);
 void lineqsys_update(double**, double**, double*, double*, int, int, int);
+int cholesky_init(double**, double**, double*, int*, int);
+int cholesky_replace(double**, double**, double*, int, double*, int*, int);
+int cholesky_rank1(double**, double*, double, int);
+int cholesky_check(double**, double**, double*, int*, int);
 double normalize_vector(double*, int);
 
 double** mat_double(int rowdim, int coldim)
@@ -96,8 +103,10 @@ void run_powell_lsq(double* xi)
 {
   char fact[1] = "N";
   char uplo[1] = "U"; // char used in dsysvx
+  char uplo_chol[1] = "L"; // upper triangle of the C array chol
   int n = 0;
   int breakflag = 0;
+  int loop_again = 0;
   double cond = 0.0;
   double F1 = 0.0;
   double F2 = 0.0;
@@ -111,8 +120,8 @@ void run_powell_lsq(double* xi)
   /* Direction vectors */
   double** d = mat_double(g_calc.ndim, g_calc.ndim);
 
-  /* Matrix of derivatives */
-  double** gamma = mat_double(g_calc.mdim, g_calc.ndim);
+  /* Matrix of derivatives, only the used entries of the force vector */
+  double** gamma = mat_double(g_calc.rdim, g_calc.ndim);
 
   /* Lin.Eq.Sys. Matrix */
   double** lineqsys = mat_double(g_calc.ndim, g_calc.ndim);
@@ -123,6 +132,14 @@ void run_powell_lsq(double* xi)
   /* Keeps track of LU pivoting */
   int* perm_indx = (int*)Malloc(g_calc.ndim * sizeof(int));
 
+  /* Cholesky factor of the lineqsys, updated with every replaced
+     direction until the next factorization (powell_refactor) */
+  double** chol = mat_double(g_calc.ndim, g_calc.ndim);
+  double* les_row = (double*)Malloc(g_calc.ndim * sizeof(double));
+  int chol_valid = 0;
+  int chol_steps = 0;
+  int chol_solves = 0;
+
   /* Normalized vector delta */
   double* delta_norm = (double*)Malloc(g_calc.ndimtot * sizeof(double));
 
@@ -142,23 +159,34 @@ void run_powell_lsq(double* xi)
   double* work = (double*)Malloc(worksize * sizeof(double));
   int* iwork = (int*)Malloc(g_calc.ndim * sizeof(int));
 
-  /* calculate the first force */
-  F1 = calc_forces(xi, forces_1, 0);
+  if (restart_stage(CHECKPOINT_POWELL)) {
+    restart_get("n", &n, sizeof(int));
+    restart_get("F1", &F1, sizeof(double));
+    restart_get("xi", xi, g_calc.ndimtot * sizeof(double));
+    restart_get("forces_1", forces_1, g_calc.mdim * sizeof(double));
+    restart_get("forces_2", forces_2, g_calc.mdim * sizeof(double));
+#if defined(APOT)
+    printf("loops\t\terror_sum\tforce calculations\n");
+#endif  // APOT
+  } else {
+    /* calculate the first force */
+    F1 = calc_forces(xi, forces_1, 0);
 
-  if (F1 < VERY_SMALL) {
-    printf("Error already too small to optimize, aborting ...\n");
-    return;
-  }
+    if (F1 < VERY_SMALL) {
+      printf("Error already too small to optimize, aborting ...\n");
+      return;
+    }
 
-  memcpy(forces_2, forces_1, g_calc.mdim * sizeof(double));
+    memcpy(forces_2, forces_1, g_calc.mdim * sizeof(double));
 
 #if defined(APOT)
-  printf("loops\t\terror_sum\tforce calculations\n");
-  printf("%5d\t%17.6f\t%6d\n", 0, F1, g_calc.fcalls);
+    printf("loops\t\terror_sum\tforce calculations\n");
+    printf("%5d\t%17.6f\t%6d\n", 0, F1, g_calc.fcalls);
 #else
-  printf("%d %f %f %f %f %f %f %d\n", 0, F1, xi[0], xi[1], xi[2], xi[3], xi[4],
-         g_calc.fcalls);
+    printf("%d %f %f %f %f %f %f %d\n", 0, F1, xi[0], xi[1], xi[2], xi[3],
+           xi[4], g_calc.fcalls);
 #endif  // APOT
+  }
   fflush(stdout);
 
   do {
@@ -185,13 +213,12 @@ void run_powell_lsq(double* xi)
       /* try again */
       if (i != 0) {
 /* ok, now this is serious, better exit cleanly */
+        update_tempfile(xi); /*emergency writeout */
+        flush_tempfile();
 #if !defined(APOT)
-        write_pot_table_potfit(g_files.tempfile); /*emergency writeout */
         warning("F does not depend on xi[%d], fit impossible!\n",
                 g_pot.opt_pot.idx[i - 1]);
 #else
-        update_apot_table(xi);
-        write_pot_table_potfit(g_files.tempfile);
         warning(
             "F does not depend on the %d. parameter (%s) of the %d. "
             "potential.\n",
@@ -206,11 +233,12 @@ void run_powell_lsq(double* xi)
     }
 
     /*init LES */
-    lineqsys_init(gamma, lineqsys, forces_1, p, g_calc.ndim, g_calc.mdim);
+    lineqsys_init(gamma, lineqsys, forces_1, p, g_calc.ndim, g_calc.rdim);
 
     F3 = F1;
 
     breakflag = 0;
+    chol_valid = 0;
 
     /*inner loop - only calculate changed rows/lines in gamma */
     do {
@@ -219,17 +247,40 @@ void run_powell_lsq(double* xi)
       /* All in one driver routine */
       int j = 1; /* 1 rhs */
 
+      if (chol_valid && chol_steps < g_param.powell_refactor) {
+        /* solve with the updated Cholesky factorization, O(ndim^2) */
+        memcpy(q, p, g_calc.ndim * sizeof(double));
+#if defined(MKL)
+        dpotrs(uplo_chol, &g_calc.ndim, &j, &chol[0][0], &g_calc.ndim, q,
+               &g_calc.ndim, &i);
+#elif defined(__ACCELERATE__)
+        dpotrs_(uplo_chol, &g_calc.ndim, &j, &chol[0][0], &g_calc.ndim, q,
+                &g_calc.ndim, &i);
+#endif
+        ferror = 0.0;
+        berror = 0.0;
+        chol_solves++;
+      } else {
 /* Linear Equation Solution (lapack) */
 #if defined(MKL)
-      dsysvx(fact, uplo, &g_calc.ndim, &j, &lineqsys[0][0], &g_calc.ndim,
-             &les_inverse[0][0], &g_calc.ndim, perm_indx, p, &g_calc.ndim, q,
-             &g_calc.ndim, &cond, &ferror, &berror, work, &worksize, iwork, &i);
+        dsysvx(fact, uplo, &g_calc.ndim, &j, &lineqsys[0][0], &g_calc.ndim,
+               &les_inverse[0][0], &g_calc.ndim, perm_indx, p, &g_calc.ndim,
+               q, &g_calc.ndim, &cond, &ferror, &berror, work, &worksize,
+               iwork, &i);
 #elif defined(__ACCELERATE__)
-      dsysvx_(fact, uplo, &g_calc.ndim, &j, &lineqsys[0][0], &g_calc.ndim,
-             &les_inverse[0][0], &g_calc.ndim, perm_indx, p, &g_calc.ndim, q,
-             &g_calc.ndim, &cond, &ferror, &berror, work, &worksize, iwork, &i);
+        dsysvx_(fact, uplo, &g_calc.ndim, &j, &lineqsys[0][0], &g_calc.ndim,
+                &les_inverse[0][0], &g_calc.ndim, perm_indx, p, &g_calc.ndim,
+                q, &g_calc.ndim, &cond, &ferror, &berror, work, &worksize,
+                iwork, &i);
 #endif
 
+        if (g_param.powell_refactor > 0) {
+          chol_valid =
+              cholesky_init(lineqsys, chol, work, iwork, g_calc.ndim);
+          chol_steps = 0;
+        }
+      }
+
 #if defined(DEBUG) && !(defined APOT)
       printf("q0: %d %f %f %f %f %f %f %f %f\n", i, q[0], q[1], q[2], q[3],
              q[4], q[5], q[6], q[7]);
@@ -316,7 +367,7 @@ void run_powell_lsq(double* xi)
       /* (f) update gamma, but if fn returns 1, matrix will be sigular,
          break inner loop and restart with new matrix */
       if (gamma_update(gamma, xi1, xi2, forces_1, forces_2, delta_norm, j,
-                       g_calc.mdim, g_calc.ndimtot, F1)) {
+                       g_calc.rdim, g_calc.ndimtot, F1)) {
         warning("Matrix gamma singular after step %d, restarting inner loop\n",
                 m);
         break;
@@ -327,8 +378,19 @@ void run_powell_lsq(double* xi)
         d[i][j] = delta_norm[g_pot.opt_pot.idx[i]];
 
       /* (h) update linear equation system */
+      if (chol_valid)
+        memcpy(les_row, lineqsys[j], g_calc.ndim * sizeof(double));
+
       lineqsys_update(gamma, lineqsys, forces_1, p, j, g_calc.ndim,
-                      g_calc.mdim);
+                      g_calc.rdim);
+
+      /* and its Cholesky factorization, a failed update or a bad
+         condition number leads to a new factorization in (a) */
+      if (chol_valid) {
+        chol_valid = cholesky_replace(lineqsys, chol, les_row, j, work, iwork,
+                                      g_calc.ndim);
+        chol_steps++;
+      }
 
       m++; /*increment loop counter */
       df = F2 - F1;
@@ -352,17 +414,12 @@ void run_powell_lsq(double* xi)
     fflush(stdout);
 
     /* End fit if break flagfile exists */
-    if (g_files.flagfile && strlen(g_files.flagfile)) {
-      FILE* ff = fopen(g_files.flagfile, "r");
-      if (ff != NULL) {
-        printf(
-            "Fit terminated prematurely in presence of break flagfile "
-            "\"%s\"!\n",
-            g_files.flagfile);
-        fclose(ff);
-        remove(g_files.flagfile);
-        break;
-      }
+    if (break_flagfile()) {
+      printf(
+          "Fit terminated prematurely in presence of break flagfile "
+          "\"%s\"!\n",
+          g_files.flagfile);
+      break;
     }
 
 /* WARNING: This rescaling is not necessary for EAM. Causes more problems. */
@@ -380,16 +437,23 @@ void run_powell_lsq(double* xi)
 #endif  // RESCALE && ( xEAM || xMEAM )
 
     /* write temp file  */
-    if (g_files.tempfile && strlen(g_files.tempfile)) {
-#if defined(APOT)
-      update_apot_table(xi);
-#endif  // APOT
-      write_pot_table_potfit(g_files.tempfile);
-    }
+    update_tempfile(xi);
 
     /*End fit if whole series didn't improve F */
-  } while (((F3 - F1 > PRECISION / 10.0) || (F3 - F1 < 0)) &&
-           (F3 - F1 > g_calc.d_eps));
+    loop_again = ((F3 - F1 > PRECISION / 10.0) || (F3 - F1 < 0)) &&
+                 (F3 - F1 > g_calc.d_eps);
+
+    /* save the state for a restart, gamma and d are initialized again */
+    if (loop_again && checkpoint_due()) {
+      checkpoint_begin(CHECKPOINT_POWELL);
+      checkpoint_add("n", &n, sizeof(int));
+      checkpoint_add("F1", &F1, sizeof(double));
+      checkpoint_add("xi", xi, g_calc.ndimtot * sizeof(double));
+      checkpoint_add("forces_1", forces_1, g_calc.mdim * sizeof(double));
+      checkpoint_add("forces_2", forces_2, g_calc.mdim * sizeof(double));
+      checkpoint_commit();
+    }
+  } while (loop_again);
   /* outer loop */
 
   if (fabs(F3 - F1) < PRECISION && F3 != F1)
@@ -403,6 +467,13 @@ void run_powell_lsq(double* xi)
   else
     printf("Precision not reached!\n");
 
+  if (g_param.powell_refactor > 0)
+    printf("%d linear equation systems solved with an updated Cholesky "
+           "factorization.\n", chol_solves);
+
+  // rendering a held back tempfile changes apot_table.values
+  flush_tempfile();
+
 #if defined(APOT)
   update_apot_table(xi);
 #endif  // APOT
@@ -419,9 +490,14 @@ void run_powell_lsq(double* xi)
 
 int gamma_init(double** gamma, double** d, double* xi, double* force_xi)
 {
-  static double* force;
+  static POTFIT_TLS double* xi_batch[FORCE_BATCH];
+  static POTFIT_TLS double* force[FORCE_BATCH];
+  /* last force vector of the previous call */
+  static POTFIT_TLS double* force_last;
 
-  double sum, temp, scale, store; /* Auxiliary var: Sum */
+  double error_sums[FORCE_BATCH];
+  double scale[FORCE_BATCH];
+  double sum, temp; /* Auxiliary var: Sum */
 
   /* Set direction vectors to coordinate directions d_ij=KroneckerDelta_ij */
   for (int i = 0; i < g_calc.ndim; i++)
@@ -429,45 +505,86 @@ int gamma_init(double** gamma, double** d, double* xi, double* force_xi)
       d[i][j] = (i == j) ? 1.0 : 0.0;
 
   /* Initialize gamma by calculating numerical derivatives */
-  if (force == NULL)
-    force = (double*)Malloc(g_calc.mdim * sizeof(double));
+  if (force[0] == NULL) {
+    for (int k = 0; k < FORCE_BATCH; k++) {
+      xi_batch[k] = (double*)Malloc(g_calc.ndimtot * sizeof(double));
+      force[k] = (double*)Malloc(g_calc.mdim * sizeof(double));
+    }
+    force_last = (double*)Malloc(g_calc.mdim * sizeof(double));
+    checkpoint_register("gamma_init", force_last, g_calc.mdim * sizeof(double));
+  }
+
+  /* the derivatives in up to FORCE_BATCH directions are calculated
+     with one sweep over the neighbor lists */
+  for (int first = 0; first < g_calc.ndim; first += FORCE_BATCH) {
+    int num = MIN(FORCE_BATCH, g_calc.ndim - first);
 
-  /*initialize gamma */
-  for (int i = 0; i < g_calc.ndim; i++) {
-    store = xi[g_pot.opt_pot.idx[i]];
+    for (int k = 0; k < num; k++) {
+      int i = first + k;
+      double store = xi[g_pot.opt_pot.idx[i]];
 #if defined(APOT)
-    scale =
-        g_pot.apot_table
-            .pmax[g_pot.apot_table.idxpot[i]][g_pot.apot_table.idxparam[i]] -
-        g_pot.apot_table
-            .pmin[g_pot.apot_table.idxpot[i]][g_pot.apot_table.idxparam[i]];
-    xi[g_pot.opt_pot.idx[i]] += (EPS * scale);
+      scale[k] =
+          g_pot.apot_table
+              .pmax[g_pot.apot_table.idxpot[i]][g_pot.apot_table.idxparam[i]] -
+          g_pot.apot_table
+              .pmin[g_pot.apot_table.idxpot[i]][g_pot.apot_table.idxparam[i]];
+      xi[g_pot.opt_pot.idx[i]] += (EPS * scale[k]);
 #else
-    scale = 1.0;
-    xi[g_pot.opt_pot.idx[i]] += EPS; /*increase xi[idx[i]]... */
+      scale[k] = 1.0;
+      xi[g_pot.opt_pot.idx[i]] += EPS; /*increase xi[idx[i]]... */
 #endif  // APOT
 
-    sum = 0.0;
+      memcpy(xi_batch[k], xi, g_calc.ndimtot * sizeof(double));
 
-    calc_forces(xi, force, 0);
+#if defined(APOT)
+      /* calc_forces() keeps the periodic parameters of xi in range */
+      apot_check_params(xi);
+      /* marks the punishments which are not recalculated */
+      for (int j = g_calc.punish_par_p; j < g_calc.mdim; j++)
+        force[k][j] = NAN;
+#endif  // APOT
 
-    for (int j = 0; j < g_calc.mdim; j++) {
-      temp = (force[j] - force_xi[j]) / (EPS * scale);
-      gamma[j][i] = temp;
-      sum += dsquare(temp);
+      xi[g_pot.opt_pot.idx[i]] = store; /*...and reset [idx[i]] again */
     }
 
-    temp = sqrt(sum);
+    calc_forces_batch(xi_batch, force, error_sums, num);
+
+    /*initialize gamma */
+    for (int k = 0; k < num; k++) {
+      int i = first + k;
 
-    xi[g_pot.opt_pot.idx[i]] = store; /*...and reset [idx[i]] again */
+#if defined(APOT)
+      /* the punishments keep their previous value, like in a sequence
+         of calc_forces() calls with the same force vector */
+      double* prev = (k == 0) ? force_last : force[k - 1];
+      for (int j = g_calc.punish_par_p; j < g_calc.mdim; j++)
+        if (isnan(force[k][j]))
+          force[k][j] = prev[j];
+#endif  // APOT
+
+      sum = 0.0;
+
+      for (int j = 0; j < g_calc.rdim; j++) {
+        int idx = g_calc.res_idx[j];
+        temp = (force[k][idx] - force_xi[idx]) / (EPS * scale[k]);
+        gamma[j][i] = temp;
+        sum += dsquare(temp);
+      }
 
-    /* scale gamma so that sum_j(gamma^2)=1                      */
-    if (temp > VERY_SMALL) {
-      for (int j = 0; j < g_calc.mdim; j++)
-        gamma[j][i] /= temp; /*normalize gamma */
-      d[i][i] /= temp;       /* rescale d */
-    } else
-      return i + 1; /* singular matrix, abort */
+      temp = sqrt(sum);
+
+      /* scale gamma so that sum_j(gamma^2)=1                      */
+      if (temp > VERY_SMALL) {
+        for (int j = 0; j < g_calc.rdim; j++)
+          gamma[j][i] /= temp; /*normalize gamma */
+        d[i][i] /= temp;       /* rescale d */
+      } else {
+        memcpy(force_last, force[k], g_calc.mdim * sizeof(double));
+        return i + 1; /* singular matrix, abort */
+      }
+    }
+
+    memcpy(force_last, force[num - 1], g_calc.mdim * sizeof(double));
   }
   return 0;
 }
@@ -476,7 +593,8 @@ int gamma_init(double** gamma, double** d, double* xi, double* force_xi)
  *
  * gamma_update: Update column j of gamma ( to newly calculated
  *           numerical derivatives (calculated from fa, fb
- *           at a,b); normalize new vector.
+ *           at a,b); normalize new vector. The m rows of gamma are
+ *           the used entries g_calc.res_idx of the force vectors.
  *
  ****************************************************************/
 
@@ -488,15 +606,16 @@ int gamma_update(double** gamma, double a, double b, double* fa, double* fb,
   double mu = 0.0;
 
   for (int i = 0; i < m; i++) {
-    temp = ((fa[i] - fb[i]) / (a - b));
+    int idx = g_calc.res_idx[i];
+    temp = ((fa[idx] - fb[idx]) / (a - b));
     gamma[i][j] = temp;
-    mu += temp * fa[i];
+    mu += temp * fa[idx];
   }
 
   mu /= fmin;
 
   for (int i = 0; i < m; i++) {
-    temp = gamma[i][j] - mu * fa[i];
+    temp = gamma[i][j] - mu * fa[g_calc.res_idx[i]];
     gamma[i][j] = temp;
     sum += temp * temp;
   }
@@ -528,7 +647,7 @@ void lineqsys_init(double** gamma, double** lineqsys, double* deltaforce,
   for (int i = 0; i < n; i++) {
     p[i] = 0.0;
     for (int j = 0; j < m; j++) {
-      p[i] -= gamma[j][i] * deltaforce[j];
+      p[i] -= gamma[j][i] * deltaforce[g_calc.res_idx[j]];
     }
   }
 
@@ -563,9 +682,140 @@ void lineqsys_update(double** gamma, double** lineqsys, double* force_xi,
     lineqsys[i][k] = 0.0;
 
     for (int j = 0; j < m; j++) {
-      p[k] -= gamma[j][k] * force_xi[j];
+      p[k] -= gamma[j][k] * force_xi[g_calc.res_idx[j]];
       lineqsys[i][k] += gamma[j][i] * gamma[j][k];
     }
     lineqsys[k][i] = lineqsys[i][k];
   }
 }
+
+/****************************************************************
+ *
+ * cholesky_init: Cholesky factorization lineqsys = r^T.r, r is
+ *              stored in the upper triangle. Returns 0 if the matrix
+ *              is not positive definite or badly conditioned.
+ *
+ ****************************************************************/
+
+int cholesky_init(double** a, double** r, double* work, int* iwork, int n)
+{
+  char uplo[1] = "L"; // upper triangle of the C array
+  int info = 0;
+
+  memcpy(&r[0][0], &a[0][0], n * n * sizeof(double));
+
+#if defined(MKL)
+  dpotrf(uplo, &n, &r[0][0], &n, &info);
+#elif defined(__ACCELERATE__)
+  dpotrf_(uplo, &n, &r[0][0], &n, &info);
+#endif
+
+  if (info != 0)
+    return 0;
+
+  return cholesky_check(a, r, work, iwork, n);
+}
+
+/****************************************************************
+ *
+ * cholesky_replace: Update r after lineqsys_update replaced row and
+ *            column j of a (old row in a_old). The change
+ *            c.e_j^T + e_j.c^T is applied as u.u^T - w.w^T.
+ *
+ ****************************************************************/
+
+int cholesky_replace(double** a, double** r, double* a_old, int j,
+                     double* work, int* iwork, int n)
+{
+  double* u = work + 3 * n; // work[0, 3n) is used by dpocon
+  double* w = work + 4 * n;
+  double sum = 0.0;
+
+  for (int k = 0; k < n; k++) {
+    u[k] = a[j][k] - a_old[k];
+    if (k == j)
+      u[k] *= 0.5;
+    sum += dsquare(u[k]);
+  }
+
+  if (sum == 0.0)
+    return 1;
+
+  // same length for both vectors of the rank-2 update
+  double scale = sqrt(sqrt(sum));
+  double h = sqrt(0.5);
+
+  for (int k = 0; k < n; k++) {
+    double x = u[k] / scale;
+    double y = (k == j) ? scale : 0.0;
+    u[k] = h * (x + y);
+    w[k] = h * (x - y);
+  }
+
+  if (!cholesky_rank1(r, u, 1.0, n) || !cholesky_rank1(r, w, -1.0, n))
+    return 0;
+
+  return cholesky_check(a, r, work, iwork, n);
+}
+
+/****************************************************************
+ *
+ * cholesky_rank1: r^T.r + sign * x.x^T, overwrites x. Returns 0 if
+ *            the downdated matrix is not positive definite.
+ *
+ ****************************************************************/
+
+int cholesky_rank1(double** r, double* x, double sign, int n)
+{
+  for (int k = 0; k < n; k++) {
+    double diag = dsquare(r[k][k]) + sign * dsquare(x[k]);
+
+    if (diag <= 0.0)
+      return 0;
+
+    diag = sqrt(diag);
+
+    double c = diag / r[k][k];
+    double s = x[k] / r[k][k];
+
+    r[k][k] = diag;
+
+    for (int i = k + 1; i < n; i++) {
+      r[k][i] = (r[k][i] + sign * s * x[i]) / c;
+      x[i] = c * x[i] - s * r[k][i];
+    }
+  }
+
+  return 1;
+}
+
+/****************************************************************
+ *
+ * cholesky_check: Estimate the reciprocal condition number of a
+ *            from its factorization r in O(n^2).
+ *
+ ****************************************************************/
+
+int cholesky_check(double** a, double** r, double* work, int* iwork, int n)
+{
+  char uplo[1] = "L"; // upper triangle of the C array
+  double anorm = 0.0;
+  double rcond = 0.0;
+  int info = 0;
+
+  // 1-norm of the symmetric matrix a
+  for (int i = 0; i < n; i++) {
+    double sum = 0.0;
+    for (int k = 0; k < n; k++)
+      sum += fabs(a[i][k]);
+    anorm = MAX(anorm, sum);
+  }
+
+#if defined(MKL)
+  dpocon(uplo, &n, &r[0][0], &n, &anorm, &rcond, work, iwork, &info);
+#elif defined(__ACCELERATE__)
+  dpocon_(uplo, &n, &r[0][0], &n, &anorm, &rcond, work, iwork, &info);
+#endif
+
+  return (info == 0 && rcond > MIN_RCOND);
+}
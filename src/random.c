@@ -28,11 +28,33 @@
  *
  *****************************************************************/
 
+#if defined(LIBRARY)
+// pthread mutexes are not part of C99
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#endif  // LIBRARY
+
 #include "potfit.h"
 
 #include "random_dsfmt.h"
 
-dsfmt_t g_dsfmt;
+POTFIT_TLS dsfmt_t g_dsfmt;
+
+// normdist() creates two numbers at once, the second one is kept here
+static POTFIT_TLS int g_have_number = 0;
+static POTFIT_TLS double g_nd2 = 0.0;
+
+#if defined(LIBRARY)
+// the seed array comes from rand(), which has one state for all contexts
+static pthread_mutex_t g_rand_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif  // LIBRARY
+
+// complete state of the generator, see get_rng_state()
+typedef struct {
+  dsfmt_t dsfmt;
+  int have_number;
+  double nd2;
+} rng_state_t;
 
 /****************************************************************
  *
@@ -56,11 +78,19 @@ void init_rng(int seed)
 {
   uint32_t* array = (uint32_t*)malloc(ARRAY_SIZE * sizeof(uint32_t));
 
+#if defined(LIBRARY)
+  pthread_mutex_lock(&g_rand_lock);
+#endif  // LIBRARY
+
   srand(seed);
 
   for (int i = 0; i < ARRAY_SIZE; i++)
     array[i] = rand();
 
+#if defined(LIBRARY)
+  pthread_mutex_unlock(&g_rand_lock);
+#endif  // LIBRARY
+
   dsfmt_init_by_array(&g_dsfmt, array, ARRAY_SIZE);
 
   for (int i = 0; i < 10e5; i++)
@@ -80,13 +110,11 @@ void init_rng(int seed)
 
 double normdist()
 {
-  static int have_number = 0;
-  static double nd2 = 0.0;
   double x1 = 0.0;
   double x2 = 0.0;
   double sqr = 0.0;
 
-  if (!have_number) {
+  if (!g_have_number) {
     do {
       x1 = 2.0 * eqdist() - 1.0;
       x2 = 2.0 * eqdist() - 1.0;
@@ -94,11 +122,39 @@ double normdist()
     } while (sqr >= 1.0 || sqr == 0);
     // Box Muller Transformation
     double cnst = sqrt(-2.0 * log(sqr) / sqr);
-    nd2 = x2 * cnst;
-    have_number = 1;
+    g_nd2 = x2 * cnst;
+    g_have_number = 1;
     return x1 * cnst;
   } else {
-    have_number = 0;
-    return nd2;
+    g_have_number = 0;
+    return g_nd2;
   }
 }
+
+/****************************************************************
+ *
+ *  get_rng_state / set_rng_state
+ *      copy the state of the pRNG to or from an opaque buffer
+ *      of rng_state_size() bytes, used for checkpoints
+ *
+ ****************************************************************/
+
+size_t rng_state_size() { return sizeof(rng_state_t); }
+
+void get_rng_state(void* buffer)
+{
+  rng_state_t* state = (rng_state_t*)buffer;
+
+  state->dsfmt = g_dsfmt;
+  state->have_number = g_have_number;
+  state->nd2 = g_nd2;
+}
+
+void set_rng_state(const void* buffer)
+{
+  const rng_state_t* state = (const rng_state_t*)buffer;
+
+  g_dsfmt = state->dsfmt;
+  g_have_number = state->have_number;
+  g_nd2 = state->nd2;
+}
@@ -35,4 +35,8 @@ void init_rng(int seed);
 double eqdist();
 double normdist();
 
+size_t rng_state_size();
+void get_rng_state(void* buffer);
+void set_rng_state(const void* buffer);
+
 #endif  // RANDOM_H_INCLUDED
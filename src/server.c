@@ -0,0 +1,324 @@
+/****************************************************************
+ *
+ * server.c: server mode, fitting jobs from a spool directory
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+// opendir and nanosleep are not part of C99
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include "potfit.h"
+
+#include "config.h"
+#include "force.h"
+#include "params.h"
+#include "potential_input.h"
+#include "random.h"
+#include "server.h"
+
+// seconds to wait before the spool directory is scanned again
+#define SERVER_POLL_INTERVAL 1
+
+int next_job(char* job, size_t len);
+void finish_job(char const* job, int status);
+
+// return point of error() while a job is running
+static jmp_buf g_server_jump;
+static int g_server_job = 0;
+
+// parameters which can be changed by a job file and the potential
+typedef struct {
+  potfit_parameters param;
+  potfit_filenames files;
+  double d_eps;
+#if defined(COULOMB)
+  double dp_cut;
+#endif  // COULOMB
+#if defined(DIPOLE)
+  double dp_tol;
+  double dp_mix;
+#endif  // DIPOLE
+  potfit_potentials pot;
+  char const** elements;
+  double* rcut;
+  double* rmin;
+#if !defined(APOT)
+  double* maxchange;
+#endif  // !APOT
+} server_state;
+
+void save_state(server_state* s);
+void restore_settings(server_state const* s);
+void restore_potential(server_state const* s);
+
+/****************************************************************
+  run_server
+
+  the configurations and neighbor lists are only set up once,
+  afterwards every file <name>.job in the spool directory is
+  processed in alphabetical order
+
+  a job file uses the syntax of the parameter file and overrides
+  the corresponding parameters, usually startpot, endpot and
+  output_prefix; ntypes and config cannot be changed, all other
+  parameters are reset to those of the parameter file afterwards
+
+  while a job is running it is renamed to <name>.running, after
+  it is finished to <name>.done or <name>.failed; errors in a job
+  only fail the job, the server keeps running
+
+  the server exits once there are no jobs left and a file named
+  stop exists in the spool directory
+
+  the optimizers keep some work vectors between jobs, so later jobs
+  can take a slightly different path than a separate potfit run
+****************************************************************/
+
+void run_server(void)
+{
+  char job[1024];
+
+#if defined(KIM)
+  error(1, "Server mode is not supported for KIM potentials.\n");
+#endif  // KIM
+
+  if (g_mpi.num_cpus * g_mpi.num_groups > 1)
+    error(1, "Server mode is not supported with more than one MPI process.\n");
+
+  printf("\nServer mode: waiting for jobs in %s\n", g_files.server_dir);
+  fflush(stdout);
+
+  server_state state;
+
+  while (next_job(job, sizeof(job))) {
+    printf("\nStarting job %s\n", job);
+
+    save_state(&state);
+
+    // error() jumps back here, the potential might be incomplete
+    if (setjmp(g_server_jump) != 0) {
+      restore_settings(&state);
+      restore_potential(&state);
+      finish_job(job, POTFIT_ERROR);
+      continue;
+    }
+
+    g_server_job = 1;
+
+    read_parameter_file(job);
+    check_parameters_complete(job);
+
+    int changed = g_param.ntypes != state.param.ntypes ||
+                  strcmp(g_files.config, state.files.config) != 0;
+#if defined(COULOMB)
+    changed = changed || g_config.dp_cut != state.dp_cut;
+#endif  // COULOMB
+
+    if (changed)
+      warning("Job %s changes the configurations, skipping it.\n", job);
+
+    if (changed || reload_pot_table(g_files.startpot) != POTFIT_SUCCESS) {
+      g_server_job = 0;
+      restore_settings(&state);
+      finish_job(job, POTFIT_ERROR);
+      continue;
+    }
+
+#if defined(APOT)
+    update_calc_table(g_pot.opt_pot.table, g_pot.calc_pot.table, 1);
+#endif  // APOT
+
+    init_force_common(0);
+    init_force(0);
+
+    g_calc.fcalls = 0;
+    init_rng(g_param.rng_seed);
+
+    fit_potential();
+
+    g_server_job = 0;
+
+    restore_settings(&state);
+    finish_job(job, POTFIT_SUCCESS);
+  }
+
+  printf("\nServer mode: stop file found, shutting down\n");
+}
+
+/****************************************************************
+  next_job
+
+  waits for the next job file and renames it to <name>.running
+  returns 0 if the server should shut down
+****************************************************************/
+
+int next_job(char* job, size_t len)
+{
+  char name[256];
+  char file[1024];
+
+  while (1) {
+    DIR* dir = opendir(g_files.server_dir);
+
+    if (dir == NULL)
+      error(1, "Could not open server directory %s\n", g_files.server_dir);
+
+    int stop = 0;
+    struct dirent* entry = NULL;
+
+    name[0] = '\0';
+
+    while ((entry = readdir(dir)) != NULL) {
+      size_t n = strlen(entry->d_name);
+      if (strcmp(entry->d_name, "stop") == 0)
+        stop = 1;
+      else if (n > 4 && strcmp(entry->d_name + n - 4, ".job") == 0 &&
+               (name[0] == '\0' || strcmp(entry->d_name, name) < 0))
+        snprintf(name, sizeof(name), "%s", entry->d_name);
+    }
+
+    closedir(dir);
+
+    if (name[0] != '\0') {
+      snprintf(file, sizeof(file), "%s/%s", g_files.server_dir, name);
+      snprintf(job, len, "%s/%.*s.running", g_files.server_dir,
+               (int)(strlen(name) - 4), name);
+      // the job might have been removed in the meantime
+      if (rename(file, job) == 0)
+        return 1;
+      continue;
+    }
+
+    if (stop) {
+      snprintf(file, sizeof(file), "%s/stop", g_files.server_dir);
+      remove(file);
+      return 0;
+    }
+
+    struct timespec ts = {SERVER_POLL_INTERVAL, 0};
+    nanosleep(&ts, NULL);
+  }
+}
+
+/****************************************************************
+  finish_job
+****************************************************************/
+
+void finish_job(char const* job, int status)
+{
+  char file[1024];
+  const size_t n = strlen(job) - strlen(".running");
+
+  snprintf(file, sizeof(file), "%.*s.%s", (int)n, job,
+           status == POTFIT_SUCCESS ? "done" : "failed");
+
+  if (rename(job, file) != 0)
+    warning("Could not rename %s to %s\n", job, file);
+
+  printf("\nJob %s finished\n", file);
+  fflush(stdout);
+}
+
+/****************************************************************
+  server_error
+    called by error(), fails the running job instead of potfit
+****************************************************************/
+
+void server_error(void)
+{
+  if (!g_server_job)
+    return;
+
+  g_server_job = 0;
+  longjmp(g_server_jump, 1);
+}
+
+/****************************************************************
+  save_state
+****************************************************************/
+
+void save_state(server_state* s)
+{
+  s->param = g_param;
+  s->files = g_files;
+  s->d_eps = g_calc.d_eps;
+#if defined(COULOMB)
+  s->dp_cut = g_config.dp_cut;
+#endif  // COULOMB
+#if defined(DIPOLE)
+  s->dp_tol = g_config.dp_tol;
+  s->dp_mix = g_config.dp_mix;
+#endif  // DIPOLE
+  s->pot = g_pot;
+  s->elements = g_config.elements;
+  s->rcut = g_config.rcut;
+  s->rmin = g_config.rmin;
+#if !defined(APOT)
+  s->maxchange = g_calc.maxchange;
+#endif  // !APOT
+}
+
+/****************************************************************
+  restore_settings
+    resets the parameters changed by a job file
+****************************************************************/
+
+void restore_settings(server_state const* s)
+{
+  g_param = s->param;
+  g_files = s->files;
+  g_calc.d_eps = s->d_eps;
+#if defined(COULOMB)
+  g_config.dp_cut = s->dp_cut;
+#endif  // COULOMB
+#if defined(DIPOLE)
+  g_config.dp_tol = s->dp_tol;
+  g_config.dp_mix = s->dp_mix;
+#endif  // DIPOLE
+}
+
+/****************************************************************
+  restore_potential
+    goes back to the potential before a failed job, the tables of
+    the old potential are not freed by reload_pot_table
+****************************************************************/
+
+void restore_potential(server_state const* s)
+{
+  g_pot = s->pot;
+  g_config.elements = s->elements;
+  g_config.rcut = s->rcut;
+  g_config.rmin = s->rmin;
+#if defined(APOT) && !defined(KIM)
+  update_slots();
+#elif !defined(APOT)
+  g_calc.maxchange = s->maxchange;
+#endif  // APOT
+}
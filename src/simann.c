@@ -29,27 +29,33 @@
 
 #include "potfit.h"
 
-#if !defined(EVO)
+#if !defined(EVO) && !defined(CMAES)
 
 #include <ctype.h>
 
+#include "checkpoint.h"
 #include "force.h"
 #include "memory.h"
 #include "optimize.h"
 #include "potential_input.h"
-#include "potential_output.h"
 #include "random.h"
 #include "rescale.h"
+#include "surrogate.h"
+#include "tempfile.h"
 #include "utils.h"
 
 #define EPS 0.1
 #define NEPS 4
-#define NSTEP 20
-#define NTEMP (3 * g_calc.ndim)
 #define STEPVAR 2.0
-#define TEMPVAR 0.85
 #define KMAX 1000
 
+/* bounds of the adaptive cooling factor */
+#define COOL_MIN 0.5
+#define COOL_MAX 0.99
+/* acceptance ratios outside of this range cool with COOL_MIN */
+#define ACCEPT_MIN 0.01
+#define ACCEPT_MAX 0.9
+
 #define ONE_OVER_SQRT_2_PI 0.39894228040143267794
 #define GAUSS(a) (ONE_OVER_SQRT_2_PI * (exp(-((a) * (a)) / 2.0)))
 
@@ -156,6 +162,8 @@ double get_annealing_temperature(const double* xi, double* xi_new,
 
       double F_new = calc_forces(xi_new, forces, 0);
 
+      surrogate_add(xi_new, F_new);
+
       if (F_new <= F) {
         m1++;
       } else {
@@ -185,6 +193,57 @@ double get_annealing_temperature(const double* xi, double* xi_new,
   return T;
 }
 
+/****************************************************************
+ *
+ * cost statistics of the visited states (Welford)
+ *
+ ****************************************************************/
+
+typedef struct {
+  int n;
+  double mean;
+  double m2;
+} cost_stats_t;
+
+static void cost_stats_add(cost_stats_t* s, const double F)
+{
+  const double d = F - s->mean;
+
+  s->n++;
+  s->mean += d / s->n;
+  s->m2 += d * (F - s->mean);
+}
+
+static double cost_stats_var(const cost_stats_t* s)
+{
+  return s->n > 1 ? s->m2 / (s->n - 1) : 0.0;
+}
+
+/****************************************************************
+ *
+ * double adaptive_cooling
+ *      const double T:         current temperature
+ *      const double sigma:     standard deviation of the cost at T
+ *      const double accept:    acceptance ratio at T
+ *
+ * Cooling factor of the adaptive schedule (Huang et al.): T is
+ * lowered by exp(-lambda * T / sigma), slowly while the cost still
+ * fluctuates strongly at T. If almost every or almost no step was
+ * accepted, the temperature is lowered fast.
+ *
+ ****************************************************************/
+
+static double adaptive_cooling(const double T, const double sigma,
+                               const double accept)
+{
+  if (accept < ACCEPT_MIN || accept > ACCEPT_MAX || sigma <= 0.0)
+    return COOL_MIN;
+
+  const double factor = exp(-g_param.anneal_adaptive * T / sigma);
+
+  return MAX(COOL_MIN, MIN(COOL_MAX, factor));
+}
+
 #if defined(MEAM) && !defined(APOT)
 
 /****************************************************************
@@ -269,6 +328,13 @@ void restore_pot_data(const pot_data_t* pot_data)
  * Anneals a vector xi to minimize a function F(xi).
  * Algorithm according to Corana et al.
  *
+ * With anneal_adaptive a temperature ends once the mean cost of two
+ * successive step adjustment periods agrees within its standard error
+ * and is lowered by adaptive_cooling(). anneal_stagnation stops after
+ * that many temperatures without improvement of the optimum and
+ * anneal_freeze stops varying parameters whose acceptance ratio was 0
+ * or 1 in that many successive step adjustments.
+ *
  ****************************************************************/
 
 void run_simulated_annealing(double* const xi)
@@ -276,6 +342,10 @@ void run_simulated_annealing(double* const xi)
   int loop_counter = 0;
   int loop_again = 0;
 
+  const int nstep = g_param.anneal_nstep;
+  const int ntemp =
+      g_param.anneal_ntemp > 0 ? g_param.anneal_ntemp : 3 * g_calc.ndim;
+
 #if defined(RESCALE) && !defined(APOT) && \
     (defined(EAM) || defined(ADP) || defined(MEAM))
   int do_rescale = 1;
@@ -305,6 +375,15 @@ void run_simulated_annealing(double* const xi)
   /* number of accepted changes in dir */
   int* naccept = (int*)Malloc(g_calc.ndim * sizeof(int));
 
+  /* successive saturated step adjustments and frozen parameters */
+  int* saturated = (int*)Malloc(g_calc.ndim * sizeof(int));
+  int* frozen = (int*)Malloc(g_calc.ndim * sizeof(int));
+  int nfrozen = 0;
+
+  /* temperatures without improvement of F_stag */
+  int stagnation = 0;
+  double F_stag = 0.0;
+
   /* init displacement vector */
   for (int i = 0; i < g_calc.ndim; i++)
     v[i] = 0.1;
@@ -312,40 +391,116 @@ void run_simulated_annealing(double* const xi)
   memcpy(xi_new, xi, g_calc.ndimtot * sizeof(double));
   memcpy(xi_opt, xi, g_calc.ndimtot * sizeof(double));
 
-  F = calc_forces(xi, forces, 0);
+  /* Temperature */
+  double T = 0.0;
+
+  surrogate_init();
+
+  if (restart_stage(CHECKPOINT_SIMANN)) {
+    restart_get("loop_counter", &loop_counter, sizeof(int));
+    restart_get("T", &T, sizeof(double));
+    restart_get("F", &F, sizeof(double));
+    restart_get("F_opt", &F_opt, sizeof(double));
+    restart_get("F_old", F_old, NEPS * sizeof(double));
+    restart_get("v", v, g_calc.ndim * sizeof(double));
+    restart_get("xi", xi, g_calc.ndimtot * sizeof(double));
+    restart_get("xi_opt", xi_opt, g_calc.ndimtot * sizeof(double));
+
+    if (g_param.anneal_stagnation > 0) {
+      restart_get("stagnation", &stagnation, sizeof(int));
+      restart_get("F_stag", &F_stag, sizeof(double));
+    }
+
+    if (g_param.anneal_freeze > 0) {
+      restart_get("saturated", saturated, g_calc.ndim * sizeof(int));
+      restart_get("frozen", frozen, g_calc.ndim * sizeof(int));
 
-  F_opt = F;
+      for (int n = 0; n < g_calc.ndim; n++)
+        nfrozen += frozen[n];
+    }
 
-  /* Temperature */
-  double T = get_annealing_temperature(xi, xi_new, forces, v, F);
+#if defined(MEAM) && !defined(APOT)
+    store_pot_data(&pot_data);
+    restart_get("pot_begin", pot_data.begin, g_param.ntypes * sizeof(double));
+    restart_get("pot_end", pot_data.end, g_param.ntypes * sizeof(double));
+    restart_get("pot_step", pot_data.step, g_param.ntypes * sizeof(double));
+    restart_get("pot_invstep", pot_data.invstep,
+                g_param.ntypes * sizeof(double));
+    restart_get("pot_xcoord", pot_data.xcoord,
+                g_calc.ndimtot * sizeof(double));
+#endif  // MEAM && !APOT
+
+#if defined(RESCALE) && !defined(APOT) && \
+    (defined(EAM) || defined(ADP) || defined(MEAM))
+    restart_get("do_rescale", &do_rescale, sizeof(int));
+#endif  // RESCALE && !APOT && (EAM || ADP || MEAM)
+
+    printf("  k\tT        \t  m\tF          \tF_opt\n");
+    fflush(stdout);
+  } else {
+    F = calc_forces(xi, forces, 0);
+
+    surrogate_add(xi, F);
+
+    F_opt = F;
+    F_stag = F;
+
+    T = get_annealing_temperature(xi, xi_new, forces, v, F);
 
-  /* don't anneal if starttemp equal zero */
-  if (T == 0.0)
-    return;
+    /* don't anneal if starttemp equal zero */
+    if (T == 0.0)
+      return;
 
 #if defined(MEAM) && !defined(APOT)
-  store_pot_data(&pot_data);
+    store_pot_data(&pot_data);
 #endif // MEAM && !APOT
 
-  printf("  k\tT        \t  m\tF          \tF_opt\n");
-  printf("%3d\t%f\t%3d\t%f\t%f\n", 0, T, 0, F, F_opt);
-  fflush(stdout);
+    printf("  k\tT        \t  m\tF          \tF_opt\n");
+    printf("%3d\t%f\t%3d\t%f\t%f\n", 0, T, 0, F, F_opt);
+    fflush(stdout);
 
-  for (int n = 0; n < NEPS; n++)
-    F_old[n] = F;
+    for (int n = 0; n < NEPS; n++)
+      F_old[n] = F;
+  }
 
   /* annealing loop */
   do {
-    for (int m = 0; m < NTEMP; m++) {
-      for (int j = 0; j < NSTEP; j++) {
+    /* cost at this temperature and in the current step adjustment period */
+    cost_stats_t temp_stats = {0, 0.0, 0.0};
+    cost_stats_t period_stats = {0, 0.0, 0.0};
+    double last_mean = 0.0;
+    int accepted = 0;
+
+    for (int m = 0; m < ntemp; m++) {
+      int equilibrium = 0;
+
+      for (int j = 0; j < nstep; j++) {
         for (int h = 0; h < g_calc.ndim; h++) {
+          if (frozen[h])
+            continue;
+
           /* Step #1 */
           memcpy(xi_new, xi, g_calc.ndimtot * sizeof(double));
 
           randomize_parameter(h, xi_new, v);
 
+          /* the Metropolis threshold is drawn in advance for the model */
+          double F_max = 0.0;
+
+          if (g_param.surrogate > 0) {
+            F_max = F - T * log(eqdist());
+
+            if (!surrogate_screen(xi_new, F_max)) {
+              cost_stats_add(&temp_stats, F);
+              cost_stats_add(&period_stats, F);
+              continue;
+            }
+          }
+
           F_new = calc_forces(xi_new, forces, 0);
 
+          surrogate_add(xi_new, F_new);
+
           /* accept new point */
           if (F_new <= F) {
 #if defined(APOT)
@@ -366,50 +521,70 @@ void run_simulated_annealing(double* const xi)
 
               F_opt = F_new;
 
-              if (g_files.tempfile && strlen(g_files.tempfile)) {
-#if defined(APOT)
-                update_apot_table(xi);
-#endif
-                write_pot_table_potfit(g_files.tempfile);
-              }
+              update_tempfile(xi_opt);
             }
-          } else if (eqdist() < (exp((F - F_new) / T))) {
+          } else if (g_param.surrogate > 0 ? F_new < F_max
+                                           : eqdist() < (exp((F - F_new) / T))) {
             memcpy(xi, xi_new, g_calc.ndimtot * sizeof(double));
             F = F_new;
             naccept[h]++;
           }
+
+          cost_stats_add(&temp_stats, F);
+          cost_stats_add(&period_stats, F);
         }  // loop over parameters
       }    // steps per temperature
 
       /* Step adjustment */
       for (int n = 0; n < g_calc.ndim; n++) {
-        if (naccept[n] > (0.6 * NSTEP))
-          v[n] *= (1 + STEPVAR * ((double)naccept[n] / NSTEP - 0.6) / 0.4);
-        else if (naccept[n] < (0.4 * NSTEP))
-          v[n] /= (1 + STEPVAR * (0.4 - (double)naccept[n] / NSTEP) / 0.4);
+        if (frozen[n])
+          continue;
+
+        accepted += naccept[n];
+
+        /* freeze parameters which are always or never accepted */
+        if (g_param.anneal_freeze > 0) {
+          if (naccept[n] == 0 || naccept[n] == nstep) {
+            if (++saturated[n] >= g_param.anneal_freeze) {
+              frozen[n] = 1;
+              nfrozen++;
+            }
+          } else {
+            saturated[n] = 0;
+          }
+        }
+
+        if (naccept[n] > (0.6 * nstep))
+          v[n] *= (1 + STEPVAR * ((double)naccept[n] / nstep - 0.6) / 0.4);
+        else if (naccept[n] < (0.4 * nstep))
+          v[n] /= (1 + STEPVAR * (0.4 - (double)naccept[n] / nstep) / 0.4);
         naccept[n] = 0;
       }
 
+      /* equilibrium if the mean cost did not change within its error */
+      if (g_param.anneal_adaptive > 0.0) {
+        const double err = sqrt(cost_stats_var(&period_stats) / period_stats.n);
+
+        equilibrium = (m > 0) && (fabs(period_stats.mean - last_mean) <= err);
+        last_mean = period_stats.mean;
+        memset(&period_stats, 0, sizeof(cost_stats_t));
+      }
+
       printf("%3d\t%f\t%3d\t%f\t%f\n", loop_counter, T, m + 1, F, F_opt);
       fflush(stdout);
 
       /* End annealing if break flagfile exists */
-      if (g_files.flagfile && strlen(g_files.flagfile)) {
-        FILE* ff = fopen(g_files.flagfile, "r");
-        if (NULL != ff) {
-          printf("Annealing terminated in presence of break flagfile \"%s\"!\n",
-                 g_files.flagfile);
-          printf("Temperature was %f, returning optimum configuration\n", T);
-
-          for (int n = 0; n < g_calc.ndimtot; n++)
-            xi[n] = xi_opt[n];
-
-          F = F_opt;
-          loop_counter = KMAX + 1;
-          fclose(ff);
-          remove(g_files.flagfile);
-          break;
-        }
+      if (break_flagfile()) {
+        printf("Annealing terminated in presence of break flagfile \"%s\"!\n",
+               g_files.flagfile);
+        printf("Temperature was %f, returning optimum configuration\n", T);
+
+        for (int n = 0; n < g_calc.ndimtot; n++)
+          xi[n] = xi_opt[n];
+
+        F = F_opt;
+        loop_counter = KMAX + 1;
+        break;
       }
 
 #if defined(RESCALE) && !defined(APOT) && \
@@ -422,13 +597,21 @@ void run_simulated_annealing(double* const xi)
           printf("F before rescale = %f\n", F);
           F = calc_forces(xi, forces, 2);
           printf("F after rescale = %f\n", F);
+          surrogate_reset();
         }
       }
 #endif  // RESCALE && !APOT && ( EAM || ADP || MEAM )
+
+      if (equilibrium || nfrozen == g_calc.ndim)
+        break;
     }
 
     /*Temp adjustment */
-    T *= TEMPVAR;
+    if (g_param.anneal_adaptive > 0.0 && temp_stats.n > 0)
+      T *= adaptive_cooling(T, sqrt(cost_stats_var(&temp_stats)),
+                            (double)accepted / temp_stats.n);
+    else
+      T *= g_param.anneal_cooling;
     loop_counter++;
 
     for (int i = 0; i < NEPS - 1; i++)
@@ -465,6 +648,58 @@ void run_simulated_annealing(double* const xi)
 
       loop_again = 1;
     }
+
+    if (g_param.anneal_stagnation > 0) {
+      if ((F_stag - F_opt) > (EPS * F_stag * 0.01)) {
+        F_stag = F_opt;
+        stagnation = 0;
+      } else if (++stagnation >= g_param.anneal_stagnation) {
+        printf("Annealing stopped, no improvement in %d temperatures.\n",
+               stagnation);
+        loop_again = 0;
+      }
+    }
+
+    if (nfrozen == g_calc.ndim) {
+      printf("Annealing stopped, all parameters are frozen.\n");
+      loop_again = 0;
+    }
+
+    /* save the state after this temperature for a restart */
+    if (loop_counter < KMAX && loop_again && checkpoint_due()) {
+      checkpoint_begin(CHECKPOINT_SIMANN);
+      checkpoint_add("loop_counter", &loop_counter, sizeof(int));
+      checkpoint_add("T", &T, sizeof(double));
+      checkpoint_add("F", &F, sizeof(double));
+      checkpoint_add("F_opt", &F_opt, sizeof(double));
+      checkpoint_add("F_old", F_old, NEPS * sizeof(double));
+      checkpoint_add("v", v, g_calc.ndim * sizeof(double));
+      checkpoint_add("xi", xi, g_calc.ndimtot * sizeof(double));
+      checkpoint_add("xi_opt", xi_opt, g_calc.ndimtot * sizeof(double));
+      checkpoint_add("stagnation", &stagnation, sizeof(int));
+      checkpoint_add("F_stag", &F_stag, sizeof(double));
+      checkpoint_add("saturated", saturated, g_calc.ndim * sizeof(int));
+      checkpoint_add("frozen", frozen, g_calc.ndim * sizeof(int));
+
+#if defined(MEAM) && !defined(APOT)
+      checkpoint_add("pot_begin", pot_data.begin,
+                     g_param.ntypes * sizeof(double));
+      checkpoint_add("pot_end", pot_data.end, g_param.ntypes * sizeof(double));
+      checkpoint_add("pot_step", pot_data.step,
+                     g_param.ntypes * sizeof(double));
+      checkpoint_add("pot_invstep", pot_data.invstep,
+                     g_param.ntypes * sizeof(double));
+      checkpoint_add("pot_xcoord", pot_data.xcoord,
+                     g_calc.ndimtot * sizeof(double));
+#endif  // MEAM && !APOT
+
+#if defined(RESCALE) && !defined(APOT) && \
+    (defined(EAM) || defined(ADP) || defined(MEAM))
+      checkpoint_add("do_rescale", &do_rescale, sizeof(int));
+#endif  // RESCALE && !APOT && (EAM || ADP || MEAM)
+
+      checkpoint_commit();
+    }
   } while (loop_counter < KMAX && loop_again);
 
   memcpy(xi, xi_opt, g_calc.ndimtot * sizeof(double));
@@ -475,14 +710,13 @@ void run_simulated_annealing(double* const xi)
   // wake other threads and sync potentials
   F = calc_forces(xi, forces, 2);
 #endif  // MEAM && !APOT
+  if (nfrozen > 0)
+    printf("%d of %d parameters were frozen.\n", nfrozen, g_calc.ndim);
+  surrogate_report();
   printf("Finished annealing, starting powell minimization ...\n");
 
-  if (g_files.tempfile && strlen(g_files.tempfile)) {
-#if defined(APOT)
-    update_apot_table(xi_opt);
-#endif  // APOT
-    write_pot_table_potfit(g_files.tempfile);
-  }
+  update_tempfile(xi_opt);
+  flush_tempfile();
 }
 
-#endif  // !EVO
+#endif  // !EVO && !CMAES
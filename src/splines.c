@@ -45,8 +45,8 @@ void spline_ed(double xstep, double* y, int n, double yp1, double ypn,
 {
   double qn = 0.0;
   double un = 0.0;
-  static double* u = NULL;
-  static int nmax = 0;
+  static POTFIT_TLS double* u = NULL;
+  static POTFIT_TLS int nmax = 0;
 
   if (n > nmax) {
     u = (double*)Realloc(u, (n - 1) * sizeof(double));
@@ -254,6 +254,30 @@ double splint_grad_dir(pot_table_t* pt, double* xi, int k, double b,
          ((3 * (b * b) - 1) * d22 - (3 * (a * a) - 1) * d21) * step / 6.0;
 }
 
+/****************************************************************
+ *
+ * spline_coeff: packs the spline of column col into one set of cubic
+ *            coefficients per interval (equidistant and NON-eqd. x[i])
+ *            requires up-to-date second derivatives in d2tab
+ *
+ ****************************************************************/
+
+void spline_coeff(pot_table_t* pt, double* xi, int col)
+{
+  for (int k = pt->first[col]; k < pt->last[col]; k++) {
+    double h = (g_pot.format_type == POTENTIAL_FORMAT_TABULATED_NON_EQ_DIST)
+                   ? pt->xcoord[k + 1] - pt->xcoord[k]
+                   : pt->step[col];
+    double h26 = h * h / 6.0;
+    double* c = pt->coeff + 4 * k;
+
+    c[0] = xi[k];
+    c[1] = xi[k + 1] - xi[k] - h26 * (2.0 * pt->d2tab[k] + pt->d2tab[k + 1]);
+    c[2] = 3.0 * h26 * pt->d2tab[k];
+    c[3] = h26 * (pt->d2tab[k + 1] - pt->d2tab[k]);
+  }
+}
+
 /****************************************************************
  *
  * spline_ne  : initializes second derivatives used for spline interpolation
@@ -265,8 +289,8 @@ void spline_ne(double* x, double* y, int n, double yp1, double ypn, double* y2)
 {
   double qn = 0.0;
   double un = 0.0;
-  static double* u = NULL;
-  static int nmax = 0;
+  static POTFIT_TLS double* u = NULL;
+  static POTFIT_TLS int nmax = 0;
 
   if (n > nmax) {
     u = (double*)Realloc(u, (n - 1) * sizeof(double));
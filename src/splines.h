@@ -42,5 +42,40 @@ double splint_ne(pot_table_t*, double*, int, double);
 double splint_ne_lin(pot_table_t*, double*, int, double);
 double splint_comb_ne(pot_table_t*, double*, int, double, double*);
 double splint_grad_ne(pot_table_t*, double*, int, double);
+void spline_coeff(pot_table_t*, double*, int);
+
+/****************************************************************
+ *
+ * splint_coeff, splint_comb_coeff, splint_grad_coeff:
+ *     same as the *_dir functions, but evaluated from the packed
+ *     interval coefficients set up by spline_coeff
+ *     f(b) = c0 + b * (c1 + b * (c2 + b * c3)),  b = shift
+ *
+ ****************************************************************/
+
+static inline double splint_coeff(pot_table_t* pt, int k, double b)
+{
+  const double* c = pt->coeff + 4 * k;
+
+  return c[0] + b * (c[1] + b * (c[2] + b * c[3]));
+}
+
+static inline double splint_comb_coeff(pot_table_t* pt, int k, double b,
+                                       double step, double* grad)
+{
+  const double* c = pt->coeff + 4 * k;
+
+  *grad = (c[1] + b * (2.0 * c[2] + 3.0 * b * c[3])) / step;
+
+  return c[0] + b * (c[1] + b * (c[2] + b * c[3]));
+}
+
+static inline double splint_grad_coeff(pot_table_t* pt, int k, double b,
+                                       double step)
+{
+  const double* c = pt->coeff + 4 * k;
+
+  return (c[1] + b * (2.0 * c[2] + 3.0 * b * c[3])) / step;
+}
 
 #endif  // SPLINES_H_INCLUDED
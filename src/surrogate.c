@@ -0,0 +1,431 @@
+/****************************************************************
+ *
+ * surrogate.c: radial basis function model of the error sum to
+ *	pre-screen candidates of the global optimizers
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+
+/****************************************************************
+ *
+ *  The last g_param.surrogate calculated candidates are kept in a
+ *  ring buffer. The logarithm of the error sum of a candidate is
+ *  predicted by a cubic radial basis function interpolation of its
+ *  2 (ndim + 1) nearest samples with a linear tail, limited to the
+ *  range of these samples. Analytic parameters are scaled to [0, 1]
+ *  by their bounds, tabulated ones are used directly.
+ *
+ *  A candidate is not calculated if its prediction minus MARGIN times
+ *  the running mean of the absolute prediction error is above the
+ *  bound the optimizer would accept. Every CONTROL-th of these
+ *  candidates is calculated anyway to keep track of wrong rejections.
+ *
+ ****************************************************************/
+
+#include "potfit.h"
+
+#if defined(MKL)
+#include <mkl_lapack.h>
+#elif defined(__ACCELERATE__)
+#include <Accelerate/Accelerate.h>
+#else
+#error No math library defined!
+#endif  // MKL
+
+#include "checkpoint.h"
+#include "memory.h"
+#include "surrogate.h"
+#include "utils.h"
+
+#define MARGIN 2.0        /* prediction errors a candidate has to be above */
+#define CONTROL 10        /* every CONTROL-th rejection is calculated */
+#define WARMUP 10         /* predictions compared before the first rejection */
+#define ERR_DECAY 0.1     /* weight of a new error in the running mean */
+#define RIDGE 1.0e-10     /* regularization of the interpolation system */
+#define MIN_COST 1.0e-100 /* smaller error sums are not resolved */
+#define MAX_COST 1.0e10   /* larger error sums mark failed calculations */
+
+// statistics, stored in front of the archive for checkpoints
+enum {
+  S_COUNT,     /* samples in the archive */
+  S_NEXT,      /* ring buffer position of the next sample */
+  S_SCREENED,  /* candidates with a prediction */
+  S_SKIPPED,   /* candidates which were not calculated */
+  S_CONTROLS,  /* rejected candidates which were calculated */
+  S_WRONG,     /* control candidates which beat their bound */
+  S_COMPARED,  /* predictions compared to a calculation */
+  S_ERR,       /* running mean of the absolute prediction error */
+  S_ERR_TOTAL, /* sum of all absolute prediction errors */
+  S_NUM
+};
+
+typedef struct {
+  int active; /* enabled for the current optimizer run */
+  int size;   /* capacity of the archive */
+  int k;      /* maximum number of neighbors */
+  double* state;
+  double* x; /* scaled samples, one per row */
+  double* f; /* logarithm of their error sums */
+
+  // the last prediction, compared in surrogate_add()
+  int predicted;
+  int control;
+  double prediction; /* logarithm of the error sum */
+  double bound;
+
+  // scratch arrays
+  double* query;
+  double* dist;
+  int* neigh;
+  double* lsq;
+  double* rhs;
+  double* work;
+  int* ipiv;
+} surrogate_t;
+
+static POTFIT_TLS surrogate_t g_sur = {0, };
+
+void surrogate_scale(const double* xi, double* y);
+int surrogate_predict(double* prediction);
+
+/****************************************************************
+ *
+ *  scale the free parameters of xi
+ *
+ ****************************************************************/
+
+void surrogate_scale(const double* xi, double* y)
+{
+  for (int j = 0; j < g_calc.ndim; j++) {
+#if defined(APOT)
+    const double pmin = g_pot.apot_table.pmin[g_pot.apot_table.idxpot[j]]
+                                             [g_pot.apot_table.idxparam[j]];
+    const double pmax = g_pot.apot_table.pmax[g_pot.apot_table.idxpot[j]]
+                                             [g_pot.apot_table.idxparam[j]];
+
+    y[j] = (xi[g_pot.opt_pot.idx[j]] - pmin) / (pmax - pmin);
+#else
+    y[j] = xi[g_pot.opt_pot.idx[j]];
+#endif  // APOT
+  }
+}
+
+/****************************************************************
+ *
+ *  predict the error sum at g_sur.query, returns 0 on failure
+ *
+ ****************************************************************/
+
+int surrogate_predict(double* prediction)
+{
+  const int n = g_calc.ndim;
+  const int count = (int)g_sur.state[S_COUNT];
+  const int k = MIN(count, g_sur.k);
+
+  if (count < n + 2)
+    return 0;
+
+  // sorted list of the k nearest samples
+  int num = 0;
+
+  for (int i = 0; i < count; i++) {
+    double d = 0.0;
+
+    for (int j = 0; j < n; j++)
+      d += dsquare(g_sur.x[i * n + j] - g_sur.query[j]);
+
+    if (num == k && d >= g_sur.dist[k - 1])
+      continue;
+
+    int pos = (num < k) ? num++ : k - 1;
+
+    while (pos > 0 && g_sur.dist[pos - 1] > d) {
+      g_sur.dist[pos] = g_sur.dist[pos - 1];
+      g_sur.neigh[pos] = g_sur.neigh[pos - 1];
+      pos--;
+    }
+
+    g_sur.dist[pos] = d;
+    g_sur.neigh[pos] = i;
+  }
+
+  // distances are scaled by the farthest neighbor
+  const double r = sqrt(g_sur.dist[k - 1]);
+
+  if (r == 0.0)
+    return 0;
+
+  // symmetric system [ Phi P ; P^T 0 ] with P = (1, x_i - query) / r,
+  // the polynomial block is regularized for samples in a subspace
+  int m = k + n + 1;
+  double* a = g_sur.lsq;
+
+  memset(a, 0, m * m * sizeof(double));
+
+  for (int i = 0; i < k; i++) {
+    const double* xi = g_sur.x + g_sur.neigh[i] * n;
+
+    for (int l = 0; l <= i; l++) {
+      const double* xl = g_sur.x + g_sur.neigh[l] * n;
+      double d = 0.0;
+
+      for (int j = 0; j < n; j++)
+        d += dsquare(xi[j] - xl[j]);
+
+      d = sqrt(d) / r;
+      a[i * m + l] = a[l * m + i] = d * d * d;
+    }
+
+    a[i * m + i] += RIDGE;
+    a[i * m + k] = a[k * m + i] = 1.0;
+
+    for (int j = 0; j < n; j++)
+      a[i * m + k + 1 + j] = a[(k + 1 + j) * m + i] =
+          (xi[j] - g_sur.query[j]) / r;
+
+    g_sur.rhs[i] = g_sur.f[g_sur.neigh[i]];
+  }
+
+  for (int i = k; i < m; i++) {
+    a[i * m + i] = -RIDGE;
+    g_sur.rhs[i] = 0.0;
+  }
+
+  char uplo[1] = "U";
+  int nrhs = 1;
+  int lwork = 64 * (g_sur.k + n + 1);
+  int info = 0;
+
+#if defined(MKL)
+  dsysv(uplo, &m, &nrhs, a, &m, g_sur.ipiv, g_sur.rhs, &m, g_sur.work, &lwork,
+        &info);
+#elif defined(__ACCELERATE__)
+  dsysv_(uplo, &m, &nrhs, a, &m, g_sur.ipiv, g_sur.rhs, &m, g_sur.work, &lwork,
+         &info);
+#endif  // MKL
+
+  if (info != 0)
+    return 0;
+
+  // the query is the origin of the tail, the kernel sum is added
+  double p = g_sur.rhs[k];
+  double fmin = g_sur.f[g_sur.neigh[0]];
+  double fmax = fmin;
+
+  for (int i = 0; i < k; i++) {
+    const double d = sqrt(g_sur.dist[i]) / r;
+    p += g_sur.rhs[i] * d * d * d;
+    fmin = MIN(fmin, g_sur.f[g_sur.neigh[i]]);
+    fmax = MAX(fmax, g_sur.f[g_sur.neigh[i]]);
+  }
+
+  if (isnan(p))
+    return 0;
+
+  // the interpolation overshoots next to steep walls
+  *prediction = MIN(MAX(p, fmin), fmax);
+
+  return 1;
+}
+
+/****************************************************************
+ *
+ *  surrogate_init
+ *
+ ****************************************************************/
+
+void surrogate_init(void)
+{
+  // a server job without surrogate keeps the archive of an earlier job
+  g_sur.active = (g_param.surrogate > 0);
+
+  if (!g_sur.active)
+    return;
+
+  const int n = g_calc.ndim;
+  const size_t length = S_NUM + g_param.surrogate * (n + 1);
+
+  // every optimizer run starts with an empty archive
+  g_sur.predicted = 0;
+  g_sur.control = 0;
+
+  if (g_sur.state != NULL && g_sur.size == g_param.surrogate &&
+      g_sur.k == 2 * (n + 1)) {
+    memset(g_sur.state, 0, length * sizeof(double));
+    return;
+  }
+
+  g_sur.size = g_param.surrogate;
+  g_sur.k = 2 * (n + 1);
+
+  g_sur.state = (double*)Realloc(g_sur.state, length * sizeof(double));
+  g_sur.x = g_sur.state + S_NUM;
+  g_sur.f = g_sur.x + g_sur.size * n;
+
+  memset(g_sur.state, 0, length * sizeof(double));
+
+  g_sur.query = (double*)Realloc(g_sur.query, n * sizeof(double));
+  g_sur.dist = (double*)Realloc(g_sur.dist, g_sur.k * sizeof(double));
+  g_sur.neigh = (int*)Realloc(g_sur.neigh, g_sur.k * sizeof(int));
+  g_sur.lsq =
+      (double*)Realloc(g_sur.lsq, dsquare(g_sur.k + n + 1) * sizeof(double));
+  g_sur.rhs = (double*)Realloc(g_sur.rhs, (g_sur.k + n + 1) * sizeof(double));
+  g_sur.work =
+      (double*)Realloc(g_sur.work, 64 * (g_sur.k + n + 1) * sizeof(double));
+  g_sur.ipiv = (int*)Realloc(g_sur.ipiv, (g_sur.k + n + 1) * sizeof(int));
+
+  // a restart continues with the same archive
+  checkpoint_register("surrogate", g_sur.state, length * sizeof(double));
+}
+
+/****************************************************************
+ *
+ *  surrogate_screen
+ *
+ ****************************************************************/
+
+int surrogate_screen(const double* xi, double bound)
+{
+  g_sur.predicted = 0;
+  g_sur.control = 0;
+
+  if (!g_sur.active)
+    return 1;
+
+  surrogate_scale(xi, g_sur.query);
+
+  if (!surrogate_predict(&g_sur.prediction))
+    return 1;
+
+  g_sur.predicted = 1;
+  g_sur.bound = bound;
+  g_sur.state[S_SCREENED]++;
+
+  if (g_sur.state[S_COMPARED] < WARMUP)
+    return 1;
+
+  if (g_sur.prediction - MARGIN * g_sur.state[S_ERR] <=
+      log(MAX(bound, MIN_COST)))
+    return 1;
+
+  if ((int)(g_sur.state[S_SKIPPED] + g_sur.state[S_CONTROLS] + 1) % CONTROL ==
+      0) {
+    g_sur.state[S_CONTROLS]++;
+    g_sur.control = 1;
+    return 1;
+  }
+
+  g_sur.state[S_SKIPPED]++;
+
+  return 0;
+}
+
+/****************************************************************
+ *
+ *  surrogate_add
+ *
+ ****************************************************************/
+
+void surrogate_add(const double* xi, double cost)
+{
+  if (!g_sur.active)
+    return;
+
+  const int n = g_calc.ndim;
+  double* s = g_sur.state;
+
+  // failed calculations would distort the model
+  if (isnan(cost) || cost >= MAX_COST) {
+    g_sur.predicted = 0;
+    g_sur.control = 0;
+    return;
+  }
+
+  if (g_sur.predicted) {
+    const double err = fabs(log(MAX(cost, MIN_COST)) - g_sur.prediction);
+
+    s[S_ERR] = (s[S_COMPARED] == 0) ? err
+                                    : (1.0 - ERR_DECAY) * s[S_ERR] +
+                                          ERR_DECAY * err;
+    s[S_ERR_TOTAL] += err;
+    s[S_COMPARED]++;
+
+    if (g_sur.control && cost <= g_sur.bound)
+      s[S_WRONG]++;
+  }
+
+  g_sur.predicted = 0;
+  g_sur.control = 0;
+
+  const int i = (int)s[S_NEXT];
+
+  surrogate_scale(xi, g_sur.x + i * n);
+  g_sur.f[i] = log(MAX(cost, MIN_COST));
+
+  s[S_NEXT] = (i + 1) % g_sur.size;
+  s[S_COUNT] = MIN(s[S_COUNT] + 1, g_sur.size);
+}
+
+/****************************************************************
+ *
+ *  surrogate_reset: the samples are invalid after a rescaling
+ *
+ ****************************************************************/
+
+void surrogate_reset(void)
+{
+  if (!g_sur.active)
+    return;
+
+  g_sur.state[S_COUNT] = 0;
+  g_sur.state[S_NEXT] = 0;
+  g_sur.predicted = 0;
+}
+
+/****************************************************************
+ *
+ *  surrogate_report
+ *
+ ****************************************************************/
+
+void surrogate_report(void)
+{
+  if (!g_sur.active)
+    return;
+
+  const double* s = g_sur.state;
+  const double screened = MAX(s[S_SCREENED], 1.0);
+  const double compared = MAX(s[S_COMPARED], 1.0);
+
+  printf("Surrogate model skipped %d of %d screened candidates (%.1f%%).\n",
+         (int)s[S_SKIPPED], (int)s[S_SCREENED],
+         100.0 * s[S_SKIPPED] / screened);
+  printf("Mean prediction error %.1f%%, %d of %d control candidates were "
+         "rejected wrongly.\n",
+         100.0 * (exp(s[S_ERR_TOTAL] / compared) - 1.0), (int)s[S_WRONG],
+         (int)s[S_CONTROLS]);
+  fflush(stdout);
+}
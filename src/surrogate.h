@@ -0,0 +1,51 @@
+/****************************************************************
+ *
+ * surrogate.h: header file for the surrogate model of the cost
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+
+#ifndef SURROGATE_H_INCLUDED
+#define SURROGATE_H_INCLUDED
+
+// allocate the sample archive, does nothing if surrogate is 0
+void surrogate_init(void);
+
+// returns 0 if the candidate xi is predicted not to beat bound and
+// does not need to be calculated
+int surrogate_screen(const double* xi, double bound);
+
+// add a calculated candidate to the archive and compare it with the
+// prediction of the last surrogate_screen() call
+void surrogate_add(const double* xi, double cost);
+
+// drop all samples, the parameters changed their meaning
+void surrogate_reset(void);
+
+// print the number of saved force calculations and the accuracy
+void surrogate_report(void);
+
+#endif  // SURROGATE_H_INCLUDED
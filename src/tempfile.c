@@ -0,0 +1,430 @@
+/****************************************************************
+ *
+ * tempfile.c: background writer for the tempfile and the flagfile
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+
+// pthreads and open_memstream() are not part of C99
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <time.h>
+
+#include "potfit.h"
+
+#include "memory.h"
+#include "potential_input.h"
+#include "potential_output.h"
+#include "tempfile.h"
+
+// The optimizers find new optima much faster than a shared filesystem
+// can write them. The potential is copied on every call to
+// update_tempfile(), but only rendered into memory every
+// tempfile_interval seconds. A background thread writes the latest
+// rendered potential to <tempfile>.tmp and renames it, older ones which
+// were not written yet are dropped. The same thread checks for the
+// break flagfile, the optimizers only read the result. The thread never
+// reads g_files, a server job can change the file names at any time.
+
+// seconds between two checks for the flagfile
+#define FLAGFILE_POLL 1
+
+typedef struct {
+  int started;
+  int no_thread;  // MPI does not allow other threads, write directly
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;  // new potential or shutdown
+  pthread_cond_t done;    // potential was written
+
+  // only used by the main thread
+  double* xi;          // latest potential, not rendered yet
+  int dirty;           // xi has not been rendered
+  double last_render;  // time of the last rendering
+  double next_poll;    // next flagfile check without the thread
+
+  // shared between the threads, protected by lock
+  char* buffer;  // rendered potential waiting for the writer
+  size_t size;
+  char* name;      // tempfile the buffer is written to
+  char* flagfile;  // flagfile to check, NULL for none
+  int busy;        // the writer works on a potential
+  int quit;        // stop the writer
+  int flag;        // the flagfile was found
+  int flag_epoch;  // changes whenever the flagfile was removed
+  int failed;      // writing the tempfile failed before
+} tempfile_writer;
+
+static POTFIT_TLS tempfile_writer g_writer = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .wakeup = PTHREAD_COND_INITIALIZER,
+  .done = PTHREAD_COND_INITIALIZER,
+};
+
+void start_writer(void);
+void render_tempfile(void);
+void set_flagfile(const char* flagfile);
+void* run_writer(void* arg);
+void write_buffer(tempfile_writer* writer, const char* name,
+                  const char* buffer, size_t size);
+double current_time(void);
+
+/****************************************************************
+  disable_tempfile_thread
+****************************************************************/
+
+void disable_tempfile_thread(void) { g_writer.no_thread = 1; }
+
+/****************************************************************
+  update_tempfile
+****************************************************************/
+
+void update_tempfile(const double* xi)
+{
+  if (g_files.tempfile == NULL || strlen(g_files.tempfile) == 0)
+    return;
+
+  if (g_writer.xi == NULL)
+    g_writer.xi = (double*)Malloc(g_calc.ndimtot * sizeof(double));
+
+  memcpy(g_writer.xi, xi, g_calc.ndimtot * sizeof(double));
+  g_writer.dirty = 1;
+
+  if (current_time() - g_writer.last_render >= g_param.tempfile_interval)
+    render_tempfile();
+}
+
+/****************************************************************
+  flush_tempfile
+****************************************************************/
+
+void flush_tempfile(void)
+{
+  if (g_writer.dirty)
+    render_tempfile();
+
+  if (!g_writer.started)
+    return;
+
+  pthread_mutex_lock(&g_writer.lock);
+
+  while (g_writer.buffer != NULL || g_writer.busy)
+    pthread_cond_wait(&g_writer.done, &g_writer.lock);
+
+  pthread_mutex_unlock(&g_writer.lock);
+}
+
+/****************************************************************
+  break_flagfile
+    also renders a potential which was held back by the interval
+****************************************************************/
+
+int break_flagfile(void)
+{
+  int flag = 0;
+
+  if (g_writer.dirty &&
+      current_time() - g_writer.last_render >= g_param.tempfile_interval)
+    render_tempfile();
+
+  const int check_flagfile =
+      g_files.flagfile != NULL && strlen(g_files.flagfile) > 0;
+
+  if (g_writer.no_thread) {
+    if (!check_flagfile || current_time() < g_writer.next_poll)
+      return 0;
+
+    g_writer.next_poll = current_time() + FLAGFILE_POLL;
+
+    FILE* ff = fopen(g_files.flagfile, "r");
+    if (ff == NULL)
+      return 0;
+
+    fclose(ff);
+    remove(g_files.flagfile);
+
+    return 1;
+  }
+
+  if (!check_flagfile && !g_writer.started)
+    return 0;
+
+  start_writer();
+
+  pthread_mutex_lock(&g_writer.lock);
+
+  set_flagfile(check_flagfile ? g_files.flagfile : NULL);
+
+  if (g_writer.flag) {
+    flag = 1;
+    g_writer.flag = 0;
+    // a check which is still running does not count
+    g_writer.flag_epoch++;
+  }
+
+  pthread_mutex_unlock(&g_writer.lock);
+
+  if (flag)
+    remove(g_files.flagfile);
+
+  return flag;
+}
+
+/****************************************************************
+  shutdown_tempfile
+****************************************************************/
+
+void shutdown_tempfile(void)
+{
+  if (!g_writer.started)
+    return;
+
+  flush_tempfile();
+
+  pthread_mutex_lock(&g_writer.lock);
+  g_writer.quit = 1;
+  pthread_cond_signal(&g_writer.wakeup);
+  pthread_mutex_unlock(&g_writer.lock);
+
+  pthread_join(g_writer.thread, NULL);
+
+  g_writer.started = 0;
+  g_writer.quit = 0;
+}
+
+/****************************************************************
+  start_writer
+****************************************************************/
+
+void start_writer(void)
+{
+  if (g_writer.started)
+    return;
+
+  if (g_writer.no_thread)
+    return;
+
+  if (pthread_create(&g_writer.thread, NULL, run_writer, &g_writer) != 0)
+    error(1, "Could not start the tempfile writer thread.\n");
+
+  g_writer.started = 1;
+}
+
+/****************************************************************
+  render_tempfile
+    write the potential in g_writer.xi to memory and pass it on
+****************************************************************/
+
+void render_tempfile(void)
+{
+  char* buffer = NULL;
+  size_t size = 0;
+
+  FILE* stream = open_memstream(&buffer, &size);
+
+  if (stream == NULL)
+    error(1, "Could not allocate memory for the tempfile.\n");
+
+#if defined(APOT)
+  // like before, apot_table.values keeps the tempfile parameters
+  update_apot_table(g_writer.xi);
+  write_pot_table_potfit_stream(stream);
+#else
+  // the optimizers already continued with other tables
+  double* table = g_pot.opt_pot.table;
+  g_pot.opt_pot.table = g_writer.xi;
+  write_pot_table_potfit_stream(stream);
+  g_pot.opt_pot.table = table;
+#endif  // APOT
+
+  fclose(stream);
+
+  g_writer.dirty = 0;
+  g_writer.last_render = current_time();
+
+  start_writer();
+
+  if (g_writer.no_thread) {
+    write_buffer(&g_writer, g_files.tempfile, buffer, size);
+    free(buffer);
+    return;
+  }
+
+  pthread_mutex_lock(&g_writer.lock);
+
+  // drop the previous potential if it was not written yet
+  free(g_writer.buffer);
+  free(g_writer.name);
+  g_writer.buffer = buffer;
+  g_writer.size = size;
+  g_writer.name = strdup(g_files.tempfile);
+
+  pthread_cond_signal(&g_writer.wakeup);
+  pthread_mutex_unlock(&g_writer.lock);
+}
+
+/****************************************************************
+  set_flagfile
+    pass the flagfile name to the writer, g_writer.lock is held
+****************************************************************/
+
+void set_flagfile(const char* flagfile)
+{
+  if (flagfile == NULL && g_writer.flagfile == NULL)
+    return;
+
+  if (flagfile != NULL && g_writer.flagfile != NULL &&
+      strcmp(flagfile, g_writer.flagfile) == 0)
+    return;
+
+  free(g_writer.flagfile);
+  g_writer.flagfile = (flagfile == NULL) ? NULL : strdup(flagfile);
+
+  // a check of the old flagfile which is still running does not count
+  g_writer.flag = 0;
+  g_writer.flag_epoch++;
+
+  pthread_cond_signal(&g_writer.wakeup);
+}
+
+/****************************************************************
+  run_writer
+    main loop of the background thread
+****************************************************************/
+
+void* run_writer(void* arg)
+{
+  // g_writer is thread-local in library builds, use the one of the caller
+  tempfile_writer* writer = (tempfile_writer*)arg;
+
+  double next_poll = current_time();
+
+  pthread_mutex_lock(&writer->lock);
+
+  while (!writer->quit) {
+    if (writer->buffer != NULL) {
+      char* buffer = writer->buffer;
+      char* name = writer->name;
+      size_t size = writer->size;
+
+      writer->buffer = NULL;
+      writer->name = NULL;
+      writer->busy = 1;
+      pthread_mutex_unlock(&writer->lock);
+
+      write_buffer(writer, name, buffer, size);
+      free(buffer);
+      free(name);
+
+      pthread_mutex_lock(&writer->lock);
+      writer->busy = 0;
+      pthread_cond_broadcast(&writer->done);
+      continue;
+    }
+
+    if (writer->flagfile != NULL && current_time() >= next_poll) {
+      const int epoch = writer->flag_epoch;
+      char* flagfile = strdup(writer->flagfile);
+      pthread_mutex_unlock(&writer->lock);
+
+      FILE* ff = fopen(flagfile, "r");
+      if (ff != NULL)
+        fclose(ff);
+      free(flagfile);
+
+      pthread_mutex_lock(&writer->lock);
+      if (ff != NULL && epoch == writer->flag_epoch)
+        writer->flag = 1;
+      next_poll = current_time() + FLAGFILE_POLL;
+      continue;
+    }
+
+    if (writer->flagfile != NULL) {
+      struct timespec until;
+      clock_gettime(CLOCK_REALTIME, &until);
+      until.tv_sec += FLAGFILE_POLL;
+      pthread_cond_timedwait(&writer->wakeup, &writer->lock, &until);
+    } else {
+      pthread_cond_wait(&writer->wakeup, &writer->lock);
+    }
+  }
+
+  pthread_mutex_unlock(&writer->lock);
+
+  return NULL;
+}
+
+/****************************************************************
+  write_buffer
+    the tempfile is replaced atomically, a crash never leaves a
+    truncated potential behind
+****************************************************************/
+
+void write_buffer(tempfile_writer* writer, const char* name,
+                   const char* buffer, size_t size)
+{
+  // not Malloc, the memory list belongs to the main thread
+  char* tempname = (char*)malloc(strlen(name) + 5);
+
+  if (tempname == NULL)
+    error(1, "Could not allocate memory for the tempfile.\n");
+
+  sprintf(tempname, "%s.tmp", name);
+
+  FILE* outfile = fopen(tempname, "w");
+  int failed = (outfile == NULL);
+
+  if (!failed) {
+    failed = (fwrite(buffer, 1, size, outfile) != size);
+    failed |= (fclose(outfile) != 0);
+  }
+
+  if (!failed)
+    failed = (rename(tempname, name) != 0);
+
+  free(tempname);
+
+  // only warn once, the next potential might be written again
+  if (failed && !writer->failed)
+    warning("Could not write tempfile %s\n", name);
+
+  writer->failed = failed;
+}
+
+/****************************************************************
+  current_time
+    monotonic time in seconds
+****************************************************************/
+
+double current_time(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + 1e-9 * now.tv_nsec;
+}
@@ -0,0 +1,50 @@
+/****************************************************************
+ *
+ * tempfile.h: background writer for the tempfile and the flagfile
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+
+#ifndef TEMPFILE_H_INCLUDED
+#define TEMPFILE_H_INCLUDED
+
+// the optimizers pass every new optimum, the potential is written at most
+// every tempfile_interval seconds by a background thread
+void update_tempfile(const double* xi);
+
+// write the latest potential passed to update_tempfile() and wait for it
+void flush_tempfile(void);
+
+// returns 1 once if the break flagfile was found, the file is removed
+int break_flagfile(void);
+
+// stop the background thread
+void shutdown_tempfile(void);
+
+// write the tempfile and check the flagfile on the calling thread
+void disable_tempfile_thread(void);
+
+#endif  // TEMPFILE_H_INCLUDED
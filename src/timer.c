@@ -0,0 +1,244 @@
+/****************************************************************
+ *
+ * timer.c: phase timers and per-configuration cost profile
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+// clock_gettime is not part of C99
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <time.h>
+
+#include "potfit.h"
+
+#include "memory.h"
+#include "timer.h"
+
+static const char* phase_names[TIMER_NUM] = {
+    "calc_forces", "splines", "pair", "embedding",
+    "threebody",   "dipole",  "mpi"};
+
+// all times are accumulated in nanoseconds
+static POTFIT_TLS int64_t phase_start[TIMER_NUM];
+static POTFIT_TLS int64_t phase_time[TIMER_NUM];
+static POTFIT_TLS long phase_calls[TIMER_NUM];
+
+static POTFIT_TLS int64_t conf_start_ns;
+static POTFIT_TLS int64_t* conf_time = NULL;
+static POTFIT_TLS long* conf_calls = NULL;
+
+/****************************************************************
+  timer_now
+****************************************************************/
+
+static inline int64_t timer_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/****************************************************************
+  timer_start
+****************************************************************/
+
+void timer_start(timer_phase_t phase)
+{
+  phase_start[phase] = timer_now();
+}
+
+/****************************************************************
+  timer_stop
+****************************************************************/
+
+void timer_stop(timer_phase_t phase)
+{
+  phase_time[phase] += timer_now() - phase_start[phase];
+  phase_calls[phase]++;
+}
+
+/****************************************************************
+  timer_conf_start
+****************************************************************/
+
+void timer_conf_start(void)
+{
+  conf_start_ns = timer_now();
+}
+
+/****************************************************************
+  timer_conf_stop
+****************************************************************/
+
+void timer_conf_stop(int config_idx)
+{
+  if (conf_time == NULL) {
+    conf_time = (int64_t*)Malloc(g_config.nconf * sizeof(int64_t));
+    conf_calls = (long*)Malloc(g_config.nconf * sizeof(long));
+  }
+
+  conf_time[config_idx] += timer_now() - conf_start_ns;
+  conf_calls[config_idx]++;
+}
+
+/****************************************************************
+  write_timing_report
+
+  collects the timings of all processes on the root process
+  and writes them to <output_prefix>.timing
+
+  with mpi_groups the configuration costs are those of the group
+  of the root process, every group calculates all configurations
+
+  the first block contains the summed phase times, the second
+  one the phase times of every process and the last one the
+  accumulated cost of every configuration
+****************************************************************/
+
+void write_timing_report(void)
+{
+  double local[2 * TIMER_NUM];
+  double* ranks = NULL;
+  // the groups of mpi_groups all have the same size
+  const int nprocs = g_mpi.num_cpus * g_mpi.num_groups;
+  const int root = (g_mpi.myid == 0 && g_mpi.group == 0);
+  double* ctime = (double*)Malloc(g_config.nconf * sizeof(double));
+  double* ccalls = (double*)Malloc(g_config.nconf * sizeof(double));
+  double* cneigh = (double*)Malloc(g_config.nconf * sizeof(double));
+
+  for (int i = 0; i < TIMER_NUM; i++) {
+    local[i] = 1e-9 * phase_time[i];
+    local[TIMER_NUM + i] = (double)phase_calls[i];
+  }
+
+  if (conf_time != NULL) {
+    for (int i = 0; i < g_config.nconf; i++) {
+      ctime[i] = 1e-9 * conf_time[i];
+      ccalls[i] = (double)conf_calls[i];
+    }
+  }
+
+  // size of the neighbor lists of the local configurations
+  for (int i = g_mpi.firstconf; i < g_mpi.firstconf + g_mpi.myconf; i++)
+    for (int j = 0; j < g_config.inconf[i]; j++)
+      cneigh[i] += g_config.conf_atoms[g_config.cnfstart[i] + j - g_mpi.firstatom].num_neigh;
+
+  if (root)
+    ranks = (double*)Malloc(nprocs * 2 * TIMER_NUM * sizeof(double));
+
+#if defined(MPI)
+  // the times of a split configuration are summed over its processes
+  if (g_mpi.myid == 0) {
+    MPI_Reduce(MPI_IN_PLACE, ctime, g_config.nconf, MPI_DOUBLE, MPI_SUM, 0, g_mpi.comm);
+    MPI_Reduce(MPI_IN_PLACE, ccalls, g_config.nconf, MPI_DOUBLE, MPI_SUM, 0, g_mpi.comm);
+    MPI_Reduce(MPI_IN_PLACE, cneigh, g_config.nconf, MPI_DOUBLE, MPI_SUM, 0, g_mpi.comm);
+  } else {
+    MPI_Reduce(ctime, NULL, g_config.nconf, MPI_DOUBLE, MPI_SUM, 0, g_mpi.comm);
+    MPI_Reduce(ccalls, NULL, g_config.nconf, MPI_DOUBLE, MPI_SUM, 0, g_mpi.comm);
+    MPI_Reduce(cneigh, NULL, g_config.nconf, MPI_DOUBLE, MPI_SUM, 0, g_mpi.comm);
+  }
+  MPI_Gather(local, 2 * TIMER_NUM, MPI_DOUBLE, ranks, 2 * TIMER_NUM, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#else
+  memcpy(ranks, local, 2 * TIMER_NUM * sizeof(double));
+#endif  // MPI
+
+  if (!root || !g_param.write_output_files)
+    return;
+
+  char file[255];
+  sprintf(file, "%s.timing", g_files.output_prefix);
+
+  FILE* outfile = fopen(file, "w");
+  if (NULL == outfile)
+    error(1, "Could not open file %s\n", file);
+
+  double total[TIMER_NUM];
+  double calls[TIMER_NUM];
+  double work_max = 0.0;
+  double work_sum = 0.0;
+
+  for (int i = 0; i < TIMER_NUM; i++) {
+    total[i] = 0.0;
+    calls[i] = 0.0;
+  }
+
+  for (int r = 0; r < nprocs; r++) {
+    double* t = ranks + r * 2 * TIMER_NUM;
+    for (int i = 0; i < TIMER_NUM; i++) {
+      total[i] += t[i];
+      calls[i] += t[TIMER_NUM + i];
+    }
+    // time spent computing, i.e. not waiting for other processes
+    double work = t[TIMER_CALC] - t[TIMER_COMM];
+    work_sum += work;
+    if (work > work_max)
+      work_max = work;
+  }
+
+  fprintf(outfile, "# potfit timing report, %d force calculations on %d process(es)\n",
+          g_calc.fcalls, nprocs);
+  fprintf(outfile, "#\n# phase totals (summed over all processes)\n");
+  fprintf(outfile, "# %-12s %14s %12s %14s\n", "phase", "time [s]", "calls", "per call [us]");
+  for (int i = 0; i < TIMER_NUM; i++)
+    fprintf(outfile, "  %-12s %14.6f %12.0f %14.3f\n", phase_names[i], total[i], calls[i],
+            calls[i] > 0 ? 1e6 * total[i] / calls[i] : 0.0);
+
+  fprintf(outfile, "#\n# per process phase times [s]\n# rank");
+  for (int i = 0; i < TIMER_NUM; i++)
+    fprintf(outfile, " %12s", phase_names[i]);
+  fprintf(outfile, "\n");
+  for (int r = 0; r < nprocs; r++) {
+    fprintf(outfile, "  %4d", r);
+    for (int i = 0; i < TIMER_NUM; i++)
+      fprintf(outfile, " %12.6f", ranks[r * 2 * TIMER_NUM + i]);
+    fprintf(outfile, "\n");
+  }
+  if (work_sum > 0.0)
+    fprintf(outfile, "# load imbalance (max/avg of compute time): %f\n",
+            work_max * nprocs / work_sum);
+
+  double conf_sum = 0.0;
+  for (int i = 0; i < g_config.nconf; i++)
+    conf_sum += ctime[i];
+
+  fprintf(outfile, "#\n# per configuration cost\n");
+  fprintf(outfile, "# %6s %8s %10s %14s %10s %14s %14s %8s\n", "conf", "atoms", "neighbors",
+          "time [s]", "calls", "per call [us]", "per atom [us]", "share");
+  for (int i = 0; i < g_config.nconf; i++) {
+    double per_call = ccalls[i] > 0 ? 1e6 * ctime[i] / ccalls[i] : 0.0;
+    fprintf(outfile, "  %6d %8d %10.0f %14.6f %10.0f %14.3f %14.5f %7.2f%%\n", i,
+            g_config.inconf[i], cneigh[i], ctime[i], ccalls[i], per_call,
+            per_call / g_config.inconf[i],
+            conf_sum > 0.0 ? 100.0 * ctime[i] / conf_sum : 0.0);
+  }
+
+  fclose(outfile);
+
+  printf("Timing report written to \t%s\n", file);
+}
@@ -0,0 +1,69 @@
+/****************************************************************
+ *
+ * timer.h: phase timers for the force routines
+ *
+ ****************************************************************
+ *
+ * Copyright 2002-2018 - the potfit development team
+ *
+ * https://www.potfit.net/
+ *
+ ****************************************************************
+ *
+ * This file is part of potfit.
+ *
+ * potfit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * potfit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with potfit; if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef TIMER_H_INCLUDED
+#define TIMER_H_INCLUDED
+
+// phases of a force calculation which are timed separately
+typedef enum {
+  TIMER_CALC,       // one complete pass through calc_forces
+  TIMER_SPLINES,    // update_splines and update_calc_table
+  TIMER_PAIR,       // pair and density loop (including F(rho) for EAM)
+  TIMER_EMBED,      // embedding forces
+  TIMER_THREEBODY,  // angular loops, including their pair terms
+  TIMER_DIPOLE,     // induced dipole iteration
+  TIMER_COMM,       // MPI broadcasts and gathers
+  TIMER_NUM
+} timer_phase_t;
+
+#if defined(TIMING)
+
+void timer_start(timer_phase_t phase);
+void timer_stop(timer_phase_t phase);
+void timer_conf_start(void);
+void timer_conf_stop(int config_idx);
+
+// collective call, has to be reached by all MPI processes
+void write_timing_report(void);
+
+#define TIMER_START(phase) timer_start(phase)
+#define TIMER_STOP(phase) timer_stop(phase)
+#define TIMER_CONF_START() timer_conf_start()
+#define TIMER_CONF_STOP(idx) timer_conf_stop(idx)
+
+#else
+
+#define TIMER_START(phase) ((void)0)
+#define TIMER_STOP(phase) ((void)0)
+#define TIMER_CONF_START() ((void)0)
+#define TIMER_CONF_STOP(idx) ((void)0)
+
+#endif  // TIMING
+
+#endif  // TIMER_H_INCLUDED
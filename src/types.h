@@ -187,6 +187,7 @@ typedef struct {
 typedef struct {
   int type;
   int num_neigh;
+  int neigh_end[SLOTS]; /* neighbors up to the last one in range of a slot */
   vector pos;
   vector force;
   double absforce;
@@ -248,6 +249,9 @@ typedef struct {
   double* xcoord;  /* the x-coordinates of sampling points */
   double* table;   /* the actual data */
   double* d2tab;   /* second derivatives of table data for spline int */
+  double* coeff;   /* cubic coefficients c0..c3 of each spline interval */
+  double* coeff_mem; /* allocated memory of coeff */
+  int coeff_len;     /* table length coeff was allocated for */
   int* idx;        /* indirect indexing */
 } pot_table_t;
 
@@ -320,6 +324,8 @@ typedef struct {
 typedef struct {
   int fcalls;  /* number of force calculations */
   int mdim;    /* total number of entries in force vector */
+  int rdim;    /* number of used entries in force vector */
+  int* res_idx; /* positions of the used entries in force vector */
   int ndim;    /* number of free optimization parameters in force vector */
   int ndimtot; /* total number of optimization parameters in force vector */
   int paircol; /* How many columns for pair potential ( ntypes*(ntypes+1)/2 ) */
@@ -361,6 +367,7 @@ typedef struct {
   int** na_type; /* number of atoms per atom type */
 
   int* cnfstart; /* index of first atom in each config */
+  int* atom_order; /* index of each atom of the config file, sort_atoms only */
   int* inconf;   /* number of atoms in each config */
   int* conf_uf;  /* local array of "use forces in config X" */
   int* useforce; /* global array of "use forces in config X" */
@@ -373,6 +380,7 @@ typedef struct {
 
   double* rcut; /* cutoff radius for each atom type */
   double* rmin; /* minimum distance for each atom type */
+  double* mindist; /* minimum distance for each pair potential */
 
   double rcutmin; /* minimum of all cutoff values */
   double rcutmax; /* maximum of all cutoff values */
@@ -387,16 +395,18 @@ typedef struct {
 // variables needed for electrostatic options
 #if defined(COULOMB)
   double dp_cut;  // cutoff-radius for long-range interactions
+  double* tail_kappa;  // kappa of the tails of each config, NAN if unknown
 #endif            // COULOMB
 #if defined(DIPOLE)
   double dp_tol;  // dipole iteration precision
-  double dp_mix;  // ???
+  double dp_mix;  // damping of the dipole iteration
 #endif            // DIPOLE
 } potfit_configurations;
 
 // potfit_filenames: holds all kinds of filenames
 
 typedef struct {
+  const char* checkpoint;    /* optimizer state for restarts */
   const char* config;        /* file with atom configuration */
 #if defined(BINDIST)
   const char* bindistfile;   /* file for binned distributions */
@@ -409,6 +419,7 @@ typedef struct {
   const char* output_lammps; /* lammps output files */
   const char* plotfile;      /* file for plotting */
   const char* plotpointfile; /* write points for plotting */
+  const char* server_dir;    /* spool directory for server mode */
   const char* startpot;      /* file with start potential */
   const char* tempfile;      /* backup potential file */
 } potfit_filenames;
@@ -417,19 +428,37 @@ typedef struct {
 
 typedef struct {
   int init_done;  // potfit setup completed
-  int myid;       // index of current process
-  int num_cpus;   // total numer of processes
+  int myid;       // index of current process in its group
+  int num_cpus;   // total numer of processes in its group
+  int group;      // index of the group of this process
+  int num_groups; // groups which calculate different parameter vectors
 
   int firstatom; /* index of first atom for this process */
   int firstconf; /* index of first configuration for this process */
   int myatoms;   /* number of atoms for this process */
   int myconf;    /* number of configurations for this process */
+  int firstcalc; /* index of first atom calculated by this process */
+  int mycalc;    /* number of atoms calculated by this process */
 
 #if defined(MPI)
   int* atom_dist; /* atom distribution for each process (starting index) */
   int* atom_len;  /* atom distribution for each process (number of atoms) */
   int* conf_dist; /* config distribution for each process (starting index) */
   int* conf_len;  /* config distribution for each process (number of configs) */
+  int* force_dist; /* atoms with forces of each process (starting index) */
+  int* force_len;  /* atoms with forces of each process (number of atoms) */
+  int myforces;    /* number of atoms with forces for this process */
+  int firstowned;  /* index of first configuration gathered from this process */
+  int myowned;     /* number of configurations gathered from this process */
+  int split_conf[2];      /* split configurations of this process, -1 if none */
+  MPI_Comm split_comm[2]; /* processes which calculate a split configuration */
+
+  MPI_Comm comm;        /* processes of the group of this process */
+  MPI_Comm group_comm;  /* first process of every group, MPI_COMM_NULL otherwise */
+
+  MPI_Comm node_comm;   /* processes which share memory with this one */
+  MPI_Comm leader_comm; /* first process of every node, MPI_COMM_NULL otherwise */
+  int node_rank;        /* index of this process on its node */
 
   /* MPI datatypes */
   MPI_Datatype MPI_ATOM;
@@ -449,21 +478,43 @@ typedef struct {
   int ntypes;      /* number of atom types */
   int opt;         /* optimization flag */
   int rng_seed;    /* seed for RNG */
+  int ensemble;      /* number of ensemble members */
+  int ensemble_keep; /* members optimized after the global stage */
+  int checkpoint_interval; /* seconds between checkpoints */
+  int restart;       /* resume from the checkpoint file */
+  double tempfile_interval; /* minimal seconds between tempfile writes */
   int usemaxch;    /* use maximal changes file */
+  int powell_refactor; /* powell steps between two factorizations */
+  int linmin_batch;    /* step lengths evaluated per line search round */
+  int surrogate;       /* samples of the pre-screening model */
 
   int plot;  // plot output flag
 
   int write_output_files;
   int write_lammps_files;
   int write_pair;
+  int sort_atoms; /* reorder the atoms of each config along a Morton curve */
+  int split_atoms; /* configs of at least this size are split (MPI) */
+  int mpi_groups;  /* groups of processes for calc_forces_batch (MPI) */
   int writeimd;
   int write_lammps; /* write output also in LAMMPS format */
 
 #if defined(EVO)
   double evo_threshold;
+#elif defined(CMAES)
+  double cmaes_threshold; /* stopping criterion for CMA-ES */
+  double cmaes_sigma;     /* initial step size, relative to the bounds */
+  int cmaes_lambda;       /* samples per generation, 0 for 4 + 3 ln(n) */
+  int cmaes_restarts;     /* restarts with twice the samples (IPOP) */
 #else
   const char* anneal_temp;
-#endif  // EVO
+  int anneal_nstep;       /* steps per parameter between step adjustments */
+  int anneal_ntemp;       /* step adjustments per temperature, 0: 3 * ndim */
+  double anneal_cooling;  /* fixed cooling factor */
+  double anneal_adaptive; /* lambda of the adaptive cooling, 0 for fixed */
+  int anneal_stagnation;  /* temperatures without improvement before stop */
+  int anneal_freeze;      /* saturated step adjustments before freezing */
+#endif  // EVO || CMAES
   double eweight;
   double sweight;
   double extend; /* how far should one extend imd pot */
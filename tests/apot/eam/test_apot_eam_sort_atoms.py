@@ -0,0 +1,48 @@
+import random
+
+def shuffled_config():
+    # bcc cell with displaced atoms, written in random order
+    rnd = random.Random(5)
+    atoms = []
+    for i in range(3):
+        for j in range(3):
+            for k in range(3):
+                for s in [0.0, 0.5]:
+                    pos = [(x + s) * 2.9 + rnd.uniform(-0.1, 0.1) for x in [i, j, k]]
+                    atoms.append('0 {:.4f} {:.4f} {:.4f} {:.3f} {:.3f} {:.3f}'.format(
+                        *pos, *[rnd.uniform(-0.5, 0.5) for _ in range(3)]))
+    rnd.shuffle(atoms)
+    return '''#N {} 1
+#C 0
+#X 8.7 0 0
+#Y 0 8.7 0
+#Z 0 0 8.7
+#E -2.0
+#F
+{}
+'''.format(len(atoms), '\n'.join(atoms))
+
+def force_table(potfit):
+    return [x.split() for x in potfit.force.split('\n') if x and not x.startswith('#')]
+
+def test_apot_eam_sort_atoms(potfit):
+    potfit.call_makeapot('startpot', '-n 1 -i eam -f 3*lj')
+    potfit.create_config_file(data=shuffled_config())
+    potfit.create_param_file(eng_weight=1)
+    potfit.run()
+    assert potfit.has_no_error()
+    reference = (force_table(potfit), potfit.rho_loc.split('\n'))
+    potfit.create_param_file(eng_weight=1, sort_atoms=1)
+    potfit.run()
+    assert potfit.has_no_error()
+    forces = force_table(potfit)
+    assert len(forces) == 3 * 54
+    # same atoms in the order of the config file, only the summation order differs
+    for a, b in zip(forces, reference[0]):
+        assert a[:2] == b[:2]
+        assert abs(float(a[3]) - float(b[3])) < 1e-9
+        assert float(a[4]) == float(b[4])
+    for a, b in zip(potfit.rho_loc.split('\n'), reference[1]):
+        if a and a[0].isdigit():
+            assert a.split()[:2] == b.split()[:2]
+            assert abs(float(a.split()[2]) - float(b.split()[2])) < 1e-6
@@ -0,0 +1,54 @@
+import os
+
+def test_apot_pair_cmaes(potfit, lj_input, error_sum):
+    potfit.create_param_file(opt=1, eng_weight=1, seed=7)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Finished CMA-ES' in potfit.stdout
+    assert 'Run 0 finished' in potfit.stdout
+    assert error_sum(potfit) < 0.25
+
+def test_apot_pair_cmaes_restarts(potfit, lj_input):
+    potfit.create_param_file(opt=1, eng_weight=1, seed=7, cmaes_restarts=2, cmaes_lambda=6)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Run 2 finished' in potfit.stdout
+    assert '\t     24\t' in potfit.stdout
+
+def test_apot_pair_cmaes_flagfile(potfit, lj_input):
+    potfit.create_param_file(opt=1, eng_weight=1, seed=7, cmaes_restarts=2, flagfile='stop')
+    potfit.create_file('stop').close()
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'CMA-ES terminated in presence of break flagfile "stop"' in potfit.stdout
+    assert 'Run 0 finished after' in potfit.stdout
+    assert '(stopped by flag file)' in potfit.stdout
+    assert 'Run 1 finished' not in potfit.stdout
+
+def test_apot_pair_cmaes_threshold_zero(potfit, lj_input):
+    potfit.create_param_file(opt=1, eng_weight=1, cmaes_threshold=0)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Run 0 finished' not in potfit.stdout
+
+def test_apot_pair_cmaes_lambda_too_small(potfit, lj_input):
+    potfit.create_param_file(opt=1, cmaes_lambda=3)
+    potfit.run()
+    assert potfit.has_error()
+    assert 'cmaes_lambda is "3"' in potfit.stderr
+
+def test_apot_pair_cmaes_restart(potfit, lj_input, run_until, error_sum):
+    potfit.filenames.append(os.path.join(potfit.cwd, 'checkpoint'))
+    potfit.create_param_file(opt=1, eng_weight=1, seed=7, checkpoint='checkpoint', checkpoint_interval=0)
+    potfit.run()
+    assert potfit.has_no_error()
+    reference = (potfit.endpot, error_sum(potfit))
+    os.remove(os.path.join(potfit.cwd, 'checkpoint'))
+    # stop the fit after 20 generations
+    run_until(potfit, '  0\t   20\t')
+    assert os.path.isfile(os.path.join(potfit.cwd, 'checkpoint'))
+    potfit.create_param_file(opt=1, eng_weight=1, seed=7, checkpoint='checkpoint', checkpoint_interval=0, restart=1)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Resuming the optimization from checkpoint checkpoint' in potfit.stdout
+    assert (potfit.endpot, error_sum(potfit)) == reference
@@ -1,4 +1,7 @@
+import os
 import pytest
+import random
+import subprocess
 
 def pytest_runtest_logstart(nodeid, location):
     path = location[0]
@@ -20,5 +23,123 @@ def get_potfit_obj():
 def potfit():
     p = get_potfit_obj()
     p.reset()
+    # every optimization writes the tempfile
+    p.filenames.append(os.path.join(p.cwd, 'tempfile'))
     yield p
     p.clear()
+
+# more free parameters than derivatives evaluated in one batch
+BATCH_POTENTIAL = '''
+#F 0 3
+#T PAIR
+#I 0 0 0
+#E
+
+type eopp
+cutoff 6.0
+C1 1.0 0.1 5
+C2 1.0 0.1 5
+eta1 8.0 4 12
+eta2 2.5 1 4
+k 2.0 1 3
+phase 0.5 0 6.2
+
+type morse
+cutoff 6.0
+D_e 0.2 0.01 1
+a 1.5 0.01 3
+r_0 2.6 2 3.5
+
+type lj
+cutoff 5.5
+epsilon 0.1 -1 1
+sigma 2.4 0.5 6
+'''
+
+def batch_config():
+    rnd = random.Random(3)
+    atoms = []
+    for i in range(4):
+        for j in range(4):
+            for k in range(4):
+                pos = [(x + 0.5) * 2.6 + rnd.uniform(-0.3, 0.3) for x in [i, j, k]]
+                atoms.append('{} {:.4f} {:.4f} {:.4f} {:.3f} {:.3f} {:.3f}'.format(
+                    rnd.randrange(2), *pos, *[rnd.uniform(-0.5, 0.5) for _ in range(3)]))
+    return '''#N {} 1
+#C 0 1
+#X 10.4 0 0
+#Y 0 10.4 0
+#Z 0 0 10.4
+#E -2.0
+#F
+{}
+'''.format(len(atoms), '\n'.join(atoms))
+
+@pytest.fixture()
+def powell_input(potfit):
+    potfit.create_potential_file(BATCH_POTENTIAL)
+    potfit.create_config_file(data=batch_config())
+
+@pytest.fixture()
+def powell_steps():
+    # error sums of the powell steps
+    def steps(potfit):
+        out = potfit.stdout.split('Starting powell minimization')[1].split('\n')
+        return [float(x.split()[1]) for x in out if len(x.split()) == 3 and x.split()[0].isdigit()]
+    return steps
+
+# Lennard-Jones potential with two free parameters
+LJ_POTENTIAL = '''
+#F 0 1
+#T PAIR
+#I 0
+#E
+
+type lj
+cutoff 6.0
+epsilon 0.1 0 1
+sigma 2.5 1 4
+'''
+
+# the perfect lattice of the default configuration has no forces
+LJ_CONFIG = '''#N 4 1
+#C 0
+#X 6.0 0 0
+#Y 0 6.0 0
+#Z 0 0 6.0
+#E -0.5
+#W 1
+#F
+0 0.0 0.0 0.0 0.1 -0.2 0.05
+0 2.9 0.2 0.1 -0.3 0.1 0.0
+0 0.3 3.1 0.2 0.2 0.2 -0.1
+0 0.1 0.2 2.8 0.0 -0.1 0.05
+'''
+
+@pytest.fixture()
+def lj_potential(potfit):
+    potfit.create_potential_file(LJ_POTENTIAL)
+
+@pytest.fixture()
+def lj_input(potfit, lj_potential):
+    potfit.create_config_file(data=LJ_CONFIG)
+
+@pytest.fixture()
+def error_sum():
+    # total error sum of the last error report
+    def total(potfit):
+        return float([x for x in potfit.stdout.split('\n') if 'total error sum' in x][-1].split()[3].strip(','))
+    return total
+
+@pytest.fixture()
+def run_until():
+    # stop the fit like a preempted job after the first line starting with marker
+    def run(potfit, marker):
+        cmd = [os.path.join(os.path.abspath('../bin'), potfit.binary_name), 'param_file']
+        p = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, cwd=potfit.cwd)
+        for line in p.stdout:
+            if line.decode('ascii').startswith(marker):
+                break
+        p.kill()
+        p.communicate()
+    return run
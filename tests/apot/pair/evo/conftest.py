@@ -1,3 +1,4 @@
+import os
 import pytest
 
 def pytest_runtest_logstart(nodeid, location):
@@ -20,5 +21,7 @@ def get_potfit_obj():
 def potfit():
     p = get_potfit_obj()
     p.reset()
+    # every optimization writes the tempfile
+    p.filenames.append(os.path.join(p.cwd, 'tempfile'))
     yield p
     p.clear()
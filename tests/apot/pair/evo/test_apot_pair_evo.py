@@ -1,4 +1,6 @@
+import os
 import pytest
+import shutil
 
 def test_apot_pair_evo_threshold_empty(potfit):
     potfit.create_param_file(evo_threshold='')
@@ -27,3 +29,37 @@ def test_apot_pair_evo_threshold_out_of_bounds(potfit):
     assert potfit.has_error()
     assert 'Illegal value in parameter file' in potfit.stderr
     assert 'evo_threshold is out of bounds' in potfit.stderr
+
+def test_apot_pair_evo_surrogate(potfit):
+    potfit.create_param_file(opt=1, evo_threshold=1e-3, surrogate=200)
+    potfit.call_makeapot('startpot', '-n 1 -i pair -f eopp_sc')
+    potfit.create_config_file()
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Finished differential evolution' in potfit.stdout
+    assert 'Surrogate model skipped' in potfit.stdout
+
+def run_jobs(potfit, jobs):
+    spool = os.path.join(potfit.cwd, 'spool')
+    shutil.rmtree(spool, ignore_errors=True)
+    os.makedirs(spool)
+    for name, content in jobs:
+        with open(os.path.join(spool, name + '.job'), 'w') as f:
+            f.write(content)
+    open(os.path.join(spool, 'stop'), 'w').close()
+    potfit.run()
+    shutil.rmtree(spool)
+    assert potfit.has_no_error()
+    return potfit.stdout.split('Starting job')[1:]
+
+def test_apot_pair_evo_surrogate_server(potfit):
+    potfit.create_param_file(server_dir='spool', evo_threshold=1e-3, seed=3)
+    potfit.call_makeapot('startpot', '-n 1 -i pair -f eopp_sc')
+    potfit.create_config_file()
+    potfit.filenames.extend(os.path.join(potfit.cwd, x) for x in ['end_a', 'end_b'])
+    job_a, job_b = run_jobs(potfit, [('a', 'opt 1\nsurrogate 200\nendpot end_a\n'), ('b', 'opt 1\nendpot end_b\n')])
+    assert 'Surrogate model skipped' in job_a
+    # the archive of job a is not used by job b
+    assert 'Surrogate model' not in job_b
+    reference, = run_jobs(potfit, [('b', 'opt 1\nendpot end_b\n')])
+    assert job_b.split('Finished differential evolution')[0] == reference.split('Finished differential evolution')[0]
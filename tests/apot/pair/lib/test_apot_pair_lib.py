@@ -0,0 +1,184 @@
+import os
+import subprocess
+import sys
+
+potential = '''
+#F 0 1
+#T PAIR
+#I 0
+#E
+
+type lj
+cutoff {}
+epsilon {} 0 1
+sigma 2.5 1 4
+'''
+
+# the library writes its output to the stdout and stderr of the process,
+# so every test runs the library calls in a separate python interpreter
+driver = '''
+import ctypes
+import sys
+
+lib = ctypes.CDLL(sys.argv[1])
+lib.potfit_create.restype = ctypes.c_void_p
+for name in ['load', 'load_potential', 'get_parameters', 'set_parameters',
+             'optimize', 'write_potential']:
+    getattr(lib, 'potfit_' + name).argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+lib.potfit_num_parameters.argtypes = [ctypes.c_void_p]
+lib.potfit_evaluate.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+lib.potfit_destroy.argtypes = [ctypes.c_void_p]
+
+def result(name, value):
+    print('RESULT {{}} {{}}'.format(name, value), flush=True)
+
+{}
+'''
+
+def run_driver(potfit, code):
+    f = potfit.create_file('driver.py')
+    f.write(driver.format(code))
+    f.close()
+    lib = os.path.join(os.path.abspath('../bin'), potfit.binary_name)
+    p = subprocess.run([sys.executable, 'driver.py', lib], stdout=subprocess.PIPE,
+                       stderr=subprocess.PIPE, cwd=potfit.cwd)
+    potfit.stdout = p.stdout.decode('ascii')
+    potfit.stderr = p.stderr.decode('ascii')
+    assert p.returncode == 0, potfit.stderr
+    results = {}
+    for line in potfit.stdout.split('\n'):
+        if line.startswith('RESULT'):
+            results[line.split()[1]] = line.split()[2]
+    return results
+
+def test_apot_pair_lib(potfit):
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1)
+    potfit.create_potential_file(potential.format(6.0, 0.1))
+    potfit.create_config_file()
+    potfit.filenames.append(os.path.join(potfit.cwd, 'libpot'))
+    potfit.filenames.append(os.path.join(potfit.cwd, 'tempfile'))
+    res = run_driver(potfit, '''
+ctx = lib.potfit_create()
+result('load', lib.potfit_load(ctx, b'param_file'))
+n = lib.potfit_num_parameters(ctx)
+result('n', n)
+params = (ctypes.c_double * n)()
+lib.potfit_get_parameters(ctx, params)
+error_sum = ctypes.c_double()
+lib.potfit_evaluate(ctx, params, ctypes.byref(error_sum))
+result('start', error_sum.value)
+candidate = (ctypes.c_double * n)(0.5, 2.5)
+lib.potfit_evaluate(ctx, candidate, ctypes.byref(error_sum))
+result('candidate', error_sum.value)
+lib.potfit_get_parameters(ctx, params)
+result('unchanged', params[0])
+lib.potfit_set_parameters(ctx, candidate)
+lib.potfit_get_parameters(ctx, params)
+lib.potfit_evaluate(ctx, params, ctypes.byref(error_sum))
+result('current', error_sum.value)
+result('optimize', lib.potfit_optimize(ctx, ctypes.byref(error_sum)))
+result('end', error_sum.value)
+result('write', lib.potfit_write_potential(ctx, b'libpot'))
+lib.potfit_set_parameters(ctx, candidate)
+lib.potfit_write_potential(ctx, b'libpot')
+lib.potfit_destroy(ctx)
+''')
+    assert res['load'] == '0'
+    assert res['n'] == '2'
+    assert float(res['start']) != float(res['candidate'])
+    assert float(res['unchanged']) == 0.1
+    assert res['current'] == res['candidate']
+    assert res['optimize'] == '0'
+    assert float(res['end']) <= float(res['candidate'])
+    assert res['write'] == '0'
+    assert 'Starting optimization with 2 parameters' in potfit.stdout
+    with open(os.path.join(potfit.cwd, 'libpot')) as f:
+        values = dict(line.split()[:2] for line in f if line.startswith('epsilon'))
+    assert float(values['epsilon']) == 0.5
+
+def test_apot_pair_lib_errors(potfit):
+    potfit.create_param_file()
+    potfit.create_potential_file(potential.format(6.0, 0.1))
+    f = potfit.create_file('pot_b')
+    f.write(potential.format(5.0, 0.1))
+    f.close()
+    potfit.create_config_file()
+    res = run_driver(potfit, '''
+ctx = lib.potfit_create()
+result('early', lib.potfit_optimize(ctx, None))
+result('load', lib.potfit_load(ctx, b'param_file'))
+result('reload', lib.potfit_load_potential(ctx, b'pot_b'))
+result('n', lib.potfit_num_parameters(ctx))
+result('missing', lib.potfit_load_potential(ctx, b'no_such_file'))
+result('failed', lib.potfit_num_parameters(ctx))
+lib.potfit_destroy(ctx)
+''')
+    assert res['early'] == '2'
+    assert res['load'] == '0'
+    assert res['reload'] == '2'
+    assert 'different cutoff radius' in potfit.stderr
+    assert res['n'] == '2'
+    assert res['missing'] == '2'
+    assert '[ERROR]' in potfit.stderr
+    assert res['failed'] == '-1'
+
+def test_apot_pair_lib_contexts(potfit):
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1)
+    potfit.create_potential_file(potential.format(6.0, 0.1))
+    potfit.create_config_file()
+    potfit.filenames.append(os.path.join(potfit.cwd, 'tempfile'))
+    res = run_driver(potfit, '''
+import threading
+
+def create():
+    ctx = lib.potfit_create()
+    lib.potfit_load(ctx, b'param_file')
+    return ctx
+
+def evaluate(ctx, values):
+    error_sum = ctypes.c_double()
+    lib.potfit_evaluate(ctx, (ctypes.c_double * 2)(*values), ctypes.byref(error_sum))
+    return error_sum.value
+
+first = create()
+second = create()
+candidates = [(0.1 + 0.05 * i, 2.0 + 0.1 * i) for i in range(8)]
+serial = [evaluate(first, c) for c in candidates]
+
+# the contexts have their own potential
+lib.potfit_set_parameters(second, (ctypes.c_double * 2)(0.5, 2.5))
+params = (ctypes.c_double * 2)()
+lib.potfit_get_parameters(first, params)
+result('first', params[0])
+lib.potfit_get_parameters(second, params)
+result('second', params[0])
+
+# evaluations on different contexts run at the same time
+parallel = {}
+def worker(ctx, name, values):
+    parallel[name] = [evaluate(ctx, c) for c in values for _ in range(20)][::20]
+threads = [threading.Thread(target=worker, args=(first, 'a', candidates[:4])),
+           threading.Thread(target=worker, args=(second, 'b', candidates[4:]))]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+result('parallel', parallel['a'] + parallel['b'] == serial)
+
+# optimizing one context does not change the other one
+result('optimize', lib.potfit_optimize(second, None))
+result('unchanged', evaluate(first, candidates[0]) == serial[0])
+lib.potfit_destroy(second)
+lib.potfit_destroy(first)
+
+# the contexts can be created again
+third = create()
+result('again', evaluate(third, candidates[0]) == serial[0])
+lib.potfit_destroy(third)
+''')
+    assert float(res['first']) == 0.1
+    assert float(res['second']) == 0.5
+    assert res['parallel'] == 'True'
+    assert res['optimize'] == '0'
+    assert res['unchanged'] == 'True'
+    assert res['again'] == 'True'
@@ -0,0 +1,31 @@
+import os
+import pytest
+import shutil
+
+def pytest_runtest_logstart(nodeid, location):
+    path = location[0]
+    if not path.startswith('apot/pair/mpi'):
+        raise pytest.UsageError("Please run the tests from the tests/ base directory!")
+
+potfit_obj = None
+
+def get_potfit_obj():
+    import sys
+    sys.path.insert(0, str(pytest.config.rootdir))
+    import potfit
+    global potfit_obj
+    if shutil.which('mpirun') == None:
+        pytest.skip('mpirun is not available')
+    if potfit_obj == None:
+        # no address sanitizer, it reports the allocations of the MPI library
+        potfit_obj = potfit.Potfit(__file__, 'apot', 'pair', ['mpi'], release=True)
+    return potfit_obj
+
+@pytest.fixture()
+def potfit():
+    p = get_potfit_obj()
+    p.reset()
+    # every optimization writes the tempfile
+    p.filenames.append(os.path.join(p.cwd, 'tempfile'))
+    yield p
+    p.clear()
@@ -0,0 +1,37 @@
+import pytest
+
+def config(energy, pos):
+    lines = ['#N 4 1', '#C 0', '#X 6.0 0 0', '#Y 0 6.0 0', '#Z 0 0 6.0', '#E {}'.format(energy), '#W 1', '#F']
+    forces = ['0.1 -0.2 0.05', '-0.3 0.1 0.0', '0.2 0.2 -0.1', '0.0 -0.1 0.05']
+    lines += ['0 {} {}'.format(p, f) for p, f in zip(pos, forces)]
+    return '\n'.join(lines) + '\n'
+
+@pytest.fixture()
+def lj_configs(potfit, lj_potential):
+    # one configuration per process
+    potfit.create_config_file(data=''.join([
+        config(-0.5, ['0.0 0.0 0.0', '2.9 0.2 0.1', '0.3 3.1 0.2', '0.1 0.2 2.8']),
+        config(-0.6, ['0.0 0.0 0.0', '2.8 0.2 0.1', '0.3 3.1 0.2', '0.1 0.2 2.8']),
+        config(-0.4, ['0.0 0.0 0.0', '2.9 0.2 0.1', '0.3 3.2 0.2', '0.1 0.2 2.8']),
+        config(-0.5, ['0.0 0.0 0.0', '2.9 0.2 0.1', '0.3 3.1 0.2', '0.2 0.2 2.9'])]))
+
+def fit(potfit, np, error_sum, **kwargs):
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1, **kwargs)
+    potfit.run(mpi=np)
+    assert potfit.has_no_error()
+    return error_sum(potfit)
+
+@pytest.mark.parametrize('np', [2, 4])
+def test_apot_pair_mpi(potfit, lj_configs, error_sum, np):
+    # the workers tabulate the analytic functions themselves
+    reference = fit(potfit, 1, error_sum)
+    assert fit(potfit, np, error_sum) == pytest.approx(reference, rel=1e-6)
+
+@pytest.mark.parametrize('np', [2, 4])
+def test_apot_pair_mpi_groups(potfit, lj_configs, error_sum, np):
+    reference = fit(potfit, 1, error_sum)
+    value = fit(potfit, np, error_sum, mpi_groups=2, linmin_batch=6)
+    assert 'linmin_batch is ignored' not in potfit.stderr
+    assert '2 groups of {} processes calculate the force batches'.format(np // 2) in potfit.stdout
+    # the root process adds the punishments of the other groups
+    assert value == pytest.approx(reference, rel=1e-6)
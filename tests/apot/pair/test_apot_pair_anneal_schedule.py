@@ -0,0 +1,69 @@
+import os
+
+def force_calculations(potfit):
+    return int([x for x in potfit.stdout.split('\n') if 'force calculations, each took' in x][-1].split()[0])
+
+def annealing_steps(potfit):
+    # (k, m) of every line of the annealing table
+    lines = potfit.stdout.split('Finished annealing')[0].split('F_opt\n')[1].split('\n')
+    return [(int(x.split()[0]), int(x.split()[2])) for x in lines if x.count('\t') == 4]
+
+def run(potfit, **kwargs):
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, seed=7, **kwargs)
+    potfit.run()
+    assert potfit.has_no_error()
+    return force_calculations(potfit)
+
+def test_apot_pair_anneal_schedule_default(potfit, lj_input):
+    fcalls = run(potfit)
+    assert 'Annealing stopped' not in potfit.stdout
+    assert 'frozen' not in potfit.stdout
+    assert max(annealing_steps(potfit))[1] == 6
+    assert fcalls > 12000
+
+def test_apot_pair_anneal_schedule_fixed(potfit, lj_input, error_sum):
+    run(potfit, anneal_nstep=10, anneal_ntemp=4, anneal_cooling=0.7)
+    steps = annealing_steps(potfit)
+    assert max(x[1] for x in steps) == 4
+    assert error_sum(potfit) < 0.25
+
+def test_apot_pair_anneal_schedule_stagnation(potfit, lj_input, error_sum):
+    fcalls = run(potfit, anneal_stagnation=5)
+    assert 'Annealing stopped, no improvement in 5 temperatures.' in potfit.stdout
+    assert error_sum(potfit) < 0.25
+    assert fcalls < 6000
+
+def test_apot_pair_anneal_schedule_adaptive(potfit, lj_input, error_sum):
+    fcalls = run(potfit, anneal_adaptive=0.7)
+    # temperatures in equilibrium end before the 6th step adjustment
+    adjustments = {}
+    for k, m in annealing_steps(potfit):
+        adjustments[k] = m
+    assert min(adjustments.values()) < 6
+    assert error_sum(potfit) < 0.25
+    assert fcalls < 6000
+
+def test_apot_pair_anneal_schedule_freeze(potfit, lj_input):
+    # with one step per adjustment every parameter is saturated
+    run(potfit, anneal_nstep=1, anneal_freeze=2)
+    assert 'Annealing stopped, all parameters are frozen.' in potfit.stdout
+    assert '2 of 2 parameters were frozen.' in potfit.stdout
+    assert annealing_steps(potfit)[-1] == (0, 2)
+
+def test_apot_pair_anneal_schedule_invalid_cooling(potfit, lj_input):
+    potfit.create_param_file(opt=1, anneal_temp=1, anneal_cooling=1.0)
+    potfit.run()
+    assert potfit.has_error()
+    assert 'anneal_cooling is out of bounds' in potfit.stderr
+
+def test_apot_pair_anneal_schedule_restart(potfit, lj_input, run_until, error_sum):
+    potfit.filenames.append(os.path.join(potfit.cwd, 'checkpoint'))
+    options = dict(anneal_adaptive=0.7, anneal_stagnation=8, anneal_freeze=4, checkpoint='checkpoint', checkpoint_interval=0)
+    run(potfit, **options)
+    reference = (potfit.endpot, error_sum(potfit))
+    os.remove(os.path.join(potfit.cwd, 'checkpoint'))
+    run_until(potfit, '  3\t')
+    assert os.path.isfile(os.path.join(potfit.cwd, 'checkpoint'))
+    run(potfit, restart=1, **options)
+    assert 'Resuming the optimization from checkpoint checkpoint' in potfit.stdout
+    assert (potfit.endpot, error_sum(potfit)) == reference
@@ -0,0 +1,9 @@
+def test_apot_pair_batch_powell(potfit, powell_input, powell_steps):
+    potfit.create_param_file(ntypes=2, opt=1, anneal_temp=0, eng_weight=1)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Starting powell minimization' in potfit.stdout
+    assert 'Matrix gamma singular' not in potfit.stderr
+    errors = powell_steps(potfit)
+    assert errors[0] > 600
+    assert errors[-1] < 25
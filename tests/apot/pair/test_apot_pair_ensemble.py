@@ -0,0 +1,46 @@
+import os
+import pytest
+
+potential = '''
+#F 0 1
+#T PAIR
+#I 0
+#E
+
+type lj
+cutoff 6.0
+epsilon 0.1 0 1
+sigma 2.5 1 4
+'''
+
+def test_apot_pair_ensemble(potfit):
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1, seed=3, ensemble=3, ensemble_keep=2)
+    potfit.create_potential_file(potential)
+    potfit.create_config_file()
+    for i in range(3):
+        potfit.filenames.append(os.path.join(potfit.cwd, 'endpot.{}'.format(i)))
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Starting ensemble fit with 3 members and 2 parameters' in potfit.stdout
+    assert potfit.stdout.count('calculating neighbor lists ... done') == 1
+    assert 'Keeping the best 2 of 3 ensemble members' in potfit.stdout
+    assert potfit.stdout.count('Starting powell minimization') == 2
+    for i in range(3):
+        assert os.path.isfile(os.path.join(potfit.cwd, 'endpot.{}'.format(i)))
+    ranking = [x.split() for x in potfit.ensemble.split('\n') if len(x) and x[0] != '#']
+    assert len(ranking) == 3
+    assert sorted(int(x[1]) for x in ranking) == [0, 1, 2]
+    assert sorted(int(x[2]) for x in ranking) == [3, 4, 5]
+    assert ranking[2][5] == 'culled'
+    assert float(ranking[0][5]) <= float(ranking[1][5])
+    best = 'Best ensemble member is {} (seed {}) with error sum {}'.format(ranking[0][1], ranking[0][2], ranking[0][5])
+    assert best in potfit.stdout
+    assert 'total error sum {}'.format(ranking[0][5]) in potfit.error
+
+def test_apot_pair_ensemble_no_opt(potfit):
+    potfit.create_param_file(ensemble=3)
+    potfit.create_potential_file(potential)
+    potfit.create_config_file()
+    potfit.run()
+    assert potfit.has_error()
+    assert 'Ensemble fits in param_file need opt to be enabled' in potfit.stderr
@@ -0,0 +1,15 @@
+import pytest
+
+def test_apot_pair_linmin_batch(potfit, lj_input, powell_steps, error_sum):
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'step lengths per line search round' not in potfit.stdout
+    steps, error = powell_steps(potfit), error_sum(potfit)
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1, linmin_batch=6)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Evaluating 6 step lengths per line search round.' in potfit.stdout
+    # the line searches find the same minima as bracket() and brent()
+    assert powell_steps(potfit) == pytest.approx(steps, rel=1e-5)
+    assert error_sum(potfit) == pytest.approx(error, rel=1e-5)
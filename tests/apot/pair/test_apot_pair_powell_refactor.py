@@ -0,0 +1,19 @@
+import pytest
+
+def cholesky_solves(potfit):
+    return int(potfit.stdout.split('linear equation systems solved with an updated Cholesky')[0].split()[-1])
+
+def test_apot_pair_powell_refactor(potfit, lj_input, powell_steps, error_sum):
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'updated Cholesky factorization' not in potfit.stdout
+    steps, error = powell_steps(potfit), error_sum(potfit)
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1, powell_refactor=20)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Matrix gamma singular' not in potfit.stderr
+    # the inner loop solved with cholesky_rank1() and cholesky_replace()
+    assert cholesky_solves(potfit) > 0
+    assert powell_steps(potfit) == pytest.approx(steps, rel=1e-5)
+    assert error_sum(potfit) == pytest.approx(error, rel=1e-5)
@@ -0,0 +1,45 @@
+import os
+
+def test_apot_pair_restart_simann(potfit, lj_input, run_until, error_sum):
+    potfit.filenames.append(os.path.join(potfit.cwd, 'checkpoint'))
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, seed=7, checkpoint='checkpoint', checkpoint_interval=0)
+    potfit.run()
+    assert potfit.has_no_error()
+    reference = (potfit.endpot, error_sum(potfit))
+    os.remove(os.path.join(potfit.cwd, 'checkpoint'))
+    run_until(potfit, '  2\t')
+    assert os.path.isfile(os.path.join(potfit.cwd, 'checkpoint'))
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, seed=7, checkpoint='checkpoint', checkpoint_interval=0, restart=1)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Resuming the optimization from checkpoint checkpoint' in potfit.stdout
+    assert 'Determining optimal starting temperature' not in potfit.stdout
+    assert (potfit.endpot, error_sum(potfit)) == reference
+
+def test_apot_pair_restart_powell(potfit, lj_input, error_sum):
+    potfit.filenames.append(os.path.join(potfit.cwd, 'checkpoint'))
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1, checkpoint='checkpoint', checkpoint_interval=0)
+    potfit.run()
+    assert potfit.has_no_error()
+    reference = (potfit.endpot, error_sum(potfit))
+    # the last checkpoint is from the last outer loop of the powell minimization
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1, checkpoint='checkpoint', checkpoint_interval=0, restart=1)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Resuming the optimization from checkpoint checkpoint' in potfit.stdout
+    assert 'Starting powell minimization' in potfit.stdout
+    assert (potfit.endpot, error_sum(potfit)) == reference
+
+def test_apot_pair_restart_no_checkpoint(potfit, lj_potential):
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1, checkpoint='checkpoint', restart=1)
+    potfit.create_config_file()
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Checkpoint file checkpoint not found' in potfit.stderr
+
+def test_apot_pair_restart_missing_file(potfit, lj_potential):
+    potfit.create_param_file(opt=1, restart=1)
+    potfit.create_config_file()
+    potfit.run()
+    assert potfit.has_error()
+    assert 'restart in param_file needs a checkpoint file' in potfit.stderr
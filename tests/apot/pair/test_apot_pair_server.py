@@ -0,0 +1,122 @@
+import os
+import pytest
+import shutil
+
+potential = '''
+#F 0 1
+#T PAIR
+#I 0
+#E
+
+type lj
+cutoff {}
+epsilon {} 0 1
+sigma 2.5 1 4
+'''
+
+def create_job(potfit, name, content):
+    f = potfit.create_file(os.path.join('spool', name + '.job'))
+    f.write(content)
+    f.close()
+
+@pytest.fixture()
+def spool(potfit):
+    path = os.path.join(potfit.cwd, 'spool')
+    os.makedirs(path, exist_ok=True)
+    yield path
+    shutil.rmtree(path)
+
+def test_apot_pair_server(potfit, spool):
+    potfit.create_param_file(server_dir='spool')
+    potfit.create_potential_file(potential.format(6.0, 0.1))
+    f = potfit.create_file('pot_b')
+    f.write(potential.format(6.0, 0.5))
+    f.close()
+    potfit.create_config_file()
+    create_job(potfit, 'a', 'endpot end_a\n')
+    create_job(potfit, 'b', 'startpot pot_b\nendpot end_b\n')
+    potfit.create_file(os.path.join('spool', 'stop')).close()
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Server mode: waiting for jobs in spool' in potfit.stdout
+    assert 'Read 1 configuration' in potfit.stdout
+    assert potfit.stdout.count('calculating neighbor lists ... done') == 1
+    assert 'Job spool/a.done finished' in potfit.stdout
+    assert 'Job spool/b.done finished' in potfit.stdout
+    assert sorted(os.listdir(spool)) == ['a.done', 'b.done']
+    for name in ['end_a', 'end_b']:
+        filename = os.path.join(potfit.cwd, name)
+        potfit.filenames.append(filename)
+        assert os.path.isfile(filename)
+
+def test_apot_pair_server_incompatible_job(potfit, spool):
+    potfit.create_param_file(server_dir='spool')
+    potfit.create_potential_file(potential.format(6.0, 0.1))
+    f = potfit.create_file('pot_b')
+    f.write(potential.format(5.0, 0.1))
+    f.close()
+    potfit.create_config_file()
+    create_job(potfit, 'a', 'startpot pot_b\n')
+    create_job(potfit, 'b', 'config other_config\n')
+    potfit.create_file(os.path.join('spool', 'stop')).close()
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'different cutoff radius' in potfit.stderr
+    assert 'changes the configurations' in potfit.stderr
+    assert sorted(os.listdir(spool)) == ['a.failed', 'b.failed']
+
+def test_apot_pair_server_job_settings(potfit, spool):
+    potfit.create_param_file(server_dir='spool')
+    potfit.create_potential_file(potential.format(6.0, 0.1))
+    potfit.create_config_file()
+    create_job(potfit, 'a', 'opt 1\nanneal_temp 0\nendpot end_a\n')
+    create_job(potfit, 'b', 'endpot end_b\n')
+    potfit.create_file(os.path.join('spool', 'stop')).close()
+    potfit.filenames.extend(os.path.join(potfit.cwd, x) for x in ['end_a', 'end_b'])
+    potfit.run()
+    assert potfit.has_no_error()
+    job_a, job_b = potfit.stdout.split('Starting job')[1:]
+    assert 'Starting optimization' in job_a
+    # the overrides of job a do not carry over to job b
+    assert 'Starting optimization' not in job_b
+    assert 'Optimization disabled. Calculating errors.' in job_b
+    assert sorted(os.listdir(spool)) == ['a.done', 'b.done']
+
+def test_apot_pair_server_invalid_job(potfit, spool):
+    potfit.create_param_file(server_dir='spool')
+    potfit.create_potential_file(potential.format(6.0, 0.1))
+    potfit.create_config_file()
+    create_job(potfit, 'a', 'eng_weight -1\n')
+    create_job(potfit, 'b', 'cell_scale 0\n')
+    create_job(potfit, 'c', 'startpot no_such_file\n')
+    create_job(potfit, 'd', 'endpot end_d\n')
+    potfit.create_file(os.path.join('spool', 'stop')).close()
+    potfit.filenames.append(os.path.join(potfit.cwd, 'end_d'))
+    potfit.run()
+    # errors in a job only fail the job
+    assert potfit.returncode == 0
+    assert 'eng_weight is out of bounds' in potfit.stderr
+    assert 'cell_scale is "0.000000"' in potfit.stderr
+    assert 'Could not open file no_such_file' in potfit.stderr
+    assert sorted(os.listdir(spool)) == ['a.failed', 'b.failed', 'c.failed', 'd.done']
+
+def test_apot_pair_server_job_tempfile(potfit, spool):
+    potfit.create_param_file(server_dir='spool', opt=1, anneal_temp=1, eng_weight=1)
+    potfit.create_potential_file(potential.format(6.0, 0.1))
+    potfit.create_config_file()
+    create_job(potfit, 'a', 'tempfile temp_a\nendpot end_a\n')
+    create_job(potfit, 'b', 'tempfile temp_b\nflagfile stop_b\nendpot end_b\n')
+    potfit.create_file('stop_b').close()
+    potfit.create_file(os.path.join('spool', 'stop')).close()
+    potfit.filenames.extend(os.path.join(potfit.cwd, x) for x in ['end_a', 'end_b', 'temp_a', 'temp_b'])
+    potfit.run()
+    assert potfit.has_no_error()
+    job_a, job_b = potfit.stdout.split('Starting job')[1:]
+    # the writer follows the file names of each job
+    assert 'break flagfile' not in job_a
+    assert 'Annealing terminated in presence of break flagfile "stop_b"' in job_b
+    assert not os.path.isfile(os.path.join(potfit.cwd, 'stop_b'))
+    for name in ['a', 'b']:
+        with open(os.path.join(potfit.cwd, 'temp_' + name)) as f:
+            with open(os.path.join(potfit.cwd, 'end_' + name)) as g:
+                assert f.read() == g.read()
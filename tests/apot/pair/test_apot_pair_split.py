@@ -0,0 +1,11 @@
+def test_apot_pair_split_atoms_without_mpi(potfit, lj_potential, error_sum):
+    potfit.create_param_file()
+    potfit.create_config_file()
+    potfit.run()
+    assert potfit.has_no_error()
+    reference = error_sum(potfit)
+    potfit.create_param_file(split_atoms=10)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'split_atoms has no effect without MPI' in potfit.stderr
+    assert error_sum(potfit) == reference
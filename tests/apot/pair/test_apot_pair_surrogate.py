@@ -0,0 +1,50 @@
+import os
+
+def skipped(potfit):
+    return int(potfit.stdout.split('Surrogate model skipped')[1].split()[0])
+
+def test_apot_pair_surrogate_simann(potfit, lj_input, error_sum):
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, seed=7, surrogate=50)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Surrogate model skipped' in potfit.stdout
+    assert skipped(potfit) > 0
+    assert error_sum(potfit) < 0.25
+
+def test_apot_pair_surrogate_off(potfit, lj_input):
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, seed=7)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Surrogate model' not in potfit.stdout
+
+def test_apot_pair_surrogate_restart(potfit, lj_input, run_until, error_sum):
+    potfit.filenames.append(os.path.join(potfit.cwd, 'checkpoint'))
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, seed=7, surrogate=50, checkpoint='checkpoint', checkpoint_interval=0)
+    potfit.run()
+    assert potfit.has_no_error()
+    reference = (potfit.endpot, error_sum(potfit), skipped(potfit))
+    os.remove(os.path.join(potfit.cwd, 'checkpoint'))
+    run_until(potfit, '  5\t')
+    assert os.path.isfile(os.path.join(potfit.cwd, 'checkpoint'))
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, seed=7, surrogate=50, checkpoint='checkpoint', checkpoint_interval=0, restart=1)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Resuming the optimization from checkpoint checkpoint' in potfit.stdout
+    assert (potfit.endpot, error_sum(potfit), skipped(potfit)) == reference
+
+def test_apot_pair_surrogate_ensemble(potfit, lj_input):
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, seed=7, surrogate=50)
+    potfit.run()
+    assert potfit.has_no_error()
+    reference = [x for x in potfit.stdout.split('\n') if 'Surrogate model' in x]
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, seed=7, surrogate=50, ensemble=3)
+    for i in range(3):
+        potfit.filenames.append(os.path.join(potfit.cwd, 'endpot.{}'.format(i)))
+    potfit.run()
+    assert potfit.has_no_error()
+    reports = [x for x in potfit.stdout.split('\n') if 'Surrogate model' in x]
+    assert len(reports) == 3
+    # every member starts with an empty archive
+    assert reports[0] == reference[0]
+    screened = [int(x.split(' of ')[1].split()[0]) for x in reports]
+    assert all(x < 2 * screened[0] for x in screened)
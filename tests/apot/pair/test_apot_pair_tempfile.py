@@ -0,0 +1,36 @@
+import os
+
+potential = '''
+#F 0 1
+#T PAIR
+#I 0
+#E
+
+type lj
+cutoff 6.0
+epsilon 0.1 0 1
+sigma 2.5 1 4
+'''
+
+def test_apot_pair_tempfile(potfit):
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, tempfile='temp_pot', tempfile_interval=60)
+    potfit.create_potential_file(potential)
+    potfit.create_config_file()
+    potfit.filenames.append(os.path.join(potfit.cwd, 'temp_pot'))
+    potfit.run()
+    assert potfit.has_no_error()
+    assert not os.path.isfile(os.path.join(potfit.cwd, 'temp_pot.tmp'))
+    # the potential held back by the interval is written at the end
+    with open(os.path.join(potfit.cwd, 'temp_pot')) as f:
+        assert f.read() == potfit.endpot
+
+def test_apot_pair_flagfile(potfit):
+    potfit.create_param_file(opt=1, anneal_temp=1, eng_weight=1, flagfile='stop')
+    potfit.create_potential_file(potential)
+    potfit.create_config_file()
+    potfit.create_file('stop').close()
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Annealing terminated in presence of break flagfile "stop"' in potfit.stdout
+    assert 'Fit terminated prematurely' not in potfit.stdout
+    assert not os.path.isfile(os.path.join(potfit.cwd, 'stop'))
@@ -24,3 +24,9 @@ def configure_html_report_env(request):
           break
       if remove:
         del request.config._metadata[key]
+
+def pytest_addoption(parser):
+    parser.addoption('--perf', action='store_true', default=False,
+                     help='run the performance regression tests in perf/')
+    parser.addoption('--perf-update', action='store_true', default=False,
+                     help='store the results of the performance tests as new baseline')
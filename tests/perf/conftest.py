@@ -0,0 +1,113 @@
+import json
+import os
+import platform
+import pytest
+import warnings
+
+# the number of atoms, force calculations and the memory usage do not depend
+# on the machine, their reference run is under version control
+shared_file = os.path.join(os.path.dirname(__file__), 'baseline.json')
+# the timings are only comparable on one machine, every host keeps its own
+# reference run (not under version control)
+host_file = os.path.join(os.path.dirname(__file__), 'baseline-{}.json'.format(platform.node()))
+results = {shared_file: {}, host_file: {}}
+
+# allowed increase relative to the reference run, None for exact values
+shared_tolerance = {
+    'fcalls': 0.1,
+    'natoms': None,
+    'peak_rss': 0.25,
+}
+
+host_tolerance = {
+    'overhead_time': 0.5,
+    'time_per_fcall': 0.5,
+}
+
+def pytest_runtest_logstart(nodeid, location):
+    path = location[0]
+    if not path.startswith('perf'):
+        raise pytest.UsageError("Please run the tests from the tests/ base directory!")
+
+def pytest_collection_modifyitems(config, items):
+    if config.getoption('--perf') or config.getoption('--perf-update'):
+        return
+    skip = pytest.mark.skip(reason='performance tests are only run with --perf')
+    for item in items:
+        if item.nodeid.startswith('perf/'):
+            item.add_marker(skip)
+
+def pytest_sessionfinish(session, exitstatus):
+    if not session.config.getoption('--perf-update'):
+        return
+    for filename, result in results.items():
+        if not len(result):
+            continue
+        data = load_baseline(filename)
+        data.update(result)
+        with open(filename, 'w') as f:
+            json.dump(data, f, indent=2, sort_keys=True)
+            f.write('\n')
+
+def load_baseline(filename):
+    if not os.path.isfile(filename):
+        return {}
+    with open(filename) as f:
+        return json.load(f)
+
+def compare(measured, stored, tolerance):
+    failed = []
+    for key, tol in sorted(tolerance.items()):
+        if tol is None:
+            if measured[key] != stored[key]:
+                failed.append('{}: {:g} != {:g}'.format(key, measured[key], stored[key]))
+            continue
+        # only increases are regressions, everything below the baseline passes
+        limit = stored[key] * (1.0 + tol)
+        if measured[key] > limit:
+            failed.append('{}: {:g} > {:g} (baseline {:g}, tolerance {:.0f}%)'.format(
+                key, measured[key], limit, stored[key], 100 * tol))
+    return failed
+
+def get_potfit_obj(model, interaction):
+    import sys
+    sys.path.insert(0, str(pytest.config.rootdir))
+    import potfit
+    # always build optimized binaries, the phase times are taken from the timing report
+    return potfit.Potfit(__file__, model, interaction, options=['timing'], release=True)
+
+@pytest.fixture()
+def potfit_perf():
+    objects = []
+    def factory(model, interaction):
+        p = get_potfit_obj(model, interaction)
+        p.reset()
+        # the fits write the tempfile
+        p.filenames.append(os.path.join(p.cwd, 'tempfile'))
+        objects.append(p)
+        return p
+    yield factory
+    for p in objects:
+        p.clear()
+
+@pytest.fixture()
+def baseline(request):
+    shared = load_baseline(shared_file)
+    host = load_baseline(host_file)
+    update = request.config.getoption('--perf-update')
+    def check(name, measured):
+        if update:
+            results[shared_file][name] = {x: measured[x] for x in shared_tolerance}
+            results[host_file][name] = {x: measured[x] for x in host_tolerance}
+            return
+        if not name in shared:
+            pytest.fail('no reference run of {} in {}'.format(name, shared_file))
+        failed = compare(measured, shared[name], shared_tolerance)
+        # a new host has no timings yet, only the shared values are checked
+        if name in host:
+            failed += compare(measured, host[name], host_tolerance)
+        if len(failed):
+            pytest.fail('performance regression in {}:\n  {}'.format(name, '\n  '.join(failed)))
+        if not name in host:
+            warnings.warn('no reference timings of {} on {}, run with --perf-update'.format(name, platform.node()))
+    return check
@@ -0,0 +1,109 @@
+import math
+import random
+import pytest
+
+# fixed seed fits on medium sized databases, the measured values are compared
+# against the reference runs in baseline.json and, for the timings, on the same
+# host (run with --perf, store the references with --perf-update)
+
+NCONF = 8
+NTYPES = 2
+CUTOFF = 6.0
+
+benchmarks = [
+    ('apot', 'pair'),
+    ('apot', 'eam'),
+    ('apot', 'stiweb'),
+    ('tab', 'pair'),
+    ('tab', 'eam'),
+]
+
+apot_functions = {
+    'pair': '3*morse',
+    'eam': '3*morse,2*csw2,2*bjs',
+}
+
+def write_config(potfit):
+    import sys
+    sys.path.insert(0, str(pytest.config.rootdir))
+    from potfit import simple_config
+    f = potfit.create_file('config')
+    for i in range(NCONF):
+        config = simple_config(ntypes=NTYPES, size=15, distance=2.5, seed=i + 1, energy=-2.5)
+        # displace the atoms, forces on a perfect lattice do not depend on the potential,
+        # the same displacements in every run keep the number of force calculations fixed
+        rng = random.Random(i + 1)
+        for atom in config.atoms.pos:
+            atom[1] = [x + rng.uniform(-0.15, 0.15) for x in atom[1]]
+        f.write(config.as_string())
+    f.close()
+    return NCONF * config.atom_count()
+
+def write_stiweb_potential(potfit):
+    # the makeapot defaults have a cutoff radius a of 1.0, which leaves no interactions
+    f = potfit.create_file('startpot')
+    f.write('#F 0 7\n#T STIWEB\n#I {}\n#E\n\n'.format(' '.join(['0'] * 7)))
+    for _ in range(3):
+        f.write('type stiweb_2\ncutoff {}\nA 20.0 1 100\nB 0.5 0 10\np 4.0 2 8\n'.format(CUTOFF))
+        f.write('q 1.0 0 4\ndelta 1.2 0.5 3\na 3.8 3 6\n\n')
+    for _ in range(3):
+        f.write('type stiweb_3\ncutoff {}\ngamma 1.2 0.5 3\nb 3.8 3 6\n\n'.format(CUTOFF))
+    f.write('type lambda\ncutoff {}\n'.format(CUTOFF))
+    for i, j, k in [(0, 0, 0), (0, 0, 1), (0, 1, 1), (1, 0, 0), (1, 0, 1), (1, 1, 1)]:
+        f.write('lambda_{}{}{} 2 0 30\n'.format(i, j, k))
+    f.close()
+
+def write_tab_potential(potfit, interaction):
+    def pair(r):
+        return 0.1 * (math.exp(-3.0 * (r - 2.5)) - 2.0 * math.exp(-1.5 * (r - 2.5)))
+    def density(r):
+        return math.exp(-1.2 * (r - 2.5)) * (r - CUTOFF) ** 2 / 12.0
+    def embedding(rho):
+        return -math.sqrt(rho) + 0.1 * rho * rho
+    columns = [(pair, 1.0, CUTOFF)] * 3
+    if interaction == 'eam':
+        columns += [(density, 1.0, CUTOFF)] * NTYPES + [(embedding, 0.0, 4.0)] * NTYPES
+    npoints = 15
+    f = potfit.create_file('startpot')
+    f.write('#F 3 {}\n#T {}\n#I {}\n#E\n\n'.format(len(columns), interaction.upper(), ' '.join(['0'] * len(columns))))
+    for col in columns:
+        f.write('{} {} {}\n'.format(col[1], col[2], npoints))
+    for col in columns:
+        f.write('\n')
+        for i in range(npoints):
+            f.write('{:.10e}\n'.format(col[0](col[1] + i * (col[2] - col[1]) / (npoints - 1))))
+    f.close()
+
+def read_timing_report(report):
+    fcalls = int(report.split('\n')[0].split()[4])
+    for line in report.split('\n'):
+        items = line.split()
+        if len(items) == 4 and items[0] == 'calc_forces':
+            return fcalls, float(items[1])
+    pytest.fail('calc_forces time missing in timing report')
+
+@pytest.mark.parametrize('model,interaction', benchmarks)
+def test_perf(potfit_perf, baseline, model, interaction):
+    potfit = potfit_perf(model, interaction)
+    potfit.create_param_file(ntypes=NTYPES, opt=1, anneal_temp=0, seed=42, eng_weight=1)
+    if model == 'apot' and interaction == 'stiweb':
+        write_stiweb_potential(potfit)
+    elif model == 'apot':
+        args = '-n {} -i {} -c {}'.format(NTYPES, interaction, CUTOFF)
+        potfit.call_makeapot('startpot', args + ' -f {}'.format(apot_functions[interaction]))
+    else:
+        write_tab_potential(potfit, interaction)
+    natoms = write_config(potfit)
+    potfit.run()
+    assert potfit.has_no_error()
+    assert 'Read {} configurations ({} with forces, 0 with stresses)'.format(NCONF, NCONF) in potfit.stdout
+    fcalls, calc_time = read_timing_report(potfit.timing)
+    assert fcalls > 0
+    baseline('{}_{}'.format(model, interaction), {
+        'natoms': natoms,
+        'fcalls': fcalls,
+        'time_per_fcall': calc_time / fcalls,
+        # reading the input, building the neighbor lists and the optimizer itself
+        'overhead_time': potfit.walltime - calc_time,
+        'peak_rss': potfit.peak_rss,
+    })
@@ -6,6 +6,7 @@ import random
 import re
 import string
 import subprocess
+import time
 
 from itertools import product
 
@@ -15,6 +16,7 @@ class Potfit:
         self.model = model
         self.interaction = interaction
         self.options = options
+        self.release = kwargs.get('release', False)
         self.filenames = []
         self.mindist_pattern = re.compile('Minimal Distances Matrix:[\w\W]*?\n\n', re.MULTILINE)
         if 'git_patch' in kwargs:
@@ -34,6 +36,8 @@ class Potfit:
         self.punish = str()
         self.rho_loc = str()
         self.returncode = 0
+        self.walltime = 0.0
+        self.peak_rss = 0
         self.config = None
 
     def create_file(self, filename, **kwargs):
@@ -99,16 +103,22 @@ class Potfit:
         f.write(self.config.as_string())
         f.close()
 
-    def run(self, param_file='param_file', args=[]):
+    def run(self, param_file='param_file', args=[], mpi=0):
         asan_filename = 'asan_{}'.format(''.join(random.choice(string.ascii_uppercase + string.digits) for _ in range(6)))
         os.environ['ASAN_OPTIONS'] = 'log_path={},exitcode=99,strip_path_prefix={}'.format(asan_filename,os.path.abspath('..') + '/build/../')
         cmd = [os.path.join(os.path.abspath('../bin'), self.binary_name)]
+        if mpi:
+            cmd = ['mpirun', '--oversubscribe', '-np', str(mpi)] + cmd
         if len(args):
             cmd.extend(args)
         if param_file != None:
             cmd.append(param_file)
+        start = time.monotonic()
         p = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, cwd=self.cwd)
-        p.wait()
+        _, status, usage = os.wait4(p.pid, 0)
+        p.returncode = os.waitstatus_to_exitcode(status)
+        self.walltime = time.monotonic() - start
+        self.peak_rss = usage.ru_maxrss
         self.stdout = p.stdout.read().decode('ascii')
         self.stderr = p.stderr.read().decode('ascii')
         try:
@@ -197,6 +207,8 @@ class Potfit:
         cmd = ['./waf', 'configure', '-c', 'no', '-m', self.model, '-i', self.interaction]
         for opt in self.options:
             cmd.append('--enable-{}'.format(opt))
+        if self.release:
+            return cmd
         cmd.append('--asan')
         cmd.append('--debug')
         cmd.append('--check-c-compiler=clang')
@@ -0,0 +1,57 @@
+import math
+import os
+import pytest
+import random
+
+from itertools import product
+
+CUTOFF = 5.5
+
+def potential():
+    # two atom types with different transfer functions
+    def pair(a):
+        return lambda r: a * (math.exp(-3.0 * (r - 2.5)) - 2.0 * math.exp(-1.5 * (r - 2.5)))
+    def density(a):
+        return lambda r: math.exp(-a * (r - 2.5)) * (r - CUTOFF) ** 2 / 60.0
+    def embedding(a):
+        return lambda rho: a * (rho - 1.0) ** 2 - 1.0
+    columns = [(pair(a), 1.5, CUTOFF) for a in [0.1, 0.12, 0.08]]
+    columns += [(density(a), 1.5, CUTOFF) for a in [1.2, 1.0]]
+    columns += [(embedding(a), 0.0, 3.0) for a in [0.5, 0.4]]
+    pot = '#F 3 {}\n#T EAM\n#I {}\n#E\n\n'.format(len(columns), ' '.join(['0'] * len(columns)))
+    pot += ''.join('{} {} 15\n'.format(c[1], c[2]) for c in columns)
+    for c in columns:
+        pot += '\n' + ''.join('{:.10e}\n'.format(c[0](c[1] + i * (c[2] - c[1]) / 14)) for i in range(15))
+    return pot
+
+def configuration(cells, seed):
+    # simple cubic lattice with random displacements and types
+    rng = random.Random(seed)
+    size = 2.5 * cells
+    config  = '#N {} 1\n#C 0 1\n'.format(cells ** 3)
+    config += '#X {} 0 0\n#Y 0 {} 0\n#Z 0 0 {}\n'.format(size, size, size)
+    config += '#E {:.6f}\n#F\n'.format(rng.uniform(-2, -1))
+    for i, j, k in product(range(cells), repeat=3):
+        pos = [2.5 * x + rng.uniform(-0.2, 0.2) for x in [i, j, k]]
+        force = [rng.uniform(-1, 1) for _ in range(3)]
+        config += '{} {}\n'.format(rng.randrange(2), ' '.join('{:.6f}'.format(x) for x in pos + force))
+    return config
+
+def powell_steps(potfit):
+    out = potfit.stdout.split('Starting powell minimization')[1].split('Finished powell')[0]
+    return [float(x.split()[1]) for x in out.split('\n') if x and x.split()[0].isdigit()]
+
+# error sums of the powell steps of the sequential force calculation
+SEQUENTIAL = [526.754574, 519.328371, 519.321906, 519.321516, 475.750337, 417.98457, 405.333974, 321.943225]
+
+def test_tab_eam_batch_powell(potfit):
+    potfit.create_param_file(ntypes=2, opt=1, anneal_temp=0, eng_weight=1)
+    potfit.create_potential_file(potential())
+    potfit.create_config_file(data=''.join(configuration(c, s) for c, s in [(3, 1), (4, 2)]))
+    potfit.filenames.append(os.path.join(potfit.cwd, 'tempfile'))
+    potfit.run()
+    assert potfit.has_no_error()
+    # the derivatives are calculated in batches, the steps are unchanged
+    errors = powell_steps(potfit)
+    assert errors[:len(SEQUENTIAL)] == pytest.approx(SEQUENTIAL, rel=1e-6)
+    assert errors[-1] == pytest.approx(134.708498, rel=1e-4)
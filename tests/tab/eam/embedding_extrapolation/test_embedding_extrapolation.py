@@ -0,0 +1,71 @@
+import pytest
+
+# linear embedding function F(rho) = 0.5 * rho - 1.0 on [{}, {}]
+POTENTIAL = '''
+#F 3 3
+#G 2 3 3
+#I 0 0 0
+#E
+
+1.7785714285714285e+00 9.0000000000000000e+00 14
+4.6483646502270971e-02 7.3000328284430382e-01 6
+{} {} 6
+
+-2.1847554330621324e+00 0.0000000000000000e+00
+8.4255614529302880e-01
+2.0271471509245159e-01
+2.2155522312087100e-02
+-6.8303638148139376e-02
+-4.9043278969706922e-02
+-1.0946697911942214e-02
+-1.0298525723152156e-02
+-6.5685589306463460e-03
+-2.0283626156443295e-03
+1.2197714420628298e-02
+2.2148801387662245e-02
+1.4461939319528331e-02
+9.9020972820913523e-03
+0.0000000000000000e+00
+
+-9.7346191762795655e+00 -8.3400770422903880e-01
+-1.7029968465264708e-01
+-7.0953418018180781e-01
+-7.5376948251785270e-01
+-7.3385648876540044e-01
+-4.9170304973223794e-01
+-4.3769486509661026e-01
+
+5.0000000000000000e-01 5.0000000000000000e-01
+{}
+'''
+
+def embedding_potential(begin, end):
+    values = [0.5 * (begin + i * (end - begin) / 5.0) - 1.0 for i in range(6)]
+    return POTENTIAL.format(begin, end, '\n'.join('{:.16e}'.format(x) for x in values))
+
+def error_sum(potfit):
+    return float([x for x in potfit.stdout.split('\n') if 'total error sum' in x][-1].split()[3].strip(','))
+
+def densities(potfit):
+    atoms = potfit.rho_loc.split('\n\n')[0].split('\n')[1:]
+    return [float(x.split()[2]) for x in atoms]
+
+def run(potfit, begin, end):
+    potfit.create_param_file(opt=0)
+    potfit.create_potential_file(embedding_potential(begin, end))
+    potfit.create_config_file()
+    potfit.run()
+    assert potfit.has_no_error()
+    assert '3 EAM potentials' in potfit.stdout
+    return error_sum(potfit), densities(potfit)
+
+def test_embedding_extrapolation(potfit):
+    # a linear embedding function is extrapolated exactly, so the densities
+    # outside of the short table give the same errors as the long table
+    reference, rho = run(potfit, 0.0, 20.0)
+    assert max(rho) < 20.0
+    assert min(rho) < 0.9 or max(rho) > 1.1
+    potfit.clear()
+    potfit.reset()
+    value, _ = run(potfit, 0.9, 1.1)
+    assert value == pytest.approx(reference, rel=1e-9)
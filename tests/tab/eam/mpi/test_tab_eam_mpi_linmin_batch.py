@@ -0,0 +1,90 @@
+import os
+import pytest
+import random
+
+potential = '''#F 3 3
+#T EAM
+#I 0 0 0
+#E
+
+1.0 6.0 5
+1.0 6.0 5
+0.0 2.0 5
+
+0.4
+0.1
+-0.05
+-0.01
+0.0
+
+0.5
+0.2
+0.1
+0.05
+0.0
+
+0.0
+-0.4
+-0.5
+-0.4
+0.0
+'''
+
+def test_tab_eam_mpi_linmin_batch(potfit):
+    potfit.create_param_file(opt=0, stress_weight=1, linmin_batch=4)
+    potfit.create_potential_file(potential)
+    potfit.create_config_file()
+    potfit.run(mpi=1)
+    assert potfit.has_no_error()
+    assert 'linmin_batch is ignored' in potfit.stderr
+
+def error_sum(potfit):
+    return float([x for x in potfit.stdout.split('\n') if 'total error sum' in x][-1].split()[3].strip(','))
+
+def write_config(potfit):
+    # every process of a group needs a configuration
+    import sys
+    sys.path.insert(0, str(pytest.config.rootdir))
+    from potfit import simple_config
+    f = potfit.create_file('config')
+    for i in range(4):
+        config = simple_config(size=4, seed=i + 1, energy=-1.0 - 0.1 * i)
+        rng = random.Random(i + 1)
+        for atom in config.atoms.pos:
+            atom[1] = [x + rng.uniform(-0.15, 0.15) for x in atom[1]]
+        f.write(config.as_string())
+    f.close()
+
+def run_opt(potfit, np, **kwargs):
+    potfit.clear()
+    potfit.reset()
+    potfit.create_param_file(opt=1, anneal_temp=0, eng_weight=1, stress_weight=1, linmin_batch=4, seed=42, **kwargs)
+    potfit.create_potential_file(potential)
+    write_config(potfit)
+    potfit.filenames.append(os.path.join(potfit.cwd, 'tempfile'))
+    potfit.run(mpi=np)
+    assert potfit.has_no_error()
+    return error_sum(potfit)
+
+def test_tab_eam_mpi_linmin_batch_groups(potfit):
+    # groups of one process calculate every vector like the serial code,
+    # the number of groups must not change the result
+    reference = run_opt(potfit, 2, mpi_groups=2)
+    assert 'linmin_batch is ignored' not in potfit.stderr
+    assert '2 groups of 1 processes calculate the force batches' in potfit.stdout
+    value = run_opt(potfit, 3, mpi_groups=3)
+    assert '3 groups of 1 processes calculate the force batches' in potfit.stdout
+    assert value == reference
+
+def test_tab_eam_mpi_linmin_batch_split_groups(potfit):
+    run_opt(potfit, 4, mpi_groups=2)
+    assert '2 groups of 2 processes calculate the force batches' in potfit.stdout
+    assert 'force calculations' in potfit.stdout
+
+def test_tab_eam_mpi_groups_divide(potfit):
+    potfit.create_param_file(opt=0, stress_weight=1, mpi_groups=2)
+    potfit.create_potential_file(potential)
+    potfit.create_config_file()
+    potfit.run(mpi=3)
+    assert potfit.has_error()
+    assert 'has to divide the number of MPI processes' in potfit.stderr
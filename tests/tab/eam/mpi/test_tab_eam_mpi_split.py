@@ -0,0 +1,76 @@
+import math
+import pytest
+import random
+
+from itertools import product
+
+CUTOFF = 6.0
+
+def potential():
+    def pair(r):
+        return 0.1 * (math.exp(-3.0 * (r - 2.5)) - 2.0 * math.exp(-1.5 * (r - 2.5)))
+    def density(r):
+        return math.exp(-1.2 * (r - 2.5)) * (r - CUTOFF) ** 2 / 12.0
+    def embedding(rho):
+        return -math.sqrt(rho) + 0.01 * rho * rho
+    columns = [(pair, 1.0, CUTOFF), (density, 1.0, CUTOFF), (embedding, 0.0, 12.0)]
+    pot = '#F 3 3\n#T EAM\n#I 0 0 0\n#E\n\n'
+    pot += ''.join('{} {} 20\n'.format(c[1], c[2]) for c in columns)
+    for c in columns:
+        pot += '\n' + ''.join('{:.10e}\n'.format(c[0](c[1] + i * (c[2] - c[1]) / 19)) for i in range(20))
+    return pot
+
+def configuration(cells, seed):
+    # simple cubic lattice with random displacements
+    rng = random.Random(seed)
+    size = 2.5 * cells
+    config  = '#N {} 1\n#C 0\n'.format(cells ** 3)
+    config += '#X {} 0 0\n#Y 0 {} 0\n#Z 0 0 {}\n'.format(size, size, size)
+    config += '#E {:.6f}\n'.format(rng.uniform(-2, -1))
+    config += '#S {}\n'.format(' '.join('{:.6f}'.format(rng.uniform(-0.01, 0.01)) for _ in range(6)))
+    config += '#F\n'
+    for i, j, k in product(range(cells), repeat=3):
+        pos = [2.5 * x + rng.uniform(-0.2, 0.2) for x in [i, j, k]]
+        force = [rng.uniform(-1, 1) for _ in range(3)]
+        config += '0 {}\n'.format(' '.join('{:.6f}'.format(x) for x in pos + force))
+    return config
+
+def error_sum(potfit):
+    return float([x for x in potfit.stdout.split('\n') if 'total error sum' in x][-1].split()[3].strip(','))
+
+def values(output):
+    result = []
+    for x in output.split():
+        try:
+            result.append(float(x))
+        except ValueError:
+            pass
+    return result
+
+def run(potfit, np, **kwargs):
+    potfit.clear()
+    potfit.reset()
+    potfit.create_param_file(opt=0, eng_weight=1, stress_weight=1, **kwargs)
+    potfit.create_potential_file(potential())
+    potfit.create_config_file(data=''.join(configuration(c, s) for c, s in [(2, 1), (6, 2), (4, 3), (5, 4)]))
+    potfit.run(mpi=np)
+    assert potfit.has_no_error()
+    return error_sum(potfit), {x: values(getattr(potfit, x)) for x in ['force', 'energy', 'stress']}
+
+@pytest.mark.parametrize('np', [2, 3, 5])
+def test_tab_eam_mpi_split(potfit, np):
+    reference, output = run(potfit, 1)
+    value, split = run(potfit, np, split_atoms=10)
+    assert 'configurations are split across processes' in potfit.stdout
+    # the weighted forces of every atom enter the error sum
+    assert value == pytest.approx(reference, rel=1e-12)
+    for key in output:
+        assert split[key] == pytest.approx(output[key], rel=1e-9, abs=1e-12)
+
+def test_tab_eam_mpi_unsplit(potfit):
+    reference, output = run(potfit, 1)
+    value, mpi = run(potfit, 3)
+    assert 'configurations are split across processes' not in potfit.stdout
+    assert value == pytest.approx(reference, rel=1e-12)
+    for key in output:
+        assert mpi[key] == pytest.approx(output[key], rel=1e-9, abs=1e-12)
@@ -0,0 +1,342 @@
+#!/usr/bin/env python3
+
+# Benchmark the potfit force routines on synthetic configuration databases.
+#
+# For every requested model/interaction a potfit binary with the timing
+# option is built, a database of crystalline or liquid configurations is
+# generated and a short powell fit is run. The phase timers of potfit
+# (<output_prefix>.timing) provide the time spent in calc_forces.
+#
+# Run it from the potfit base directory, e.g.
+#
+#   util/devel/bench_potfit.py --cells 4 --output bench.json
+#   util/devel/bench_potfit.py -i eam -m tab --lattice liquid --ntypes 3
+
+import argparse
+import json
+import math
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+
+# interactions which are benchmarked for every model
+benchmarks = [
+    ['apot', 'pair'],
+    ['apot', 'eam'],
+    ['apot', 'adp'],
+    ['apot', 'meam'],
+    ['apot', 'tersoff'],
+    ['apot', 'stiweb'],
+    ['apot', 'coulomb'],
+    ['tab', 'pair'],
+    ['tab', 'eam'],
+    ['tab', 'adp'],
+    ['tab', 'meam'],
+]
+
+# basis of the cubic unit cells in units of the lattice constant
+lattices = {
+    'fcc': [[0, 0, 0], [0.5, 0.5, 0], [0.5, 0, 0.5], [0, 0.5, 0.5]],
+    'bcc': [[0, 0, 0], [0.5, 0.5, 0.5]],
+    'diamond': [[0, 0, 0], [0.5, 0.5, 0], [0.5, 0, 0.5], [0, 0.5, 0.5],
+                [0.25, 0.25, 0.25], [0.75, 0.75, 0.25], [0.75, 0.25, 0.75], [0.25, 0.75, 0.75]],
+}
+
+# nearest neighbor distance of the synthetic structures
+nn_dist = {
+    'default': 2.5,
+    'tersoff': 2.35,
+    'stiweb': 2.35,
+}
+
+# covalent interactions are benchmarked on the diamond lattice
+default_lattice = {
+    'tersoff': 'diamond',
+    'stiweb': 'diamond',
+}
+
+CUTOFF = 6.0
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(
+        description='Benchmark the potfit force routines on synthetic databases.')
+    parser.add_argument('-m', '--model', choices=['apot', 'tab'], action='append',
+                        help='only benchmark this model (can be repeated)')
+    parser.add_argument('-i', '--interaction', action='append',
+                        help='only benchmark this interaction (can be repeated)')
+    parser.add_argument('--lattice', choices=sorted(lattices) + ['liquid'],
+                        help='structure of the configurations (default: fcc, diamond for tersoff and stiweb)')
+    parser.add_argument('--cells', type=int, default=3,
+                        help='number of unit cells in each direction (default 3)')
+    parser.add_argument('--nconf', type=int, default=4,
+                        help='number of configurations (default 4)')
+    parser.add_argument('--ntypes', type=int, default=2,
+                        help='number of atom types (default 2)')
+    parser.add_argument('--seed', type=int, default=42)
+    parser.add_argument('--output', metavar='FILE',
+                        help='write the results as JSON to FILE instead of stdout')
+    parser.add_argument('--no-build', action='store_true',
+                        help='use the binaries from a previous run in bin/')
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the generated input files')
+    parser.add_argument('waf_args', nargs='*',
+                        help='additional arguments for waf configure (after --)')
+    return parser.parse_args()
+
+
+def build_binary(model, interaction, args):
+    cmd = ['./waf', 'configure', '-m', model, '-i', interaction, '--enable-timing'] + args.waf_args
+    if not args.no_build:
+        if subprocess.call(cmd, stdout=subprocess.DEVNULL):
+            raise RuntimeError('error calling "{}"'.format(' '.join(cmd)))
+        p = subprocess.run(['./waf', 'build'], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        if p.returncode:
+            raise RuntimeError(p.stderr.decode('ascii'))
+    name = 'potfit_{}_{}'.format(model, interaction)
+    candidates = [x for x in os.listdir('bin') if x.startswith(name) and 'timing' in x]
+    if not len(candidates):
+        raise RuntimeError('no binary found for {}'.format(name))
+    return os.path.abspath(os.path.join('bin', sorted(candidates, key=len)[0]))
+
+
+def generate_positions(lattice, cells, nn, rng):
+    if lattice == 'liquid':
+        # random positions at fcc density, no two atoms closer than 0.7 nn
+        a = nn * math.sqrt(2.0)
+        box = cells * a
+        natoms = 4 * cells ** 3
+        mindist = (0.7 * nn) ** 2
+        pos = []
+        tries = 0
+        while len(pos) < natoms:
+            tries += 1
+            if tries > 1000 * natoms:
+                raise RuntimeError('could not place {} atoms in the liquid configuration'.format(natoms))
+            p = [rng.uniform(0, box) for _ in range(3)]
+            ok = True
+            for q in pos:
+                d = [p[k] - q[k] - box * round((p[k] - q[k]) / box) for k in range(3)]
+                if d[0] * d[0] + d[1] * d[1] + d[2] * d[2] < mindist:
+                    ok = False
+                    break
+            if ok:
+                pos.append(p)
+        return box, pos
+    basis = lattices[lattice]
+    a = {'fcc': nn * math.sqrt(2.0), 'bcc': nn * 2.0 / math.sqrt(3.0),
+         'diamond': nn * 4.0 / math.sqrt(3.0)}[lattice]
+    pos = []
+    for i in range(cells):
+        for j in range(cells):
+            for k in range(cells):
+                for b in basis:
+                    pos.append([a * (i + b[0]) + rng.uniform(-0.05, 0.05) * nn,
+                                a * (j + b[1]) + rng.uniform(-0.05, 0.05) * nn,
+                                a * (k + b[2]) + rng.uniform(-0.05, 0.05) * nn])
+    return cells * a, pos
+
+
+def write_config(filename, lattice, args, nn, rng):
+    natoms = 0
+    with open(filename, 'w') as f:
+        for _ in range(args.nconf):
+            box, pos = generate_positions(lattice, args.cells, nn, rng)
+            natoms += len(pos)
+            f.write('#N {} 1\n'.format(len(pos)))
+            f.write('#C {}\n'.format(' '.join([str(s) for s in range(args.ntypes)])))
+            f.write('## synthetic {} configuration\n'.format(lattice))
+            f.write('#X {:.6f} 0 0\n#Y 0 {:.6f} 0\n#Z 0 0 {:.6f}\n'.format(box, box, box))
+            f.write('#E {:.6f}\n'.format(rng.uniform(-4, -2)))
+            f.write('#F\n')
+            for p in pos:
+                f.write('{} {:.6f} {:.6f} {:.6f} {:.6f} {:.6f} {:.6f}\n'.format(
+                    rng.randrange(args.ntypes), *p, *[rng.uniform(-0.5, 0.5) for _ in range(3)]))
+    return natoms
+
+
+def paircol(ntypes):
+    return ntypes * (ntypes + 1) // 2
+
+
+def makeapot(filename, interaction, ntypes):
+    n = ntypes
+    p = paircol(n)
+    functions = {
+        'pair': '{}*morse'.format(p),
+        'eam': '{}*morse,{}*csw2,{}*bjs'.format(p, n, n),
+        'adp': '{}*morse,{}*csw2,{}*bjs,{}*csw2,{}*csw2'.format(p, n, n, p, p),
+        'meam': '{}*morse,{}*csw2,{}*bjs,{}*csw2,{}*poly_5'.format(p, n, n, p, n),
+    }
+    cmd = [os.path.abspath('util/makeapot'), '-o', filename, '-n', str(n), '-i', interaction,
+           '-c', str(CUTOFF)]
+    if interaction in functions:
+        cmd.extend(['-f', functions[interaction]])
+    if subprocess.call(cmd, stderr=subprocess.DEVNULL):
+        raise RuntimeError('error calling "{}"'.format(' '.join(cmd)))
+
+
+def write_coulomb_potential(filename, ntypes):
+    with open(filename, 'w') as f:
+        f.write('#F 0 {}\n#T ELSTAT\n#I {}\n#E\n\n'.format(paircol(ntypes), ' '.join(['0'] * paircol(ntypes))))
+        for _ in range(paircol(ntypes)):
+            f.write('type morse\ncutoff {}\nD 0.1 0 1\na 1.5 0.5 3\nr0 2.8 2 4\n\n'.format(CUTOFF))
+        f.write('elstat\nratio {}\n'.format(' '.join(['1'] * ntypes)))
+        for i in range(ntypes - 1):
+            f.write('charge_{} {} 0 2\n'.format(i, 0.8 if i % 2 == 0 else -0.8))
+        f.write('dp_kappa 0.2 0.1 0.5\n')
+
+
+def write_tab_potential(filename, interaction, ntypes):
+    n = ntypes
+    p = paircol(n)
+
+    def pair(r):
+        return 0.1 * (math.exp(-3.0 * (r - 2.5)) - 2.0 * math.exp(-1.5 * (r - 2.5)))
+
+    def density(r):
+        return math.exp(-1.2 * (r - 2.5)) * (r - CUTOFF) ** 2 / 12.0
+
+    def embedding(rho):
+        return -math.sqrt(rho) + 0.1 * rho * rho
+
+    def angular(c):
+        return 0.5 + 0.2 * c + 0.1 * c * c
+
+    columns = {
+        'pair': [(pair, 1.0, CUTOFF)] * p,
+        'eam': [(pair, 1.0, CUTOFF)] * p + [(density, 1.0, CUTOFF)] * n + [(embedding, 0.0, 4.0)] * n,
+        'adp': [(pair, 1.0, CUTOFF)] * p + [(density, 1.0, CUTOFF)] * n + [(embedding, 0.0, 4.0)] * n +
+               [(density, 1.0, CUTOFF)] * (2 * p),
+        'meam': [(pair, 1.0, CUTOFF)] * p + [(density, 1.0, CUTOFF)] * n + [(embedding, 0.0, 4.0)] * n +
+                [(density, 1.0, CUTOFF)] * p + [(angular, -1.0, 1.0)] * n,
+    }[interaction]
+    npoints = 20
+    with open(filename, 'w') as f:
+        f.write('#F 3 {}\n#T {}\n#I {}\n#E\n\n'.format(len(columns), interaction.upper(),
+                                                        ' '.join(['0'] * len(columns))))
+        for col in columns:
+            f.write('{} {} {}\n'.format(col[1], col[2], npoints))
+        for col in columns:
+            f.write('\n')
+            for i in range(npoints):
+                f.write('{:.10e}\n'.format(col[0](col[1] + i * (col[2] - col[1]) / (npoints - 1))))
+
+
+def write_param_file(filename, interaction, args):
+    with open(filename, 'w') as f:
+        f.write('ntypes {}\n'.format(args.ntypes))
+        f.write('config config\nstartpot startpot\nendpot endpot\ntempfile tempfile\n')
+        f.write('output_prefix bench\nopt 1\nanneal_temp 0\n')
+        f.write('seed {}\neng_weight 1\n'.format(args.seed))
+        if interaction == 'coulomb':
+            f.write('dp_cut {}\n'.format(CUTOFF))
+
+
+def read_timing_report(filename):
+    result = {'phases': {}, 'neighbors': 0}
+    section = None
+    with open(filename) as f:
+        for line in f:
+            if line.startswith('# phase totals'):
+                section = 'phases'
+            elif line.startswith('# per process'):
+                section = None
+            elif line.startswith('# per configuration'):
+                section = 'configs'
+            if line.startswith('#'):
+                continue
+            items = line.split()
+            if section == 'phases':
+                result['phases'][items[0]] = {'time': float(items[1]), 'calls': int(float(items[2]))}
+            elif section == 'configs':
+                result['neighbors'] += int(float(items[2]))
+    return result
+
+
+def run_benchmark(model, interaction, args, workdir):
+    rng = random.Random(args.seed)
+    lattice = args.lattice or default_lattice.get(interaction, 'fcc')
+    nn = nn_dist.get(interaction, nn_dist['default'])
+    binary = build_binary(model, interaction, args)
+
+    natoms = write_config(os.path.join(workdir, 'config'), lattice, args, nn, rng)
+    startpot = os.path.join(workdir, 'startpot')
+    if model == 'tab':
+        write_tab_potential(startpot, interaction, args.ntypes)
+    elif interaction == 'coulomb':
+        write_coulomb_potential(startpot, args.ntypes)
+    else:
+        makeapot(startpot, interaction, args.ntypes)
+    write_param_file(os.path.join(workdir, 'param'), interaction, args)
+
+    # wait4 provides the peak resident set size (in kB) of the potfit process
+    with open(os.path.join(workdir, 'stdout'), 'w') as out, open(os.path.join(workdir, 'stderr'), 'w') as err:
+        p = subprocess.Popen([binary, 'param'], cwd=workdir, stdout=out, stderr=err)
+        _, status, usage = os.wait4(p.pid, 0)
+        p.returncode = os.waitstatus_to_exitcode(status)
+    if p.returncode:
+        with open(os.path.join(workdir, 'stderr')) as err:
+            raise RuntimeError(err.read())
+    rss = usage.ru_maxrss
+
+    timing = read_timing_report(os.path.join(workdir, 'bench.timing'))
+    calc = timing['phases']['calc_forces']
+    result = {
+        'model': model,
+        'interaction': interaction,
+        'lattice': lattice,
+        'ntypes': args.ntypes,
+        'nconf': args.nconf,
+        'natoms': natoms,
+        'neighbors': timing['neighbors'],
+        'fcalls': calc['calls'],
+        'time': calc['time'],
+        'fcalls_per_s': calc['calls'] / calc['time'] if calc['time'] > 0 else 0.0,
+        'neighbors_per_s': calc['calls'] * timing['neighbors'] / calc['time'] if calc['time'] > 0 else 0.0,
+        'peak_rss_kb': rss,
+        'kb_per_atom': float(rss) / natoms,
+        'phases': timing['phases'],
+    }
+    return result
+
+
+def main():
+    args = parse_arguments()
+    if not os.path.isfile('wscript') or not os.path.isdir('src'):
+        sys.exit('Please run this script from the potfit base directory!')
+
+    results = []
+    for model, interaction in benchmarks:
+        if args.model and model not in args.model:
+            continue
+        if args.interaction and interaction not in args.interaction:
+            continue
+        workdir = tempfile.mkdtemp(prefix='potfit_bench_')
+        sys.stderr.write('Benchmarking {} {} ... '.format(model, interaction))
+        sys.stderr.flush()
+        try:
+            result = run_benchmark(model, interaction, args, workdir)
+            results.append(result)
+            sys.stderr.write('{:.1f} fcalls/s, {:.3e} neighbors/s\n'.format(
+                result['fcalls_per_s'], result['neighbors_per_s']))
+        except RuntimeError as e:
+            sys.stderr.write('failed\n{}\n'.format(e))
+        if args.keep:
+            sys.stderr.write('input files kept in {}\n'.format(workdir))
+        else:
+            shutil.rmtree(workdir)
+
+    output = json.dumps({'version': 1, 'benchmarks': results}, indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(output + '\n')
+    else:
+        print(output)
+
+
+if __name__ == "__main__":
+    main()